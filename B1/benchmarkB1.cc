@@ -0,0 +1,296 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file benchmarkB1.cc
+/// \brief Micro-benchmarks of the user-action hot paths of the B1 example
+//
+// Usage: benchmarkB1 [iterations]
+//
+// Builds the geometry and physics of exampleB1 (PHYSLIST is honoured),
+// opens a run without transporting anything, and calls on their own:
+//  - B1SteppingAction::UserSteppingAction on synthetic steps of photons
+//    and electrons located in the detectors, the shapes and the envelope;
+//  - B1PrimaryGeneratorAction::GeneratePrimaries;
+//  - B1EventAction::BeginOfEventAction and EndOfEventAction, with a few
+//    detectors hit per event;
+//  - B1Run::Merge of a worker run into the master run.
+// Every benchmark prints the wall-clock time and the number of heap
+// allocations per call (global operator new is counted, not the pools of
+// G4Allocator), so that changes to a hot path can be compared without the
+// noise of full transport.
+// The default number of iterations is 1000000 steps, and a tenth of it
+// for the other benchmarks. Always runs sequentially.
+
+#include "B1DetectorConstruction.hh"
+#include "B1ActionInitialization.hh"
+#include "B1EventAction.hh"
+#include "B1Run.hh"
+#include "B1FastShapes.hh"
+#include "B1PhysicsLists.hh"
+
+#include "G4RunManager.hh"
+#include "G4VModularPhysicsList.hh"
+#include "G4UserSteppingAction.hh"
+#include "G4VUserPrimaryGeneratorAction.hh"
+#include "G4TransportationManager.hh"
+#include "G4Navigator.hh"
+#include "G4TouchableHandle.hh"
+#include "G4PhysicalVolumeStore.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4LogicalVolume.hh"
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4DynamicParticle.hh"
+#include "G4Event.hh"
+#include "G4Gamma.hh"
+#include "G4Electron.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace
+{
+  // heap allocations since the start, the benchmark is single-threaded
+  unsigned long long allocations = 0;
+
+  class Stopwatch
+  {
+    public:
+      void Start()
+      {
+        fAllocations = allocations;
+        fStart = std::chrono::steady_clock::now();
+      }
+
+      void Stop(const char* name, long iterations)
+      {
+        double seconds = std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - fStart).count();
+        std::printf("%-34s %12.1f ns/call %10.2f allocations/call\n", name,
+                    1e9*seconds/iterations,
+                    double(allocations - fAllocations)/iterations);
+      }
+
+    private:
+      unsigned long long fAllocations;
+      std::chrono::steady_clock::time_point fStart;
+  };
+
+  // steps of the given particle at the given point, as seen by the
+  // stepping action
+  G4Step* MakeStep(G4Navigator& navigator, const G4ThreeVector& position,
+                   G4ParticleDefinition* particle, G4double energy)
+  {
+    navigator.LocateGlobalPointAndSetup(position, 0, false);
+    G4TouchableHandle touchable = navigator.CreateTouchableHistory();
+
+    G4DynamicParticle* dynamic
+      = new G4DynamicParticle(particle, G4ThreeVector(0., 0., 1.), energy);
+    G4Track* track = new G4Track(dynamic, 0., position);
+    G4Step* step = new G4Step;
+    step->SetTrack(track);
+    track->SetStep(step);
+    step->SetStepLength(0.1*mm);
+    step->SetTotalEnergyDeposit((particle == G4Gamma::Gamma()) ? 0. : 10.*keV);
+    G4StepPoint* points[2]
+      = { step->GetPreStepPoint(), step->GetPostStepPoint() };
+    for (G4int i = 0; i < 2; i++) {
+      points[i]->SetPosition(position);
+      points[i]->SetTouchableHandle(touchable);
+      points[i]->SetKineticEnergy(energy);
+      points[i]->SetWeight(1.);
+      points[i]->SetMaterial(
+        touchable->GetVolume()->GetLogicalVolume()->GetMaterial());
+    }
+    return step;
+  }
+}
+
+void* operator new(std::size_t size)
+{
+  allocations++;
+  void* pointer = std::malloc(size ? size : 1);
+  if (!pointer) throw std::bad_alloc();
+  return pointer;
+}
+
+void* operator new[](std::size_t size)
+{
+  allocations++;
+  void* pointer = std::malloc(size ? size : 1);
+  if (!pointer) throw std::bad_alloc();
+  return pointer;
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept
+{ std::free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept
+{ std::free(pointer); }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int main(int argc, char** argv)
+{
+  long iterations = (argc > 1) ? std::atol(argv[1]) : 1000000;
+  if (iterations < 10) iterations = 10;
+  long eventIterations = iterations/10;
+
+  // the generator reads the beam spot at every event
+  if (FILE* parameters_file = fopen("GunPositionParameters.txt", "r")) {
+    fclose(parameters_file);
+  }
+  else {
+    parameters_file = fopen("GunPositionParameters.txt", "w");
+    fprintf(parameters_file, "%f\t%f\t%f\t%f", 0.0f, 100.0f, 0.0f, 100.0f);
+    fclose(parameters_file);
+  }
+
+  G4Random::setTheEngine(new CLHEP::RanecuEngine);
+
+  G4RunManager* runManager = new G4RunManager;
+  runManager->SetUserInitialization(new B1DetectorConstruction());
+  G4VModularPhysicsList* physicsList
+    = B1PhysicsLists::Create(B1PhysicsLists::GetSelectedName());
+  if (B1FastShapes::IsModelBuilt()) {
+    physicsList->RegisterPhysics(new B1FastShapesPhysics);
+  }
+  runManager->SetUserInitialization(physicsList);
+  runManager->SetUserInitialization(new B1ActionInitialization());
+  runManager->Initialize();
+
+  // a run is opened for the actions which fill the current run
+  if (!runManager->ConfirmBeamOnCondition()) return 1;
+  runManager->RunInitialization();
+
+  G4UserSteppingAction* steppingAction
+    = const_cast<G4UserSteppingAction*>(runManager->GetUserSteppingAction());
+  B1EventAction* eventAction = static_cast<B1EventAction*>(
+    const_cast<G4UserEventAction*>(runManager->GetUserEventAction()));
+  G4VUserPrimaryGeneratorAction* generatorAction
+    = const_cast<G4VUserPrimaryGeneratorAction*>(
+        runManager->GetUserPrimaryGeneratorAction());
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>(
+        runManager->GetUserDetectorConstruction());
+  G4int nofDetectors = detectorConstruction->GetNumberOfScoringVolumes();
+
+  // steps at the centres of the volumes placed in the envelope (detectors
+  // and shapes) and at random points of the envelope, photons and
+  // electrons alternately
+  G4Navigator navigator;
+  navigator.SetWorldVolume(G4TransportationManager::GetTransportationManager()
+                           ->GetNavigatorForTracking()->GetWorldVolume());
+  std::vector<G4ThreeVector> positions;
+  G4PhysicalVolumeStore* volumeStore = G4PhysicalVolumeStore::GetInstance();
+  for (size_t i = 0; i < volumeStore->size(); i++) {
+    G4VPhysicalVolume* volume = (*volumeStore)[i];
+    G4LogicalVolume* mother = volume->GetMotherLogical();
+    if (mother && mother->GetName() == "Envelope") {
+      positions.push_back(volume->GetTranslation());
+    }
+  }
+  for (size_t i = 0, n = positions.size(); i < n; i++) {
+    positions.push_back(G4ThreeVector(40.*cm*(2.*G4UniformRand() - 1.),
+                                      40.*cm*(2.*G4UniformRand() - 1.),
+                                      40.*cm*(2.*G4UniformRand() - 1.)));
+  }
+  std::vector<G4Step*> steps;
+  for (size_t i = 0; i < positions.size(); i++) {
+    steps.push_back(MakeStep(navigator, positions[i], G4Gamma::Gamma(),
+                             1.*MeV));
+    steps.push_back(MakeStep(navigator, positions[i], G4Electron::Electron(),
+                             300.*keV));
+  }
+  std::printf("benchmarkB1: %d detectors, %d synthetic steps, "
+              "%ld iterations\n", nofDetectors, (int)steps.size(),
+              iterations);
+
+  Stopwatch stopwatch;
+  G4Event event(0);
+
+  // stepping action, within one event
+  eventAction->BeginOfEventAction(&event);
+  for (size_t i = 0; i < steps.size(); i++) {
+    steppingAction->UserSteppingAction(steps[i]);   // warm-up
+  }
+  stopwatch.Start();
+  for (long i = 0; i < iterations; i++) {
+    steppingAction->UserSteppingAction(steps[i % steps.size()]);
+  }
+  stopwatch.Stop("B1SteppingAction::UserSteppingAction", iterations);
+  eventAction->EndOfEventAction(&event);
+
+  // primary generation, the event owns and deletes the vertices
+  stopwatch.Start();
+  for (long i = 0; i < eventIterations; i++) {
+    G4Event generated(i);
+    generatorAction->GeneratePrimaries(&generated);
+  }
+  stopwatch.Stop("B1PrimaryGeneratorAction::Generate", eventIterations);
+
+  // event action, three detectors hit per event
+  stopwatch.Start();
+  for (long i = 0; i < eventIterations; i++) {
+    eventAction->BeginOfEventAction(&event);
+    for (G4int k = 0; k < 3 && nofDetectors > 0; k++) {
+      eventAction->AddEdep((i + 5*k) % nofDetectors, 100.*keV);
+    }
+    eventAction->EndOfEventAction(&event);
+  }
+  stopwatch.Stop("B1EventAction::Begin/EndOfEvent", eventIterations);
+
+  // merge of a filled worker run
+  B1Run masterRun(nofDetectors);
+  B1Run workerRun(nofDetectors);
+  for (G4int d = 0; d < nofDetectors; d++) {
+    workerRun.AddDetectorEdep(d, 1.*MeV);
+    workerRun.AddDetectorKerma(d, 1.*MeV);
+  }
+  stopwatch.Start();
+  for (long i = 0; i < eventIterations; i++) masterRun.Merge(&workerRun);
+  stopwatch.Stop("B1Run::Merge", eventIterations);
+
+  runManager->RunTermination();
+
+  for (size_t i = 0; i < steps.size(); i++) {
+    delete steps[i]->GetTrack();
+    delete steps[i];
+  }
+  delete runManager;
+  return 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -30,6 +30,25 @@
 
 #include "B1DetectorConstruction.hh"
 #include "B1ActionInitialization.hh"
+#include "B1PhaseSpace.hh"
+#include "B1ResponseKernel.hh"
+#include "B1UncollidedDose.hh"
+#include "B1EventStream.hh"
+#include "B1RunMetrics.hh"
+#include "B1RunSnapshots.hh"
+#include "B1EnergyResponse.hh"
+#include "B1QuasiRandom.hh"
+#include "B1CorrelatedSampling.hh"
+#include "B1Perturbation.hh"
+#include "B1AdjointScan.hh"
+#include "B1ResultCache.hh"
+#include "B1AdaptiveSweep.hh"
+#include "B1SurrogateModel.hh"
+#include "B1CutTuner.hh"
+#include "B1FastShapes.hh"
+#include "B1StepTrace.hh"
+#include "B1PhysicsLists.hh"
+#include "B1MemoryUsage.hh"
 
 #ifdef G4MULTITHREADED
 #include "G4MTRunManager.hh"
@@ -38,7 +57,8 @@
 #endif
 
 #include "G4UImanager.hh"
-#include "QBBC.hh"
+#include "G4Timer.hh"
+#include "G4VModularPhysicsList.hh"
 
 #ifdef G4VIS_USE
 #include "G4VisExecutive.hh"
@@ -78,10 +98,15 @@ int main(int argc,char** argv)
   //
   G4Random::setTheEngine(new CLHEP::RanecuEngine);
   
-  // Construct the default run manager
+  // Physics list, QBBC unless PHYSLIST selects another one
+  G4String physicsListName = B1PhysicsLists::GetSelectedName();
+
+  // Construct the default run manager, sequential for the reverse
+  // Monte Carlo which does not run multi-threaded
   //
 #ifdef G4MULTITHREADED
-  G4MTRunManager* runManager = new G4MTRunManager;
+  G4RunManager* runManager = (physicsListName == "adjoint")
+    ? new G4RunManager : new G4MTRunManager;
 #else
   G4RunManager* runManager = new G4RunManager;
 #endif
@@ -92,16 +117,46 @@ int main(int argc,char** argv)
   runManager->SetUserInitialization(new B1DetectorConstruction());
 
   // Physics list
-  G4VModularPhysicsList* physicsList = new QBBC;
+  G4VModularPhysicsList* physicsList = B1PhysicsLists::Create(physicsListName);
   physicsList->SetVerboseLevel(1);
+  if (B1FastShapes::IsModelBuilt()) {
+    physicsList->RegisterPhysics(new B1FastShapesPhysics);
+  }
   runManager->SetUserInitialization(physicsList);
     
   // User action initialization
   runManager->SetUserInitialization(new B1ActionInitialization());
 
+  // Shared output managers (their commands act on the master)
+  B1PhaseSpaceWriter* phaseSpaceWriter = B1PhaseSpaceWriter::Instance();
+  B1ResponseKernel* responseKernel = B1ResponseKernel::Instance();
+  B1EnergyResponse* energyResponse = B1EnergyResponse::Instance();
+  B1QuasiRandom* quasiRandom = B1QuasiRandom::Instance();
+  B1CorrelatedSampling* correlated = B1CorrelatedSampling::Instance();
+  B1Perturbation* perturbation = B1Perturbation::Instance();
+  B1AdjointScan* adjointScan = B1AdjointScan::Instance();
+  B1UncollidedDose* uncollidedDose = B1UncollidedDose::Instance();
+  B1EventStream* eventStream = B1EventStream::Instance();
+  B1RunMetrics* runMetrics = B1RunMetrics::Instance();
+  B1RunSnapshots* runSnapshots = B1RunSnapshots::Instance();
+  B1ResultCache* resultCache = B1ResultCache::Instance();
+  resultCache->SetExecutable(argv[0]);
+  B1AdaptiveSweep* adaptiveSweep = B1AdaptiveSweep::Instance();
+  B1SurrogateModel* surrogateModel = B1SurrogateModel::Instance();
+  B1CutTuner* cutTuner = B1CutTuner::Instance();
+  B1FastShapes* fastShapes = B1FastShapes::Instance();
+  B1StepTrace* stepTrace = B1StepTrace::Instance();
+
   // Initialize G4 kernel
   //
+  G4Timer initTimer;
+  initTimer.Start();
   runManager->Initialize();
+  initTimer.Stop();
+  runMetrics->AddPhaseTime("init", initTimer.GetRealElapsed());
+  G4cout << "Physics list " << physicsListName << ": initialization "
+         << initTimer.GetRealElapsed() << " s, resident memory "
+         << B1MemoryUsage::GetResidentSize()/(1024.*1024.) << " MB" << G4endl;
   
 #ifdef G4VIS_USE
   // Initialize visualization
@@ -137,8 +192,16 @@ int main(int argc,char** argv)
 	  size_x = min_size_x;
 	  size_y = min_size_y;
 
-	  //Setting random values generator
+	  //Setting random values generator, seeded once so that a relaunch
+	  //gets the same event counts (and the same cache keys)
 	  CLHEP::RanecuEngine theEngine;
+	  const char* seed = std::getenv("B1_SCAN_SEED");
+	  theEngine.setSeed(seed ? atol(seed) : 1);
+
+	  // the runs are cached unless B1_CACHE_DIR is none, an interrupted
+	  // scan then resumes from the positions already simulated
+	  const char* cacheDirectory = std::getenv("B1_CACHE_DIR");
+	  resultCache->SetDirectory(cacheDirectory ? cacheDirectory : "sweepCache");
 
 	  double mean = 0.0, standardDeviation = 0.05;
 
@@ -155,11 +218,10 @@ int main(int argc,char** argv)
 			 fflush(parameters_file);
 			 fclose(parameters_file);
 
-			 theEngine.setSeed(time(0));
 			 //Executing run for current position
 			 int forRandom = static_cast<int>(user_input * 50000.0f / 30.0f);
 			 int numGamma = std::abs(forRandom - 0.2 * forRandom * std::fabs(CLHEP::RandGauss::shoot(&theEngine, mean, standardDeviation)));
-			 runManager->BeamOn(numGamma);
+			 resultCache->BeamOn(numGamma);
 
 			 size_y += env_sizeXY / shapesArraySize;
 			 }
@@ -190,6 +252,23 @@ int main(int argc,char** argv)
   delete visManager;
 #endif
   delete runManager;
+  delete phaseSpaceWriter;
+  delete responseKernel;
+  delete energyResponse;
+  delete quasiRandom;
+  delete correlated;
+  delete perturbation;
+  delete adjointScan;
+  delete uncollidedDose;
+  delete eventStream;
+  delete runMetrics;
+  delete runSnapshots;
+  delete resultCache;
+  delete adaptiveSweep;
+  delete surrogateModel;
+  delete cutTuner;
+  delete fastShapes;
+  delete stepTrace;
 
   return 0;
 }
@@ -0,0 +1,127 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1AdaptiveSweep.hh
+/// \brief Definition of the B1AdaptiveSweep class
+
+#ifndef B1AdaptiveSweep_h
+#define B1AdaptiveSweep_h 1
+
+#include "globals.hh"
+
+#include <vector>
+
+class G4GenericMessenger;
+class B1Run;
+
+/// Adaptive sweep of the dose in one detector over the beam energy or the
+/// detector radius, run within one process.
+///
+/// The sweep starts from a coarse uniform grid (in log scale if asked),
+/// one batch of events per point. It then repeats the most useful of:
+///   - inserting the midpoint of the interval with the largest linear
+///     interpolation error, |y''| h^2/8 with y'' the second divided
+///     difference of the neighbouring points less twice its statistical
+///     error, so that noise is not taken for curvature;
+///   - adding events to the point with the largest relative error, as
+///     many as needed to bring it to the target (at most 8 batches),
+///     which equalises the relative errors of all points. A point
+///     without any deposit has an unbounded error and gets 8 batches at
+///     a time, up to 100 batches.
+/// Both are measured in units of the target relative error; the sweep
+/// ends when none exceeds 1, or when the time budget or the maximum
+/// number of points is reached. Runs go through B1ResultCache, so an
+/// interrupted sweep replays the points already simulated for free.
+///   /B1/sweep/parameter energy      (or detectorRadius)
+///   /B1/sweep/range 0.5 10 MeV
+///   /B1/sweep/logScale true
+///   /B1/sweep/initialPoints 5
+///   /B1/sweep/maxPoints 40
+///   /B1/sweep/eventsPerBatch 10000
+///   /B1/sweep/targetError 0.01
+///   /B1/sweep/timeBudget 2 h
+///   /B1/sweep/detector 0
+///   /B1/sweep/file sweep.txt
+///   /B1/sweep/run
+
+class B1AdaptiveSweep
+{
+  public:
+    static B1AdaptiveSweep* Instance();
+    ~B1AdaptiveSweep();
+
+    // called by the master run action
+    void EndOfRun(const B1Run* run);
+
+    void SetParameter(G4String parameter);
+    void SetRange(G4String range);
+    void Run();
+
+  private:
+    struct Point
+    {
+      G4double fX;
+      G4double fSum;     // energy deposit per event, summed
+      G4double fSum2;
+      G4double fEvents;
+      G4double fMass;
+
+      G4double GetDose() const;
+      G4double GetError() const;
+      G4double GetRelativeError() const;
+    };
+
+    B1AdaptiveSweep();
+    void DefineCommands();
+
+    void Simulate(size_t point, G4int nofEvents);
+    G4double GetCoordinate(G4double x) const;
+    G4double GetInterpolationError(size_t interval) const;
+    void Report() const;
+
+    static B1AdaptiveSweep* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4bool   fSweepEnergy;
+    G4double fMin, fMax;
+    G4bool   fLogScale;
+    G4int    fInitialPoints;
+    G4int    fMaxPoints;
+    G4int    fEventsPerBatch;
+    G4double fTargetError;
+    G4double fTimeBudget;
+    G4int    fDetector;
+    G4String fFileName;
+
+    std::vector<Point> fPoints;    // sorted in x
+    G4int              fCurrent;   // point being simulated, or -1
+    G4double           fAppliedX;  // parameter value last set
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
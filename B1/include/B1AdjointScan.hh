@@ -0,0 +1,130 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1AdjointScan.hh
+/// \brief Definition of the B1AdjointScan and B1AdjointPhysics classes
+
+#ifndef B1AdjointScan_h
+#define B1AdjointScan_h 1
+
+#include "G4VPhysicsConstructor.hh"
+#include "globals.hh"
+
+#include <vector>
+
+class G4GenericMessenger;
+
+/// Response maps of the detectors over the source plane by reverse
+/// Monte Carlo (G4AdjointSimManager), instead of one forward run per
+/// source position.
+///
+/// For every detector in turn, adjoint particles are started on the
+/// surface of the detector and transported backward until they leave the
+/// envelope. Each history also tracks the equivalent forward particle from
+/// the detector surface, and our stepping action scores its deposit. A
+/// history adds to the map when its adjoint track leaves through the front
+/// face of the envelope as the source particle, within the source energy
+/// band, and with a forward direction in the source cone around +z. The
+/// adjoint weight, times the deposit and the source density
+/// 1/(pixel area x band width x cone solid angle x cos theta), gives the
+/// mean deposit per source particle shot into the pixel. A parallel beam
+/// has no adjoint estimate; the cone trades a small bias for statistics.
+///
+/// The scan needs the adjoint physics and the sequential run manager,
+/// selected at startup with PHYSLIST=adjoint (see B1PhysicsLists).
+/// Commands (acting on the master):
+///   /B1/adjoint/particle gamma
+///   /B1/adjoint/eMin 5.9 MeV        (source energy band)
+///   /B1/adjoint/eMax 6.1 MeV
+///   /B1/adjoint/cone 5 deg          (half angle around +z)
+///   /B1/adjoint/adjointEmin 10 keV  (lowest energy entering a detector)
+///   /B1/adjoint/nX 20
+///   /B1/adjoint/nY 20
+///   /B1/adjoint/file adjoint_map.txt
+///   /B1/adjoint/scan 100000         (histories per detector)
+
+class B1AdjointScan
+{
+  public:
+    static B1AdjointScan* Instance();
+    ~B1AdjointScan();
+
+    G4bool IsActive() const { return fDetector >= 0; }
+
+    // the adjoint physics and a sequential run manager are in place
+    static G4bool IsAvailable();
+
+    // called by the event action, with the deposits of the forward phase
+    void EndOfEvent(const std::vector<G4double>& detectorEdep);
+
+    void Scan(G4int nofHistories);
+
+  private:
+    B1AdjointScan();
+    void DefineCommands();
+    G4bool SetUpSurfaces(G4int detector, G4String& volumeName);
+    void Write() const;
+
+    static B1AdjointScan* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4String fParticle;
+    G4double fEMin, fEMax;
+    G4double fCone;
+    G4double fAdjointEMin;
+    G4int    fNX, fNY;
+    G4String fFileName;
+
+    // map of the current scan
+    G4int                 fDetector;     // current detector, -1 if none
+    G4double              fFrontZ;
+    G4double              fX0, fY0, fPitchX, fPitchY;
+    G4double              fDensity;      // per unit of adjoint weight
+    std::vector<G4String> fDetectorNames;
+    std::vector<G4double> fMasses;
+    std::vector<G4double> fHistories;    // [detector]
+    std::vector<G4double> fSum;          // [detector*nX*nY + pixel]
+    std::vector<G4double> fSum2;
+};
+
+/// Electromagnetic physics of photons, electrons and positrons with the
+/// adjoint processes of the reverse Monte Carlo, for B1AdjointScan. Other
+/// charged particles are only transported.
+
+class B1AdjointPhysics : public G4VPhysicsConstructor
+{
+  public:
+    B1AdjointPhysics();
+    virtual ~B1AdjointPhysics();
+
+    virtual void ConstructParticle();
+    virtual void ConstructProcess();
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,82 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1AliasTable.hh
+/// \brief Definition of the B1AliasTable class
+
+#ifndef B1AliasTable_h
+#define B1AliasTable_h 1
+
+#include "globals.hh"
+
+#include <vector>
+
+/// Walker's alias table for sampling a discrete distribution in O(1).
+///
+/// The table is built once from a set of non-negative weights (Vose's
+/// construction, O(n)) and is read-only afterwards, so a single instance
+/// can be shared by all worker threads. Sample() needs one uniform number:
+/// its integer part selects a column, its fractional part decides between
+/// the column and its alias.
+
+class B1AliasTable
+{
+  public:
+    B1AliasTable();
+    B1AliasTable(const std::vector<G4double>& weights);
+    ~B1AliasTable();
+
+    void Build(const std::vector<G4double>& weights);
+
+    // returns an index in [0, GetSize()) distributed as the input weights
+    G4int Sample(G4double u) const;
+
+    G4int    GetSize() const { return (G4int)fThreshold.size(); }
+    G4double GetProbability(G4int i) const { return fProbability[i]; }
+    G4double GetTotalWeight() const { return fTotalWeight; }
+
+  private:
+    std::vector<G4double> fThreshold;
+    std::vector<G4int>    fAlias;
+    std::vector<G4double> fProbability;
+    G4double              fTotalWeight;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+inline G4int B1AliasTable::Sample(G4double u) const
+{
+  const G4int n = (G4int)fThreshold.size();
+  G4double x = u * n;
+  G4int i = (G4int)x;
+  if (i >= n) i = n - 1;
+  return (x - i < fThreshold[i]) ? i : fAlias[i];
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
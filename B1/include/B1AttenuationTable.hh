@@ -0,0 +1,118 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1AttenuationTable.hh
+/// \brief Definition of the B1AttenuationTable class
+
+#ifndef B1AttenuationTable_h
+#define B1AttenuationTable_h 1
+
+#include "globals.hh"
+
+#include <vector>
+
+class G4Material;
+
+/// Photon interaction coefficients of one material on a log-energy grid.
+///
+/// The linear coefficients of the photoelectric effect, Compton and
+/// Rayleigh scattering and pair production are taken from the models of
+/// the current physics list through G4EmCalculator, so the table matches
+/// what the transport uses. Besides the total attenuation coefficient mu,
+/// the energy-transfer coefficient mu_tr is kept: the photoelectric and
+/// pair terms weighted by the fraction of the photon energy given to
+/// charged particles (1 and 1 - 2mc^2/E) and Compton weighted by the
+/// Klein-Nishina mean energy-transfer fraction. Fluorescence is
+/// neglected.
+///
+/// The energy-absorption coefficient mu_en = mu_tr (1-g) removes the
+/// part g of the transferred energy that the electrons and positrons
+/// radiate while slowing down. It uses their radiative yield
+/// Y(T) = 1/T int_0^T S_rad/S_tot dT' in the continuous-slowing-down
+/// approximation, from the stopping powers of the same physics list:
+/// Y(E) for photoelectrons, Y averaged over the Klein-Nishina recoil
+/// spectrum (weighted by T) for Compton electrons, and Y((E - 2mc^2)/2)
+/// for pairs. In lead g is a few per cent at 1 MeV and about 10 % at
+/// 10 MeV.
+///
+/// Tables are built once per material, after the physics is initialised,
+/// and shared read-only by all threads.
+
+class B1AttenuationTable
+{
+  public:
+    enum Process { kPhot, kCompt, kConv, kRayl, kNofProcesses };
+
+    static const B1AttenuationTable* GetShared(const G4Material* material);
+
+    B1AttenuationTable(const G4Material* material);
+    ~B1AttenuationTable();
+
+    G4double GetMu(G4double energy) const
+      { return Interpolate(fMu, energy); }
+    G4double GetMuTr(G4double energy) const
+      { return Interpolate(fMuTr, energy); }
+    G4double GetMuEn(G4double energy) const
+      { return Interpolate(fMuEn, energy); }
+    G4double GetMu(Process process, G4double energy) const
+      { return Interpolate(fMuProcess[process], energy); }
+
+    const G4Material* GetMaterial() const { return fMaterial; }
+
+    static const char* GetProcessName(Process process);
+
+  private:
+    G4double Interpolate(const std::vector<G4double>& table,
+                         G4double energy) const;
+
+    const G4Material*     fMaterial;
+    G4double              fLogEMin;
+    G4double              fInvLogStep;
+    std::vector<G4double> fMu;
+    std::vector<G4double> fMuTr;
+    std::vector<G4double> fMuEn;
+    std::vector<G4double> fMuProcess[kNofProcesses];
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+inline G4double
+B1AttenuationTable::Interpolate(const std::vector<G4double>& table,
+                                G4double energy) const
+{
+  // linear in log(E), clamped to the grid
+  G4double x = (std::log(energy) - fLogEMin) * fInvLogStep;
+  if (x <= 0.) return table.front();
+  G4int i = (G4int)x;
+  if (i >= (G4int)table.size() - 1) return table.back();
+  G4double f = x - i;
+  return table[i] + f*(table[i+1] - table[i]);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,125 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1CorrelatedSampling.hh
+/// \brief Definition of the B1CorrelatedSampling class
+
+#ifndef B1CorrelatedSampling_h
+#define B1CorrelatedSampling_h 1
+
+#include "globals.hh"
+
+#include <vector>
+
+class B1Run;
+class G4GenericMessenger;
+
+/// Paired comparison of configurations with correlated sampling.
+///
+/// A configuration is a label and the commands which set it up (shape
+/// material or thickness, detector radius, ...). The configurations are run one after the other
+/// with the same number of primaries, and the random engine is reseeded at
+/// the start of every event from the event number, so that primary n has
+/// the same random numbers in every configuration, whatever the thread.
+/// The deposits per event and detector are kept for the first configuration
+/// only; the others are compared with it event by event as they run, and
+/// keep the sums of their doses and of the paired differences: the mean
+/// difference of the dose per primary, its standard error from the paired
+/// differences, and the error the same difference would have from
+/// independent runs. The histories
+/// stay correlated until they reach a region which differs, so the paired
+/// error is much smaller for small changes. Commands (acting on the
+/// master), the commands of a configuration are applied before its run
+/// and the last configuration stays set afterwards:
+///   /B1/correlated/add Pb
+///   /B1/correlated/command /B1/det/shapeMaterial G4_Pb
+///   /B1/correlated/add Al
+///   /B1/correlated/command /B1/det/shapeMaterial G4_Al
+///   /B1/correlated/add Pb-thicker
+///   /B1/correlated/command /B1/det/shapeMaterial G4_Pb
+///   /B1/correlated/command /B1/det/shapeThickness 1.1 mm
+///   /B1/correlated/seed 12345
+///   /B1/correlated/file correlated.txt
+///   /B1/correlated/run 20000      (primaries per configuration)
+///   /B1/correlated/clear
+
+class B1CorrelatedSampling
+{
+  public:
+    static B1CorrelatedSampling* Instance();
+    ~B1CorrelatedSampling();
+
+    G4bool IsActive() const { return fCurrent >= 0; }
+
+    // called by the primary generator of every thread, first thing
+    void SeedEvent(G4int eventID) const;
+
+    // called by the event action of every thread
+    void EndOfEvent(G4int eventID, const std::vector<G4int>& hitDetectors,
+                    const std::vector<G4double>& detectorEdep);
+
+    // called by the master run action
+    void BeginOfRun(G4int nofEvents, G4int nofDetectors);
+
+    void AddConfiguration(G4String label);
+    void AddCommand(G4String command);
+    void Clear();
+    void Run(G4int nofEvents);
+
+  private:
+    struct Configuration
+    {
+      G4String              fLabel;
+      std::vector<G4String> fCommands;
+      std::vector<G4double> fMasses;  // of the detectors
+      // per detector, sums over the events of the dose per primary and of
+      // its difference with the first configuration, and their squares
+      std::vector<G4double> fSum, fSum2, fSumDiff, fSumDiff2;
+      G4int                 fNofEvents;
+    };
+
+    B1CorrelatedSampling();
+    void DefineCommands();
+    void Write() const;
+
+    static B1CorrelatedSampling* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4int    fSeed;
+    G4String fFileName;
+
+    std::vector<Configuration> fConfigurations;
+    std::vector<G4double> fReference;  // [event*nofDetectors + detector]
+    G4int fReferenceDetectors;
+    G4int fCurrent;
+    G4int fNofEvents;
+    G4int fNofDetectors;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,105 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1CutTuner.hh
+/// \brief Definition of the B1CutTuner class
+
+#ifndef B1CutTuner_h
+#define B1CutTuner_h 1
+
+#include "globals.hh"
+
+#include <vector>
+#include <chrono>
+
+class G4GenericMessenger;
+class B1Run;
+
+/// Production-cut tuner: the coarsest cuts that leave the doses unbiased.
+///
+/// The same short run, with the same seeds, is repeated for every cut of
+/// a ladder, applied to the given regions (Shapes and Detectors, see
+/// B1DetectorConstruction). The finest cut is the reference. For every
+/// cut the time per event (event loop only, without the physics tables)
+/// and the change of the dose of every detector with its statistical
+/// error are printed. A cut is accepted when, for every detector with a
+/// reference dose, the upper bound |change| + 2 sigma stays within the
+/// tolerance; the fastest accepted cut is recommended and written out
+/// as a macro of /run/setCutForRegion commands, which is also applied.
+///   /B1/cutTuner/regions Shapes Detectors
+///   /B1/cutTuner/cuts 0.01 0.1 0.3 1 3 mm
+///   /B1/cutTuner/events 20000
+///   /B1/cutTuner/seeds 12345 67890
+///   /B1/cutTuner/tolerance 0.02
+///   /B1/cutTuner/macro tunedCuts.mac
+///   /B1/cutTuner/run
+
+class B1CutTuner
+{
+  public:
+    static B1CutTuner* Instance();
+    ~B1CutTuner();
+
+    // called by the master run action
+    void BeginOfRun();
+    void EndOfRun(const B1Run* run);
+
+    void SetCuts(G4String cuts);
+    void Run();
+
+  private:
+    struct Step
+    {
+      G4double              fCut;
+      G4double              fSeconds;   // event loop
+      G4double              fEvents;
+      std::vector<G4double> fSum;       // energy deposit per detector
+      std::vector<G4double> fSum2;
+    };
+
+    B1CutTuner();
+    void DefineCommands();
+    // false, with a warning, if a region is missing or refuses the cut
+    G4bool ApplyCut(G4double cut) const;
+
+    static B1CutTuner* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4String              fRegions;
+    std::vector<G4double> fCuts;
+    G4int                 fEvents;
+    G4String              fSeeds;
+    G4double              fTolerance;
+    G4String              fMacroName;
+
+    Step*                 fCurrent;   // step being run, or 0
+    std::chrono::steady_clock::time_point fStart;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
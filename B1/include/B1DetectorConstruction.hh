@@ -34,10 +34,50 @@
 #include "G4VUserDetectorConstruction.hh"
 #include "globals.hh"
 
+#include <vector>
+
 class G4VPhysicalVolume;
 class G4LogicalVolume;
+class G4Material;
+class G4GenericMessenger;
 
 /// Detector construction class to define materials and geometry.
+///
+/// Construct() can be called again after /run/reinitializeGeometry: the
+/// previous volumes are deleted from the geometry stores first, and the
+/// lists of shapes and detectors are refilled. Code caching volumes should
+/// compare GetGeometryId(), which changes with every construction.
+///
+/// The resident memory is printed after every construction at verbose
+/// level 1. A soak test rebuilds the geometry N times and aborts when the
+/// resident size grows by more than 1 MB after the first N/10 rebuilds:
+///   /B1/det/verbose 1
+///   /B1/det/soakTest 1000
+///
+/// The radius of the detectors can be changed between runs, the geometry
+/// is then rebuilt at the next run:
+///   /B1/det/detectorRadius 2.5 cm
+/// and so can the NIST materials of the shapes and of the detectors,
+/// optionally with their density scaled by a factor (none for the
+/// built-in G4_Pb or the materials of the GDML file):
+///   /B1/det/shapeMaterial G4_Al
+///   /B1/det/detectorMaterial G4_WATER 0.98
+///
+/// The shapes and the detectors are the regions Shapes and Detectors, so
+/// that they can have their own production cuts:
+///   /run/setCutForRegion Shapes 0.5 mm
+/// The fast transport model of the shapes (B1FastShapes) is attached to
+/// the region Shapes on every thread by ConstructSDandField().
+///
+/// When built with GDML support (B1_USE_GDML), the geometry can instead be
+/// read from a GDML file, and the current geometry can be written out as a
+/// starting point. Detectors are the volumes with the auxiliary tag
+/// ScoringVolume, or else named Tube_*; the shapes in front of them are
+/// tagged SolidVolume or named Box_*. The value of a tag gives the index
+/// of the volume, untagged volumes are ordered by name (Tube_1_10 after
+/// Tube_1_9). The generator expects a box named Envelope.
+///   /B1/det/exportGdml b1.gdml
+///   /B1/det/gdml b1.gdml            (none for the built-in geometry)
 
 class B1DetectorConstruction : public G4VUserDetectorConstruction
 {
@@ -46,13 +86,53 @@ class B1DetectorConstruction : public G4VUserDetectorConstruction
     virtual ~B1DetectorConstruction();
 
     virtual G4VPhysicalVolume* Construct();
+    virtual void ConstructSDandField();
     
-    G4LogicalVolume** GetScoringVolumes() const { return fScoringVolumeArray; }
-    G4LogicalVolume** GetSolidVolumes() const { return fSolidVolumeArray; }
+    const std::vector<G4LogicalVolume*>& GetScoringVolumes() const
+      { return fScoringVolumes; }
+    const std::vector<G4LogicalVolume*>& GetSolidVolumes() const
+      { return fSolidVolumes; }
+    G4int GetNumberOfScoringVolumes() const
+      { return (G4int)fScoringVolumes.size(); }
+    G4int GetGeometryId() const { return fGeometryId; }
+    G4double GetDetectorRadius() const { return fDetectorRadius; }
+    G4double GetShapeThickness() const { return fShapeThickness; }
+    const G4String& GetShapeMaterial() const { return fShapeMaterial; }
+    const G4String& GetDetectorMaterial() const { return fDetectorMaterial; }
+
+    // NIST material from "name [densityFactor]", 0 if unknown
+    static G4Material* FindMaterial(const G4String& specification);
+
+    void SetDetectorRadius(G4double radius);
+    void SetShapeThickness(G4double thickness);
+    void SetShapeMaterial(G4String name);
+    void SetDetectorMaterial(G4String name);
+    void SetGdmlFile(G4String fileName);
+    void ExportGdml(G4String fileName);
+    void SoakTest(G4int iterations);
 
   protected:
-    G4LogicalVolume** fScoringVolumeArray;
-    G4LogicalVolume** fSolidVolumeArray;
+    void DefineCommands();
+    G4VPhysicalVolume* ConstructBuiltIn();
+    G4VPhysicalVolume* ConstructFromGdml();
+    void SetRegion(const G4String& name,
+                   const std::vector<G4LogicalVolume*>& volumes,
+                   G4bool add);
+    G4bool SetMaterial(G4String& member, const G4String& name);
+    void ApplyMaterial(const std::vector<G4LogicalVolume*>& volumes,
+                       const G4String& name);
+
+    G4GenericMessenger*           fMessenger;
+    G4double                      fDetectorRadius;
+    G4double                      fShapeThickness;    // of the thinnest shape
+    G4String                      fGdmlFile;
+    G4String                      fShapeMaterial;     // empty: built-in
+    G4String                      fDetectorMaterial;
+    G4VPhysicalVolume*            fWorld;
+    std::vector<G4LogicalVolume*> fScoringVolumes;
+    std::vector<G4LogicalVolume*> fSolidVolumes;
+    G4int                         fGeometryId;
+    G4int                         fVerboseLevel;
 };
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
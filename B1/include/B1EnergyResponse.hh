@@ -0,0 +1,91 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1EnergyResponse.hh
+/// \brief Definition of the B1EnergyResponse class
+
+#ifndef B1EnergyResponse_h
+#define B1EnergyResponse_h 1
+
+#include "globals.hh"
+
+class B1Run;
+class G4GenericMessenger;
+
+/// Response of the detectors versus incident energy from a single run.
+///
+/// The primaries of the run are spread over [eMin, eMax], divided into
+/// nBins logarithmic bins: log-uniform over the whole range, or stratified,
+/// where event n is shot into bin n % nBins (log-uniform within the bin)
+/// so that all bins get the same number of primaries whatever the thread.
+/// The gun particle, spot and direction are unchanged. Every deposit is
+/// tallied per (energy bin, detector), and the mean deposit and dose per
+/// primary of every bin are written with their standard errors at the end
+/// of the run. Commands (acting on the master):
+///   /B1/response/eMin 10 keV
+///   /B1/response/eMax 10 MeV
+///   /B1/response/bins 40
+///   /B1/response/sampling stratified   (or logUniform)
+///   /B1/response/file response.txt
+///   /B1/response/run 400000            (primaries over all bins)
+
+class B1EnergyResponse
+{
+  public:
+    static B1EnergyResponse* Instance();
+    ~B1EnergyResponse();
+
+    G4bool IsActive() const { return fActive; }
+    G4int  GetNumberOfBins() const { return fNofBins; }
+
+    // returns the energy of the event and its bin;
+    // called by the primary generator of every thread
+    G4double SampleEnergy(G4int eventID, G4int& bin) const;
+
+    // called by the master run action
+    void EndOfRun(const B1Run* run);
+
+    void Run(G4int nofEvents);
+
+  private:
+    B1EnergyResponse();
+    void DefineCommands();
+    G4double GetBinEdge(G4int i) const;
+
+    static B1EnergyResponse* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4bool   fActive;
+    G4double fEMin, fEMax;
+    G4int    fNofBins;
+    G4String fSampling;
+    G4String fFileName;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,93 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1EnergySpectrum.hh
+/// \brief Definition of the B1EnergySpectrum class
+
+#ifndef B1EnergySpectrum_h
+#define B1EnergySpectrum_h 1
+
+#include "B1AliasTable.hh"
+#include "globals.hh"
+
+#include <vector>
+
+/// Tabulated energy spectrum of the primary source.
+///
+/// The spectrum is read from a text file with two columns, energy in MeV
+/// and relative weight; lines starting with '#' are comments.
+/// - discrete:  every row is a line (e.g. Co-60 1.173 and 1.332 MeV)
+/// - histogram: rows are bin lower edges with the weight of the bin,
+///              the energy of the last row closes the last bin
+///              (its weight is ignored); energies are flat within a bin.
+///
+/// The bins/lines are sampled with a B1AliasTable. Spectra are loaded
+/// once per process via GetShared() and are read-only afterwards, so all
+/// worker threads sample the same instance.
+
+class B1EnergySpectrum
+{
+  public:
+    enum Type { kDiscrete, kHistogram };
+
+    // returns the spectrum of the given file, loading it on first use;
+    // 0 if the file cannot be read
+    static const B1EnergySpectrum* GetShared(const G4String& fileName,
+                                             Type type);
+
+    B1EnergySpectrum(const G4String& fileName, Type type);
+    ~B1EnergySpectrum();
+
+    // sample with the thread random engine
+    G4double Sample() const;
+    // sample from two given uniform numbers (bin, position in bin)
+    G4double Sample(G4double u1, G4double u2) const;
+
+    // energies and probabilities to integrate over the spectrum: the lines,
+    // or pointsPerBin midpoints in every histogram bin
+    void GetQuadrature(std::vector<G4double>& energies,
+                       std::vector<G4double>& probabilities,
+                       G4int pointsPerBin = 8) const;
+
+    G4bool   IsValid() const { return fTable.GetSize() > 0; }
+    Type     GetType() const { return fType; }
+    const G4String& GetFileName() const { return fFileName; }
+    G4double GetMinEnergy() const { return fEnergies.front(); }
+    G4double GetMaxEnergy() const { return fEnergies.back(); }
+    G4double GetMeanEnergy() const { return fMeanEnergy; }
+
+  private:
+    G4String              fFileName;
+    Type                  fType;
+    std::vector<G4double> fEnergies;
+    B1AliasTable          fTable;
+    G4double              fMeanEnergy;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
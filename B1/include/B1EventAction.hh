@@ -34,8 +34,16 @@
 #include "G4UserEventAction.hh"
 #include "globals.hh"
 
+#include <vector>
+
 /// Event action class
 ///
+/// The energy deposited in each detector is collected in a per-detector
+/// array sized with the geometry; only the detectors hit in the event are reset and
+/// passed to B1Run, so nothing is allocated per event. The track-length
+/// kerma of the photons crossing the detectors is collected the same way.
+/// The scores of B1Perturbation (log of the weights and density
+/// derivatives of the history) are collected while it is active.
 
 class B1EventAction : public G4UserEventAction
 {
@@ -46,14 +54,41 @@ class B1EventAction : public G4UserEventAction
     virtual void BeginOfEventAction(const G4Event* event);
     virtual void EndOfEventAction(const G4Event* event);
 
-    void AddEdep(G4double edep) { fEdep += edep; }
+    void AddEdep(G4int detector, G4double edep);
+    void AddKerma(G4int detector, G4double kerma);
+    std::vector<G4double>& GetPerturbationScores()
+      { return fPerturbationScores; }
 
   private:
-    G4double  fEdep;
+    G4double               fEdep;
+    std::vector<G4double>  fDetectorEdep;
+    std::vector<G4int>     fHitDetectors;
+    std::vector<G4double>  fDetectorKerma;
+    std::vector<G4int>     fKermaDetectors;
+    std::vector<G4double>  fPerturbationScores;
 };
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
+inline void B1EventAction::AddEdep(G4int detector, G4double edep)
+{
+  fEdep += edep;
+  if (fDetectorEdep[detector] == 0. && edep > 0.) {
+    fHitDetectors.push_back(detector);
+  }
+  fDetectorEdep[detector] += edep;
+}
+
+inline void B1EventAction::AddKerma(G4int detector, G4double kerma)
+{
+  if (fDetectorKerma[detector] == 0. && kerma > 0.) {
+    fKermaDetectors.push_back(detector);
+  }
+  fDetectorKerma[detector] += kerma;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
 #endif
 
     
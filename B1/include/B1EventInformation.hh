@@ -0,0 +1,78 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1EventInformation.hh
+/// \brief Definition of the B1EventInformation class
+
+#ifndef B1EventInformation_h
+#define B1EventInformation_h 1
+
+#include "G4VUserEventInformation.hh"
+#include "globals.hh"
+
+#include <vector>
+
+/// Event information class
+///
+/// Carries what the primary generator knows about the event to the
+/// event action, e.g. the pencil beam of the response kernel the
+/// primary was shot into (-1 if none), the component of a mixed-field
+/// source it was sampled from (-1 if none), the incident energy bin of a
+/// B1EnergyResponse run (-1 if none), or the uncollided deposits
+/// per detector used as control variate (see B1UncollidedDose).
+
+class B1EventInformation : public G4VUserEventInformation
+{
+  public:
+    B1EventInformation();
+    virtual ~B1EventInformation();
+
+    virtual void Print() const;
+
+    void  SetBeamIndex(G4int index) { fBeamIndex = index; }
+    G4int GetBeamIndex() const { return fBeamIndex; }
+
+    void  SetSourceComponent(G4int index) { fSourceComponent = index; }
+    G4int GetSourceComponent() const { return fSourceComponent; }
+
+    void  SetEnergyBin(G4int bin) { fEnergyBin = bin; }
+    G4int GetEnergyBin() const { return fEnergyBin; }
+
+    std::vector<G4double>& GetUncollidedDeposits() { return fUncollided; }
+    const std::vector<G4double>& GetUncollidedDeposits() const
+      { return fUncollided; }
+
+  private:
+    G4int                 fBeamIndex;
+    G4int                 fSourceComponent;
+    G4int                 fEnergyBin;
+    std::vector<G4double> fUncollided;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
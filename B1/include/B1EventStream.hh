@@ -0,0 +1,94 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1EventStream.hh
+/// \brief Definition of the B1EventStream class
+
+#ifndef B1EventStream_h
+#define B1EventStream_h 1
+
+#include "B1EventStreamFormat.hh"
+#include "G4Timer.hh"
+#include "globals.hh"
+
+#include <vector>
+
+class G4GenericMessenger;
+
+/// Optional event-level output: one (event, detector, edep) record for
+/// every detector hit in an event, for coincidence and crosstalk studies.
+///
+/// At the beginning of a run the master creates the file with one segment
+/// per worker thread and maps it in memory; the workers copy their records
+/// straight into their segment, without locks or system calls, and publish
+/// the new record count after each event (see B1EventStreamFormat.hh).
+/// Records of a full segment are counted as dropped. Unused parts of the
+/// preallocated file stay sparse on disk. streamReader reads the file
+/// zero-copy, also while the run is going on. Commands:
+///   /B1/eventStream/file events.bin   (none to disable)
+///   /B1/eventStream/capacity 4000000  (records per thread)
+
+class B1EventStream
+{
+  public:
+    static B1EventStream* Instance();
+    ~B1EventStream();
+
+    G4bool IsActive() const { return fActive; }
+
+    void BeginOfRun(G4int runID, G4int nofDetectors);
+    void EndOfRun();
+
+    // called by the event action of every thread
+    void WriteEvent(G4int eventID, const std::vector<G4int>& detectors,
+                    const std::vector<G4double>& edep);
+
+    void SetFileName(G4String fileName);
+
+  private:
+    B1EventStream();
+    void DefineCommands();
+    void Close();
+
+    static B1EventStream* fgInstance;
+
+    G4GenericMessenger*  fMessenger;
+    G4String             fFileName;
+    G4int                fCapacity;  // records per segment
+    G4bool               fActive;
+
+    G4int                fFile;
+    char*                fBase;      // mapping of the whole file
+    size_t               fSize;
+    B1EventStreamHeader* fHeader;
+    B1EventStreamRecord* fRecords;
+    G4Timer              fTimer;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
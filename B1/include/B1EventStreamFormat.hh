@@ -0,0 +1,71 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1EventStreamFormat.hh
+/// \brief Layout of the per-event deposition stream file
+
+#ifndef B1EventStreamFormat_h
+#define B1EventStreamFormat_h 1
+
+#include <stdint.h>
+
+// Layout of the file written by B1EventStream, shared with the reader
+// tool (which does not depend on Geant4).
+//
+// The header is followed, at fDataOffset, by fNofSegments segments of
+// fSegmentCapacity records each; every worker thread appends to its own
+// segment. fCounts[s] is the number of records of segment s that are
+// complete: it is stored with release semantics after the records of a
+// whole event are written, so a reader loading it with acquire semantics
+// can process the segment up to there while the run goes on. fComplete is
+// set when the run is over.
+
+const uint32_t kB1EventStreamMaxSegments = 256;
+
+/// Energy deposited in one detector in one event (16 bytes).
+struct B1EventStreamRecord
+{
+  int32_t fEventID;
+  int32_t fDetector;
+  double  fEdep;     // MeV, weighted
+};
+
+/// File header, magic "B1EVS001".
+struct B1EventStreamHeader
+{
+  char     fMagic[8];
+  uint32_t fNofSegments;
+  uint32_t fNofDetectors;
+  uint64_t fSegmentCapacity;
+  uint64_t fDataOffset;
+  uint32_t fRunID;
+  uint32_t fComplete;
+  uint64_t fCounts[kB1EventStreamMaxSegments];
+  uint64_t fDropped[kB1EventStreamMaxSegments];  // records not written, segment full
+};
+
+#endif
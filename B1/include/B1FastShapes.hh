@@ -0,0 +1,232 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1FastShapes.hh
+/// \brief Definition of the B1FastShapes, B1ShapeFastModel and
+///        B1FastShapesPhysics classes
+
+#ifndef B1FastShapes_h
+#define B1FastShapes_h 1
+
+#include "G4VFastSimulationModel.hh"
+#include "G4VPhysicsConstructor.hh"
+#include "globals.hh"
+
+#include <vector>
+#include <map>
+#include <chrono>
+
+class G4Step;
+class G4Region;
+class G4ParticleDefinition;
+class G4GenericMessenger;
+class B1Run;
+
+/// Calibration tables and modes of the fast shape transport.
+///
+/// Calibration is a run with full transport in which the stepping action
+/// follows every photon, electron and positron entering a shape, with the
+/// secondaries created inside it, and records the particles leaving the
+/// shape (particle, fraction of the incident energy, cosine to the
+/// incident direction). Photons of a line, annihilation or fluorescence
+/// photons leaving the shape unscattered, keep their energy instead of a
+/// fraction, so that replays at other energies of the bin do not smear
+/// the line. The histories, including those without any exit,
+/// are binned by material, particle, energy (log bins) and chord; the
+/// first maxHistories of every bin are kept. Commands (on the master):
+///   /B1/fastShapes/energyBins 10        (bins per decade from 1 keV)
+///   /B1/fastShapes/chordBin 1 mm
+///   /B1/fastShapes/maxHistories 2000
+///   /B1/fastShapes/minHistories 100     (fewer: transported in full)
+///   /B1/fastShapes/calibrate 1000000    (full-transport run)
+///   /B1/fastShapes/save shapes.bin
+///   /B1/fastShapes/load shapes.bin
+///   /B1/fastShapes/enable true          (use the model in the runs)
+///   /B1/fastShapes/validate 100000
+///
+/// Validation runs the same number of events with full transport and with
+/// the model, and prints the dose of every detector for both, their
+/// difference in standard deviations, and the speed-up of the event loop.
+///
+/// The fast simulation process and the model are only set up when the
+/// environment variable B1_FASTSHAPES is 1 at startup, read before the
+/// initialization like PHYSLIST; otherwise the runs pay nothing for them,
+/// and enable and validate refuse to run (calibration works either way).
+
+class B1FastShapes
+{
+  public:
+    enum Mode { kOff, kCalibrate, kFast };
+
+    // exit of one particle from a shape
+    struct Exit
+    {
+      const G4ParticleDefinition* fParticle;
+      G4float                     fEnergy;     // fraction of the incident
+                                               // energy, minus the energy
+                                               // of a line photon
+      G4float                     fCos;        // to the incident direction
+
+      G4double GetEnergy(G4double incident) const
+        { return (fEnergy >= 0.f) ? fEnergy*incident : -fEnergy; }
+    };
+    // histories of one bin; history i is fExits[fStart[i]..fStart[i+1])
+    struct Bin
+    {
+      std::vector<G4int> fStart;
+      std::vector<Exit>  fExits;
+      G4int GetNumberOfHistories() const { return (G4int)fStart.size(); }
+    };
+
+    static B1FastShapes* Instance();
+    ~B1FastShapes();
+
+    // fast simulation process and model set up, from B1_FASTSHAPES
+    static G4bool IsModelBuilt();
+
+    Mode GetMode() const { return fMode; }
+    G4bool IsCalibrating() const { return fMode == kCalibrate; }
+
+    // bin of a track entering a shape, 0 if too few histories
+    const Bin* FindBin(const G4String& material,
+                       const G4ParticleDefinition* particle,
+                       G4double energy, G4double chord) const;
+
+    // entry of a track into a shape, replayed or transported in full;
+    // on every thread
+    void CountEntry(G4bool replayed);
+
+    // calibration, on every thread
+    void BeginOfEvent();
+    void ProcessStep(const G4Step* step);
+    void EndOfEvent();
+
+    // called by the run action, of the master for BeginOfRun
+    void BeginOfRun();
+    void EndOfRun(G4bool isMaster, const B1Run* run);
+
+    void Calibrate(G4int nofEvents);
+    void Validate(G4int nofEvents);
+    void Save(G4String fileName);
+    void Load(G4String fileName);
+    void Enable(G4bool enable);
+    void SetEnergyBins(G4int binsPerDecade);
+    void SetChordBin(G4double width);
+    void Clear();
+
+  private:
+    // material, particle (PDG code), energy bin, chord bin
+    struct Key
+    {
+      G4String fMaterial;
+      G4int    fParticle;
+      G4int    fEnergyBin;
+      G4int    fChordBin;
+      G4bool operator<(const Key& other) const;
+    };
+    typedef std::map<Key, Bin> Table;
+    struct ThreadData;
+
+    struct ValidationRun
+    {
+      G4double              fSeconds;   // event loop
+      G4double              fEvents;
+      std::vector<G4double> fSum;       // energy deposit per detector
+      std::vector<G4double> fSum2;
+    };
+
+    B1FastShapes();
+    void DefineCommands();
+    G4bool MakeKey(const G4String& material,
+                   const G4ParticleDefinition* particle,
+                   G4double energy, G4double chord, Key& key) const;
+    ThreadData* GetThreadData();
+    void Merge(ThreadData* data);
+
+    static B1FastShapes* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    Mode     fMode;
+    G4int    fBinsPerDecade;
+    G4double fChordBin;
+    G4int    fMaxHistories;
+    G4int    fMinHistories;
+    Table    fTable;
+    G4double fReplayed;
+    G4double fTransported;
+    std::vector<ThreadData*> fThreadData;
+
+    ValidationRun* fCurrent;
+    std::chrono::steady_clock::time_point fStart;
+};
+
+/// Fast simulation of the transport through the shapes.
+///
+/// A photon, electron or positron entering a shape (region Shapes) is
+/// replaced by the particles that leave the shape in one history drawn
+/// from the calibration table of its material, particle, energy and chord
+/// (the path length through the shape along its direction). The exit
+/// energies are scaled to the energy of the track, except for the line
+/// photons, the exit directions
+/// keep their angle to the incident direction with a random azimuth, and
+/// the particles leave from the exit point of the chord (forward) or from
+/// the entry point (backward); the lateral spread inside the shape is
+/// neglected. The energy not carried away is deposited in the shape.
+/// Tracks whose table bin has too few histories are transported in full.
+
+class B1ShapeFastModel : public G4VFastSimulationModel
+{
+  public:
+    B1ShapeFastModel(G4Region* region);
+    virtual ~B1ShapeFastModel();
+
+    virtual G4bool IsApplicable(const G4ParticleDefinition& particle);
+    virtual G4bool ModelTrigger(const G4FastTrack& fastTrack);
+    virtual void   DoIt(const G4FastTrack& fastTrack, G4FastStep& fastStep);
+
+  private:
+    B1FastShapes*            fFastShapes;
+    const B1FastShapes::Bin* fBin;      // bin found by the last trigger
+    G4double                 fChord;
+};
+
+/// Physics constructor adding the fast simulation process to photons,
+/// electrons and positrons; the model decides when it applies.
+
+class B1FastShapesPhysics : public G4VPhysicsConstructor
+{
+  public:
+    B1FastShapesPhysics();
+    virtual ~B1FastShapesPhysics();
+
+    virtual void ConstructParticle();
+    virtual void ConstructProcess();
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,146 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1Perturbation.hh
+/// \brief Definition of the B1Perturbation class
+
+#ifndef B1Perturbation_h
+#define B1Perturbation_h 1
+
+#include "globals.hh"
+
+#include <vector>
+#include <map>
+
+class B1Run;
+class B1AttenuationTable;
+class G4Step;
+class G4Material;
+class G4GenericMessenger;
+
+/// Dose of perturbed materials from the histories of the nominal geometry.
+///
+/// A perturbation replaces the material of a region, the shapes or the
+/// detectors, by another NIST material or by the same one with its density
+/// scaled. Every history of the nominal run gets the likelihood ratio of
+/// its photon transport in the perturbed and nominal materials: for every
+/// photon step of length s in the region, exp(-(mu' - mu) s), times
+/// mu_p'/mu_p when the step ends with an interaction of process p, the
+/// coefficients being those of B1AttenuationTable. The mean of the weighted
+/// deposits is the deposit of the perturbed geometry, with its standard
+/// error, and the mean weight (expected to be 1) is printed as a check.
+/// The dose of a perturbed detector uses its perturbed mass.
+///
+/// Only the photons are reweighted: the electrons are transported as in
+/// the nominal materials, which is fair when the perturbation acts through
+/// the attenuation and scattering of the beam and less so for the
+/// deposits of electrons crossing a perturbed boundary. The shapes handled
+/// by the fast model (B1FastShapes) have no photon steps to reweight.
+///
+/// The first-order sensitivity of the dose to the density of each region
+/// is also scored (differential operator: the derivative of the weight at
+/// the nominal density is the number of photon interactions minus the
+/// optical depth crossed in the region).
+///
+/// The validation runs the nominal geometry, then every perturbed geometry
+/// directly with the same number of primaries, and compares the estimates.
+/// Commands (acting on the master):
+///   /B1/perturb/add Pb95 shapes same 0.95   (label region material factor)
+///   /B1/perturb/add water detectors G4_WATER
+///   /B1/perturb/file perturbation.txt
+///   /B1/perturb/validate 50000
+///   /B1/perturb/clear
+
+class B1Perturbation
+{
+  public:
+    enum Region { kShapes, kDetectors, kNofRegions };
+
+    static B1Perturbation* Instance();
+    ~B1Perturbation();
+
+    G4bool IsActive() const { return !fPerturbations.empty() && !fSuspended; }
+
+    // perturbations, then the density derivative of every region
+    G4int GetNumberOfScores() const
+      { return (G4int)fPerturbations.size() + kNofRegions; }
+
+    // called by the stepping action of every thread for the steps in a
+    // region, the scores of the event are the log of the weights and the
+    // density derivatives
+    void ProcessStep(const G4Step* step, Region region,
+                     std::vector<G4double>& scores) const;
+
+    // called by the event action of every thread
+    void EndOfEvent(B1Run* run, const std::vector<G4double>& scores,
+                    const std::vector<G4int>& hitDetectors,
+                    const std::vector<G4double>& detectorEdep) const;
+
+    // called by the master run action
+    void BeginOfRun();
+    void EndOfRun(const B1Run* run);
+
+    void AddPerturbation(G4String definition);
+    void Clear();
+    void Validate(G4int nofEvents);
+
+  private:
+    struct Perturbation
+    {
+      G4String  fLabel;
+      Region    fRegion;
+      G4String  fMaterialName;  // "same" for a density change only
+      G4double  fFactor;        // of the density
+      const B1AttenuationTable* fTable;  // of the perturbed material, if any
+    };
+
+    B1Perturbation();
+    void DefineCommands();
+    G4String GetSpecification(const Perturbation& perturbation) const;
+    G4double GetMassFactor(const Perturbation& perturbation,
+                           const G4Material* nominal) const;
+
+    static B1Perturbation* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4String fFileName;
+    std::vector<Perturbation> fPerturbations;
+    G4bool   fSuspended;
+
+    // nominal materials of the regions, filled by the master at the
+    // start of the run and read by the worker threads
+    std::map<const G4Material*, const B1AttenuationTable*> fTables;
+
+    // validation: reweighted and direct dose per perturbation and detector
+    G4bool fValidating;
+    std::vector<std::vector<G4double> > fEstimates, fEstimateErrors;
+    std::vector<std::vector<G4double> > fDirect, fDirectErrors;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
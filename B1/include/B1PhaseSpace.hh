@@ -0,0 +1,149 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1PhaseSpace.hh
+/// \brief Definition of the B1PhaseSpaceWriter and B1PhaseSpaceReader classes
+
+#ifndef B1PhaseSpace_h
+#define B1PhaseSpace_h 1
+
+#include "globals.hh"
+
+#include <vector>
+#include <cstdio>
+
+#include <stdint.h>
+
+class G4Step;
+class G4GenericMessenger;
+
+/// One particle crossing the phase-space plane (36 bytes on disk).
+/// Energy in MeV, positions in mm, z is the plane position of the file.
+/// The history is the event of the recording run the particle comes from.
+
+struct B1PhaseSpaceRecord
+{
+  int32_t fPDG;
+  float   fEnergy;
+  float   fX, fY;
+  float   fU, fV, fW;
+  float   fWeight;
+  int32_t fHistory;
+};
+
+/// File header: magic "B1PHSP02", number of records, number of source
+/// histories the records were recorded from, plane position in mm.
+
+struct B1PhaseSpaceHeader
+{
+  char     fMagic[8];
+  uint64_t fRecords;
+  uint64_t fHistories;
+  double   fPlaneZ;
+};
+
+/// Phase-space recorder.
+///
+/// Every particle crossing the plane z = const in the forward direction is
+/// written to a binary file. Records are buffered per thread and appended
+/// to the single output file under a lock; the header is completed when
+/// the master closes the file at the end of the run. Optionally the
+/// particles are killed at the plane so that a recording run does not pay
+/// for the transport downstream of it. Commands:
+///   /B1/phaseSpace/record phsp.bin   (none to stop recording)
+///   /B1/phaseSpace/plane 5 cm
+///   /B1/phaseSpace/killAtPlane true
+
+class B1PhaseSpaceWriter
+{
+  public:
+    static B1PhaseSpaceWriter* Instance();
+    ~B1PhaseSpaceWriter();
+
+    G4bool IsActive() const { return fActive; }
+
+    // called by the stepping action of every thread
+    void ProcessStep(const G4Step* step);
+
+    void BeginOfRun();
+    void EndOfRun(G4bool isMaster, G4int nofHistories);
+
+    void SetFileName(G4String fileName);
+
+  private:
+    B1PhaseSpaceWriter();
+    void Flush();
+    void DefineCommands();
+
+    static B1PhaseSpaceWriter* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4String            fFileName;
+    G4double            fPlaneZ;
+    G4bool              fKillAtPlane;
+    G4bool              fActive;
+    FILE*               fFile;
+    uint64_t            fRecords;
+};
+
+/// Phase-space file loaded in memory, shared read-only by all threads.
+/// The records are grouped by history, in the order of the histories.
+
+class B1PhaseSpaceReader
+{
+  public:
+    // returns the phase space of the given file, loading it on first use
+    // and again when the file changed since; 0 if it cannot be read
+    static const B1PhaseSpaceReader* GetShared(const G4String& fileName);
+
+    B1PhaseSpaceReader(const G4String& fileName);
+    ~B1PhaseSpaceReader();
+
+    G4bool   IsValid() const { return !fRecords.empty(); }
+    G4int    GetNumberOfRecords() const { return (G4int)fRecords.size(); }
+    G4double GetNumberOfHistories() const { return (G4double)fHistories; }
+    G4double GetPlaneZ() const { return fPlaneZ; }
+    const G4String& GetFileName() const { return fFileName; }
+    const B1PhaseSpaceRecord& GetRecord(G4int i) const { return fRecords[i]; }
+
+    // histories with at least one record, and their records [begin, end)
+    G4int GetNumberOfRecordedHistories() const
+      { return (G4int)fHistoryStarts.size() - 1; }
+    G4int GetHistoryBegin(G4int h) const { return fHistoryStarts[h]; }
+    G4int GetHistoryEnd(G4int h) const { return fHistoryStarts[h+1]; }
+
+  private:
+    G4String                        fFileName;
+    std::vector<B1PhaseSpaceRecord> fRecords;
+    std::vector<G4int>              fHistoryStarts;
+    uint64_t                        fHistories;
+    G4double                        fPlaneZ;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
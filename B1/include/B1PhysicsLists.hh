@@ -0,0 +1,63 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1PhysicsLists.hh
+/// \brief Definition of the B1PhysicsLists class
+
+#ifndef B1PhysicsLists_h
+#define B1PhysicsLists_h 1
+
+#include "globals.hh"
+
+class G4VModularPhysicsList;
+
+/// Physics list chosen at startup by the environment variable PHYSLIST.
+///
+/// The gamma shielding runs need electromagnetic physics only; the
+/// EM-only lists skip the hadronic and neutron tables of the reference
+/// lists, which take most of the initialization time and memory
+/// (photonuclear reactions in lead start above 7 MeV). Names:
+///   emstandard, emstandard_opt1 ... emstandard_opt4
+///   livermore, penelope               (low-energy models)
+///   adjoint                           (with the reverse Monte Carlo of
+///                                      B1AdjointScan, sequential run)
+///   any reference list of G4PhysListFactory, e.g. QBBC (the default),
+///   FTFP_BERT or QGSP_BIC_LIV
+/// For example: PHYSLIST=emstandard_opt4 ./exampleB1
+
+class B1PhysicsLists
+{
+  public:
+    // name from PHYSLIST, QBBC if not set
+    static G4String GetSelectedName();
+    // the list of that name, QBBC if unknown
+    static G4VModularPhysicsList* Create(const G4String& name);
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -33,16 +33,64 @@
 
 #include "G4VUserPrimaryGeneratorAction.hh"
 #include "G4ParticleGun.hh"
+#include "B1AliasTable.hh"
 #include "globals.hh"
 
+#include <vector>
+
 class G4ParticleGun;
+class G4ParticleDefinition;
 class G4Event;
 class G4Box;
+class G4GenericMessenger;
+class B1EnergySpectrum;
+class B1PhaseSpaceReader;
 
 /// The primary generator action class with particle gun.
 ///
 /// The default kinematic is a 6 MeV gamma, randomly distribued 
 /// in front of the phantom across 80% of the (X,Y) phantom size.
+///
+/// Instead of the monoenergetic gun energy, the energy can be sampled
+/// from a tabulated spectrum (see B1EnergySpectrum) and the direction
+/// can be spread uniformly within a cone around the beam axis:
+///   /B1/gun/spectrumType histogram|discrete
+///   /B1/gun/spectrum co60.spec      (none to switch back)
+///   /B1/gun/divergence 2 deg
+///
+/// Transport can also be restarted from a phase space recorded with
+/// B1PhaseSpaceWriter: event n replays all the particles of source
+/// history n (modulo the number of histories of the file), each split
+/// into N copies of weight 1/N. Histories without any particle at the
+/// plane give empty events, so that doses and their errors stay per
+/// source history:
+///   /B1/gun/phaseSpace phsp.bin     (none to switch back)
+///   /B1/gun/recycle 4
+///
+/// A mixed field is a list of source components weighted by intensity,
+/// one of which is sampled for every event (alias table). Each has its
+/// own particle, energy or spectrum, and optionally its own beam spot
+/// (otherwise the one of GunPositionParameters.txt); the deposits are
+/// also tallied per component. The commands edit the last component:
+///   /B1/source/add gamma 0.8        (particle, relative intensity)
+///   /B1/source/energy 1.25 MeV
+///   /B1/source/add neutron 0.2
+///   /B1/source/spectrum fission.spec
+///   /B1/source/spot 0 20 0 20       (x, width x, y, width y in cm)
+///   /B1/source/clear
+///
+/// With /B1/uncollided/controlVariate, every gun photon carries its
+/// analytic uncollided deposits (see B1UncollidedDose), except in a
+/// mixed field.
+///
+/// The uniform numbers of the spot position, spectrum energy and
+/// direction can be quasi-random or stratified (see B1QuasiRandom).
+///
+/// During a B1CorrelatedSampling comparison, the random engine is
+/// reseeded from the event number before the primary is generated.
+///
+/// During a B1EnergyResponse run, the energy of the primary is sampled
+/// over the response energy range instead.
 
 class B1PrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction
 {
@@ -55,10 +103,55 @@ class B1PrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction
   
     // method to access particle gun
     const G4ParticleGun* GetParticleGun() const { return fParticleGun; }
+    const B1EnergySpectrum* GetSpectrum() const { return fSpectrum; }
+    const B1PhaseSpaceReader* GetPhaseSpace() const { return fPhaseSpace; }
+
+    void SetSpectrum(G4String fileName);
+    void SetPhaseSpace(G4String fileName);
+
+    // mixed-field source
+    G4int GetNumberOfComponents() const { return (G4int)fComponents.size(); }
+    std::vector<G4String> GetComponentNames() const;
+
+    void AddComponent(G4String component);
+    void SetComponentEnergy(G4double energy);
+    void SetComponentSpectrum(G4String fileName);
+    void SetComponentSpot(G4String spot);
+    void ClearComponents();
   
   private:
+    struct SourceComponent
+    {
+      G4ParticleDefinition*   fParticle;
+      G4double                fIntensity;
+      G4double                fEnergy;
+      const B1EnergySpectrum* fSpectrum;  // shared, not owned
+      G4bool                  fHasSpot;
+      G4double                fX, fWidthX, fY, fWidthY;
+    };
+
+    void DefineCommands();
+    void GeneratePhaseSpacePrimaries(G4Event*);
+    void AttachControlVariate(G4Event*);
+
     G4ParticleGun*  fParticleGun; // pointer a to G4 gun class
     G4Box* fEnvelopeBox;
+
+    G4GenericMessenger*     fMessenger;
+    G4String                fSpectrumType;
+    const B1EnergySpectrum* fSpectrum;  // shared, not owned
+    G4double                fMonoEnergy;
+    G4double                fDivergence;
+    G4bool                  fDiverged;
+
+    const B1PhaseSpaceReader* fPhaseSpace;  // shared, not owned
+    G4int                     fRecycle;
+
+    G4GenericMessenger*          fSourceMessenger;
+    std::vector<SourceComponent> fComponents;
+    B1AliasTable                 fComponentTable;
+    G4ParticleDefinition*        fGunParticle;  // restored by ClearComponents
+    G4double                     fGunEnergy;
 };
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,100 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1PulseHeightSpectra.hh
+/// \brief Definition of the B1PulseHeightSpectra class
+
+#ifndef B1PulseHeightSpectra_h
+#define B1PulseHeightSpectra_h 1
+
+#include "globals.hh"
+
+#include <vector>
+#include <cmath>
+
+/// Distributions of the energy deposited per event, one per detector.
+///
+/// All detectors share one binning, linear or logarithmic in energy, with
+/// an underflow and an overflow bin. The counts of all detectors are kept
+/// in a single contiguous array (detectors x (bins+2)) allocated once, so
+/// filling never allocates. An instance is owned by each thread-local
+/// B1Run and merged into the master one in B1Run::Merge().
+///
+/// Write() produces a compact binary file: the magic "B1PHS001", the
+/// number of detectors, bins and the log flag (3 x int32), the range in
+/// MeV and the number of events (3 x double), then the counts (double)
+/// detector by detector, underflow first and overflow last.
+
+class B1PulseHeightSpectra
+{
+  public:
+    B1PulseHeightSpectra(G4int nofDetectors, G4int nofBins,
+                         G4double eMin, G4double eMax, G4bool logBinning);
+    ~B1PulseHeightSpectra();
+
+    void Fill(G4int detector, G4double edep, G4double weight = 1.);
+    void Merge(const B1PulseHeightSpectra& other);
+    void Reset();
+
+    G4bool Write(const G4String& fileName, G4double nofEvents) const;
+
+    G4int    GetNumberOfDetectors() const { return fNofDetectors; }
+    G4int    GetNumberOfBins() const { return fNofBins; }
+    // bin 0 is the underflow, bin nofBins+1 the overflow
+    G4double GetCount(G4int detector, G4int bin) const
+      { return fCounts[detector*(fNofBins+2) + bin]; }
+
+  private:
+    G4int    fNofDetectors;
+    G4int    fNofBins;
+    G4double fEMin;
+    G4double fEMax;
+    G4bool   fLogBinning;
+    G4double fOffset;    // bin coordinate = (x - fOffset) * fScale,
+    G4double fScale;     // x = e or log(e)
+    std::vector<G4double> fCounts;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+inline void B1PulseHeightSpectra::Fill(G4int detector, G4double edep,
+                                       G4double weight)
+{
+  G4int bin;
+  if (edep < fEMin) bin = 0;
+  else if (edep >= fEMax) bin = fNofBins + 1;
+  else {
+    G4double x = fLogBinning ? std::log(edep) : edep;
+    bin = 1 + (G4int)((x - fOffset) * fScale);
+    if (bin > fNofBins) bin = fNofBins;
+  }
+  fCounts[detector*(fNofBins+2) + bin] += weight;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
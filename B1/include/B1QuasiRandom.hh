@@ -0,0 +1,121 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1QuasiRandom.hh
+/// \brief Definition of the B1QuasiRandom class
+
+#ifndef B1QuasiRandom_h
+#define B1QuasiRandom_h 1
+
+#include "globals.hh"
+
+#include <vector>
+
+#include <stdint.h>
+
+class B1Run;
+class G4GenericMessenger;
+
+/// Quasi-random or stratified uniform numbers for the primary generator.
+///
+/// Event n of a run takes point n of the selected point set, whatever the
+/// thread that processes it, so the points of a run are always the first
+/// N of the set however the events are shared between the threads:
+/// - halton:     Halton sequence, bases 2, 3, 5, 7, 11, 13, with a random
+///               shift modulo 1 (Cranley-Patterson rotation)
+/// - sobol:      Sobol sequence (Joe-Kuo direction numbers) with a random
+///               digital shift
+/// - stratified: beam spot cut into strata x strata cells, event n in
+///               cell n % strata^2 (jittered), other numbers pseudo-random
+/// The shift is drawn by the master at the start of every run, so that
+/// repeated runs are independent replicates of the same estimator. The
+/// coordinates are, in order: the spot x and y, the spectrum bin and the
+/// position in the bin, and cos(theta) and phi of the divergence cone;
+/// the energy and direction coordinates can be left pseudo-random.
+///
+/// The spread of the run results is then no longer the one of
+/// independent events: the gain is measured from replicate runs, the
+/// same number with pseudo-random and with the selected sampling, and
+/// the variance of the replicate means is compared per detector.
+/// Commands (acting on the master):
+///   /B1/qmc/sampling sobol        (pseudo, stratified, halton, sobol)
+///   /B1/qmc/strata 16
+///   /B1/qmc/energy true
+///   /B1/qmc/direction true
+///   /B1/qmc/replicates 10
+///   /B1/qmc/compare 20000         (events per replicate run)
+
+class B1QuasiRandom
+{
+  public:
+    enum { kX, kY, kEnergyBin, kEnergy, kCosTheta, kPhi, kDimensions };
+
+    static B1QuasiRandom* Instance();
+    ~B1QuasiRandom();
+
+    G4bool IsActive() const { return fSampling != "pseudo"; }
+
+    // uniform numbers of the given event, kDimensions of them;
+    // called by the primary generator of every thread
+    void GetPoint(G4int eventID, G4double* u) const;
+
+    // called by the master run action
+    void BeginOfRun();
+    void EndOfRun(const B1Run* run);
+
+    void Compare(G4int nofEvents);
+
+  private:
+    B1QuasiRandom();
+    void DefineCommands();
+    void PrintComparison() const;
+
+    static G4double RadicalInverse(uint32_t n, uint32_t base);
+    uint32_t Sobol(G4int dimension, uint32_t n) const;
+
+    static B1QuasiRandom* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4String fSampling;
+    G4int    fNofStrata;
+    G4bool   fEnergy;
+    G4bool   fDirection;
+    G4int    fNofReplicates;
+
+    uint32_t fDirections[kDimensions][32];
+    G4double fShift[kDimensions];
+    uint32_t fDigitalShift[kDimensions];
+
+    // replicate means of the deposit per primary, [sampling][replicate][detector]
+    G4bool fComparing;
+    G4int  fComparedSampling;
+    std::vector<std::vector<G4double> > fReplicates[2];
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
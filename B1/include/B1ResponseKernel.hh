@@ -0,0 +1,118 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1ResponseKernel.hh
+/// \brief Definition of the B1ResponseKernel class
+
+#ifndef B1ResponseKernel_h
+#define B1ResponseKernel_h 1
+
+#include "globals.hh"
+
+#include <vector>
+
+class B1Run;
+class B1AliasTable;
+class G4GenericMessenger;
+
+/// Pencil-beam response kernels of the detector array.
+///
+/// The envelope face is divided into a grid of nX x nY square pixels.
+/// Building the kernel is a single run in which event n is shot uniformly
+/// into pixel n % (nX*nY), so all pixels get the same number of primaries
+/// whatever the thread. The mean energy deposited per primary in every
+/// detector, K[detector][pixel], and its uncertainty are kept.
+///
+/// The doses for any fluence map phi[pixel] (primaries per pixel) then
+/// follow from the matrix product D = K phi / mass, in milliseconds.
+/// The same fluence can be simulated directly for validation, sampling
+/// the pixels with an alias table. Commands (acting on the master):
+///   /B1/kernel/nX 80
+///   /B1/kernel/nY 80
+///   /B1/kernel/pitch 1 cm
+///   /B1/kernel/build 1000          (primaries per pixel)
+///   /B1/kernel/save kernel.bin
+///   /B1/kernel/load kernel.bin
+///   /B1/kernel/fluence fluence.txt (nY lines of nX weights)
+///   /B1/kernel/apply doses.txt
+///   /B1/kernel/validate 1000000    (Monte Carlo of the same fluence)
+
+class B1ResponseKernel
+{
+  public:
+    enum Mode { kOff, kBuild, kValidate };
+
+    static B1ResponseKernel* Instance();
+    ~B1ResponseKernel();
+
+    Mode  GetMode() const { return fMode; }
+    G4int GetNumberOfBeams() const { return fNX*fNY; }
+
+    // returns the pixel of the event and a position in it;
+    // called by the primary generator of every thread
+    G4int SamplePixel(G4int eventID, G4double& x, G4double& y) const;
+
+    // called by the master run action
+    void EndOfRun(const B1Run* run);
+
+    void Build(G4int primariesPerPixel);
+    void Save(G4String fileName);
+    void Load(G4String fileName);
+    void SetFluence(G4String fileName);
+    void Apply(G4String fileName);
+    void Validate(G4int nofEvents);
+
+  private:
+    B1ResponseKernel();
+    void DefineCommands();
+    void ComputeDoses(std::vector<G4double>& doses,
+                      std::vector<G4double>& errors) const;
+    G4bool HasKernel() const { return fNofDetectors > 0; }
+
+    static B1ResponseKernel* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    Mode     fMode;
+    G4int    fNX, fNY;
+    G4double fPitch;
+    G4double fCenterX, fCenterY;
+
+    // kernel, detector-major so that each dose is a contiguous dot product
+    G4int                 fNofDetectors;
+    G4int                 fKernelNX, fKernelNY;
+    G4double              fKernelPitch, fKernelX0, fKernelY0;
+    std::vector<G4double> fKernel;      // [detector*nofBeams + beam]
+    std::vector<G4double> fKernelVar;   // variance of the means
+    std::vector<G4double> fMasses;
+
+    std::vector<G4double> fFluence;
+    B1AliasTable*         fFluenceTable;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,104 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1ResultCache.hh
+/// \brief Definition of the B1ResultCache class
+
+#ifndef B1ResultCache_h
+#define B1ResultCache_h 1
+
+#include "globals.hh"
+
+class G4GenericMessenger;
+class B1Run;
+
+/// Content-addressed cache of run results, so that sweeps can be resumed.
+///
+/// The key of a run is the 64-bit FNV-1a hash of a canonical description
+/// of everything that determines its result:
+///   - the executable (the templated sources compile defaults into it),
+///   - the geometry: every placement with its solid parameters and material,
+///   - the physics list and the production cuts of every region,
+///   - the last value of every UI command that changes the simulation,
+///     and the whole sequence of those which add up (the components of a
+///     mixed field, the process (in)activations), with the contents of
+///     the files they name (spectra, phase spaces),
+///   - the contents of GunPositionParameters.txt,
+///   - the number of events and the full state of the random engine.
+///
+/// Runs started with /B1/cache/beamOn (and the sweep of main()) first look
+/// for <dir>/<key>.b1r. On a hit the stored detector sums are passed to
+/// B1RunAction::ReplayRun() (dose report and sweeps only), and the engine
+/// is set to the state it had after the original run, so the following
+/// points of a sweep get the same keys again. On a miss the run is
+/// simulated and its result stored. Runs with per-event outputs
+/// (pulse-height spectra, phase space, event stream, kernels, control
+/// variate, perturbations) are always simulated.
+///   /B1/cache/dir sweepCache    (none to disable)
+///   /B1/cache/beamOn 100000
+
+class B1ResultCache
+{
+  public:
+    static B1ResultCache* Instance();
+    ~B1ResultCache();
+
+    // path of the running executable, where /proc/self/exe is missing
+    void SetExecutable(const G4String& path) { fExecutable = path; }
+
+    void SetDirectory(G4String directory);
+    void BeamOn(G4int nofEvents);
+
+    // called by the master run action, stores the run started by BeamOn()
+    void EndOfRun(const B1Run* run);
+
+  private:
+    B1ResultCache();
+    void DefineCommands();
+
+    G4bool   IsCacheable(G4String& reason) const;
+    G4String DescribeConfiguration(G4int nofEvents);
+    G4String HashExecutable();
+    G4bool   Replay(const G4String& key, const G4String& configuration);
+    G4String GetEntryName(const G4String& key) const;
+
+    static B1ResultCache* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4String fDirectory;
+    G4String fExecutable;
+    G4String fExecutableHash;
+    G4String fPendingKey;
+    G4String fPendingConfiguration;
+    G4int    fPendingEvents;
+    G4int    fHits;
+    G4int    fMisses;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
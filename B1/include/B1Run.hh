@@ -34,29 +34,145 @@
 #include "G4Run.hh"
 #include "globals.hh"
 
+#include <vector>
+#include <iosfwd>
+
 class G4Event;
+class B1PulseHeightSpectra;
 
 /// Run class
 ///
+/// Besides the total deposit, the sums of the energy deposited per event
+/// and its square are kept for every detector, and likewise for the
+/// track-length kerma estimate. Optionally holds the
+/// per-detector pulse-height spectra, enabled by B1RunAction when a
+/// pulse-height output file is set, and the (pencil beam x detector)
+/// sums used to build a B1ResponseKernel, the sums of the uncollided
+/// control variate of B1UncollidedDose with its expectation, the
+/// deposits split by component of a mixed-field source, the
+/// (incident energy bin x detector) sums of a B1EnergyResponse run, and
+/// the (score x detector) sums of the reweighted deposits of
+/// B1Perturbation, with the sums of the weights per score.
 
 class B1Run : public G4Run
 {
   public:
-    B1Run();
+    B1Run(G4int nofDetectors);
     virtual ~B1Run();
 
     // method from the base class
     virtual void Merge(const G4Run*);
     
     void AddEdep (G4double edep); 
+    void AddDetectorEdep (G4int detector, G4double edep);
+    void AddDetectorKerma(G4int detector, G4double kerma);
+
+    void EnablePulseHeight(G4int nofBins, G4double eMin, G4double eMax,
+                           G4bool logBinning);
+
+    void EnableKernel(G4int nofBeams);
+    void AddKernelEvent(G4int beam);
+    void AddKernelEdep(G4int beam, G4int detector, G4double edep);
+
+    void EnableSourceComponents(const std::vector<G4String>& names);
+    void AddComponentEvent(G4int component);
+    void AddComponentEdep(G4int component, G4int detector, G4double edep);
+
+    void EnableEnergyBins(G4int nofBins);
+    void AddEnergyBinEvent(G4int bin);
+    void AddEnergyBinEdep(G4int bin, G4int detector, G4double edep);
+
+    void EnablePerturbations(G4int nofScores);
+    void AddPerturbationWeight(G4int score, G4double weight);
+    void AddPerturbedEdep(G4int score, G4int detector, G4double edep);
+
+    // the event count and detector sums, as stored by B1ResultCache
+    void   WriteTallies(std::ostream& out) const;
+    G4bool ReadTallies(std::istream& in);
+
+    void EnableControlVariate(const std::vector<G4double>& expected);
+    void AddControlVariate(const std::vector<G4double>& edep,
+                           const std::vector<G4double>& control);
 
     // get methods
     G4double GetEdep()  const { return fEdep; }
     G4double GetEdep2() const { return fEdep2; }
+    const B1PulseHeightSpectra* GetPulseHeight() const { return fPulseHeight; }
+
+    G4int    GetNumberOfDetectors() const { return fNofDetectors; }
+    G4double GetDetectorEdep(G4int i)  const { return fDetectorEdep[i]; }
+    G4double GetDetectorEdep2(G4int i) const { return fDetectorEdep2[i]; }
+    G4double GetDetectorKerma(G4int i)  const { return fDetectorKerma[i]; }
+    G4double GetDetectorKerma2(G4int i) const { return fDetectorKerma2[i]; }
+
+    G4bool   HasKernel() const { return !fKernelEvents.empty(); }
+    const std::vector<G4double>& GetKernelEdep()   const { return fKernelEdep; }
+    const std::vector<G4double>& GetKernelEdep2()  const { return fKernelEdep2; }
+    const std::vector<G4double>& GetKernelEvents() const { return fKernelEvents; }
+
+    G4bool   HasControlVariate() const { return !fControlExpected.empty(); }
+    G4double GetControlVariateEvents() const { return fControlEvents; }
+    G4double GetControlVariateExpected(G4int i) const { return fControlExpected[i]; }
+    G4double GetControlVariateSum(G4int i)   const { return fControlSum[i]; }
+    G4double GetControlVariateSum2(G4int i)  const { return fControlSum2[i]; }
+    G4double GetControlVariateCross(G4int i) const { return fControlCross[i]; }
+
+    G4bool HasSourceComponents() const { return !fComponentNames.empty(); }
+    const std::vector<G4String>& GetComponentNames() const
+      { return fComponentNames; }
+    G4double GetComponentEvents(G4int c) const { return fComponentEvents[c]; }
+    G4double GetComponentEdep(G4int c, G4int detector) const
+      { return fComponentEdep[c*fNofDetectors + detector]; }
+    G4double GetComponentEdep2(G4int c, G4int detector) const
+      { return fComponentEdep2[c*fNofDetectors + detector]; }
+
+    G4bool HasEnergyBins() const { return !fEnergyBinEvents.empty(); }
+    G4int  GetNumberOfEnergyBins() const
+      { return (G4int)fEnergyBinEvents.size(); }
+    G4double GetEnergyBinEvents(G4int b) const { return fEnergyBinEvents[b]; }
+    G4double GetEnergyBinEdep(G4int b, G4int detector) const
+      { return fEnergyBinEdep[b*fNofDetectors + detector]; }
+    G4double GetEnergyBinEdep2(G4int b, G4int detector) const
+      { return fEnergyBinEdep2[b*fNofDetectors + detector]; }
+
+    G4bool HasPerturbations() const { return !fPerturbationWeight.empty(); }
+    G4double GetPerturbationWeight(G4int s) const
+      { return fPerturbationWeight[s]; }
+    G4double GetPerturbationWeight2(G4int s) const
+      { return fPerturbationWeight2[s]; }
+    G4double GetPerturbedEdep(G4int s, G4int detector) const
+      { return fPerturbedEdep[s*fNofDetectors + detector]; }
+    G4double GetPerturbedEdep2(G4int s, G4int detector) const
+      { return fPerturbedEdep2[s*fNofDetectors + detector]; }
 
   private:
     G4double  fEdep;
     G4double  fEdep2;
+    G4int                 fNofDetectors;
+    std::vector<G4double> fDetectorEdep;
+    std::vector<G4double> fDetectorEdep2;
+    std::vector<G4double> fDetectorKerma;
+    std::vector<G4double> fDetectorKerma2;
+    std::vector<G4double> fKernelEdep;    // [beam*nofDetectors + detector]
+    std::vector<G4double> fKernelEdep2;
+    std::vector<G4double> fKernelEvents;  // [beam]
+    std::vector<G4double> fControlExpected;
+    std::vector<G4double> fControlSum;
+    std::vector<G4double> fControlSum2;
+    std::vector<G4double> fControlCross;  // sum of control x edep
+    G4double              fControlEvents;
+    std::vector<G4String> fComponentNames;
+    std::vector<G4double> fComponentEdep;   // [component*nofDetectors + detector]
+    std::vector<G4double> fComponentEdep2;
+    std::vector<G4double> fComponentEvents; // [component]
+    std::vector<G4double> fEnergyBinEdep;   // [bin*nofDetectors + detector]
+    std::vector<G4double> fEnergyBinEdep2;
+    std::vector<G4double> fEnergyBinEvents; // [bin]
+    std::vector<G4double> fPerturbedEdep;   // [score*nofDetectors + detector]
+    std::vector<G4double> fPerturbedEdep2;
+    std::vector<G4double> fPerturbationWeight;  // [score]
+    std::vector<G4double> fPerturbationWeight2;
+    B1PulseHeightSpectra* fPulseHeight;
 };
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
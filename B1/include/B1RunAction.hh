@@ -32,16 +32,37 @@
 #define B1RunAction_h 1
 
 #include "G4UserRunAction.hh"
+#include "G4Timer.hh"
 #include "globals.hh"
 
 class G4Run;
 class G4LogicalVolume;
+class G4GenericMessenger;
 
 /// Run action class
 ///
 /// In EndOfRunAction(), it calculates the dose in the selected volume 
 /// from the energy deposit accumulated via stepping and event actions.
 /// The computed dose is then printed on the screen.
+///
+/// A run read back from B1ResultCache is passed to ReplayRun(): its doses
+/// are reported as for a simulated run (console, ConsoleOutputData.txt
+/// and ResultsToPlot.txt) and handed to the sweeps driving the cache,
+/// B1AdaptiveSweep and B1SurrogateModel. The other outputs and tallies
+/// (metrics, snapshots, kernels, phase space, pulse heights, ...) only
+/// see simulated runs.
+///
+/// The master times the event loop of every simulated run and prints
+///   Event loop: <events> events in <seconds> s
+/// which physlists.sh reads for the throughput, whatever /run/verbose.
+///
+/// When an output file is set, the per-detector pulse-height spectra are
+/// accumulated and written by the master at the end of the run:
+///   /B1/pulseHeight/nBins 200
+///   /B1/pulseHeight/eMin 1 keV
+///   /B1/pulseHeight/eMax 10 MeV
+///   /B1/pulseHeight/logBinning true
+///   /B1/pulseHeight/file pulseHeight.bin
 
 class B1RunAction : public G4UserRunAction
 {
@@ -53,7 +74,24 @@ class B1RunAction : public G4UserRunAction
     virtual void BeginOfRunAction(const G4Run*);
     virtual void   EndOfRunAction(const G4Run*);
 
+    G4bool HasPulseHeightOutput() const { return !fPulseHeightFile.empty(); }
+
+    // called by the master for a run read back from the result cache
+    void ReplayRun(const G4Run* run);
+
     int counter;
+
+  private:
+    void DefineCommands();
+
+    G4GenericMessenger* fMessenger;
+    G4String            fPulseHeightFile;
+    G4int               fPulseHeightBins;
+    G4double            fPulseHeightEMin;
+    G4double            fPulseHeightEMax;
+    G4bool              fPulseHeightLog;
+    G4bool              fReplaying;
+    G4Timer             fEventLoopTimer;  // of the master
 };
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
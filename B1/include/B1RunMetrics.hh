@@ -0,0 +1,123 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1RunMetrics.hh
+/// \brief Definition of the B1RunMetrics class
+
+#ifndef B1RunMetrics_h
+#define B1RunMetrics_h 1
+
+#include "globals.hh"
+
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include <stdint.h>
+
+class G4GenericMessenger;
+class B1Run;
+
+/// Live run metrics in the Prometheus text format, for unattended batches.
+///
+/// A background thread of the master rewrites the metrics file every
+/// interval (write to a temporary file, then rename, so a scraper never
+/// sees a partial file):
+///   b1_events_processed_total       events of the current run so far
+///   b1_events_requested             events of the current run
+///   b1_events_per_second{thread}    rate of each worker thread
+///   b1_detector_relative_error{detector}
+///   b1_resident_memory_bytes
+///   b1_phase_seconds{phase}         init, run and output time
+///
+/// The workers only bump a per-thread event counter; every 1000 events
+/// they also copy their detector sums for the relative errors, which the
+/// sums of the merged run replace at the end of the run. Commands:
+///   /B1/metrics/file metrics.prom   (none to stop)
+///   /B1/metrics/interval 10 s
+
+class B1RunMetrics
+{
+  public:
+    static B1RunMetrics* Instance();
+    ~B1RunMetrics();
+
+    G4bool IsActive() const { return fActive; }
+
+    // master
+    void BeginOfRun(G4int runID, G4int nofEventsRequested, G4int nofDetectors);
+    void EndOfRun(const B1Run* run);
+    void AddPhaseTime(const G4String& phase, G4double seconds);
+
+    // event action of every thread; returns at once when inactive
+    void EndOfEvent(const B1Run* run);
+
+    void SetFileName(G4String fileName);
+    void SetInterval(G4double interval);
+
+  private:
+    struct ThreadSlot
+    {
+      uint64_t              fEvents;
+      G4double              fPublishedEvents;
+      std::vector<G4double> fSum;
+      std::vector<G4double> fSum2;
+      uint64_t              fLastEvents;  // at the previous write
+    };
+
+    B1RunMetrics();
+    void DefineCommands();
+    void Loop();
+    void Write();
+
+    static B1RunMetrics* fgInstance;
+
+    G4GenericMessenger*     fMessenger;
+    G4String                fFileName;
+    G4double                fInterval;
+    G4bool                  fActive;
+
+    std::vector<ThreadSlot> fSlots;
+    G4int                   fRunID;
+    G4int                   fEventsRequested;
+    G4bool                  fRunning;
+    std::map<G4String, G4double> fPhaseSeconds;
+    std::chrono::steady_clock::time_point fRunStart;
+    std::chrono::steady_clock::time_point fLastWrite;
+
+    std::thread*            fThread;
+    std::mutex              fMutex;
+    std::condition_variable fWakeUp;
+    G4bool                  fStop;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
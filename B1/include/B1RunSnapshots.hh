@@ -0,0 +1,136 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1RunSnapshots.hh
+/// \brief Definition of the B1RunSnapshots class
+
+#ifndef B1RunSnapshots_h
+#define B1RunSnapshots_h 1
+
+#include "globals.hh"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include <stdint.h>
+
+class G4GenericMessenger;
+class B1Run;
+
+/// Progressive snapshots of the dose per detector while a run is going on,
+/// to follow the convergence of a long run and stop a bad one early.
+///
+/// Every worker has a snapshot buffer besides its B1Run accumulators,
+/// guarded by a sequence counter which is odd while the buffer is written.
+/// Every 100 events the worker makes the counter odd, copies its event
+/// count and detector sums into the buffer and makes the counter even
+/// again; the workers never wait. A background thread of the master sums
+/// the buffers of all threads, copying again a buffer whose counter was odd
+/// or moved meanwhile, and rewrites the snapshot file (temporary file, then
+/// rename) after every given number of events of the run or interval,
+/// whichever comes first. At the end of the run the file gets
+/// the merged result. The file lists per detector the dose per primary,
+/// its standard error and the relative error. Commands:
+///   /B1/snapshot/file snapshot.txt  (none to stop)
+///   /B1/snapshot/events 100000      (0 for the interval only)
+///   /B1/snapshot/interval 30 s
+///   /B1/snapshot/stressTest 1000000  (publications against the reader,
+///                                     abort on a torn copy)
+
+class B1RunSnapshots
+{
+  public:
+    static B1RunSnapshots* Instance();
+    ~B1RunSnapshots();
+
+    G4bool IsActive() const { return fActive; }
+
+    // master
+    void BeginOfRun(G4int runID, G4int nofEventsRequested);
+    void EndOfRun(const B1Run* run);
+
+    // event action of every thread
+    void EndOfEvent(const B1Run* run);
+
+    void SetFileName(G4String fileName);
+    void SetEvents(G4int events);
+    void SetInterval(G4double interval);
+    void StressTest(G4int publications);
+
+  private:
+    struct Buffer
+    {
+      G4double              fEvents;
+      std::vector<G4double> fSum;
+      std::vector<G4double> fSum2;
+    };
+
+    struct ThreadSlot
+    {
+      uint64_t fEvents;     // owned by the worker
+      uint64_t fSequence;   // odd while fBuffer is written
+      Buffer   fBuffer;
+    };
+
+    B1RunSnapshots();
+    void DefineCommands();
+    void Loop();
+    void Collect(Buffer& total);
+    static void Publish(ThreadSlot& slot, const B1Run* run);
+    static void Read(const ThreadSlot& slot, Buffer& copy);
+    static void StressWriter(ThreadSlot* slot, G4int publications);
+    void Write(const Buffer& total, G4bool final);
+
+    static B1RunSnapshots* fgInstance;
+
+    G4GenericMessenger*     fMessenger;
+    G4String                fFileName;
+    G4int                   fEvents;
+    G4double                fInterval;
+    G4bool                  fActive;
+
+    std::vector<ThreadSlot> fSlots;
+    std::vector<G4double>   fMasses;
+    G4int                   fRunID;
+    G4int                   fEventsRequested;
+    G4bool                  fRunning;
+    G4double                fNextEvents;  // of the next snapshot
+    std::chrono::steady_clock::time_point fRunStart;
+    std::chrono::steady_clock::time_point fLastWrite;
+
+    std::thread*            fThread;
+    std::mutex              fMutex;
+    std::condition_variable fWakeUp;
+    G4bool                  fStop;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
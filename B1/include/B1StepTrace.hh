@@ -0,0 +1,103 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1StepTrace.hh
+/// \brief Definition of the B1StepTrace class
+
+#ifndef B1StepTrace_h
+#define B1StepTrace_h 1
+
+#include "B1StepTraceFormat.hh"
+#include "globals.hh"
+
+#include <vector>
+#include <map>
+#include <chrono>
+
+class G4Step;
+class G4GenericMessenger;
+
+/// Sampled step trace, to see where the tracking spends its time.
+///
+/// A random sample of the steps (on average one in 1/rate, with gaps
+/// drawn from a generator of its own so that the physics is unchanged) is
+/// copied into a ring buffer of every thread: position, volume, particle,
+/// process, energy deposit, global and wall-clock time. The cost of the
+/// steps not sampled is a counter decrement. At the end of the run the
+/// master writes the buffers, the latest records of every thread, to the
+/// file (see B1StepTraceFormat.hh); traceSummary lists the volumes taking
+/// most of the steps and of the time, and the tracks with the most steps.
+///   /B1/stepTrace/rate 0.001
+///   /B1/stepTrace/capacity 1000000     (records per thread)
+///   /B1/stepTrace/file trace.bin       (none to disable)
+
+class B1StepTrace
+{
+  public:
+    static B1StepTrace* Instance();
+    ~B1StepTrace();
+
+    G4bool IsActive() const { return fActive; }
+
+    // called by the stepping action of every thread
+    void ProcessStep(const G4Step* step);
+
+    // called by the master run action
+    void BeginOfRun(G4int runID);
+    void EndOfRun();
+
+    void SetFileName(G4String fileName);
+    void SetRate(G4double rate);
+
+  private:
+    struct Buffer;
+
+    B1StepTrace();
+    void DefineCommands();
+    Buffer* GetBuffer();
+    G4int Register(std::vector<G4String>& names, const G4String& name,
+                   G4int maxNames);
+
+    static B1StepTrace* fgInstance;
+
+    G4GenericMessenger*   fMessenger;
+    G4String              fFileName;
+    G4double              fRate;
+    G4int                 fCapacity;   // records per thread
+    G4bool                fActive;
+    G4int                 fRunID;
+    std::chrono::steady_clock::time_point fStart;
+
+    std::vector<Buffer*>  fBuffers;    // of all threads
+    std::vector<G4String> fVolumes;
+    std::vector<G4String> fParticles;
+    std::vector<G4String> fProcesses;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,87 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1StepTraceFormat.hh
+/// \brief Layout of the step-trace file
+
+#ifndef B1StepTraceFormat_h
+#define B1StepTraceFormat_h 1
+
+#include <stdint.h>
+
+// Layout of the file written by B1StepTrace, shared with the traceSummary
+// tool (which does not depend on Geant4).
+//
+// The header is followed by fNamesSize bytes of zero-terminated names:
+// fNofVolumes physical volumes, fNofParticles particles and fNofProcesses
+// processes, which the records refer to by index. Then come fNofSections
+// sections, one per thread, each a B1StepTraceSection followed by its
+// fNofRecords records in the order they were sampled.
+
+/// Index of the names that did not fit in the tables.
+const uint16_t kB1StepTraceOtherVolume = 0xffff;
+const uint8_t  kB1StepTraceOther = 0xff;
+
+/// One sampled step (56 bytes).
+struct B1StepTraceRecord
+{
+  float    fX, fY, fZ;       // mm, end of the step
+  float    fStepLength;      // mm
+  float    fEdep;            // MeV
+  float    fKineticEnergy;   // MeV, end of the step
+  double   fGlobalTime;      // ns
+  double   fWallTime;        // s since the start of the run
+  int32_t  fEventID;
+  int32_t  fTrackID;
+  int32_t  fStepNumber;
+  uint16_t fVolume;
+  uint8_t  fParticle;
+  uint8_t  fProcess;         // that limited the step
+};
+
+/// File header, magic "B1STR001".
+struct B1StepTraceHeader
+{
+  char     fMagic[8];
+  uint32_t fRunID;
+  uint32_t fNofSections;
+  double   fSamplingRate;
+  uint32_t fNofVolumes;
+  uint32_t fNofParticles;
+  uint32_t fNofProcesses;
+  uint32_t fNamesSize;
+};
+
+/// Header of the records of one thread.
+struct B1StepTraceSection
+{
+  uint64_t fSteps;           // all steps of the thread
+  uint64_t fSampled;         // steps sampled, the latest are kept
+  uint64_t fNofRecords;
+};
+
+#endif
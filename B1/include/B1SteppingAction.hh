@@ -34,12 +34,29 @@
 #include "G4UserSteppingAction.hh"
 #include "globals.hh"
 
+#include <vector>
+
 class B1EventAction;
+class B1DetectorConstruction;
+class B1PhaseSpaceWriter;
+class B1FastShapes;
+class B1StepTrace;
+class B1Perturbation;
+class B1AttenuationTable;
 
 class G4LogicalVolume;
+class G4ParticleDefinition;
 
 /// Stepping action class
-/// 
+///
+/// Scores the energy deposited in the detectors and, for photons, the
+/// track-length estimate of the collision kerma: step length x E x mu_en(E)
+/// of the detector material (B1AttenuationTable). Every photon crossing a
+/// detector contributes, not only the few interacting in it, so the kerma
+/// of thin detectors converges much faster than the deposit.
+///
+/// The photon steps in the detectors and shapes are also passed to
+/// B1Perturbation while it is active.
 
 class B1SteppingAction : public G4UserSteppingAction
 {
@@ -52,7 +69,17 @@ class B1SteppingAction : public G4UserSteppingAction
 
   private:
     B1EventAction*  	fEventAction;
-    G4LogicalVolume** 	fScoringVolumeArray;
+    const B1DetectorConstruction* fDetectorConstruction;
+    G4int                         fGeometryId;
+    std::vector<G4LogicalVolume*> fScoringVolumes;
+    std::vector<G4LogicalVolume*> fSolidVolumes;
+    G4int               fNofScoringVolumes;
+    B1PhaseSpaceWriter* fPhaseSpaceWriter;
+    B1FastShapes*       fFastShapes;
+    B1StepTrace*        fStepTrace;
+    B1Perturbation*     fPerturbation;
+    const G4ParticleDefinition* fGamma;
+    std::vector<const B1AttenuationTable*> fKermaTables;  // per detector
 };
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,165 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1SurrogateModel.hh
+/// \brief Definition of the B1SurrogateModel class
+
+#ifndef B1SurrogateModel_h
+#define B1SurrogateModel_h 1
+
+#include "globals.hh"
+
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+#include <iosfwd>
+
+class G4GenericMessenger;
+class B1Run;
+
+/// Interpolation table of the detector doses over the material of the
+/// shapes, the beam energy and the detector radius, answering dose queries
+/// between the simulated points without running the simulation.
+///
+/// The nodes of the table are full runs, one per (material, energy,
+/// radius), with the sums of every detector. For each material the
+/// energies and radii of the nodes span a grid, and a query inside it is
+/// interpolated bilinearly in (log energy, radius) from the corners of its
+/// cell. Its uncertainty combines
+///   - the statistical errors of the corners, with the squared weights;
+///   - the interpolation error (x - x0)(x1 - x)/2 |y''| along each axis,
+///     with y'' the second divided difference at the nodes of the cell
+///     less twice its statistical error, so that noise is not taken for
+///     curvature (not estimated along an axis of fewer than 3 values).
+/// A query outside the grid, in a cell with a missing node, or with a
+/// relative uncertainty above maxError is answered by a targeted run at
+/// the query point instead (unless autoRun is off), repeated once with
+/// more events if its own error is still too large. Targeted points are
+/// kept apart from the grid, which stays the full product of the energies
+/// and radii built: they only answer queries at their own point. The
+/// table is written to its file after every build and targeted run. Runs
+/// go through B1ResultCache, and leave the geometry and the beam at the
+/// last point.
+///   /B1/surrogate/file surrogate.txt
+///   /B1/surrogate/load
+///   /B1/surrogate/materials G4_WATER G4_Al
+///   /B1/surrogate/energies 0.5 1 2 5 10 MeV
+///   /B1/surrogate/radii 1 2 3 cm
+///   /B1/surrogate/eventsPerPoint 10000
+///   /B1/surrogate/build
+///   /B1/surrogate/maxError 0.05
+///   /B1/surrogate/autoRun true
+///   /B1/surrogate/query G4_WATER 1.25 MeV 2.7 cm 0
+
+class B1SurrogateModel
+{
+  public:
+    static B1SurrogateModel* Instance();
+    ~B1SurrogateModel();
+
+    struct Answer
+    {
+      G4double fDose;
+      G4double fStatisticalError;
+      G4double fInterpolationError;
+      G4bool   fInDomain;      // all corners of the cell are nodes
+
+      G4double GetError() const;
+      G4double GetRelativeError() const;
+    };
+
+    // interpolated dose of a detector, without any run
+    Answer Interpolate(const G4String& material, G4double energy,
+                       G4double radius, G4int detector) const;
+
+    // called by the master run action, fills the node being simulated
+    void EndOfRun(const B1Run* run);
+
+    void SetMaterials(G4String materials);
+    void SetEnergies(G4String energies);
+    void SetRadii(G4String radii);
+    void Load();
+    void Build();
+    void Query(G4String query);
+
+  private:
+    struct Sample
+    {
+      G4double fSum;     // energy deposit per event, summed
+      G4double fSum2;
+      G4double fEvents;
+      G4double fMass;
+
+      G4double GetDose() const;
+      G4double GetError() const;
+    };
+
+    typedef std::pair<G4double, G4double> NodeKey;   // (energy, radius)
+    typedef std::map<NodeKey, std::vector<Sample> > NodeMap;
+
+    struct Slice
+    {
+      std::set<G4double> fEnergies;   // axes of the grid
+      std::set<G4double> fRadii;
+      NodeMap fNodes;                 // built on the grid
+      NodeMap fPoints;                // targeted runs, off the grid
+    };
+
+    B1SurrogateModel();
+    void DefineCommands();
+
+    const Sample* FindSample(const NodeMap& nodes, G4double energy,
+                             G4double radius, G4int detector) const;
+    // -1 when a node of the grid needed for it is missing
+    G4double GetCurvature(const Slice& slice, G4bool alongEnergy,
+                          G4double node, G4double other,
+                          G4int detector) const;
+    G4bool Simulate(const G4String& material, G4double energy,
+                    G4double radius, G4int nofEvents, G4bool onGrid);
+    void Save() const;
+    void WriteNodes(std::ostream& out, const G4String& kind,
+                    const G4String& material, const NodeMap& nodes) const;
+
+    static B1SurrogateModel* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4String fFileName;
+    std::vector<G4String> fMaterials;
+    std::vector<G4double> fEnergyGrid;
+    std::vector<G4double> fRadiusGrid;
+    G4int    fEventsPerPoint;
+    G4double fMaxError;
+    G4bool   fAutoRun;
+
+    std::map<G4String, Slice> fSlices;
+    std::vector<Sample>*      fCurrent;   // node being simulated, or 0
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,163 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1UncollidedDose.hh
+/// \brief Definition of the B1RayTracer and B1UncollidedDose classes
+
+#ifndef B1UncollidedDose_h
+#define B1UncollidedDose_h 1
+
+#include "G4ThreeVector.hh"
+#include "globals.hh"
+
+#include <vector>
+
+class G4Navigator;
+class G4VPhysicalVolume;
+class G4LogicalVolume;
+class G4GenericMessenger;
+class B1AttenuationTable;
+class B1Run;
+
+/// Rectangular beam spot of the gun (GunPositionParameters.txt):
+/// centre, full widths and the plane z it is shot from.
+
+struct B1BeamSpot
+{
+  G4double fX, fY;
+  G4double fWidthX, fWidthY;
+  G4double fZ;
+};
+
+/// Straight rays along +z through the geometry.
+///
+/// The tracer has its own G4Navigator, so it can be used from the primary
+/// generator without disturbing the tracking. A ray is stored as a list of
+/// segments (attenuation table of the material, length, detector index or
+/// -1); the uncollided deposits are then computed from flat arrays for any
+/// number of energies without tracing again. One tracer per thread; it
+/// follows the geometry when B1DetectorConstruction rebuilds it.
+
+class B1RayTracer
+{
+  public:
+    static B1RayTracer* GetThreadInstance();
+
+    B1RayTracer();
+    ~B1RayTracer();
+
+    // segments of the ray starting at position until it leaves the world
+    void Trace(const G4ThreeVector& position);
+
+    // adds weight * energy deposited in every detector by the uncollided
+    // photons of the given energy along the last traced ray
+    void AddDeposits(G4double energy, G4double weight, G4double* deposits);
+
+    G4int GetNumberOfDetectors() const { return (G4int)fDetectors.size(); }
+    // bounding box of a detector in the (x,y) plane
+    void GetFootprint(G4int detector, G4double& xMin, G4double& xMax,
+                      G4double& yMin, G4double& yMax) const;
+
+  private:
+    void Setup();
+
+    G4Navigator*                   fNavigator;
+    G4VPhysicalVolume*             fWorld;
+    G4int                          fGeometryId;
+    std::vector<G4LogicalVolume*>  fDetectors;
+    std::vector<G4double>          fFootprints;  // 4 per detector
+    std::vector<const B1AttenuationTable*> fTables;  // by material index
+
+    std::vector<const B1AttenuationTable*> fSegmentTable;
+    std::vector<G4double>          fSegmentLength;
+    std::vector<G4int>             fSegmentDetector;
+    std::vector<G4double>          fMu, fMuTr, fAttenuation;  // scratch
+};
+
+/// Uncollided-photon dose without transport.
+///
+/// The primary photons that reach a detector without interacting deposit
+/// on average E exp(-tau) mu_tr/mu (1 - exp(-mu t)) in a detector slab of
+/// thickness t behind the optical depth tau. With the attenuation tables
+/// of B1AttenuationTable this is summed over the rays of the beam spot
+/// and the energies of the source; secondary electron transport is not
+/// followed (kerma approximation).
+///
+///   /B1/uncollided/preview         prints the uncollided dose per
+///                                  detector for the current beam spot
+///   /B1/uncollided/energy 6 MeV    source of the preview ...
+///   /B1/uncollided/spectrum f.dat  ... or a spectrum (see B1EnergySpectrum)
+///   /B1/uncollided/nRays 32        rays per side and detector footprint
+///   /B1/uncollided/controlVariate true
+///
+/// As a control variate, the generator attaches to every photon event its
+/// uncollided deposit C (see B1EventInformation); the run keeps the sums
+/// of C, C^2 and C x edep, and at the end of the run the regression
+/// estimate edep - beta (C - E[C]) is printed next to the plain tally. Its
+/// variance is reduced by 1/(1-rho^2), large behind thick boxes where the
+/// uncollided term dominates.
+
+class B1UncollidedDose
+{
+  public:
+    static B1UncollidedDose* Instance();
+    ~B1UncollidedDose();
+
+    G4bool UseControlVariate() const { return fControlVariate; }
+
+    // uncollided deposit per detector of one photon, on this thread
+    void ComputeDeposits(const G4ThreeVector& position, G4double energy,
+                         std::vector<G4double>& deposits) const;
+    // its expectation over the beam spot and the energies given
+    void ComputeExpectedDeposits(const B1BeamSpot& spot,
+                                 const std::vector<G4double>& energies,
+                                 const std::vector<G4double>& probabilities,
+                                 std::vector<G4double>& deposits) const;
+
+    // current gun spot; false if the parameters file cannot be read
+    static G4bool ReadBeamSpot(B1BeamSpot& spot);
+
+    void Preview();
+    void EndOfRun(const B1Run* run) const;
+
+  private:
+    B1UncollidedDose();
+    void DefineCommands();
+
+    static B1UncollidedDose* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4int               fNofRays;
+    G4double            fEnergy;
+    G4String            fSpectrumFile;
+    G4String            fSpectrumType;
+    G4bool              fControlVariate;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,25 @@
+#!/bin/bash
+# Benchmark of the physics lists on the standard geometry (example B1)
+#
+# For every list: initialization time and resident memory, then the events
+# and event-loop throughput of the 4 x 4 position scan (exampleB1 <time>).
+# Run from the build directory:
+#   ./physlists.sh [time] [list ...]
+# The logs are kept as physlist_<list>.log.
+
+time=${1:-30}
+[ $# -gt 0 ] && shift
+lists=${*:-"QBBC emstandard emstandard_opt3 emstandard_opt4 livermore penelope"}
+
+printf "%-18s %10s %12s %10s %12s %12s\n" \
+       list "init [s]" "memory [MB]" events "loop [s]" "events/s"
+for list in $lists; do
+  log=physlist_$list.log
+  PHYSLIST=$list B1_CACHE_DIR=none ./exampleB1 $time > $log 2>&1
+  # master output only, the worker lines start with G4WT
+  grep -v '^G4WT' $log | awk -v list=$list '
+    /^Physics list .*: initialization/ { init = $(NF-5); memory = $(NF-1) }
+    /^ Event loop: /                   { events += $3; loop += $6 }
+    END { printf "%-18s %10.3g %12.4g %10d %12.4g %12.4g\n", list, init,
+                 memory, events, loop, (loop > 0 ? events/loop : 0) }'
+done
@@ -33,6 +33,9 @@
 #include "B1RunAction.hh"
 #include "B1EventAction.hh"
 #include "B1SteppingAction.hh"
+#include "B1PhysicsLists.hh"
+
+#include "G4AdjointSimManager.hh"
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
@@ -57,12 +60,21 @@ void B1ActionInitialization::BuildForMaster() const
 void B1ActionInitialization::Build() const
 {
   SetUserAction(new B1PrimaryGeneratorAction);
-  SetUserAction(new B1RunAction);
+  B1RunAction* runAction = new B1RunAction;
+  SetUserAction(runAction);
   
   B1EventAction* eventAction = new B1EventAction;
   SetUserAction(eventAction);
   
   SetUserAction(new B1SteppingAction(eventAction));
+
+  // the adjoint runs of B1AdjointScan keep the same run and event actions,
+  // the stepping action scores the forward phase
+  if (B1PhysicsLists::GetSelectedName() == "adjoint") {
+    G4AdjointSimManager* adjointManager = G4AdjointSimManager::GetInstance();
+    adjointManager->SetAdjointRunAction(runAction);
+    adjointManager->SetAdjointEventAction(eventAction);
+  }
 }  
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,475 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1AdaptiveSweep.cc
+/// \brief Implementation of the B1AdaptiveSweep class
+
+#include "B1AdaptiveSweep.hh"
+#include "B1ResultCache.hh"
+#include "B1DetectorConstruction.hh"
+#include "B1Run.hh"
+
+#include "G4RunManager.hh"
+#include "G4UImanager.hh"
+#include "G4UIcommand.hh"
+#include "G4GenericMessenger.hh"
+#include "G4LogicalVolume.hh"
+#include "G4UnitsTable.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+  // intervals are not split below this fraction of the range
+  const G4double minimumWidth = 1./1024.;
+  // events added to a point at once, in batches
+  const G4double maximumBatches = 8.;
+  // a point still without deposit after these batches stops the sweep
+  const G4double emptyPointBatches = 100.;
+}
+
+B1AdaptiveSweep* B1AdaptiveSweep::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B1AdaptiveSweep::Point::GetDose() const
+{
+  return (fEvents > 0. && fMass > 0.) ? fSum/fEvents/fMass : 0.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B1AdaptiveSweep::Point::GetError() const
+{
+  if (fEvents <= 1. || fMass <= 0.) return 0.;
+  G4double mean = fSum/fEvents;
+  G4double variance = (fSum2/fEvents - mean*mean)/fEvents;
+  return variance > 0. ? std::sqrt(variance)/fMass : 0.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B1AdaptiveSweep::Point::GetRelativeError() const
+{
+  // a point without any deposit has no estimate yet, its error is unbounded
+  return fSum > 0. ? GetError()/GetDose()
+                   : std::numeric_limits<G4double>::infinity();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1AdaptiveSweep* B1AdaptiveSweep::Instance()
+{
+  if (!fgInstance) fgInstance = new B1AdaptiveSweep;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1AdaptiveSweep::B1AdaptiveSweep()
+: fMessenger(0),
+  fSweepEnergy(true),
+  fMin(0.5*MeV),
+  fMax(10.*MeV),
+  fLogScale(false),
+  fInitialPoints(5),
+  fMaxPoints(40),
+  fEventsPerBatch(10000),
+  fTargetError(0.01),
+  fTimeBudget(0.),
+  fDetector(0),
+  fCurrent(-1),
+  fAppliedX(-1.)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1AdaptiveSweep::~B1AdaptiveSweep()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1AdaptiveSweep::SetParameter(G4String parameter)
+{
+  fSweepEnergy = (parameter == "energy");
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1AdaptiveSweep::SetRange(G4String range)
+{
+  std::istringstream input(range);
+  G4double min = 0., max = 0.;
+  G4String unit;
+  if (!(input >> min >> max >> unit) || G4UIcommand::ValueOf(unit) <= 0.) {
+    G4ExceptionDescription msg;
+    msg << "Cannot read the sweep range \"" << range
+        << "\", expected: min max unit.";
+    G4Exception("B1AdaptiveSweep::SetRange()", "MyCode0013", JustWarning, msg);
+    return;
+  }
+  fMin = min*G4UIcommand::ValueOf(unit);
+  fMax = max*G4UIcommand::ValueOf(unit);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B1AdaptiveSweep::GetCoordinate(G4double x) const
+{
+  return fLogScale ? std::log(x) : x;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1AdaptiveSweep::Run()
+{
+  if (fMin >= fMax || (fLogScale && fMin <= 0.) || fInitialPoints < 2) {
+    G4Exception("B1AdaptiveSweep::Run()", "MyCode0013", JustWarning,
+                "Invalid sweep range or number of initial points.");
+    return;
+  }
+
+  // a detector the run does not score would leave every point empty
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  G4int nofDetectors = detectorConstruction->GetNumberOfScoringVolumes();
+  if (fDetector < 0 || fDetector >= nofDetectors) {
+    G4ExceptionDescription msg;
+    msg << "Detector " << fDetector << " does not exist, the geometry has "
+        << nofDetectors << " detectors (0 to " << nofDetectors - 1
+        << "), no sweep.";
+    G4Exception("B1AdaptiveSweep::Run()", "MyCode0013", JustWarning, msg);
+    return;
+  }
+
+  std::chrono::steady_clock::time_point start
+    = std::chrono::steady_clock::now();
+
+  // coarse grid
+  fPoints.clear();
+  fAppliedX = -1.;
+  G4double u0 = GetCoordinate(fMin), u1 = GetCoordinate(fMax);
+  for (G4int i = 0; i < fInitialPoints; i++) {
+    G4double u = u0 + (u1 - u0)*i/(fInitialPoints - 1);
+    Point point = { fLogScale ? std::exp(u) : u, 0., 0., 0., 0. };
+    fPoints.push_back(point);
+  }
+  for (size_t i = 0; i < fPoints.size(); i++) {
+    Simulate(i, fEventsPerBatch);
+  }
+
+  // refinement
+  G4String stopReason;
+  for (;;) {
+    G4double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start).count();
+    if (fTimeBudget > 0. && seconds*s >= fTimeBudget) {
+      stopReason = "time budget reached";
+      break;
+    }
+
+    G4double worstInterval = 0.;
+    size_t interval = 0;
+    if ((G4int)fPoints.size() < fMaxPoints) {
+      for (size_t i = 0; i + 1 < fPoints.size(); i++) {
+        G4double width = GetCoordinate(fPoints[i+1].fX)
+                       - GetCoordinate(fPoints[i].fX);
+        if (width < minimumWidth*(u1 - u0)) continue;
+        G4double score = GetInterpolationError(i)/fTargetError;
+        if (score > worstInterval) {
+          worstInterval = score;
+          interval = i;
+        }
+      }
+    }
+
+    G4double worstPoint = 0.;
+    size_t point = 0;
+    for (size_t i = 0; i < fPoints.size(); i++) {
+      G4double score = fPoints[i].GetRelativeError()/fTargetError;
+      if (score > worstPoint) {
+        worstPoint = score;
+        point = i;
+      }
+    }
+
+    if (worstInterval <= 1. && worstPoint <= 1.) {
+      stopReason = "target error reached";
+      break;
+    }
+
+    if (worstInterval > worstPoint) {
+      G4double u = 0.5*(GetCoordinate(fPoints[interval].fX)
+                        + GetCoordinate(fPoints[interval+1].fX));
+      Point newPoint = { fLogScale ? std::exp(u) : u, 0., 0., 0., 0. };
+      fPoints.insert(fPoints.begin() + interval + 1, newPoint);
+      Simulate(interval + 1, fEventsPerBatch);
+      if (fPoints[interval+1].fEvents <= 0.) {
+        stopReason = "run aborted";
+        break;
+      }
+    }
+    else {
+      // events for the target error, as N ~ 1/error^2
+      G4double events = fPoints[point].fEvents;
+      G4double needed = maximumBatches*fEventsPerBatch;
+      if (fPoints[point].fSum <= 0.) {
+        if (events >= emptyPointBatches*fEventsPerBatch) {
+          stopReason = "no deposit at a point";
+          break;
+        }
+      }
+      else {
+        needed = std::min(needed, events*(worstPoint*worstPoint - 1.));
+        needed = std::max(needed, (G4double)fEventsPerBatch);
+      }
+      Simulate(point, (G4int)std::ceil(needed));
+      if (fPoints[point].fEvents <= events) {
+        stopReason = "run aborted";
+        break;
+      }
+    }
+  }
+
+  G4cout << "\n Adaptive sweep: " << stopReason << " after "
+         << std::chrono::duration<double>(
+              std::chrono::steady_clock::now() - start).count()
+         << " s" << G4endl;
+  Report();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1AdaptiveSweep::Simulate(size_t point, G4int nofEvents)
+{
+  // the geometry is only rebuilt when the radius changes
+  if (fPoints[point].fX != fAppliedX) {
+    std::ostringstream command;
+    command << std::setprecision(12);
+    if (fSweepEnergy) {
+      command << "/gun/energy " << fPoints[point].fX/MeV << " MeV";
+    }
+    else {
+      command << "/B1/det/detectorRadius " << fPoints[point].fX/mm << " mm";
+    }
+    G4UImanager::GetUIpointer()->ApplyCommand(command.str());
+    fAppliedX = fPoints[point].fX;
+  }
+
+  fCurrent = (G4int)point;
+  B1ResultCache::Instance()->BeamOn(nofEvents);
+  fCurrent = -1;
+
+  const Point& result = fPoints[point];
+  G4cout << " Sweep point "
+         << G4BestUnit(result.fX, fSweepEnergy ? "Energy" : "Length")
+         << ": " << result.fEvents << " events, dose "
+         << G4BestUnit(result.GetDose(), "Dose") << " +- "
+         << 100.*result.GetRelativeError() << " %" << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1AdaptiveSweep::EndOfRun(const B1Run* run)
+{
+  if (fCurrent < 0 || fDetector >= run->GetNumberOfDetectors()) return;
+
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+
+  // batches of one point are independent, their sums add up
+  Point& point = fPoints[fCurrent];
+  point.fSum    += run->GetDetectorEdep(fDetector);
+  point.fSum2   += run->GetDetectorEdep2(fDetector);
+  point.fEvents += run->GetNumberOfEvent();
+  point.fMass
+    = detectorConstruction->GetScoringVolumes()[fDetector]->GetMass();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B1AdaptiveSweep::GetInterpolationError(size_t interval) const
+{
+  if (fPoints.size() < 3) return 0.;
+
+  // significant second derivative at the interior points next to it
+  G4double curvature = 0.;
+  for (size_t i = interval; i <= interval + 1; i++) {
+    if (i == 0 || i + 1 >= fPoints.size()) continue;
+    G4double um = GetCoordinate(fPoints[i-1].fX);
+    G4double u  = GetCoordinate(fPoints[i].fX);
+    G4double up = GetCoordinate(fPoints[i+1].fX);
+    G4double a = 2./((up - um)*(u - um));
+    G4double c = 2./((up - um)*(up - u));
+    G4double b = -(a + c);
+    G4double second = a*fPoints[i-1].GetDose() + b*fPoints[i].GetDose()
+                    + c*fPoints[i+1].GetDose();
+    G4double errorM = a*fPoints[i-1].GetError();
+    G4double error  = b*fPoints[i].GetError();
+    G4double errorP = c*fPoints[i+1].GetError();
+    G4double sigma
+      = std::sqrt(errorM*errorM + error*error + errorP*errorP);
+    curvature = std::max(curvature, std::fabs(second) - 2.*sigma);
+  }
+
+  G4double scale = std::max(std::fabs(fPoints[interval].GetDose()),
+                            std::fabs(fPoints[interval+1].GetDose()));
+  if (scale <= 0.) return 0.;
+  G4double width = GetCoordinate(fPoints[interval+1].fX)
+                 - GetCoordinate(fPoints[interval].fX);
+  return curvature*width*width/8./scale;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1AdaptiveSweep::Report() const
+{
+  G4double unit = fSweepEnergy ? MeV : mm;
+  const char* unitName = fSweepEnergy ? "MeV" : "mm";
+
+  std::ostringstream table;
+  table << "# " << (fSweepEnergy ? "energy" : "detectorRadius")
+        << " [" << unitName << "]  dose [Gy]  error [Gy]  relative error"
+        << "  events  (detector " << fDetector << ")\n";
+  G4double totalEvents = 0.;
+  for (size_t i = 0; i < fPoints.size(); i++) {
+    const Point& point = fPoints[i];
+    table << std::setw(12) << point.fX/unit << "  "
+          << std::setw(12) << point.GetDose()/gray << "  "
+          << std::setw(12) << point.GetError()/gray << "  "
+          << std::setw(12) << point.GetRelativeError() << "  "
+          << std::setw(10) << point.fEvents << "\n";
+    totalEvents += point.fEvents;
+  }
+
+  G4cout << " " << fPoints.size() << " points, " << totalEvents
+         << " events\n" << table.str() << G4endl;
+
+  if (!fFileName.empty()) {
+    std::ofstream file(fFileName.c_str());
+    file << table.str();
+    if (file) G4cout << " Sweep written to " << fFileName << G4endl;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1AdaptiveSweep::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/sweep/",
+                                      "Adaptive parameter sweep");
+
+  // the sweep drives the runs from the master
+  G4GenericMessenger::Command& parameterCmd
+    = fMessenger->DeclareMethod("parameter", &B1AdaptiveSweep::SetParameter,
+        "Parameter swept: beam energy or detector radius.");
+  parameterCmd.SetParameterName("parameter", false);
+  parameterCmd.SetCandidates("energy detectorRadius");
+  parameterCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& rangeCmd
+    = fMessenger->DeclareMethod("range", &B1AdaptiveSweep::SetRange,
+        "Range of the parameter: min max unit.");
+  rangeCmd.SetParameterName("range", false);
+  rangeCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& logCmd
+    = fMessenger->DeclareProperty("logScale", fLogScale,
+        "Place and split the points in log scale.");
+  logCmd.SetParameterName("flag", true);
+  logCmd.SetDefaultValue("true");
+  logCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& initialCmd
+    = fMessenger->DeclareProperty("initialPoints", fInitialPoints,
+        "Points of the initial uniform grid.");
+  initialCmd.SetParameterName("points", false);
+  initialCmd.SetRange("points>=2");
+  initialCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& maxCmd
+    = fMessenger->DeclareProperty("maxPoints", fMaxPoints,
+        "No point is inserted beyond this number.");
+  maxCmd.SetParameterName("points", false);
+  maxCmd.SetRange("points>=2");
+  maxCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& batchCmd
+    = fMessenger->DeclareProperty("eventsPerBatch", fEventsPerBatch,
+        "Events of the first run of a point, and of the smallest addition.");
+  batchCmd.SetParameterName("events", false);
+  batchCmd.SetRange("events>0");
+  batchCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& errorCmd
+    = fMessenger->DeclareProperty("targetError", fTargetError,
+        "Relative error aimed at, for the doses and the interpolation.");
+  errorCmd.SetParameterName("error", false);
+  errorCmd.SetRange("error>0.");
+  errorCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& budgetCmd
+    = fMessenger->DeclarePropertyWithUnit("timeBudget", "s", fTimeBudget,
+        "No run is started after this time (0 for no limit).");
+  budgetCmd.SetParameterName("time", false);
+  budgetCmd.SetRange("time>=0.");
+  budgetCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& detectorCmd
+    = fMessenger->DeclareProperty("detector", fDetector,
+        "Detector whose dose is swept.");
+  detectorCmd.SetParameterName("detector", false);
+  detectorCmd.SetRange("detector>=0");
+  detectorCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareProperty("file", fFileName,
+        "Output table of the sweep (empty string for none).");
+  fileCmd.SetParameterName("fileName", true);
+  fileCmd.SetDefaultValue("");
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& runCmd
+    = fMessenger->DeclareMethod("run", &B1AdaptiveSweep::Run,
+        "Run the sweep.");
+  runCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
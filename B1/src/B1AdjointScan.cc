@@ -0,0 +1,514 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1AdjointScan.cc
+/// \brief Implementation of the B1AdjointScan and B1AdjointPhysics classes
+
+#include "B1AdjointScan.hh"
+#include "B1DetectorConstruction.hh"
+
+#include "G4AdjointSimManager.hh"
+#include "G4AdjointCSManager.hh"
+#include "G4AdjointGamma.hh"
+#include "G4AdjointElectron.hh"
+#include "G4AdjointComptonModel.hh"
+#include "G4AdjointPhotoElectricModel.hh"
+#include "G4AdjointeIonisationModel.hh"
+#include "G4AdjointBremsstrahlungModel.hh"
+#include "G4AdjointAlongStepWeightCorrection.hh"
+#include "G4ContinuousGainOfEnergy.hh"
+#include "G4eAdjointMultipleScattering.hh"
+#include "G4eInverseIonisation.hh"
+#include "G4eInverseBremsstrahlung.hh"
+#include "G4eInverseCompton.hh"
+#include "G4InversePEEffect.hh"
+#include "G4ComptonScattering.hh"
+#include "G4PhotoElectricEffect.hh"
+#include "G4GammaConversion.hh"
+#include "G4eMultipleScattering.hh"
+#include "G4eIonisation.hh"
+#include "G4eBremsstrahlung.hh"
+#include "G4eplusAnnihilation.hh"
+#include "G4UrbanMscModel.hh"
+#include "G4BosonConstructor.hh"
+#include "G4LeptonConstructor.hh"
+#include "G4MesonConstructor.hh"
+#include "G4BaryonConstructor.hh"
+#include "G4IonConstructor.hh"
+#include "G4Gamma.hh"
+#include "G4Electron.hh"
+#include "G4Positron.hh"
+#include "G4ProcessManager.hh"
+#include "G4ParticleTable.hh"
+#include "G4RunManager.hh"
+#include "G4LogicalVolumeStore.hh"
+#include "G4LogicalVolume.hh"
+#include "G4PhysicalVolumeStore.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4Box.hh"
+#include "G4GenericMessenger.hh"
+#include "G4UnitsTable.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4PhysicalConstants.hh"
+#include "G4Timer.hh"
+
+#include <fstream>
+#include <cmath>
+
+namespace
+{
+  // energy range of the adjoint models, above the sources of the example
+  const G4double adjointModelsEMin = 1.*keV;
+  const G4double adjointModelsEMax = 20.*MeV;
+}
+
+B1AdjointScan* B1AdjointScan::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1AdjointScan* B1AdjointScan::Instance()
+{
+  if (!fgInstance) fgInstance = new B1AdjointScan;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1AdjointScan::B1AdjointScan()
+: fMessenger(0),
+  fParticle("gamma"),
+  fEMin(5.9*MeV), fEMax(6.1*MeV),
+  fCone(5.*deg),
+  fAdjointEMin(10.*keV),
+  fNX(20), fNY(20),
+  fFileName("adjoint_map.txt"),
+  fDetector(-1),
+  fFrontZ(0.),
+  fX0(0.), fY0(0.), fPitchX(0.), fPitchY(0.),
+  fDensity(0.)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1AdjointScan::~B1AdjointScan()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B1AdjointScan::IsAvailable()
+{
+  // the reverse Monte Carlo of this Geant4 version is sequential only
+  return G4RunManager::GetRunManager()->GetRunManagerType()
+           == G4RunManager::sequentialRM
+      && G4ParticleTable::GetParticleTable()->FindParticle("adj_gamma");
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1AdjointScan::Scan(G4int nofHistories)
+{
+  if (!IsAvailable()) {
+    G4Exception("B1AdjointScan::Scan()", "MyCode0021", JustWarning,
+                "The adjoint scan needs PHYSLIST=adjoint at startup.");
+    return;
+  }
+  if (!(fEMax > fEMin && fEMin > 0.)) {
+    G4Exception("B1AdjointScan::Scan()", "MyCode0021", JustWarning,
+                "The source energy band is empty.");
+    return;
+  }
+
+  G4Box* envelopeBox = 0;
+  G4LogicalVolume* envelope
+    = G4LogicalVolumeStore::GetInstance()->GetVolume("Envelope", false);
+  if (envelope) envelopeBox = dynamic_cast<G4Box*>(envelope->GetSolid());
+  if (!envelopeBox) {
+    G4Exception("B1AdjointScan::Scan()", "MyCode0021", JustWarning,
+                "Envelope volume of box shape not found, no scan.");
+    return;
+  }
+
+  // source plane: the front face of the envelope, as for the gun
+  fFrontZ = -envelopeBox->GetZHalfLength();
+  fX0 = -envelopeBox->GetXHalfLength();
+  fY0 = -envelopeBox->GetYHalfLength();
+  fPitchX = 2.*envelopeBox->GetXHalfLength()/fNX;
+  fPitchY = 2.*envelopeBox->GetYHalfLength()/fNY;
+  G4double solidAngle = twopi*(1. - std::cos(fCone));
+  fDensity = 1./(fPitchX*fPitchY*(fEMax - fEMin)*solidAngle);
+
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  const std::vector<G4LogicalVolume*>& volumes
+    = detectorConstruction->GetScoringVolumes();
+  G4int nofDetectors = (G4int)volumes.size();
+  G4int nofPixels = fNX*fNY;
+  fDetectorNames.assign(nofDetectors, G4String());
+  fMasses.resize(nofDetectors);
+  fHistories.assign(nofDetectors, 0.);
+  fSum.assign(nofDetectors*nofPixels, 0.);
+  fSum2.assign(nofDetectors*nofPixels, 0.);
+
+  G4AdjointSimManager* adjointManager = G4AdjointSimManager::GetInstance();
+  adjointManager->SetAdjointSourceEmin(fAdjointEMin);
+  adjointManager->SetAdjointSourceEmax(fEMax);
+  adjointManager->SetExtSourceEmax(fEMax);
+  adjointManager->DefineExtSourceOnTheExtSurfaceOfAVolume("Envelope");
+
+  G4cout << "Adjoint scan: " << nofDetectors << " detectors, "
+         << nofHistories << " histories each, map of " << fNX << " x "
+         << fNY << " pixels" << G4endl;
+
+  for (G4int d = 0; d < nofDetectors; d++) {
+    fMasses[d] = volumes[d]->GetMass();
+    if (!SetUpSurfaces(d, fDetectorNames[d])) continue;
+
+    G4Timer timer;
+    timer.Start();
+    fDetector = d;
+    adjointManager->RunAdjointSimulation(nofHistories);
+    fDetector = -1;
+    timer.Stop();
+
+    // the adjoint primaries cycle over the particle types, nofHistories each
+    fHistories[d] = nofHistories;
+    G4int nofTypes = (G4int)adjointManager->GetNbOfPrimaryFwdParticles();
+    G4int scored = 0;
+    for (G4int p = 0; p < nofPixels; p++) {
+      if (fSum[d*nofPixels + p] > 0.) scored++;
+    }
+    G4cout << "Adjoint scan: detector " << fDetectorNames[d] << ", "
+           << nofHistories*nofTypes << " adjoint primaries, " << scored
+           << " pixels scored, " << timer.GetRealElapsed() << " s" << G4endl;
+  }
+  Write();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B1AdjointScan::SetUpSurfaces(G4int detector, G4String& volumeName)
+{
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  const G4LogicalVolume* logical
+    = detectorConstruction->GetScoringVolumes()[detector];
+
+  // the adjoint source is given by the name of the placement
+  G4PhysicalVolumeStore* store = G4PhysicalVolumeStore::GetInstance();
+  for (size_t i = 0; i < store->size(); i++) {
+    if ((*store)[i]->GetLogicalVolume() == logical) {
+      volumeName = (*store)[i]->GetName();
+      return G4AdjointSimManager::GetInstance()
+               ->DefineAdjointSourceOnTheExtSurfaceOfAVolume(volumeName);
+    }
+  }
+  G4ExceptionDescription msg;
+  msg << "No placement of detector " << detector << ", skipped.";
+  G4Exception("B1AdjointScan::SetUpSurfaces()", "MyCode0021", JustWarning, msg);
+  return false;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1AdjointScan::EndOfEvent(const std::vector<G4double>& detectorEdep)
+{
+  // scored after the forward phase, if the adjoint track reached the
+  // surface of the envelope
+  G4AdjointSimManager* adjointManager = G4AdjointSimManager::GetInstance();
+  if (adjointManager->GetAdjointTrackingMode()
+      || !adjointManager->GetDidAdjParticleReachTheExtSource()) return;
+
+  G4double edep = detectorEdep[fDetector];
+  if (edep <= 0.) return;
+  if (adjointManager->GetFwdParticleNameAtEndOfLastAdjointTrack() != fParticle)
+    return;
+
+  G4double energy = adjointManager->GetEkinAtEndOfLastAdjointTrack();
+  if (energy < fEMin || energy > fEMax) return;
+
+  G4ThreeVector position = adjointManager->GetPositionAtEndOfLastAdjointTrack();
+  if (std::fabs(position.z() - fFrontZ) > 1.*um) return;
+
+  // the forward particle goes against the adjoint one
+  G4double cosTheta = -adjointManager->GetDirectionAtEndOfLastAdjointTrack().z();
+  if (cosTheta < std::cos(fCone)) return;
+
+  G4int ix = (G4int)std::floor((position.x() - fX0)/fPitchX);
+  G4int iy = (G4int)std::floor((position.y() - fY0)/fPitchY);
+  if (ix < 0 || ix >= fNX || iy < 0 || iy >= fNY) return;
+
+  G4double contribution
+    = adjointManager->GetWeightAtEndOfLastAdjointTrack()*edep*fDensity/cosTheta;
+  G4int i = fDetector*fNX*fNY + iy*fNX + ix;
+  fSum[i]  += contribution;
+  fSum2[i] += contribution*contribution;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1AdjointScan::Write() const
+{
+  std::ofstream output(fFileName.c_str());
+  if (!output) {
+    G4ExceptionDescription msg;
+    msg << "Cannot write the adjoint maps to " << fFileName << ".";
+    G4Exception("B1AdjointScan::Write()", "MyCode0021", JustWarning, msg);
+    return;
+  }
+
+  G4int nofTypes
+    = (G4int)G4AdjointSimManager::GetInstance()->GetNbOfPrimaryFwdParticles();
+  G4int nofPixels = fNX*fNY;
+  output << "# adjoint response maps: mean deposit (MeV) and dose (Gy) in "
+            "the detector per " << fParticle << " of "
+         << fEMin/MeV << "-" << fEMax/MeV << " MeV within " << fCone/deg
+         << " deg of +z, shot uniformly into the pixel\n"
+         << "# detector  name  ix  iy  x (cm)  y (cm)  edep  error"
+            "  dose  error\n";
+  for (size_t d = 0; d < fHistories.size(); d++) {
+    G4double n = fHistories[d];
+    if (n <= 0.) continue;
+    for (G4int p = 0; p < nofPixels; p++) {
+      // nofTypes*n histories, normalized per adjoint primary type
+      G4double sum = fSum[d*nofPixels + p];
+      G4double sum2 = fSum2[d*nofPixels + p];
+      G4double histories = nofTypes*n;
+      G4double mean = sum/n;
+      G4double variance = 0.;
+      if (histories > 1.) {
+        variance = (sum2 - sum*sum/histories)/(histories - 1.)*nofTypes/n;
+      }
+      G4double error = (variance > 0.) ? std::sqrt(variance) : 0.;
+      G4int ix = p % fNX;
+      G4int iy = p / fNX;
+      output << d << "\t" << fDetectorNames[d] << "\t" << ix << "\t" << iy
+             << "\t" << (fX0 + (ix + 0.5)*fPitchX)/cm
+             << "\t" << (fY0 + (iy + 0.5)*fPitchY)/cm
+             << "\t" << mean/MeV << "\t" << error/MeV
+             << "\t" << mean/fMasses[d]/gray << "\t" << error/fMasses[d]/gray
+             << "\n";
+    }
+  }
+  G4cout << "Adjoint scan: maps written to " << fFileName << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1AdjointScan::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/adjoint/",
+                                      "Adjoint response maps");
+
+  G4GenericMessenger::Command& particleCmd
+    = fMessenger->DeclareProperty("particle", fParticle,
+        "Particle of the source.");
+  particleCmd.SetParameterName("particle", false);
+  particleCmd.SetCandidates("gamma e-");
+  particleCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& eMinCmd
+    = fMessenger->DeclarePropertyWithUnit("eMin", "MeV", fEMin,
+        "Lower edge of the source energy band.");
+  eMinCmd.SetParameterName("eMin", false);
+  eMinCmd.SetRange("eMin>0.");
+  eMinCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& eMaxCmd
+    = fMessenger->DeclarePropertyWithUnit("eMax", "MeV", fEMax,
+        "Upper edge of the source energy band.");
+  eMaxCmd.SetParameterName("eMax", false);
+  eMaxCmd.SetRange("eMax>0.");
+  eMaxCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& coneCmd
+    = fMessenger->DeclarePropertyWithUnit("cone", "deg", fCone,
+        "Half angle of the source directions around +z.");
+  coneCmd.SetParameterName("cone", false);
+  coneCmd.SetRange("cone>0.");
+  coneCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& adjointEMinCmd
+    = fMessenger->DeclarePropertyWithUnit("adjointEmin", "keV", fAdjointEMin,
+        "Lowest energy of the particles entering a detector.");
+  adjointEMinCmd.SetParameterName("adjointEmin", false);
+  adjointEMinCmd.SetRange("adjointEmin>0.");
+  adjointEMinCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& nXCmd
+    = fMessenger->DeclareProperty("nX", fNX, "Number of pixels along x.");
+  nXCmd.SetParameterName("nX", false);
+  nXCmd.SetRange("nX>0");
+  nXCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& nYCmd
+    = fMessenger->DeclareProperty("nY", fNY, "Number of pixels along y.");
+  nYCmd.SetParameterName("nY", false);
+  nYCmd.SetRange("nY>0");
+  nYCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareProperty("file", fFileName,
+        "Output file of the response maps.");
+  fileCmd.SetParameterName("fileName", false);
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& scanCmd
+    = fMessenger->DeclareMethod("scan", &B1AdjointScan::Scan,
+        "Run the given number of adjoint histories for every detector "
+        "and write the response maps.");
+  scanCmd.SetParameterName("nofHistories", false);
+  scanCmd.SetRange("nofHistories>0");
+  scanCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1AdjointPhysics::B1AdjointPhysics()
+: G4VPhysicsConstructor("B1Adjoint")
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1AdjointPhysics::~B1AdjointPhysics()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1AdjointPhysics::ConstructParticle()
+{
+  G4BosonConstructor  bosons;  bosons.ConstructParticle();
+  G4LeptonConstructor leptons; leptons.ConstructParticle();
+  G4MesonConstructor  mesons;  mesons.ConstructParticle();
+  G4BaryonConstructor baryons; baryons.ConstructParticle();
+  G4IonConstructor    ions;    ions.ConstructParticle();
+
+  G4AdjointGamma::AdjointGammaDefinition();
+  G4AdjointElectron::AdjointElectronDefinition();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1AdjointPhysics::ConstructProcess()
+{
+  G4AdjointCSManager* csManager = G4AdjointCSManager::GetAdjointCSManager();
+  G4AdjointSimManager* adjointManager = G4AdjointSimManager::GetInstance();
+  csManager->RegisterAdjointParticle(G4AdjointElectron::AdjointElectron());
+  csManager->RegisterAdjointParticle(G4AdjointGamma::AdjointGamma());
+  adjointManager->ConsiderParticleAsPrimary("e-");
+  adjointManager->ConsiderParticleAsPrimary("gamma");
+
+  // forward processes, registered for the adjoint cross sections
+  G4ParticleDefinition* gamma = G4Gamma::Gamma();
+  G4ComptonScattering* compton = new G4ComptonScattering();
+  G4PhotoElectricEffect* photoElectric = new G4PhotoElectricEffect();
+  G4ProcessManager* gammaManager = gamma->GetProcessManager();
+  gammaManager->AddDiscreteProcess(compton);
+  gammaManager->AddDiscreteProcess(photoElectric);
+  gammaManager->AddDiscreteProcess(new G4GammaConversion());
+  csManager->RegisterEmProcess(compton, gamma);
+  csManager->RegisterEmProcess(photoElectric, gamma);
+
+  G4ParticleDefinition* electron = G4Electron::Electron();
+  G4eMultipleScattering* electronMsc = new G4eMultipleScattering();
+  electronMsc->AddEmModel(1, new G4UrbanMscModel());
+  G4eIonisation* electronIonisation = new G4eIonisation();
+  G4eBremsstrahlung* electronBrems = new G4eBremsstrahlung();
+  G4ProcessManager* electronManager = electron->GetProcessManager();
+  electronManager->AddProcess(electronMsc, -1, 1, 1);
+  electronManager->AddProcess(electronIonisation, -1, 2, 2);
+  electronManager->AddProcess(electronBrems, -1, 3, 3);
+  csManager->RegisterEnergyLossProcess(electronIonisation, electron);
+  csManager->RegisterEnergyLossProcess(electronBrems, electron);
+
+  G4ProcessManager* positronManager = G4Positron::Positron()->GetProcessManager();
+  G4eplusAnnihilation* annihilation = new G4eplusAnnihilation();
+  positronManager->AddProcess(new G4eMultipleScattering(), -1, 1, 1);
+  positronManager->AddProcess(new G4eIonisation(), -1, 2, 2);
+  positronManager->AddProcess(new G4eBremsstrahlung(), -1, 3, 3);
+  positronManager->AddProcess(annihilation, 0, -1, 4);
+
+  // adjoint models, shared by the projectile and product cases
+  G4AdjointeIonisationModel* ionisationModel = new G4AdjointeIonisationModel();
+  G4AdjointBremsstrahlungModel* bremsModel = new G4AdjointBremsstrahlungModel();
+  G4AdjointComptonModel* comptonModel = new G4AdjointComptonModel();
+  G4AdjointPhotoElectricModel* photoElectricModel
+    = new G4AdjointPhotoElectricModel();
+  comptonModel->SetDirectProcess(compton);
+  comptonModel->SetUseMatrix(false);
+  bremsModel->SetHighEnergyLimit(1.01*adjointModelsEMax);
+  bremsModel->SetLowEnergyLimit(adjointModelsEMin);
+  ionisationModel->SetHighEnergyLimit(adjointModelsEMax);
+  ionisationModel->SetLowEnergyLimit(adjointModelsEMin);
+  comptonModel->SetHighEnergyLimit(adjointModelsEMax);
+  comptonModel->SetLowEnergyLimit(adjointModelsEMin);
+  photoElectricModel->SetHighEnergyLimit(adjointModelsEMax);
+  photoElectricModel->SetLowEnergyLimit(adjointModelsEMin);
+
+  // adjoint electron: energy gain along the step, reverse interactions
+  G4ContinuousGainOfEnergy* gainOfEnergy = new G4ContinuousGainOfEnergy();
+  gainOfEnergy->SetLossFluctuations(true);
+  gainOfEnergy->SetDirectEnergyLossProcess(electronIonisation);
+  gainOfEnergy->SetDirectParticle(electron);
+  G4eAdjointMultipleScattering* adjointMsc = new G4eAdjointMultipleScattering();
+  adjointMsc->AddEmModel(1, new G4UrbanMscModel());
+
+  G4ProcessManager* adjointElectronManager
+    = G4AdjointElectron::AdjointElectron()->GetProcessManager();
+  adjointElectronManager->AddProcess(adjointMsc, -1, 1, 7);
+  adjointElectronManager->AddProcess(gainOfEnergy, -1, 2, -1);
+  adjointElectronManager->AddProcess(new G4AdjointAlongStepWeightCorrection(),
+                                     -1, 3, -1);
+  adjointElectronManager->AddProcess(
+    new G4eInverseIonisation(true, "Inv_eIon", ionisationModel), -1, -1, 1);
+  adjointElectronManager->AddProcess(
+    new G4eInverseIonisation(false, "Inv_eIon1", ionisationModel), -1, -1, 2);
+  adjointElectronManager->AddProcess(
+    new G4eInverseBremsstrahlung(true, "Inv_eBrem", bremsModel), -1, -1, 3);
+  adjointElectronManager->AddProcess(
+    new G4eInverseCompton(false, "Inv_Compt1", comptonModel), -1, -1, 4);
+  adjointElectronManager->AddProcess(
+    new G4InversePEEffect("Inv_PEEffect", photoElectricModel), -1, -1, 5);
+
+  // adjoint photon
+  G4ProcessManager* adjointGammaManager
+    = G4AdjointGamma::AdjointGamma()->GetProcessManager();
+  adjointGammaManager->AddProcess(new G4AdjointAlongStepWeightCorrection(),
+                                  -1, 1, -1);
+  adjointGammaManager->AddProcess(
+    new G4eInverseBremsstrahlung(false, "Inv_eBrem1", bremsModel), -1, -1, 1);
+  adjointGammaManager->AddProcess(
+    new G4eInverseCompton(true, "Inv_Compt", comptonModel), -1, -1, 2);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,101 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1AliasTable.cc
+/// \brief Implementation of the B1AliasTable class
+
+#include "B1AliasTable.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1AliasTable::B1AliasTable()
+: fTotalWeight(0.)
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1AliasTable::B1AliasTable(const std::vector<G4double>& weights)
+: fTotalWeight(0.)
+{
+  Build(weights);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1AliasTable::~B1AliasTable()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1AliasTable::Build(const std::vector<G4double>& weights)
+{
+  const G4int n = (G4int)weights.size();
+  fThreshold.assign(n, 1.);
+  fAlias.resize(n);
+  fProbability.assign(n, 0.);
+  fTotalWeight = 0.;
+  if (n == 0) return;
+
+  for (G4int i = 0; i < n; i++) {
+    if (weights[i] > 0.) fTotalWeight += weights[i];
+  }
+  if (fTotalWeight <= 0.) {
+    G4Exception("B1AliasTable::Build()", "MyCode0003", JustWarning,
+                "All weights are zero, falling back to a flat distribution.");
+  }
+
+  // scaled probabilities: a column is "small" below 1 and "large" above
+  std::vector<G4double> scaled(n);
+  std::vector<G4int> small, large;
+  small.reserve(n);
+  large.reserve(n);
+  for (G4int i = 0; i < n; i++) {
+    G4double w = (weights[i] > 0.) ? weights[i] : 0.;
+    fProbability[i] = (fTotalWeight > 0.) ? w / fTotalWeight : 1. / n;
+    scaled[i] = fProbability[i] * n;
+    fAlias[i] = i;
+    if (scaled[i] < 1.) small.push_back(i); else large.push_back(i);
+  }
+
+  // Vose: fill every small column up to 1 with mass taken from a large one
+  while (!small.empty() && !large.empty()) {
+    G4int s = small.back(); small.pop_back();
+    G4int l = large.back();
+    fThreshold[s] = scaled[s];
+    fAlias[s] = l;
+    scaled[l] -= 1. - scaled[s];
+    if (scaled[l] < 1.) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // whatever is left is 1 up to rounding
+  for (size_t k = 0; k < large.size(); k++) fThreshold[large[k]] = 1.;
+  for (size_t k = 0; k < small.size(); k++) fThreshold[small[k]] = 1.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,193 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1AttenuationTable.cc
+/// \brief Implementation of the B1AttenuationTable class
+
+#include "B1AttenuationTable.hh"
+
+#include "G4EmCalculator.hh"
+#include "G4Gamma.hh"
+#include "G4Electron.hh"
+#include "G4Material.hh"
+#include "G4AutoLock.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4PhysicalConstants.hh"
+
+#include <map>
+#include <cmath>
+#include <cfloat>
+
+namespace
+{
+  G4Mutex attenuationMutex = G4MUTEX_INITIALIZER;
+
+  const G4double tableEMin = 1.*keV;
+  const G4double tableEMax = 100.*MeV;
+  const G4int    pointsPerDecade = 100;
+
+  const char* processNames[B1AttenuationTable::kNofProcesses]
+    = { "phot", "compt", "conv", "Rayl" };
+
+  struct AttenuationRegistry
+  {
+    std::map<const G4Material*, B1AttenuationTable*> fTables;
+    ~AttenuationRegistry()
+    {
+      std::map<const G4Material*, B1AttenuationTable*>::iterator it;
+      for (it = fTables.begin(); it != fTables.end(); ++it) delete it->second;
+    }
+  };
+  AttenuationRegistry attenuationRegistry;
+
+  const G4int comptonPoints = 200;
+
+  // Klein-Nishina cross section at the Simpson nodes in cos(theta), with
+  // the fraction of the photon energy given to the electron
+  void KleinNishina(G4double energy, G4int i, G4double& dsigma,
+                    G4double& transfer)
+  {
+    const G4double eps = energy / electron_mass_c2;
+    G4double cosTheta = -1. + 2.*i/comptonPoints;
+    G4double ratio = 1. / (1. + eps*(1. - cosTheta));  // k'/k
+    G4double w = (i == 0 || i == comptonPoints) ? 1. : ((i % 2) ? 4. : 2.);
+    dsigma = w*ratio*ratio*(ratio + 1./ratio - (1. - cosTheta*cosTheta));
+    transfer = 1. - ratio;
+  }
+
+  // Klein-Nishina mean fraction of the photon energy given to the electron
+  G4double ComptonTransferFraction(G4double energy)
+  {
+    G4double sigma = 0., sigmaTr = 0.;
+    for (G4int i = 0; i <= comptonPoints; i++) {
+      G4double dsigma, transfer;
+      KleinNishina(energy, i, dsigma, transfer);
+      sigma   += dsigma;
+      sigmaTr += dsigma*transfer;
+    }
+    return (sigma > 0.) ? sigmaTr/sigma : 0.;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+const B1AttenuationTable*
+B1AttenuationTable::GetShared(const G4Material* material)
+{
+  G4AutoLock lock(&attenuationMutex);
+
+  std::map<const G4Material*, B1AttenuationTable*>::iterator it
+    = attenuationRegistry.fTables.find(material);
+  if (it != attenuationRegistry.fTables.end()) return it->second;
+
+  B1AttenuationTable* table = new B1AttenuationTable(material);
+  attenuationRegistry.fTables[material] = table;
+  return table;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+const char* B1AttenuationTable::GetProcessName(Process process)
+{
+  return processNames[process];
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1AttenuationTable::B1AttenuationTable(const G4Material* material)
+: fMaterial(material),
+  fLogEMin(std::log(tableEMin)),
+  fInvLogStep(pointsPerDecade/std::log(10.))
+{
+  G4int nofPoints
+    = (G4int)(std::log10(tableEMax/tableEMin)*pointsPerDecade) + 1;
+  fMu.assign(nofPoints, 0.);
+  fMuTr.assign(nofPoints, 0.);
+  fMuEn.assign(nofPoints, 0.);
+  for (G4int p = 0; p < kNofProcesses; p++) fMuProcess[p].assign(nofPoints, 0.);
+
+  G4EmCalculator calculator;
+  calculator.SetVerbose(0);
+  const G4ParticleDefinition* gamma = G4Gamma::Gamma();
+  const G4ParticleDefinition* electron = G4Electron::Electron();
+
+  // radiative yield of the electrons, Y(T) = 1/T int_0^T S_rad/S_tot dT',
+  // by trapezoids on the grid (the part below its first point is nil)
+  std::vector<G4double> yield(nofPoints, 0.);
+  G4double integral = 0., previousEnergy = 0., previousRatio = 0.;
+  for (G4int i = 0; i < nofPoints; i++) {
+    G4double energy = std::exp(fLogEMin + i/fInvLogStep);
+    G4double total
+      = calculator.ComputeTotalDEDX(energy, electron, material, DBL_MAX);
+    G4double radiative = calculator.ComputeDEDX(energy, electron, "eBrem",
+                                                material, DBL_MAX);
+    G4double ratio = (total > 0.) ? radiative/total : 0.;
+    if (i > 0) {
+      integral += 0.5*(ratio + previousRatio)*(energy - previousEnergy);
+    }
+    yield[i] = integral/energy;
+    previousEnergy = energy;
+    previousRatio = ratio;
+  }
+
+  for (G4int i = 0; i < nofPoints; i++) {
+    G4double energy = std::exp(fLogEMin + i/fInvLogStep);
+    for (G4int p = 0; p < kNofProcesses; p++) {
+      fMuProcess[p][i] = calculator.ComputeCrossSectionPerVolume(
+        energy, gamma, processNames[p], material);
+      fMu[i] += fMuProcess[p][i];
+    }
+    G4double pairFraction = (energy > 2.*electron_mass_c2)
+      ? 1. - 2.*electron_mass_c2/energy : 0.;
+    fMuTr[i] = fMuProcess[kPhot][i]
+             + fMuProcess[kCompt][i]*ComptonTransferFraction(energy)
+             + fMuProcess[kConv][i]*pairFraction;
+
+    // energy kept by the charged secondaries, Compton recoils weighted
+    // by their energy
+    G4double sigma = 0., comptonAbsorbed = 0.;
+    for (G4int k = 0; k <= comptonPoints; k++) {
+      G4double dsigma, transfer;
+      KleinNishina(energy, k, dsigma, transfer);
+      sigma += dsigma;
+      comptonAbsorbed
+        += dsigma*transfer*(1. - Interpolate(yield, transfer*energy));
+    }
+    G4double pairAbsorbed = (pairFraction > 0.)
+      ? pairFraction*(1. - Interpolate(yield, 0.5*pairFraction*energy)) : 0.;
+    fMuEn[i] = fMuProcess[kPhot][i]*(1. - Interpolate(yield, energy))
+             + fMuProcess[kCompt][i]*((sigma > 0.) ? comptonAbsorbed/sigma : 0.)
+             + fMuProcess[kConv][i]*pairAbsorbed;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1AttenuationTable::~B1AttenuationTable()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,366 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1CorrelatedSampling.cc
+/// \brief Implementation of the B1CorrelatedSampling class
+
+#include "B1CorrelatedSampling.hh"
+#include "B1DetectorConstruction.hh"
+#include "B1Run.hh"
+
+#include "G4RunManager.hh"
+#include "G4UImanager.hh"
+#include "G4LogicalVolume.hh"
+#include "G4GenericMessenger.hh"
+#include "G4AutoLock.hh"
+#include "G4UnitsTable.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <cmath>
+#include <iomanip>
+
+#include <stdint.h>
+
+namespace
+{
+  G4Mutex correlatedMutex = G4MUTEX_INITIALIZER;
+
+  // SplitMix64 finalizer, spreads consecutive event numbers over the seeds
+  uint64_t Mix(uint64_t z)
+  {
+    z += 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  // variance of the mean from the sums over n events
+  G4double VarianceOfMean(G4double sum, G4double sum2, G4double n)
+  {
+    if (n < 2.) return 0.;
+    G4double variance = (sum2 - sum*sum/n) / (n - 1.);
+    return (variance > 0.) ? variance / n : 0.;
+  }
+}
+
+B1CorrelatedSampling* B1CorrelatedSampling::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1CorrelatedSampling* B1CorrelatedSampling::Instance()
+{
+  if (!fgInstance) fgInstance = new B1CorrelatedSampling;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1CorrelatedSampling::B1CorrelatedSampling()
+: fMessenger(0),
+  fSeed(12345),
+  fFileName("correlated.txt"),
+  fReferenceDetectors(0),
+  fCurrent(-1),
+  fNofEvents(0),
+  fNofDetectors(0)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1CorrelatedSampling::~B1CorrelatedSampling()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1CorrelatedSampling::SeedEvent(G4int eventID) const
+{
+  uint64_t z = Mix(((uint64_t)(uint32_t)fSeed << 32) | (uint32_t)eventID);
+  // within the ranges of the Ranecu seeds, non-zero for the engines which
+  // read the seeds up to a 0
+  long seeds[3] = { (long)(1 + (z & 0xffffffffULL) % 2147483562ULL),
+                    (long)(1 + (z >> 32) % 2147483398ULL), 0 };
+  G4Random::setTheSeeds(seeds);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1CorrelatedSampling::BeginOfRun(G4int nofEvents, G4int nofDetectors)
+{
+  if (!IsActive()) return;
+
+  Configuration& configuration = fConfigurations[fCurrent];
+  fNofEvents = nofEvents;
+  fNofDetectors = nofDetectors;
+  configuration.fNofEvents = 0;
+  if (fCurrent == 0) {
+    // filled by the worker threads, each event in its own slots
+    fReference.assign((size_t)nofEvents*nofDetectors, 0.);
+    fReferenceDetectors = nofDetectors;
+  }
+  else {
+    // compared with the reference detectors only
+    G4int nofSums = std::min(nofDetectors, fReferenceDetectors);
+    configuration.fSum.assign(nofSums, 0.);
+    configuration.fSum2.assign(nofSums, 0.);
+    configuration.fSumDiff.assign(nofSums, 0.);
+    configuration.fSumDiff2.assign(nofSums, 0.);
+  }
+
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  const std::vector<G4LogicalVolume*>& volumes
+    = detectorConstruction->GetScoringVolumes();
+  configuration.fMasses.resize(nofDetectors);
+  for (G4int d = 0; d < nofDetectors; d++) {
+    configuration.fMasses[d] = volumes[d]->GetMass();
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1CorrelatedSampling::EndOfEvent(G4int eventID,
+                                      const std::vector<G4int>& hitDetectors,
+                                      const std::vector<G4double>& detectorEdep)
+{
+  if (eventID >= fNofEvents) return;
+  Configuration& configuration = fConfigurations[fCurrent];
+  if (fCurrent == 0) {
+    for (size_t i = 0; i < hitDetectors.size(); i++) {
+      G4int detector = hitDetectors[i];
+      if (detector < fNofDetectors) {
+        fReference[(size_t)eventID*fNofDetectors + detector]
+          = detectorEdep[detector];
+      }
+    }
+    G4AutoLock lock(&correlatedMutex);
+    configuration.fNofEvents++;
+    return;
+  }
+
+  // every detector, the reference may have a deposit where this one has none
+  const Configuration& reference = fConfigurations[0];
+  const G4double* referenceEdep
+    = &fReference[(size_t)eventID*fReferenceDetectors];
+  G4AutoLock lock(&correlatedMutex);
+  for (size_t d = 0; d < configuration.fSum.size(); d++) {
+    G4double a = referenceEdep[d] / reference.fMasses[d];
+    G4double b = detectorEdep[d] / configuration.fMasses[d];
+    configuration.fSum[d]      += b;
+    configuration.fSum2[d]     += b*b;
+    configuration.fSumDiff[d]  += b - a;
+    configuration.fSumDiff2[d] += (b - a)*(b - a);
+  }
+  configuration.fNofEvents++;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1CorrelatedSampling::AddConfiguration(G4String label)
+{
+  Configuration configuration;
+  configuration.fLabel = label;
+  configuration.fNofEvents = 0;
+  fConfigurations.push_back(configuration);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1CorrelatedSampling::AddCommand(G4String command)
+{
+  if (fConfigurations.empty()) {
+    G4Exception("B1CorrelatedSampling::AddCommand()", "MyCode0024",
+                JustWarning, "No configuration added yet.");
+    return;
+  }
+  fConfigurations.back().fCommands.push_back(command);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1CorrelatedSampling::Clear()
+{
+  fConfigurations.clear();
+  std::vector<G4double>().swap(fReference);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1CorrelatedSampling::Run(G4int nofEvents)
+{
+  if (fConfigurations.size() < 2) {
+    G4Exception("B1CorrelatedSampling::Run()", "MyCode0024", JustWarning,
+                "At least two configurations are needed, no run.");
+    return;
+  }
+
+  G4UImanager* uiManager = G4UImanager::GetUIpointer();
+  G4RunManager* runManager = G4RunManager::GetRunManager();
+  for (size_t c = 0; c < fConfigurations.size(); c++) {
+    Configuration& configuration = fConfigurations[c];
+    G4cout << "Correlated sampling: configuration " << configuration.fLabel
+           << ", " << nofEvents << " primaries" << G4endl;
+    for (size_t i = 0; i < configuration.fCommands.size(); i++) {
+      if (uiManager->ApplyCommand(configuration.fCommands[i]) != 0) {
+        G4ExceptionDescription msg;
+        msg << "Command \"" << configuration.fCommands[i] << "\" of "
+            << configuration.fLabel << " failed, comparison stopped.";
+        G4Exception("B1CorrelatedSampling::Run()", "MyCode0024",
+                    JustWarning, msg);
+        fCurrent = -1;
+        return;
+      }
+    }
+    fCurrent = c;
+    configuration.fNofEvents = 0;
+    runManager->BeamOn(nofEvents);
+    fCurrent = -1;
+    if (configuration.fNofEvents == 0) {
+      G4ExceptionDescription msg;
+      msg << "No run for configuration " << configuration.fLabel
+          << ", comparison stopped.";
+      G4Exception("B1CorrelatedSampling::Run()", "MyCode0024",
+                  JustWarning, msg);
+      return;
+    }
+  }
+
+  Write();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1CorrelatedSampling::Write() const
+{
+  std::ofstream output(fFileName.c_str());
+  if (!output) {
+    G4ExceptionDescription msg;
+    msg << "Cannot write the comparison to " << fFileName << ".";
+    G4Exception("B1CorrelatedSampling::Write()", "MyCode0024",
+                JustWarning, msg);
+  }
+  output << "# correlated sampling: dose per primary (Gy) of every "
+            "configuration and detector, difference with the first\n"
+         << "# configuration, with the paired error and the error of "
+            "independent runs\n"
+         << "# configuration  detector  reference  error  dose  error"
+            "  difference  paired_error  independent_error\n";
+
+  const Configuration& reference = fConfigurations[0];
+  G4cout << "\n Correlated sampling, difference with " << reference.fLabel
+         << " (" << fFileName << ")\n"
+         << " configuration  detector     difference        paired error"
+            "   independent error   variance ratio" << G4endl;
+  for (size_t c = 1; c < fConfigurations.size(); c++) {
+    const Configuration& configuration = fConfigurations[c];
+    G4double n = std::min(reference.fNofEvents, configuration.fNofEvents);
+    for (size_t d = 0; d < configuration.fSum.size(); d++) {
+      G4double sumA = 0., sumA2 = 0.;
+      for (size_t e = 0; e < (size_t)n; e++) {
+        G4double a = fReference[e*fReferenceDetectors + d]
+                     / reference.fMasses[d];
+        sumA  += a;
+        sumA2 += a*a;
+      }
+      G4double sumB = configuration.fSum[d];
+      G4double sumD = configuration.fSumDiff[d];
+      G4double varA = VarianceOfMean(sumA, sumA2, n);
+      G4double varB = VarianceOfMean(sumB, configuration.fSum2[d], n);
+      G4double varD = VarianceOfMean(sumD, configuration.fSumDiff2[d], n);
+      G4double paired = std::sqrt(varD);
+      G4double independent = std::sqrt(varA + varB);
+      output << configuration.fLabel << "\t" << d
+             << "\t" << sumA/n/gray << "\t" << std::sqrt(varA)/gray
+             << "\t" << sumB/n/gray << "\t" << std::sqrt(varB)/gray
+             << "\t" << sumD/n/gray << "\t" << paired/gray
+             << "\t" << independent/gray << "\n";
+      G4cout << std::setw(14) << configuration.fLabel << "  "
+             << std::setw(8) << d << "  "
+             << std::setw(12) << G4BestUnit(sumD/n, "Dose") << "  "
+             << std::setw(12) << G4BestUnit(paired, "Dose") << "  "
+             << std::setw(12) << G4BestUnit(independent, "Dose") << "  "
+             << std::setw(12) << (varD > 0. ? (varA + varB)/varD : 0.)
+             << G4endl;
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1CorrelatedSampling::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/correlated/",
+                                      "Correlated sampling of configurations");
+
+  G4GenericMessenger::Command& addCmd
+    = fMessenger->DeclareMethod("add", &B1CorrelatedSampling::AddConfiguration,
+        "Add a configuration with the given label, the first one is the "
+        "reference.");
+  addCmd.SetParameterName("label", false);
+  addCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& commandCmd
+    = fMessenger->DeclareMethod("command", &B1CorrelatedSampling::AddCommand,
+        "Command applied before the run of the last configuration.");
+  commandCmd.SetParameterName("command", false);
+  commandCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& seedCmd
+    = fMessenger->DeclareProperty("seed", fSeed,
+        "Seed the random numbers of every primary are derived from.");
+  seedCmd.SetParameterName("seed", false);
+  seedCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareProperty("file", fFileName,
+        "Output file of the comparison.");
+  fileCmd.SetParameterName("fileName", false);
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& runCmd
+    = fMessenger->DeclareMethod("run", &B1CorrelatedSampling::Run,
+        "Run the given number of primaries in every configuration and "
+        "compare them with the first one.");
+  runCmd.SetParameterName("nofEvents", false);
+  runCmd.SetRange("nofEvents>0");
+  runCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& clearCmd
+    = fMessenger->DeclareMethod("clear", &B1CorrelatedSampling::Clear,
+        "Remove all configurations.");
+  clearCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,319 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1CutTuner.cc
+/// \brief Implementation of the B1CutTuner class
+
+#include "B1CutTuner.hh"
+#include "B1Run.hh"
+
+#include "G4RunManager.hh"
+#include "G4UImanager.hh"
+#include "G4UIcommand.hh"
+#include "G4GenericMessenger.hh"
+#include "G4RegionStore.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+
+B1CutTuner* B1CutTuner::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1CutTuner* B1CutTuner::Instance()
+{
+  if (!fgInstance) fgInstance = new B1CutTuner;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1CutTuner::B1CutTuner()
+: fMessenger(0),
+  fRegions("Shapes Detectors"),
+  fEvents(20000),
+  fSeeds("12345 67890"),
+  fTolerance(0.02),
+  fMacroName("tunedCuts.mac"),
+  fCurrent(0)
+{
+  const G4double defaultCuts[] = { 0.01, 0.1, 0.3, 0.7, 2., 5. };
+  for (size_t i = 0; i < sizeof(defaultCuts)/sizeof(G4double); i++) {
+    fCuts.push_back(defaultCuts[i]*mm);
+  }
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1CutTuner::~B1CutTuner()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1CutTuner::SetCuts(G4String cuts)
+{
+  // values followed by their unit
+  std::istringstream input(cuts);
+  std::vector<G4String> words;
+  G4String word;
+  while (input >> word) words.push_back(word);
+  G4double unit = words.empty() ? 0. : G4UIcommand::ValueOf(words.back());
+  std::vector<G4double> values;
+  for (size_t i = 0; unit > 0. && i + 1 < words.size(); i++) {
+    G4double value = G4UIcommand::ConvertToDouble(words[i]);
+    if (value > 0.) values.push_back(value*unit);
+  }
+  if (values.size() < 2) {
+    G4ExceptionDescription msg;
+    msg << "Cannot read the cut ladder \"" << cuts
+        << "\", expected at least two values and a unit.";
+    G4Exception("B1CutTuner::SetCuts()", "MyCode0016", JustWarning, msg);
+    return;
+  }
+  std::sort(values.begin(), values.end());
+  fCuts = values;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B1CutTuner::ApplyCut(G4double cut) const
+{
+  // the command only warns about an unknown region, every rung would then
+  // run with the same cuts
+  std::istringstream regions(fRegions);
+  G4String region;
+  G4int nofRegions = 0;
+  while (regions >> region) {
+    G4ExceptionDescription msg;
+    if (!G4RegionStore::GetInstance()->GetRegion(region, false)) {
+      msg << "No region " << region << " in the geometry";
+    }
+    else {
+      std::ostringstream command;
+      command << "/run/setCutForRegion " << region << " " << cut/mm << " mm";
+      if (G4UImanager::GetUIpointer()->ApplyCommand(command.str()) != 0) {
+        msg << "Command \"" << command.str() << "\" failed";
+      }
+    }
+    if (!msg.str().empty()) {
+      msg << ", cut tuning stopped.";
+      G4Exception("B1CutTuner::ApplyCut()", "MyCode0016", JustWarning, msg);
+      return false;
+    }
+    nofRegions++;
+  }
+  if (nofRegions == 0) {
+    G4Exception("B1CutTuner::ApplyCut()", "MyCode0016", JustWarning,
+                "No region to tune, cut tuning stopped.");
+    return false;
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1CutTuner::Run()
+{
+  G4UImanager* uiManager = G4UImanager::GetUIpointer();
+  G4RunManager* runManager = G4RunManager::GetRunManager();
+
+  // the same histories for every cut, the finest first as reference
+  std::vector<Step> steps(fCuts.size());
+  for (size_t i = 0; i < fCuts.size(); i++) {
+    steps[i].fCut = fCuts[i];
+    steps[i].fSeconds = 0.;
+    steps[i].fEvents = 0.;
+    if (!ApplyCut(fCuts[i])) return;
+    if (!fSeeds.empty()) uiManager->ApplyCommand("/random/setSeeds " + fSeeds);
+    fCurrent = &steps[i];
+    runManager->BeamOn(fEvents);
+    fCurrent = 0;
+    if (steps[i].fEvents <= 0.) {
+      G4Exception("B1CutTuner::Run()", "MyCode0016", JustWarning,
+                  "Run aborted, cut tuning stopped.");
+      return;
+    }
+  }
+
+  const Step& reference = steps[0];
+  G4double referenceTime = reference.fSeconds/reference.fEvents;
+  size_t best = 0;
+
+  G4cout << "\n Production-cut tuning (" << fRegions << "), "
+         << fEvents << " events per cut, tolerance "
+         << 100.*fTolerance << " %\n"
+         << "        cut    time/event   speed-up   worst dose change"
+            "   detector   accepted" << G4endl;
+  for (size_t i = 0; i < steps.size(); i++) {
+    const Step& step = steps[i];
+    G4double time = step.fSeconds/step.fEvents;
+
+    // largest 95% upper bound of the relative dose change
+    G4double worstBound = 0., worstChange = 0., worstSigma = 0.;
+    G4int worstDetector = -1;
+    for (size_t d = 0; i > 0 && d < reference.fSum.size()
+                       && d < step.fSum.size(); d++) {
+      if (reference.fSum[d] <= 0.) continue;
+      G4double meanR = reference.fSum[d]/reference.fEvents;
+      G4double varR = (reference.fSum2[d]/reference.fEvents - meanR*meanR)
+                      /reference.fEvents;
+      G4double mean = step.fSum[d]/step.fEvents;
+      G4double var = (step.fSum2[d]/step.fEvents - mean*mean)/step.fEvents;
+      G4double change = (mean - meanR)/meanR;
+      G4double sigma = std::sqrt(std::max(varR, 0.) + std::max(var, 0.))/meanR;
+      G4double bound = std::fabs(change) + 2.*sigma;
+      if (bound > worstBound) {
+        worstBound = bound;
+        worstChange = change;
+        worstSigma = sigma;
+        worstDetector = (G4int)d;
+      }
+    }
+    G4bool accepted = (worstBound <= fTolerance);
+    if (accepted && time < steps[best].fSeconds/steps[best].fEvents) best = i;
+
+    G4cout << std::setw(8) << step.fCut/mm << " mm"
+           << std::setw(11) << time*1000. << " ms"
+           << std::setw(11) << (time > 0. ? referenceTime/time : 0.)
+           << std::setw(10) << 100.*worstChange << " +- "
+           << std::setw(6) << 100.*worstSigma << " %"
+           << std::setw(11) << worstDetector
+           << std::setw(11) << (i == 0 ? "reference" : accepted ? "yes" : "no")
+           << G4endl;
+  }
+
+  G4double cut = steps[best].fCut;
+  G4cout << " Recommended cut: " << cut/mm << " mm, "
+         << referenceTime*steps[best].fEvents/steps[best].fSeconds
+         << " times faster than " << reference.fCut/mm << " mm" << G4endl;
+  if (best == 0 && steps.size() > 1) {
+    G4cout << " No coarser cut accepted; if the statistical errors alone "
+              "exceed the tolerance, raise /B1/cutTuner/events." << G4endl;
+  }
+  ApplyCut(cut);
+
+  if (!fMacroName.empty()) {
+    std::ofstream macro(fMacroName.c_str());
+    macro << "# Production cuts tuned by /B1/cutTuner/run: within "
+          << 100.*fTolerance << " % of the doses at " << reference.fCut/mm
+          << " mm\n";
+    std::istringstream regions(fRegions);
+    G4String region;
+    while (regions >> region) {
+      macro << "/run/setCutForRegion " << region << " " << cut/mm << " mm\n";
+    }
+    if (macro) G4cout << " Cuts written to " << fMacroName << G4endl;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1CutTuner::BeginOfRun()
+{
+  if (fCurrent) fStart = std::chrono::steady_clock::now();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1CutTuner::EndOfRun(const B1Run* run)
+{
+  if (!fCurrent) return;
+  fCurrent->fSeconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - fStart).count();
+  fCurrent->fEvents = run->GetNumberOfEvent();
+  G4int nofDetectors = run->GetNumberOfDetectors();
+  fCurrent->fSum.resize(nofDetectors);
+  fCurrent->fSum2.resize(nofDetectors);
+  for (G4int d = 0; d < nofDetectors; d++) {
+    fCurrent->fSum[d]  = run->GetDetectorEdep(d);
+    fCurrent->fSum2[d] = run->GetDetectorEdep2(d);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1CutTuner::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/cutTuner/",
+                                      "Production-cut tuning");
+
+  // the tuner drives the runs from the master
+  G4GenericMessenger::Command& regionsCmd
+    = fMessenger->DeclareProperty("regions", fRegions,
+        "Regions whose cuts are tuned (DefaultRegionForTheWorld for all).");
+  regionsCmd.SetParameterName("regions", false);
+  regionsCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& cutsCmd
+    = fMessenger->DeclareMethod("cuts", &B1CutTuner::SetCuts,
+        "Ladder of cuts followed by their unit, e.g. 0.01 0.1 1 mm.");
+  cutsCmd.SetParameterName("cuts", false);
+  cutsCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& eventsCmd
+    = fMessenger->DeclareProperty("events", fEvents,
+        "Events of every run of the ladder.");
+  eventsCmd.SetParameterName("events", false);
+  eventsCmd.SetRange("events>0");
+  eventsCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& seedsCmd
+    = fMessenger->DeclareProperty("seeds", fSeeds,
+        "Seeds set before every run (empty string to keep the sequence).");
+  seedsCmd.SetParameterName("seeds", true);
+  seedsCmd.SetDefaultValue("");
+  seedsCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& toleranceCmd
+    = fMessenger->DeclareProperty("tolerance", fTolerance,
+        "Largest relative dose change accepted, at 95% confidence.");
+  toleranceCmd.SetParameterName("tolerance", false);
+  toleranceCmd.SetRange("tolerance>0.");
+  toleranceCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& macroCmd
+    = fMessenger->DeclareProperty("macro", fMacroName,
+        "Macro the recommended cuts are written to (empty string for none).");
+  macroCmd.SetParameterName("fileName", true);
+  macroCmd.SetDefaultValue("");
+  macroCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& runCmd
+    = fMessenger->DeclareMethod("run", &B1CutTuner::Run,
+        "Run the ladder and apply the recommended cuts.");
+  runCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -29,8 +29,12 @@
 /// \brief Implementation of the B1DetectorConstruction class
 
 #include "B1DetectorConstruction.hh"
+#include "B1MemoryUsage.hh"
+#include "B1FastShapes.hh"
 
 #include "G4RunManager.hh"
+#include "G4UImanager.hh"
+#include "G4GenericMessenger.hh"
 #include "G4NistManager.hh"
 #include "G4Box.hh"
 #include "G4Cons.hh"
@@ -40,31 +44,146 @@
 #include "G4Trd.hh"
 #include "G4LogicalVolume.hh"
 #include "G4PVPlacement.hh"
+#include "G4GeometryManager.hh"
+#include "G4PhysicalVolumeStore.hh"
+#include "G4LogicalVolumeStore.hh"
+#include "G4SolidStore.hh"
+#include "G4RegionStore.hh"
+#include "G4Region.hh"
+#include "G4AutoDelete.hh"
 #include "G4SystemOfUnits.hh"
 
+#ifdef B1_USE_GDML
+#include "G4GDMLParser.hh"
+#endif
+
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
 
 #define M_Pi 3.14159265358979323846
 
+namespace
+{
+  // growth of the resident size over a soak test that counts as a leak
+  const G4double soakTolerance = 1024.*1024.;
+
+  struct TaggedVolume
+  {
+    G4LogicalVolume* fVolume;
+    G4int            fIndex;   // from the auxiliary tag, -1 if none
+  };
+
+  // by tag index, then by name with the numbers compared as numbers
+  G4bool operator<(const TaggedVolume& a, const TaggedVolume& b)
+  {
+    if (a.fIndex >= 0 || b.fIndex >= 0) {
+      if (a.fIndex < 0) return false;
+      if (b.fIndex < 0) return true;
+      return a.fIndex < b.fIndex;
+    }
+    const char* p = a.fVolume->GetName().c_str();
+    const char* q = b.fVolume->GetName().c_str();
+    while (*p && *q) {
+      if (std::isdigit(*p) && std::isdigit(*q)) {
+        char* pEnd;
+        char* qEnd;
+        long m = std::strtol(p, &pEnd, 10);
+        long n = std::strtol(q, &qEnd, 10);
+        if (m != n) return m < n;
+        p = pEnd;
+        q = qEnd;
+      }
+      else {
+        if (*p != *q) return *p < *q;
+        p++;
+        q++;
+      }
+    }
+    return *q != 0;
+  }
+}
+
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 B1DetectorConstruction::B1DetectorConstruction()
 : G4VUserDetectorConstruction(),
-  fScoringVolumeArray(0),
-  fSolidVolumeArray(0)
-{ }
+  fMessenger(0),
+  fDetectorRadius(2.5*cm),
+  fShapeThickness(1*mm),
+  fWorld(0),
+  fGeometryId(0),
+  fVerboseLevel(0)
+{
+  DefineCommands();
+}
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 B1DetectorConstruction::~B1DetectorConstruction()
-{ }
+{
+  delete fMessenger;
+}
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 G4VPhysicalVolume* B1DetectorConstruction::Construct()
 {  
+  // Clean old geometry, if any; the regions keep their cuts
+  //
+  SetRegion("Shapes", fSolidVolumes, false);
+  SetRegion("Detectors", fScoringVolumes, false);
+  G4GeometryManager::GetInstance()->OpenGeometry();
+  G4PhysicalVolumeStore::GetInstance()->Clean();
+  G4LogicalVolumeStore::GetInstance()->Clean();
+  G4SolidStore::GetInstance()->Clean();
+  fScoringVolumes.clear();
+  fSolidVolumes.clear();
+
+  G4VPhysicalVolume* world = 0;
+  if (!fGdmlFile.empty()) world = ConstructFromGdml();
+  if (!world) world = ConstructBuiltIn();
+
+  ApplyMaterial(fSolidVolumes, fShapeMaterial);
+  ApplyMaterial(fScoringVolumes, fDetectorMaterial);
+
+  SetRegion("Shapes", fSolidVolumes, true);
+  SetRegion("Detectors", fScoringVolumes, true);
+
+  fWorld = world;
+  fGeometryId++;
+
+  if (fVerboseLevel > 0) {
+    G4cout << "Geometry construction " << fGeometryId << ", resident memory "
+           << B1MemoryUsage::GetResidentSize()/(1024.*1024.) << " MB"
+           << G4endl;
+  }
+
+  return world;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1DetectorConstruction::ConstructSDandField()
+{
+  // the region outlives geometry rebuilds, so one model per thread
+  if (!B1FastShapes::IsModelBuilt()) return;
+  G4Region* shapes = G4RegionStore::GetInstance()->GetRegion("Shapes", false);
+  if (shapes && !shapes->GetFastSimulationManager()) {
+    G4AutoDelete::Register(new B1ShapeFastModel(shapes));
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4VPhysicalVolume* B1DetectorConstruction::ConstructBuiltIn()
+{
   // Get nist material manager
   G4NistManager* nist = G4NistManager::Instance();
   
@@ -159,8 +278,8 @@ G4VPhysicalVolume* B1DetectorConstruction::Construct()
 
 
 
-  G4ThreeVector* shapesArrayPositions = new G4ThreeVector[shapesArraySize * shapesArraySize];
-  G4ThreeVector* detectorsArrayPositions = new G4ThreeVector[shapesArraySize * shapesArraySize];
+  std::vector<G4ThreeVector> shapesArrayPositions(shapesArraySize * shapesArraySize);
+  std::vector<G4ThreeVector> detectorsArrayPositions(shapesArraySize * shapesArraySize);
 
   const G4double min_size_x = -0.4 * env_sizeXY;
   const G4double min_size_y = -0.4 * env_sizeXY;
@@ -188,11 +307,11 @@ G4VPhysicalVolume* B1DetectorConstruction::Construct()
   }
 
   // Creating solids for detection
-  G4Box** solidShapesArray = new G4Box*[shapesArraySize * shapesArraySize];
+  std::vector<G4Box*> solidShapesArray(shapesArraySize * shapesArraySize);
 
   // Creating detector solids
   G4double detectorLenght_dz = 1*mm;
-  G4Tubs** solidDetectorsArray = new G4Tubs*[shapesArraySize * shapesArraySize];
+  std::vector<G4Tubs*> solidDetectorsArray(shapesArraySize * shapesArraySize);
 
   for(int i = 0; i < shapesArraySize; i++)
     {
@@ -201,7 +320,7 @@ G4VPhysicalVolume* B1DetectorConstruction::Construct()
   		  std::stringstream boxNumberStream;
   		  boxNumberStream << "Box_" << i << "_" << j;
 
-  		  shapeArrayElement_dz = 1*mm + (i * shapesArraySize + j)*mm;
+  		  shapeArrayElement_dz = fShapeThickness + (i * shapesArraySize + j)*fShapeThickness;
 
   		  solidShapesArray[i * shapesArraySize + j] = new G4Box(boxNumberStream.str(),
   				  0.5*shapeArrayElement_dx, 0.5*shapeArrayElement_dy, 0.5*shapeArrayElement_dz);
@@ -210,16 +329,16 @@ G4VPhysicalVolume* B1DetectorConstruction::Construct()
   		  tubsNumberStream << "Tube_" << i << "_" << j;
 
   		  solidDetectorsArray[i * shapesArraySize + j] = new G4Tubs(tubsNumberStream.str(),
-  				  0, 2.5*cm,
+  				  0, fDetectorRadius,
   				  0.5*detectorLenght_dz,
   				  0, 2*M_Pi);
   	  }
     }
 
   // Creating logical shapes volumes
-  G4LogicalVolume** logicalShapesArray = new G4LogicalVolume*[shapesArraySize * shapesArraySize];
+  std::vector<G4LogicalVolume*> logicalShapesArray(shapesArraySize * shapesArraySize);
   // Creating logical detectors volumes
-  G4LogicalVolume** logicalDetectorsArray = new G4LogicalVolume*[shapesArraySize * shapesArraySize];
+  std::vector<G4LogicalVolume*> logicalDetectorsArray(shapesArraySize * shapesArraySize);
 
   for(int i = 0; i < shapesArraySize; i++)
   {
@@ -272,8 +391,8 @@ G4VPhysicalVolume* B1DetectorConstruction::Construct()
 	  }
   }
 
-  fScoringVolumeArray = logicalDetectorsArray;
-  fSolidVolumeArray = logicalShapesArray;
+  fScoringVolumes = logicalDetectorsArray;
+  fSolidVolumes = logicalShapesArray;
 
   //
   //always return the physical World
@@ -281,4 +400,308 @@ G4VPhysicalVolume* B1DetectorConstruction::Construct()
   return physWorld;
 }
 
-//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
\ No newline at end of file
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4VPhysicalVolume* B1DetectorConstruction::ConstructFromGdml()
+{
+#ifdef B1_USE_GDML
+  G4GDMLParser parser;
+  parser.Read(fGdmlFile, false);
+  G4VPhysicalVolume* world = parser.GetWorldVolume();
+  if (!world) {
+    G4ExceptionDescription msg;
+    msg << "No world volume in " << fGdmlFile
+        << ", the built-in geometry is used.";
+    G4Exception("B1DetectorConstruction::ConstructFromGdml()",
+                "MyCode0015", JustWarning, msg);
+    return 0;
+  }
+
+  // detectors and shapes, by auxiliary tag or by name
+  std::vector<TaggedVolume> detectors, shapes;
+  G4LogicalVolumeStore* volumeStore = G4LogicalVolumeStore::GetInstance();
+  for (size_t i = 0; i < volumeStore->size(); i++) {
+    G4LogicalVolume* volume = (*volumeStore)[i];
+    TaggedVolume tagged = { volume, -1 };
+    G4bool isDetector = (volume->GetName().compare(0, 5, "Tube_") == 0);
+    G4bool isShape = (volume->GetName().compare(0, 4, "Box_") == 0);
+    G4GDMLAuxListType auxiliaries
+      = parser.GetVolumeAuxiliaryInformation(volume);
+    for (size_t a = 0; a < auxiliaries.size(); a++) {
+      if (auxiliaries[a].type != "ScoringVolume"
+          && auxiliaries[a].type != "SolidVolume") continue;
+      isDetector = (auxiliaries[a].type == "ScoringVolume");
+      isShape = !isDetector;
+      if (!auxiliaries[a].value.empty()) {
+        tagged.fIndex = std::atoi(auxiliaries[a].value.c_str());
+      }
+    }
+    if (isDetector) detectors.push_back(tagged);
+    else if (isShape) shapes.push_back(tagged);
+  }
+  std::stable_sort(detectors.begin(), detectors.end());
+  std::stable_sort(shapes.begin(), shapes.end());
+  for (size_t i = 0; i < detectors.size(); i++) {
+    fScoringVolumes.push_back(detectors[i].fVolume);
+  }
+  for (size_t i = 0; i < shapes.size(); i++) {
+    fSolidVolumes.push_back(shapes[i].fVolume);
+  }
+
+  G4cout << "Geometry read from " << fGdmlFile << ": "
+         << fScoringVolumes.size() << " detectors, "
+         << fSolidVolumes.size() << " shapes" << G4endl;
+  if (fScoringVolumes.empty()) {
+    G4ExceptionDescription msg;
+    msg << "No detector in " << fGdmlFile << ", tag the detector volumes "
+        << "with the auxiliary type ScoringVolume or name them Tube_*.";
+    G4Exception("B1DetectorConstruction::ConstructFromGdml()",
+                "MyCode0015", JustWarning, msg);
+  }
+  return world;
+#else
+  G4Exception("B1DetectorConstruction::ConstructFromGdml()",
+              "MyCode0015", JustWarning,
+              "Built without GDML support, the built-in geometry is used.");
+  return 0;
+#endif
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1DetectorConstruction::SetRegion(const G4String& name,
+                        const std::vector<G4LogicalVolume*>& volumes,
+                        G4bool add)
+{
+  G4Region* region = G4RegionStore::GetInstance()->GetRegion(name, false);
+  if (!region) {
+    if (!add) return;
+    region = new G4Region(name);
+  }
+  for (size_t i = 0; i < volumes.size(); i++) {
+    if (add) region->AddRootLogicalVolume(volumes[i]);
+    else region->RemoveRootLogicalVolume(volumes[i]);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1DetectorConstruction::SetDetectorRadius(G4double radius)
+{
+  fDetectorRadius = radius;
+  G4RunManager::GetRunManager()->ReinitializeGeometry();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1DetectorConstruction::SetShapeThickness(G4double thickness)
+{
+  fShapeThickness = thickness;
+  G4RunManager::GetRunManager()->ReinitializeGeometry();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1DetectorConstruction::SetShapeMaterial(G4String name)
+{
+  if (SetMaterial(fShapeMaterial, name)) {
+    G4RunManager::GetRunManager()->ReinitializeGeometry();
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1DetectorConstruction::SetDetectorMaterial(G4String name)
+{
+  if (SetMaterial(fDetectorMaterial, name)) {
+    G4RunManager::GetRunManager()->ReinitializeGeometry();
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B1DetectorConstruction::SetMaterial(G4String& member,
+                                           const G4String& name)
+{
+  // the material is per-thread data of the logical volumes, so it is
+  // changed by rebuilding the geometry rather than in place
+  G4String material = (name == "none") ? G4String() : name;
+  if (!material.empty() && !FindMaterial(material)) {
+    G4ExceptionDescription msg;
+    msg << "Unknown material " << name << ", the material is not changed.";
+    G4Exception("B1DetectorConstruction::SetMaterial()",
+                "MyCode0023", JustWarning, msg);
+    return false;
+  }
+  if (material == member) return false;
+  member = material;
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4Material* B1DetectorConstruction::FindMaterial(const G4String& specification)
+{
+  std::istringstream input(specification);
+  G4String name;
+  G4double factor = 1.;
+  if (!(input >> name)) return 0;
+  input >> factor;
+  G4NistManager* nist = G4NistManager::Instance();
+  G4Material* material = nist->FindOrBuildMaterial(name);
+  if (!material || factor == 1.) return material;
+  if (!(factor > 0.)) return 0;
+
+  // built once, the scaled material keeps the composition
+  std::ostringstream scaledName;
+  scaledName << name << "_x" << factor;
+  G4Material* scaled = G4Material::GetMaterial(scaledName.str(), false);
+  if (scaled) return scaled;
+  return nist->BuildMaterialWithNewDensity(scaledName.str(), name,
+                                           material->GetDensity()*factor);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1DetectorConstruction::ApplyMaterial(
+  const std::vector<G4LogicalVolume*>& volumes, const G4String& name)
+{
+  if (name.empty()) return;
+  G4Material* material = FindMaterial(name);
+  for (size_t i = 0; i < volumes.size(); i++) volumes[i]->SetMaterial(material);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1DetectorConstruction::SetGdmlFile(G4String fileName)
+{
+  fGdmlFile = (fileName == "none") ? G4String() : fileName;
+  G4RunManager::GetRunManager()->ReinitializeGeometry();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1DetectorConstruction::ExportGdml(G4String fileName)
+{
+#ifdef B1_USE_GDML
+  if (!fWorld) {
+    G4Exception("B1DetectorConstruction::ExportGdml()", "MyCode0015",
+                JustWarning, "No geometry built yet, run /run/initialize.");
+    return;
+  }
+  // the writer refuses to overwrite a file
+  std::remove(fileName.c_str());
+  G4GDMLParser parser;
+  parser.Write(fileName, fWorld);
+  G4cout << "Geometry written to " << fileName << G4endl;
+#else
+  (void)fileName;
+  G4Exception("B1DetectorConstruction::ExportGdml()", "MyCode0015",
+              JustWarning, "Built without GDML support.");
+#endif
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1DetectorConstruction::SoakTest(G4int iterations)
+{
+  // the first rebuilds fill the allocator pools and the navigation
+  // caches, the resident size is compared from there on
+  G4UImanager* uiManager = G4UImanager::GetUIpointer();
+  G4int warmUp = std::max(1, iterations/10);
+  G4double reference = 0.;
+  for (G4int i = 0; i < iterations; i++) {
+    uiManager->ApplyCommand("/run/reinitializeGeometry");
+    uiManager->ApplyCommand("/run/beamOn 0");
+    if (i + 1 == warmUp) reference = B1MemoryUsage::GetResidentSize();
+  }
+  G4double resident = B1MemoryUsage::GetResidentSize();
+
+  if (reference <= 0. || resident <= 0.) {
+    G4Exception("B1DetectorConstruction::SoakTest()", "MyCode0027",
+                JustWarning, "Resident size not available, nothing checked.");
+    return;
+  }
+  G4cout << "Soak test: " << iterations << " rebuilds, resident memory "
+         << reference/(1024.*1024.) << " MB after " << warmUp << ", "
+         << resident/(1024.*1024.) << " MB at the end" << G4endl;
+  if (resident - reference > soakTolerance) {
+    G4ExceptionDescription msg;
+    msg << "The resident size grew by " << (resident - reference)/1024.
+        << " kB over " << iterations - warmUp << " geometry rebuilds, "
+        << "the construction leaks.";
+    G4Exception("B1DetectorConstruction::SoakTest()", "MyCode0027",
+                FatalException, msg);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1DetectorConstruction::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/det/",
+                                      "Detector construction control");
+
+  // the geometry is built by the master
+  G4GenericMessenger::Command& radiusCmd
+    = fMessenger->DeclareMethodWithUnit("detectorRadius", "cm",
+        &B1DetectorConstruction::SetDetectorRadius,
+        "Radius of the detectors, the geometry is rebuilt at the next run.");
+  radiusCmd.SetParameterName("radius", false);
+  radiusCmd.SetRange("radius>0.");
+  radiusCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& thicknessCmd
+    = fMessenger->DeclareMethodWithUnit("shapeThickness", "mm",
+        &B1DetectorConstruction::SetShapeThickness,
+        "Thickness of the first shape, each following shape is thicker by "
+        "the same amount; the geometry is rebuilt at the next run.");
+  thicknessCmd.SetParameterName("thickness", false);
+  thicknessCmd.SetRange("thickness>0.");
+  thicknessCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& shapeMaterialCmd
+    = fMessenger->DeclareMethod("shapeMaterial",
+        &B1DetectorConstruction::SetShapeMaterial,
+        "NIST material of the shapes and optional density factor (none "
+        "for the built-in one), the geometry is rebuilt at the next run.");
+  shapeMaterialCmd.SetParameterName("material", false);
+  shapeMaterialCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& detectorMaterialCmd
+    = fMessenger->DeclareMethod("detectorMaterial",
+        &B1DetectorConstruction::SetDetectorMaterial,
+        "NIST material of the detectors and optional density factor (none "
+        "for the built-in one), the geometry is rebuilt at the next run.");
+  detectorMaterialCmd.SetParameterName("material", false);
+  detectorMaterialCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& gdmlCmd
+    = fMessenger->DeclareMethod("gdml", &B1DetectorConstruction::SetGdmlFile,
+        "Read the geometry from a GDML file at the next run "
+        "(none for the built-in geometry).");
+  gdmlCmd.SetParameterName("fileName", false);
+  gdmlCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& exportCmd
+    = fMessenger->DeclareMethod("exportGdml",
+        &B1DetectorConstruction::ExportGdml,
+        "Write the current geometry to a GDML file.");
+  exportCmd.SetParameterName("fileName", false);
+  exportCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& verboseCmd
+    = fMessenger->DeclareProperty("verbose", fVerboseLevel,
+        "Print the resident memory after every construction (1).");
+  verboseCmd.SetParameterName("level", false);
+  verboseCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& soakCmd
+    = fMessenger->DeclareMethod("soakTest", &B1DetectorConstruction::SoakTest,
+        "Rebuild the geometry repeatedly, abort if the memory keeps growing.");
+  soakCmd.SetParameterName("iterations", false);
+  soakCmd.SetRange("iterations>=10");
+  soakCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,240 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1EnergyResponse.cc
+/// \brief Implementation of the B1EnergyResponse class
+
+#include "B1EnergyResponse.hh"
+#include "B1DetectorConstruction.hh"
+#include "B1Run.hh"
+
+#include "G4RunManager.hh"
+#include "G4LogicalVolume.hh"
+#include "G4GenericMessenger.hh"
+#include "G4UnitsTable.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <cmath>
+#include <iomanip>
+
+namespace
+{
+  // variance of the mean from the sums over n events
+  G4double VarianceOfMean(G4double sum, G4double sum2, G4double n)
+  {
+    if (n < 2.) return 0.;
+    G4double variance = (sum2 - sum*sum/n) / (n - 1.);
+    return (variance > 0.) ? variance / n : 0.;
+  }
+}
+
+B1EnergyResponse* B1EnergyResponse::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1EnergyResponse* B1EnergyResponse::Instance()
+{
+  if (!fgInstance) fgInstance = new B1EnergyResponse;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1EnergyResponse::B1EnergyResponse()
+: fMessenger(0),
+  fActive(false),
+  fEMin(10.*keV), fEMax(10.*MeV),
+  fNofBins(40),
+  fSampling("stratified"),
+  fFileName("response.txt")
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1EnergyResponse::~B1EnergyResponse()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B1EnergyResponse::GetBinEdge(G4int i) const
+{
+  return fEMin*std::pow(fEMax/fEMin, (G4double)i/fNofBins);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B1EnergyResponse::SampleEnergy(G4int eventID, G4int& bin) const
+{
+  // position on the log scale, in units of bins
+  G4double t = (fSampling == "stratified")
+    ? eventID % fNofBins + G4UniformRand()
+    : fNofBins*G4UniformRand();
+  bin = std::min((G4int)t, fNofBins - 1);
+  return fEMin*std::pow(fEMax/fEMin, t/fNofBins);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1EnergyResponse::Run(G4int nofEvents)
+{
+  if (!(fEMin > 0. && fEMax > fEMin)) {
+    G4ExceptionDescription msg;
+    msg << "Energy range " << G4BestUnit(fEMin, "Energy") << " - "
+        << G4BestUnit(fEMax, "Energy") << " is empty, no run.";
+    G4Exception("B1EnergyResponse::Run()", "MyCode0020", JustWarning, msg);
+    return;
+  }
+
+  G4cout << "Energy response: " << fNofBins << " bins from "
+         << G4BestUnit(fEMin, "Energy") << " to "
+         << G4BestUnit(fEMax, "Energy") << ", " << fSampling << ", "
+         << nofEvents << " primaries" << G4endl;
+
+  fActive = true;
+  G4RunManager::GetRunManager()->BeamOn(nofEvents);
+  fActive = false;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1EnergyResponse::EndOfRun(const B1Run* run)
+{
+  if (!fActive || !run->HasEnergyBins()) return;
+
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  const std::vector<G4LogicalVolume*>& volumes
+    = detectorConstruction->GetScoringVolumes();
+  G4int nofDetectors = run->GetNumberOfDetectors();
+
+  std::ofstream output(fFileName.c_str());
+  if (!output) {
+    G4ExceptionDescription msg;
+    msg << "Cannot write the energy response to " << fFileName << ".";
+    G4Exception("B1EnergyResponse::EndOfRun()", "MyCode0020", JustWarning, msg);
+  }
+  output << "# energy response: per bin and detector the mean deposit (MeV)"
+            " and dose (Gy) per primary, with their standard errors\n"
+         << "# bin  eLow (MeV)  eHigh (MeV)  primaries";
+  for (G4int d = 0; d < nofDetectors; d++) {
+    output << "  edep_" << d << "  error_" << d
+           << "  dose_" << d << "  error_" << d;
+  }
+  output << "\n";
+
+  G4cout << "\n Energy response (" << fFileName << ")\n"
+         << "    bin          energy range            primaries"
+            "   largest relative error" << G4endl;
+  for (G4int b = 0; b < run->GetNumberOfEnergyBins(); b++) {
+    G4double events = run->GetEnergyBinEvents(b);
+    output << b << "\t" << GetBinEdge(b)/MeV << "\t" << GetBinEdge(b + 1)/MeV
+           << "\t" << events;
+    G4double largestError = 0.;
+    for (G4int d = 0; d < nofDetectors; d++) {
+      G4double mean = 0., error = 0.;
+      if (events > 0.) {
+        G4double sum = run->GetEnergyBinEdep(b, d);
+        mean = sum/events;
+        error = std::sqrt(VarianceOfMean(sum, run->GetEnergyBinEdep2(b, d),
+                                         events));
+      }
+      G4double mass = volumes[d]->GetMass();
+      output << "\t" << mean/MeV << "\t" << error/MeV
+             << "\t" << mean/mass/gray << "\t" << error/mass/gray;
+      G4double relative = (mean > 0.) ? error/mean : 1.;
+      if (relative > largestError) largestError = relative;
+    }
+    output << "\n";
+    G4cout << std::setw(7) << b << "  "
+           << std::setw(10) << G4BestUnit(GetBinEdge(b), "Energy") << " - "
+           << std::setw(10) << G4BestUnit(GetBinEdge(b + 1), "Energy") << "  "
+           << std::setw(10) << events << "  "
+           << std::setw(10) << largestError << G4endl;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1EnergyResponse::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/response/",
+                                      "Detector response versus energy");
+
+  G4GenericMessenger::Command& eMinCmd
+    = fMessenger->DeclarePropertyWithUnit("eMin", "keV", fEMin,
+        "Lower edge of the energy range.");
+  eMinCmd.SetParameterName("eMin", false);
+  eMinCmd.SetRange("eMin>0.");
+  eMinCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& eMaxCmd
+    = fMessenger->DeclarePropertyWithUnit("eMax", "MeV", fEMax,
+        "Upper edge of the energy range.");
+  eMaxCmd.SetParameterName("eMax", false);
+  eMaxCmd.SetRange("eMax>0.");
+  eMaxCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& binsCmd
+    = fMessenger->DeclareProperty("bins", fNofBins,
+        "Number of logarithmic energy bins.");
+  binsCmd.SetParameterName("bins", false);
+  binsCmd.SetRange("bins>0");
+  binsCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& samplingCmd
+    = fMessenger->DeclareProperty("sampling", fSampling,
+        "stratified: the same number of primaries in every bin; "
+        "logUniform: log-uniform over the whole range.");
+  samplingCmd.SetParameterName("sampling", false);
+  samplingCmd.SetCandidates("stratified logUniform");
+  samplingCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareProperty("file", fFileName,
+        "Output file of the response matrix.");
+  fileCmd.SetParameterName("fileName", false);
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& runCmd
+    = fMessenger->DeclareMethod("run", &B1EnergyResponse::Run,
+        "Run the given number of primaries over the energy range and "
+        "tally the response per energy bin.");
+  runCmd.SetParameterName("nofEvents", false);
+  runCmd.SetRange("nofEvents>0");
+  runCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
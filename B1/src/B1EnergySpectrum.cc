@@ -0,0 +1,184 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1EnergySpectrum.cc
+/// \brief Implementation of the B1EnergySpectrum class
+
+#include "B1EnergySpectrum.hh"
+
+#include "G4AutoLock.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+
+#include <fstream>
+#include <sstream>
+#include <map>
+
+namespace
+{
+  G4Mutex spectrumMutex = G4MUTEX_INITIALIZER;
+
+  // spectra live until the end of the job
+  struct SpectrumRegistry
+  {
+    std::map<G4String, B1EnergySpectrum*> fSpectra;
+    ~SpectrumRegistry()
+    {
+      std::map<G4String, B1EnergySpectrum*>::iterator it;
+      for (it = fSpectra.begin(); it != fSpectra.end(); ++it) delete it->second;
+    }
+  };
+  SpectrumRegistry spectrumRegistry;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+const B1EnergySpectrum*
+B1EnergySpectrum::GetShared(const G4String& fileName, Type type)
+{
+  G4AutoLock lock(&spectrumMutex);
+
+  G4String key = fileName + (type == kDiscrete ? "#discrete" : "#histogram");
+  std::map<G4String, B1EnergySpectrum*>::iterator it
+    = spectrumRegistry.fSpectra.find(key);
+  if (it != spectrumRegistry.fSpectra.end()) return it->second;
+
+  B1EnergySpectrum* spectrum = new B1EnergySpectrum(fileName, type);
+  if (!spectrum->IsValid()) {
+    delete spectrum;
+    return 0;
+  }
+  spectrumRegistry.fSpectra[key] = spectrum;
+  return spectrum;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1EnergySpectrum::B1EnergySpectrum(const G4String& fileName, Type type)
+: fFileName(fileName),
+  fType(type),
+  fMeanEnergy(0.)
+{
+  std::ifstream input(fileName.c_str());
+  if (!input) {
+    G4ExceptionDescription msg;
+    msg << "Cannot open spectrum file " << fileName;
+    G4Exception("B1EnergySpectrum::B1EnergySpectrum()",
+                "MyCode0004", JustWarning, msg);
+    return;
+  }
+
+  std::vector<G4double> weights;
+  std::string line;
+  while (std::getline(input, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream columns(line);
+    G4double energy, weight;
+    if (!(columns >> energy >> weight)) continue;
+    if (!fEnergies.empty() && energy <= fEnergies.back()) {
+      G4ExceptionDescription msg;
+      msg << "Energies in " << fileName << " must be increasing, "
+          << "skipping " << energy << " MeV";
+      G4Exception("B1EnergySpectrum::B1EnergySpectrum()",
+                  "MyCode0004", JustWarning, msg);
+      continue;
+    }
+    fEnergies.push_back(energy*MeV);
+    weights.push_back(weight);
+  }
+
+  // the last histogram edge only closes the previous bin
+  if (fType == kHistogram) {
+    if (fEnergies.size() < 2) {
+      fEnergies.clear();
+      weights.clear();
+    }
+    else weights.pop_back();
+  }
+  if (weights.empty()) {
+    G4ExceptionDescription msg;
+    msg << "No usable entries in spectrum file " << fileName;
+    G4Exception("B1EnergySpectrum::B1EnergySpectrum()",
+                "MyCode0004", JustWarning, msg);
+    return;
+  }
+
+  fTable.Build(weights);
+
+  for (G4int i = 0; i < fTable.GetSize(); i++) {
+    G4double energy = (fType == kDiscrete)
+      ? fEnergies[i] : 0.5*(fEnergies[i] + fEnergies[i+1]);
+    fMeanEnergy += fTable.GetProbability(i) * energy;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1EnergySpectrum::~B1EnergySpectrum()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B1EnergySpectrum::Sample() const
+{
+  if (fType == kDiscrete) return fEnergies[fTable.Sample(G4UniformRand())];
+  return Sample(G4UniformRand(), G4UniformRand());
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B1EnergySpectrum::Sample(G4double u1, G4double u2) const
+{
+  G4int i = fTable.Sample(u1);
+  if (fType == kDiscrete) return fEnergies[i];
+  return fEnergies[i] + u2 * (fEnergies[i+1] - fEnergies[i]);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1EnergySpectrum::GetQuadrature(std::vector<G4double>& energies,
+                                     std::vector<G4double>& probabilities,
+                                     G4int pointsPerBin) const
+{
+  energies.clear();
+  probabilities.clear();
+  for (G4int i = 0; i < fTable.GetSize(); i++) {
+    G4double probability = fTable.GetProbability(i);
+    if (fType == kDiscrete) {
+      energies.push_back(fEnergies[i]);
+      probabilities.push_back(probability);
+      continue;
+    }
+    G4double width = (fEnergies[i+1] - fEnergies[i]) / pointsPerBin;
+    for (G4int k = 0; k < pointsPerBin; k++) {
+      energies.push_back(fEnergies[i] + (k + 0.5)*width);
+      probabilities.push_back(probability / pointsPerBin);
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -30,6 +30,15 @@
 
 #include "B1EventAction.hh"
 #include "B1Run.hh"
+#include "B1DetectorConstruction.hh"
+#include "B1EventInformation.hh"
+#include "B1EventStream.hh"
+#include "B1RunMetrics.hh"
+#include "B1RunSnapshots.hh"
+#include "B1FastShapes.hh"
+#include "B1AdjointScan.hh"
+#include "B1CorrelatedSampling.hh"
+#include "B1Perturbation.hh"
 
 #include "G4Event.hh"
 #include "G4RunManager.hh"
@@ -51,17 +60,118 @@ B1EventAction::~B1EventAction()
 void B1EventAction::BeginOfEventAction(const G4Event*)
 {    
   fEdep = 0.;
+
+  B1FastShapes* fastShapes = B1FastShapes::Instance();
+  if (fastShapes->IsCalibrating()) fastShapes->BeginOfEvent();
+
+  // sized again only if a rebuilt geometry changed the number of detectors
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  G4int nofDetectors = detectorConstruction->GetNumberOfScoringVolumes();
+  if ((G4int)fDetectorEdep.size() != nofDetectors) {
+    fDetectorEdep.assign(nofDetectors, 0.);
+    fHitDetectors.clear();
+    fHitDetectors.reserve(nofDetectors);
+    fDetectorKerma.assign(nofDetectors, 0.);
+    fKermaDetectors.clear();
+    fKermaDetectors.reserve(nofDetectors);
+  }
+  for (size_t i = 0; i < fHitDetectors.size(); i++) {
+    fDetectorEdep[fHitDetectors[i]] = 0.;
+  }
+  fHitDetectors.clear();
+  for (size_t i = 0; i < fKermaDetectors.size(); i++) {
+    fDetectorKerma[fKermaDetectors[i]] = 0.;
+  }
+  fKermaDetectors.clear();
+
+  B1Perturbation* perturbation = B1Perturbation::Instance();
+  if (perturbation->IsActive()) {
+    fPerturbationScores.assign(perturbation->GetNumberOfScores(), 0.);
+  }
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
-void B1EventAction::EndOfEventAction(const G4Event*)
+void B1EventAction::EndOfEventAction(const G4Event* event)
 {   
   // accumulate statistics in B1Run
   B1Run* run 
     = static_cast<B1Run*>(
         G4RunManager::GetRunManager()->GetNonConstCurrentRun());
   run->AddEdep(fEdep);
+
+  for (size_t i = 0; i < fHitDetectors.size(); i++) {
+    G4int detector = fHitDetectors[i];
+    run->AddDetectorEdep(detector, fDetectorEdep[detector]);
+  }
+  for (size_t i = 0; i < fKermaDetectors.size(); i++) {
+    G4int detector = fKermaDetectors[i];
+    run->AddDetectorKerma(detector, fDetectorKerma[detector]);
+  }
+
+  B1EventStream* eventStream = B1EventStream::Instance();
+  if (eventStream->IsActive()) {
+    eventStream->WriteEvent(event->GetEventID(), fHitDetectors, fDetectorEdep);
+  }
+
+  B1RunMetrics* metrics = B1RunMetrics::Instance();
+  if (metrics->IsActive()) metrics->EndOfEvent(run);
+
+  B1RunSnapshots* snapshots = B1RunSnapshots::Instance();
+  if (snapshots->IsActive()) snapshots->EndOfEvent(run);
+
+  B1FastShapes* fastShapes = B1FastShapes::Instance();
+  if (fastShapes->IsCalibrating()) fastShapes->EndOfEvent();
+
+  B1AdjointScan* adjointScan = B1AdjointScan::Instance();
+  if (adjointScan->IsActive()) adjointScan->EndOfEvent(fDetectorEdep);
+
+  B1Perturbation* perturbation = B1Perturbation::Instance();
+  if (perturbation->IsActive() && run->HasPerturbations()) {
+    perturbation->EndOfEvent(run, fPerturbationScores, fHitDetectors,
+                             fDetectorEdep);
+  }
+
+  B1CorrelatedSampling* correlated = B1CorrelatedSampling::Instance();
+  if (correlated->IsActive()) {
+    correlated->EndOfEvent(event->GetEventID(), fHitDetectors, fDetectorEdep);
+  }
+
+  // uncollided control variate, pencil beam of the response kernel,
+  // incident energy bin of the response run, component of a mixed-field
+  // source
+  const B1EventInformation* info
+    = static_cast<const B1EventInformation*>(event->GetUserInformation());
+  if (info && !info->GetUncollidedDeposits().empty()
+      && run->HasControlVariate()) {
+    run->AddControlVariate(fDetectorEdep, info->GetUncollidedDeposits());
+  }
+  if (info && info->GetBeamIndex() >= 0 && run->HasKernel()) {
+    G4int beam = info->GetBeamIndex();
+    run->AddKernelEvent(beam);
+    for (size_t i = 0; i < fHitDetectors.size(); i++) {
+      G4int detector = fHitDetectors[i];
+      run->AddKernelEdep(beam, detector, fDetectorEdep[detector]);
+    }
+  }
+  if (info && info->GetEnergyBin() >= 0 && run->HasEnergyBins()) {
+    G4int bin = info->GetEnergyBin();
+    run->AddEnergyBinEvent(bin);
+    for (size_t i = 0; i < fHitDetectors.size(); i++) {
+      G4int detector = fHitDetectors[i];
+      run->AddEnergyBinEdep(bin, detector, fDetectorEdep[detector]);
+    }
+  }
+  if (info && info->GetSourceComponent() >= 0 && run->HasSourceComponents()) {
+    G4int component = info->GetSourceComponent();
+    run->AddComponentEvent(component);
+    for (size_t i = 0; i < fHitDetectors.size(); i++) {
+      G4int detector = fHitDetectors[i];
+      run->AddComponentEdep(component, detector, fDetectorEdep[detector]);
+    }
+  }
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
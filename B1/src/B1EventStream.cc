@@ -0,0 +1,263 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1EventStream.cc
+/// \brief Implementation of the B1EventStream class
+
+#include "B1EventStream.hh"
+
+#include "G4RunManager.hh"
+#include "G4GenericMessenger.hh"
+#include "G4Threading.hh"
+#include "G4SystemOfUnits.hh"
+
+#ifdef G4MULTITHREADED
+#include "G4MTRunManager.hh"
+#endif
+
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define B1_EVENTSTREAM_MMAP 1
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  const char eventStreamMagic[8] = { 'B','1','E','V','S','0','0','1' };
+  const size_t pageSize = 4096;
+}
+
+B1EventStream* B1EventStream::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1EventStream* B1EventStream::Instance()
+{
+  if (!fgInstance) fgInstance = new B1EventStream;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1EventStream::B1EventStream()
+: fMessenger(0),
+  fCapacity(4000000),
+  fActive(false),
+  fFile(-1),
+  fBase(0),
+  fSize(0),
+  fHeader(0),
+  fRecords(0)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1EventStream::~B1EventStream()
+{
+  Close();
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1EventStream::SetFileName(G4String fileName)
+{
+  fActive = !(fileName == "none" || fileName.empty());
+  fFileName = fActive ? fileName : G4String();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1EventStream::BeginOfRun(G4int runID, G4int nofDetectors)
+{
+  Close();
+  if (!fActive) return;
+
+#ifdef B1_EVENTSTREAM_MMAP
+  G4int nofSegments = 1;
+#ifdef G4MULTITHREADED
+  G4MTRunManager* mtRunManager
+    = dynamic_cast<G4MTRunManager*>(G4RunManager::GetRunManager());
+  if (mtRunManager) nofSegments = mtRunManager->GetNumberOfThreads();
+#endif
+  if (nofSegments > (G4int)kB1EventStreamMaxSegments) {
+    nofSegments = kB1EventStreamMaxSegments;
+  }
+
+  size_t dataOffset
+    = ((sizeof(B1EventStreamHeader) + pageSize - 1)/pageSize)*pageSize;
+  fSize = dataOffset
+        + (size_t)nofSegments*fCapacity*sizeof(B1EventStreamRecord);
+
+  fFile = open(fFileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fFile < 0 || ftruncate(fFile, (off_t)fSize) != 0) {
+    G4ExceptionDescription msg;
+    msg << "Cannot create event stream " << fFileName << " of "
+        << fSize/(1024*1024) << " MB, stream disabled for this run.";
+    G4Exception("B1EventStream::BeginOfRun()", "MyCode0011", JustWarning, msg);
+    Close();
+    return;
+  }
+  void* base = mmap(0, fSize, PROT_READ | PROT_WRITE, MAP_SHARED, fFile, 0);
+  if (base == MAP_FAILED) {
+    G4ExceptionDescription msg;
+    msg << "Cannot map event stream " << fFileName
+        << ", stream disabled for this run.";
+    G4Exception("B1EventStream::BeginOfRun()", "MyCode0011", JustWarning, msg);
+    Close();
+    return;
+  }
+  fBase = static_cast<char*>(base);
+  fHeader = reinterpret_cast<B1EventStreamHeader*>(fBase);
+  fRecords = reinterpret_cast<B1EventStreamRecord*>(fBase + dataOffset);
+
+  // the file is new, so counts are already zero; the magic comes last
+  fHeader->fNofSegments = nofSegments;
+  fHeader->fNofDetectors = nofDetectors;
+  fHeader->fSegmentCapacity = fCapacity;
+  fHeader->fDataOffset = dataOffset;
+  fHeader->fRunID = runID;
+  fHeader->fComplete = 0;
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  std::memcpy(fHeader->fMagic, eventStreamMagic, sizeof(fHeader->fMagic));
+
+  fTimer.Start();
+#else
+  (void)runID;
+  (void)nofDetectors;
+  G4Exception("B1EventStream::BeginOfRun()", "MyCode0011", JustWarning,
+              "Memory-mapped event stream not supported on this platform.");
+#endif
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1EventStream::WriteEvent(G4int eventID,
+                               const std::vector<G4int>& detectors,
+                               const std::vector<G4double>& edep)
+{
+  if (!fHeader || detectors.empty()) return;
+
+  // the master runs the events in sequential mode
+  G4int segment = G4Threading::G4GetThreadId();
+  if (segment < 0) segment = 0;
+  if (segment >= (G4int)fHeader->fNofSegments) return;
+
+  // only this thread writes the counters of its segment
+  uint64_t count = fHeader->fCounts[segment];
+  if (count + detectors.size() > fHeader->fSegmentCapacity) {
+    fHeader->fDropped[segment] += detectors.size();
+    return;
+  }
+
+  B1EventStreamRecord* record
+    = fRecords + (size_t)segment*fHeader->fSegmentCapacity + count;
+  for (size_t i = 0; i < detectors.size(); i++, record++) {
+    record->fEventID  = eventID;
+    record->fDetector = detectors[i];
+    record->fEdep     = edep[detectors[i]]/MeV;
+  }
+  __atomic_store_n(&fHeader->fCounts[segment], count + detectors.size(),
+                   __ATOMIC_RELEASE);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1EventStream::EndOfRun()
+{
+  if (!fHeader) return;
+
+  fTimer.Stop();
+  uint64_t records = 0, dropped = 0;
+  for (uint32_t s = 0; s < fHeader->fNofSegments; s++) {
+    records += fHeader->fCounts[s];
+    dropped += fHeader->fDropped[s];
+  }
+  __atomic_store_n(&fHeader->fComplete, 1u, __ATOMIC_RELEASE);
+
+  G4double seconds = fTimer.GetRealElapsed();
+  G4cout << "Event stream: " << records << " records in "
+         << fHeader->fNofSegments << " segments written to " << fFileName;
+  if (seconds > 0.) G4cout << " (" << records/seconds << " records/s)";
+  G4cout << G4endl;
+  if (dropped > 0) {
+    G4ExceptionDescription msg;
+    msg << dropped << " records dropped, raise /B1/eventStream/capacity.";
+    G4Exception("B1EventStream::EndOfRun()", "MyCode0011", JustWarning, msg);
+  }
+  Close();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1EventStream::Close()
+{
+#ifdef B1_EVENTSTREAM_MMAP
+  if (fBase) {
+    msync(fBase, fSize, MS_SYNC);
+    munmap(fBase, fSize);
+  }
+  if (fFile >= 0) close(fFile);
+#endif
+  fFile = -1;
+  fBase = 0;
+  fSize = 0;
+  fHeader = 0;
+  fRecords = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1EventStream::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/eventStream/",
+                                      "Per-event deposition stream");
+
+  // the stream is shared by all threads, the commands act on the master
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareMethod("file", &B1EventStream::SetFileName,
+        "Write the deposits of every event into the given file "
+        "(none to disable).");
+  fileCmd.SetParameterName("fileName", false);
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& capacityCmd
+    = fMessenger->DeclareProperty("capacity", fCapacity,
+        "Records reserved per thread; further records are dropped.");
+  capacityCmd.SetParameterName("records", false);
+  capacityCmd.SetRange("records>0");
+  capacityCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
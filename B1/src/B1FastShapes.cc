@@ -0,0 +1,836 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1FastShapes.cc
+/// \brief Implementation of the B1FastShapes, B1ShapeFastModel and
+///        B1FastShapesPhysics classes
+
+#include "B1FastShapes.hh"
+#include "B1DetectorConstruction.hh"
+#include "B1Run.hh"
+
+#include "G4FastSimulationManagerProcess.hh"
+#include "G4FastTrack.hh"
+#include "G4FastStep.hh"
+#include "G4RunManager.hh"
+#include "G4RegionStore.hh"
+#include "G4Region.hh"
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4VProcess.hh"
+#include "G4EmProcessSubType.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VSolid.hh"
+#include "G4Material.hh"
+#include "G4DynamicParticle.hh"
+#include "G4ParticleTable.hh"
+#include "G4ProcessManager.hh"
+#include "G4Gamma.hh"
+#include "G4Electron.hh"
+#include "G4Positron.hh"
+#include "G4GenericMessenger.hh"
+#include "G4AutoLock.hh"
+#include "G4UnitsTable.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4PhysicalConstants.hh"
+#include "Randomize.hh"
+#include "geomdefs.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <iomanip>
+
+namespace
+{
+  G4Mutex fastShapesMutex = G4MUTEX_INITIALIZER;
+
+  const char tableMagic[8] = { 'B', '1', 'F', 'S', 'H', 'P', '0', '2' };
+
+  const G4double tableEMin = 1.*keV;
+  const G4int    tableDecades = 6;   // up to 1 GeV
+
+  G4bool IsElectromagnetic(const G4ParticleDefinition* particle)
+  {
+    return particle == G4Gamma::Gamma() || particle == G4Electron::Electron()
+           || particle == G4Positron::Positron();
+  }
+
+  // photon created in the shape with an energy of its own (annihilation,
+  // fluorescence, nuclear deexcitation), leaving it unscattered
+  G4bool IsLinePhoton(const G4Track* track, G4double exitEnergy)
+  {
+    const G4VProcess* creator = track->GetCreatorProcess();
+    return track->GetDefinition() == G4Gamma::Gamma() && creator
+           && creator->GetProcessSubType() != fBremsstrahlung
+           && exitEnergy == track->GetVertexKineticEnergy();
+  }
+}
+
+/// Calibration state of one thread: the shape entries of the current event
+/// and the histories recorded in this run.
+
+struct B1FastShapes::ThreadData
+{
+  struct Incident
+  {
+    Key                      fKey;
+    G4bool                   fValid;       // within the table binning
+    G4int                    fTrackID;     // of the entering track
+    G4double                 fEnergy;
+    G4ThreeVector            fDirection;
+    const G4VPhysicalVolume* fVolume;
+    std::vector<Exit>        fExits;
+  };
+
+  ThreadData() : fRegion(0), fReplayed(0.), fTransported(0.) {}
+
+  const G4Region*        fRegion;
+  std::map<G4int, G4int> fIncidentOf;   // track ID -> last incident
+  std::vector<Incident>  fIncidents;
+  Table                  fTable;
+  G4double               fReplayed;
+  G4double               fTransported;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B1FastShapes::Key::operator<(const Key& other) const
+{
+  if (fMaterial != other.fMaterial) return fMaterial < other.fMaterial;
+  if (fParticle != other.fParticle) return fParticle < other.fParticle;
+  if (fEnergyBin != other.fEnergyBin) return fEnergyBin < other.fEnergyBin;
+  return fChordBin < other.fChordBin;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1FastShapes* B1FastShapes::fgInstance = 0;
+
+B1FastShapes* B1FastShapes::Instance()
+{
+  if (!fgInstance) fgInstance = new B1FastShapes;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1FastShapes::B1FastShapes()
+: fMessenger(0),
+  fMode(kOff),
+  fBinsPerDecade(10),
+  fChordBin(1.*mm),
+  fMaxHistories(2000),
+  fMinHistories(100),
+  fReplayed(0.),
+  fTransported(0.),
+  fCurrent(0)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1FastShapes::~B1FastShapes()
+{
+  for (size_t i = 0; i < fThreadData.size(); i++) delete fThreadData[i];
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1FastShapes::ThreadData* B1FastShapes::GetThreadData()
+{
+  static G4ThreadLocal ThreadData* data = 0;
+  if (!data) {
+    data = new ThreadData;
+    G4AutoLock lock(&fastShapesMutex);
+    fThreadData.push_back(data);
+  }
+  return data;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B1FastShapes::MakeKey(const G4String& material,
+                             const G4ParticleDefinition* particle,
+                             G4double energy, G4double chord, Key& key) const
+{
+  if (energy < tableEMin || chord <= 0.) return false;
+  G4int energyBin
+    = (G4int)std::floor(std::log10(energy/tableEMin)*fBinsPerDecade);
+  if (energyBin >= tableDecades*fBinsPerDecade) return false;
+  key.fMaterial = material;
+  key.fParticle = particle->GetPDGEncoding();
+  key.fEnergyBin = energyBin;
+  key.fChordBin = (G4int)(chord/fChordBin);
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+const B1FastShapes::Bin* B1FastShapes::FindBin(const G4String& material,
+                                const G4ParticleDefinition* particle,
+                                G4double energy, G4double chord) const
+{
+  Key key;
+  if (!MakeKey(material, particle, energy, chord, key)) return 0;
+  Table::const_iterator it = fTable.find(key);
+  if (it == fTable.end()
+      || it->second.GetNumberOfHistories() < fMinHistories) return 0;
+  return &it->second;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B1FastShapes::IsModelBuilt()
+{
+  const char* value = std::getenv("B1_FASTSHAPES");
+  return value && std::strcmp(value, "1") == 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapes::CountEntry(G4bool replayed)
+{
+  ThreadData* data = GetThreadData();
+  if (replayed) data->fReplayed++;
+  else data->fTransported++;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapes::BeginOfEvent()
+{
+  ThreadData* data = GetThreadData();
+  data->fRegion = G4RegionStore::GetInstance()->GetRegion("Shapes", false);
+  data->fIncidentOf.clear();
+  data->fIncidents.clear();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapes::ProcessStep(const G4Step* step)
+{
+  ThreadData* data = GetThreadData();
+  const G4StepPoint* prePoint = step->GetPreStepPoint();
+  const G4VPhysicalVolume* volume = prePoint->GetTouchableHandle()->GetVolume();
+  if (!data->fRegion
+      || volume->GetLogicalVolume()->GetRegion() != data->fRegion) return;
+
+  const G4Track* track = step->GetTrack();
+  const G4ParticleDefinition* particle = track->GetDefinition();
+  G4int incident = -1;
+  if (prePoint->GetStepStatus() == fGeomBoundary) {
+    // a photon or electron entering the shape starts a history
+    if (!IsElectromagnetic(particle)) return;
+    const G4AffineTransform& transform
+      = prePoint->GetTouchableHandle()->GetHistory()->GetTopTransform();
+    G4ThreeVector position = transform.TransformPoint(prePoint->GetPosition());
+    G4ThreeVector direction
+      = transform.TransformAxis(prePoint->GetMomentumDirection());
+    G4double chord = volume->GetLogicalVolume()->GetSolid()
+                       ->DistanceToOut(position, direction);
+
+    ThreadData::Incident entry;
+    entry.fValid = MakeKey(volume->GetLogicalVolume()->GetMaterial()->GetName(),
+                           particle, prePoint->GetKineticEnergy(), chord,
+                           entry.fKey);
+    entry.fTrackID = track->GetTrackID();
+    entry.fEnergy = prePoint->GetKineticEnergy();
+    entry.fDirection = prePoint->GetMomentumDirection();
+    entry.fVolume = volume;
+    incident = (G4int)data->fIncidents.size();
+    data->fIncidents.push_back(entry);
+    data->fIncidentOf[track->GetTrackID()] = incident;
+  }
+  else {
+    std::map<G4int, G4int>::const_iterator it
+      = data->fIncidentOf.find(track->GetTrackID());
+    if (it != data->fIncidentOf.end()) {
+      incident = it->second;
+    }
+    else if (track->GetCurrentStepNumber() == 1) {
+      // created in the shape: belongs to the history of its parent
+      it = data->fIncidentOf.find(track->GetParentID());
+      if (it != data->fIncidentOf.end()) {
+        incident = it->second;
+        data->fIncidentOf[track->GetTrackID()] = incident;
+      }
+    }
+    if (incident >= 0 && data->fIncidents[incident].fVolume != volume) return;
+  }
+  if (incident < 0) return;
+
+  // leaving the shape; nuclei are not replayed, their energy stays
+  const G4StepPoint* postPoint = step->GetPostStepPoint();
+  if (postPoint->GetStepStatus() != fGeomBoundary
+      || particle->GetParticleType() == "nucleus") return;
+  ThreadData::Incident& entry = data->fIncidents[incident];
+  Exit exit;
+  exit.fParticle = particle;
+  G4double exitEnergy = postPoint->GetKineticEnergy();
+  if (track->GetTrackID() != entry.fTrackID
+      && IsLinePhoton(track, exitEnergy)) {
+    exit.fEnergy = (G4float)(-exitEnergy);
+  }
+  else {
+    exit.fEnergy = (G4float)(exitEnergy/entry.fEnergy);
+  }
+  exit.fCos = (G4float)postPoint->GetMomentumDirection().dot(entry.fDirection);
+  entry.fExits.push_back(exit);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapes::EndOfEvent()
+{
+  ThreadData* data = GetThreadData();
+  for (size_t i = 0; i < data->fIncidents.size(); i++) {
+    const ThreadData::Incident& entry = data->fIncidents[i];
+    if (!entry.fValid) continue;
+    Bin& bin = data->fTable[entry.fKey];
+    if (bin.GetNumberOfHistories() >= fMaxHistories) continue;
+    bin.fStart.push_back((G4int)bin.fExits.size());
+    bin.fExits.insert(bin.fExits.end(),
+                      entry.fExits.begin(), entry.fExits.end());
+  }
+  data->fIncidentOf.clear();
+  data->fIncidents.clear();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapes::Merge(ThreadData* data)
+{
+  // histories are independent, so the first ones of each thread will do
+  G4AutoLock lock(&fastShapesMutex);
+  for (Table::const_iterator it = data->fTable.begin();
+       it != data->fTable.end(); ++it) {
+    const Bin& source = it->second;
+    Bin& target = fTable[it->first];
+    G4int n = source.GetNumberOfHistories();
+    for (G4int h = 0; h < n; h++) {
+      if (target.GetNumberOfHistories() >= fMaxHistories) break;
+      G4int first = source.fStart[h];
+      G4int last = (h + 1 < n) ? source.fStart[h+1]
+                               : (G4int)source.fExits.size();
+      target.fStart.push_back((G4int)target.fExits.size());
+      target.fExits.insert(target.fExits.end(),
+                           source.fExits.begin() + first,
+                           source.fExits.begin() + last);
+    }
+  }
+  data->fTable.clear();
+  fReplayed += data->fReplayed;
+  fTransported += data->fTransported;
+  data->fReplayed = 0.;
+  data->fTransported = 0.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapes::BeginOfRun()
+{
+  fReplayed = 0.;
+  fTransported = 0.;
+  if (fCurrent) fStart = std::chrono::steady_clock::now();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapes::EndOfRun(G4bool isMaster, const B1Run* run)
+{
+  if (fMode != kOff) Merge(GetThreadData());
+  if (!isMaster) return;
+
+  if (fMode == kCalibrate) {
+    G4double histories = 0.;
+    for (Table::const_iterator it = fTable.begin(); it != fTable.end(); ++it) {
+      histories += it->second.GetNumberOfHistories();
+    }
+    G4cout << "Fast shapes: " << histories << " histories in "
+           << fTable.size() << " bins" << G4endl;
+  }
+  if (fMode == kFast && fReplayed + fTransported > 0.) {
+    G4cout << "Fast shapes: " << fReplayed << " of "
+           << fReplayed + fTransported << " shape entries replayed" << G4endl;
+  }
+
+  if (!fCurrent) return;
+  fCurrent->fSeconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - fStart).count();
+  fCurrent->fEvents = run->GetNumberOfEvent();
+  G4int nofDetectors = run->GetNumberOfDetectors();
+  fCurrent->fSum.resize(nofDetectors);
+  fCurrent->fSum2.resize(nofDetectors);
+  for (G4int d = 0; d < nofDetectors; d++) {
+    fCurrent->fSum[d]  = run->GetDetectorEdep(d);
+    fCurrent->fSum2[d] = run->GetDetectorEdep2(d);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapes::Calibrate(G4int nofEvents)
+{
+  Mode mode = fMode;
+  fMode = kCalibrate;
+  G4RunManager::GetRunManager()->BeamOn(nofEvents);
+  fMode = mode;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapes::Validate(G4int nofEvents)
+{
+  if (!IsModelBuilt()) {
+    G4Exception("B1FastShapes::Validate()", "MyCode0017", JustWarning,
+                "The fast shape model is not set up, start with "
+                "B1_FASTSHAPES=1.");
+    return;
+  }
+  if (fTable.empty()) {
+    G4Exception("B1FastShapes::Validate()", "MyCode0017", JustWarning,
+                "Calibrate or load the fast shape tables first.");
+    return;
+  }
+
+  // full transport, then the model
+  Mode mode = fMode;
+  ValidationRun runs[2];
+  for (G4int k = 0; k < 2; k++) {
+    runs[k].fEvents = 0.;
+    fMode = (k == 0) ? kOff : kFast;
+    fCurrent = &runs[k];
+    G4RunManager::GetRunManager()->BeamOn(nofEvents);
+    fCurrent = 0;
+  }
+  fMode = mode;
+  if (runs[0].fEvents <= 0. || runs[1].fEvents <= 0.) return;
+
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  const std::vector<G4LogicalVolume*>& detectors
+    = detectorConstruction->GetScoringVolumes();
+
+  G4cout << "\n Fast shapes validation, " << nofEvents << " events per run\n"
+         << " detector        full transport                 fast"
+            "         difference" << G4endl;
+  G4double worst = 0.;
+  for (size_t d = 0; d < runs[0].fSum.size() && d < runs[1].fSum.size()
+                     && d < detectors.size(); d++) {
+    G4double mass = detectors[d]->GetMass();
+    G4double mean[2], sigma[2];
+    for (G4int k = 0; k < 2; k++) {
+      mean[k] = runs[k].fSum[d]/runs[k].fEvents;
+      G4double variance
+        = (runs[k].fSum2[d]/runs[k].fEvents - mean[k]*mean[k])/runs[k].fEvents;
+      sigma[k] = std::sqrt(std::max(variance, 0.));
+    }
+    G4double error = std::sqrt(sigma[0]*sigma[0] + sigma[1]*sigma[1]);
+    G4double pull = (error > 0.) ? (mean[1] - mean[0])/error : 0.;
+    worst = std::max(worst, std::fabs(pull));
+    G4cout << std::setw(9) << d << "  "
+           << G4BestUnit(mean[0]/mass, "Dose") << " +- "
+           << G4BestUnit(sigma[0]/mass, "Dose") << "  "
+           << G4BestUnit(mean[1]/mass, "Dose") << " +- "
+           << G4BestUnit(sigma[1]/mass, "Dose") << "  "
+           << std::setw(7) << pull << " sigma" << G4endl;
+  }
+  G4double speedup = (runs[0].fSeconds/runs[0].fEvents)
+                     /(runs[1].fSeconds/runs[1].fEvents);
+  G4cout << " Largest difference " << worst << " sigma, event loop "
+         << speedup << " times faster" << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapes::Save(G4String fileName)
+{
+  FILE* output = fTable.empty() ? 0 : fopen(fileName.c_str(), "wb");
+  if (!output) {
+    G4ExceptionDescription msg;
+    msg << "No fast shape tables to save or cannot open " << fileName;
+    G4Exception("B1FastShapes::Save()", "MyCode0017", JustWarning, msg);
+    return;
+  }
+
+  int32_t binning[2] = { fBinsPerDecade, (int32_t)fTable.size() };
+  double chordBin = fChordBin/mm;
+  fwrite(tableMagic, sizeof(tableMagic), 1, output);
+  fwrite(binning, sizeof(binning), 1, output);
+  fwrite(&chordBin, sizeof(chordBin), 1, output);
+  for (Table::const_iterator it = fTable.begin(); it != fTable.end(); ++it) {
+    const Key& key = it->first;
+    const Bin& bin = it->second;
+    int32_t header[6] = { (int32_t)key.fMaterial.size(), key.fParticle,
+                          key.fEnergyBin, key.fChordBin,
+                          bin.GetNumberOfHistories(),
+                          (int32_t)bin.fExits.size() };
+    fwrite(header, sizeof(header), 1, output);
+    fwrite(key.fMaterial.c_str(), 1, key.fMaterial.size(), output);
+    for (size_t h = 0; h < bin.fStart.size(); h++) {
+      int32_t start = bin.fStart[h];
+      fwrite(&start, sizeof(start), 1, output);
+    }
+    for (size_t e = 0; e < bin.fExits.size(); e++) {
+      int32_t particle = bin.fExits[e].fParticle->GetPDGEncoding();
+      float values[2] = { bin.fExits[e].fEnergy, bin.fExits[e].fCos };
+      fwrite(&particle, sizeof(particle), 1, output);
+      fwrite(values, sizeof(values), 1, output);
+    }
+  }
+  fclose(output);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapes::Load(G4String fileName)
+{
+  FILE* input = fopen(fileName.c_str(), "rb");
+  char magic[8];
+  int32_t binning[2];
+  double chordBin;
+  if (!input || fread(magic, sizeof(magic), 1, input) != 1
+      || std::memcmp(magic, tableMagic, sizeof(magic))
+      || fread(binning, sizeof(binning), 1, input) != 1
+      || fread(&chordBin, sizeof(chordBin), 1, input) != 1) {
+    G4ExceptionDescription msg;
+    msg << "Cannot read fast shape tables " << fileName;
+    G4Exception("B1FastShapes::Load()", "MyCode0017", JustWarning, msg);
+    if (input) fclose(input);
+    return;
+  }
+
+  G4ParticleTable* particleTable = G4ParticleTable::GetParticleTable();
+  Table table;
+  G4bool complete = true;
+  for (int32_t b = 0; complete && b < binning[1]; b++) {
+    int32_t header[6];
+    complete = (fread(header, sizeof(header), 1, input) == 1
+                && header[0] >= 0 && header[4] >= 0 && header[5] >= 0);
+    if (!complete) break;
+    std::string material(header[0], ' ');
+    std::vector<int32_t> starts(header[4]);
+    complete
+      = (!header[0]
+         || fread(&material[0], 1, header[0], input) == (size_t)header[0])
+        && (!header[4]
+            || fread(&starts[0], sizeof(int32_t), header[4], input)
+               == (size_t)header[4]);
+    Key key;
+    key.fMaterial = material;
+    key.fParticle = header[1];
+    key.fEnergyBin = header[2];
+    key.fChordBin = header[3];
+    Bin& bin = table[key];
+
+    // exits of particles unknown to this physics list are dropped
+    size_t next = 0;
+    for (int32_t e = 0; complete && e < header[5]; e++) {
+      while (next < starts.size() && starts[next] == e) {
+        bin.fStart.push_back((G4int)bin.fExits.size());
+        next++;
+      }
+      int32_t particle;
+      float values[2];
+      complete = fread(&particle, sizeof(particle), 1, input) == 1
+                 && fread(values, sizeof(values), 1, input) == 1;
+      Exit exit;
+      exit.fParticle = particleTable->FindParticle(particle);
+      exit.fEnergy = values[0];
+      exit.fCos = values[1];
+      if (exit.fParticle) bin.fExits.push_back(exit);
+    }
+    while (next < starts.size()) {
+      bin.fStart.push_back((G4int)bin.fExits.size());
+      next++;
+    }
+  }
+  fclose(input);
+  if (!complete) {
+    G4ExceptionDescription msg;
+    msg << "Fast shape tables " << fileName << " are truncated.";
+    G4Exception("B1FastShapes::Load()", "MyCode0017", JustWarning, msg);
+    return;
+  }
+
+  fBinsPerDecade = binning[0];
+  fChordBin = chordBin*mm;
+  fTable.swap(table);
+  G4cout << "Fast shapes: " << fTable.size() << " bins read from "
+         << fileName << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapes::Enable(G4bool enable)
+{
+  if (enable && !IsModelBuilt()) {
+    G4Exception("B1FastShapes::Enable()", "MyCode0017", JustWarning,
+                "The fast shape model is not set up, start with "
+                "B1_FASTSHAPES=1.");
+    return;
+  }
+  if (enable && fTable.empty()) {
+    G4Exception("B1FastShapes::Enable()", "MyCode0017", JustWarning,
+                "No fast shape tables, all tracks are transported in full.");
+  }
+  fMode = enable ? kFast : kOff;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapes::SetEnergyBins(G4int binsPerDecade)
+{
+  if (binsPerDecade == fBinsPerDecade) return;
+  Clear();
+  fBinsPerDecade = binsPerDecade;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapes::SetChordBin(G4double width)
+{
+  if (width == fChordBin) return;
+  Clear();
+  fChordBin = width;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapes::Clear()
+{
+  if (!fTable.empty()) G4cout << "Fast shapes: tables cleared" << G4endl;
+  fTable.clear();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapes::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/fastShapes/",
+                                      "Fast transport through the shapes");
+
+  G4GenericMessenger::Command& energyBinsCmd
+    = fMessenger->DeclareMethod("energyBins", &B1FastShapes::SetEnergyBins,
+        "Energy bins per decade (clears the tables).");
+  energyBinsCmd.SetParameterName("binsPerDecade", false);
+  energyBinsCmd.SetRange("binsPerDecade>0");
+  energyBinsCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& chordBinCmd
+    = fMessenger->DeclareMethodWithUnit("chordBin", "mm",
+        &B1FastShapes::SetChordBin,
+        "Width of the chord bins (clears the tables).");
+  chordBinCmd.SetParameterName("width", false);
+  chordBinCmd.SetRange("width>0.");
+  chordBinCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& maxHistoriesCmd
+    = fMessenger->DeclareProperty("maxHistories", fMaxHistories,
+        "Histories kept per bin in a calibration.");
+  maxHistoriesCmd.SetParameterName("histories", false);
+  maxHistoriesCmd.SetRange("histories>0");
+  maxHistoriesCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& minHistoriesCmd
+    = fMessenger->DeclareProperty("minHistories", fMinHistories,
+        "Histories a bin needs to be replayed.");
+  minHistoriesCmd.SetParameterName("histories", false);
+  minHistoriesCmd.SetRange("histories>0");
+  minHistoriesCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& calibrateCmd
+    = fMessenger->DeclareMethod("calibrate", &B1FastShapes::Calibrate,
+        "Run with full transport, adding the histories to the tables.");
+  calibrateCmd.SetParameterName("events", false);
+  calibrateCmd.SetRange("events>0");
+  calibrateCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& saveCmd
+    = fMessenger->DeclareMethod("save", &B1FastShapes::Save,
+        "Write the tables to a file.");
+  saveCmd.SetParameterName("fileName", false);
+  saveCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& loadCmd
+    = fMessenger->DeclareMethod("load", &B1FastShapes::Load,
+        "Read the tables from a file.");
+  loadCmd.SetParameterName("fileName", false);
+  loadCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& enableCmd
+    = fMessenger->DeclareMethod("enable", &B1FastShapes::Enable,
+        "Replay the tables for the tracks entering the shapes.");
+  enableCmd.SetParameterName("enable", true);
+  enableCmd.SetDefaultValue("true");
+  enableCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& validateCmd
+    = fMessenger->DeclareMethod("validate", &B1FastShapes::Validate,
+        "Compare the doses with full transport and with the tables.");
+  validateCmd.SetParameterName("events", false);
+  validateCmd.SetRange("events>0");
+  validateCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& clearCmd
+    = fMessenger->DeclareMethod("clear", &B1FastShapes::Clear,
+        "Delete the tables.");
+  clearCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1ShapeFastModel::B1ShapeFastModel(G4Region* region)
+: G4VFastSimulationModel("B1ShapeFastModel", region),
+  fFastShapes(B1FastShapes::Instance()),
+  fBin(0),
+  fChord(0.)
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1ShapeFastModel::~B1ShapeFastModel()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B1ShapeFastModel::IsApplicable(const G4ParticleDefinition& particle)
+{
+  return IsElectromagnetic(&particle);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B1ShapeFastModel::ModelTrigger(const G4FastTrack& fastTrack)
+{
+  fBin = 0;
+  if (fFastShapes->GetMode() != B1FastShapes::kFast) return false;
+
+  // only tracks entering the shape
+  const G4VSolid* solid = fastTrack.GetEnvelopeSolid();
+  G4ThreeVector position = fastTrack.GetPrimaryTrackLocalPosition();
+  if (solid->Inside(position) != kSurface) return false;
+  fChord = solid->DistanceToOut(position,
+                                fastTrack.GetPrimaryTrackLocalDirection());
+  if (fChord <= 0. || fChord >= kInfinity) return false;
+
+  const G4Track* track = fastTrack.GetPrimaryTrack();
+  fBin = fFastShapes->FindBin(
+           fastTrack.GetEnvelopeLogicalVolume()->GetMaterial()->GetName(),
+           track->GetDefinition(), track->GetKineticEnergy(), fChord);
+  fFastShapes->CountEntry(fBin != 0);
+  return fBin != 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1ShapeFastModel::DoIt(const G4FastTrack& fastTrack,
+                            G4FastStep& fastStep)
+{
+  const G4Track* track = fastTrack.GetPrimaryTrack();
+  const G4VSolid* solid = fastTrack.GetEnvelopeSolid();
+  G4double energy = track->GetKineticEnergy();
+  G4ThreeVector entryPoint = fastTrack.GetPrimaryTrackLocalPosition();
+  G4ThreeVector direction = fastTrack.GetPrimaryTrackLocalDirection();
+  G4ThreeVector exitPoint = entryPoint + fChord*direction;
+  G4ThreeVector u = direction.orthogonal().unit();
+  G4ThreeVector v = direction.cross(u);
+
+  G4int nofHistories = fBin->GetNumberOfHistories();
+  G4int history = std::min((G4int)(G4UniformRand()*nofHistories),
+                           nofHistories - 1);
+  G4int first = fBin->fStart[history];
+  G4int last = (history + 1 < nofHistories) ? fBin->fStart[history+1]
+                                            : (G4int)fBin->fExits.size();
+
+  fastStep.KillPrimaryTrack();
+  fastStep.ProposePrimaryTrackPathLength(fChord);
+  fastStep.SetNumberOfSecondaryTracks(last - first);
+  G4double carried = 0.;
+  for (G4int i = first; i < last; i++) {
+    const B1FastShapes::Exit& exit = fBin->fExits[i];
+    G4double cosTheta = exit.fCos;
+    G4double sinTheta = std::sqrt(std::max(0., 1. - cosTheta*cosTheta));
+    G4double phi = twopi*G4UniformRand();
+    G4ThreeVector exitDirection = cosTheta*direction
+      + sinTheta*(std::cos(phi)*u + std::sin(phi)*v);
+    G4ThreeVector position = (cosTheta >= 0.) ? exitPoint : entryPoint;
+
+    // the particle must leave the shape from the face it is put on
+    G4ThreeVector normal = solid->SurfaceNormal(position);
+    G4double outward = exitDirection.dot(normal);
+    if (outward < 0.) exitDirection -= 2.*outward*normal;
+
+    G4double exitEnergy = exit.GetEnergy(energy);
+    G4DynamicParticle particle(exit.fParticle, exitDirection, exitEnergy);
+    G4Track* secondary = fastStep.CreateSecondaryTrack(particle, position,
+                           track->GetGlobalTime(), true);
+    if (secondary) secondary->SetWeight(track->GetWeight());
+    carried += exitEnergy;
+  }
+  // annihilation photons can carry more than the kinetic energy
+  fastStep.ProposeTotalEnergyDeposited(std::max(0., energy - carried));
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1FastShapesPhysics::B1FastShapesPhysics()
+: G4VPhysicsConstructor("B1FastShapes")
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1FastShapesPhysics::~B1FastShapesPhysics()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapesPhysics::ConstructParticle()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1FastShapesPhysics::ConstructProcess()
+{
+  G4FastSimulationManagerProcess* process
+    = new G4FastSimulationManagerProcess("fastShapes");
+  G4ParticleDefinition* particles[3]
+    = { G4Gamma::Gamma(), G4Electron::Electron(), G4Positron::Positron() };
+  for (G4int i = 0; i < 3; i++) {
+    particles[i]->GetProcessManager()->AddDiscreteProcess(process);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,512 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1Perturbation.cc
+/// \brief Implementation of the B1Perturbation class
+
+#include "B1Perturbation.hh"
+#include "B1AttenuationTable.hh"
+#include "B1DetectorConstruction.hh"
+#include "B1Run.hh"
+
+#include "G4RunManager.hh"
+#include "G4UImanager.hh"
+#include "G4Step.hh"
+#include "G4VProcess.hh"
+#include "G4Gamma.hh"
+#include "G4Material.hh"
+#include "G4LogicalVolume.hh"
+#include "G4GenericMessenger.hh"
+#include "G4UnitsTable.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <iomanip>
+
+namespace
+{
+  const char* regionNames[B1Perturbation::kNofRegions]
+    = { "shapes", "detectors" };
+
+  // variance of the mean from the sums over n events
+  G4double VarianceOfMean(G4double sum, G4double sum2, G4double n)
+  {
+    if (n < 2.) return 0.;
+    G4double variance = (sum2 - sum*sum/n) / (n - 1.);
+    return (variance > 0.) ? variance / n : 0.;
+  }
+
+  const B1DetectorConstruction* GetDetectorConstruction()
+  {
+    return static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  }
+
+  const std::vector<G4LogicalVolume*>& GetVolumes(G4int region)
+  {
+    const B1DetectorConstruction* detectorConstruction
+      = GetDetectorConstruction();
+    return (region == B1Perturbation::kShapes)
+      ? detectorConstruction->GetSolidVolumes()
+      : detectorConstruction->GetScoringVolumes();
+  }
+}
+
+B1Perturbation* B1Perturbation::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1Perturbation* B1Perturbation::Instance()
+{
+  if (!fgInstance) fgInstance = new B1Perturbation;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1Perturbation::B1Perturbation()
+: fMessenger(0),
+  fFileName("perturbation.txt"),
+  fSuspended(false),
+  fValidating(false)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1Perturbation::~B1Perturbation()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Perturbation::ProcessStep(const G4Step* step, Region region,
+                                 std::vector<G4double>& scores) const
+{
+  if (step->GetTrack()->GetDefinition() != G4Gamma::Gamma()) return;
+
+  const G4StepPoint* prePoint = step->GetPreStepPoint();
+  std::map<const G4Material*, const B1AttenuationTable*>::const_iterator it
+    = fTables.find(prePoint->GetMaterial());
+  if (it == fTables.end()) return;
+  const B1AttenuationTable* nominal = it->second;
+
+  G4double energy = prePoint->GetKineticEnergy();
+  G4double length = step->GetStepLength();
+  G4double mu = nominal->GetMu(energy);
+
+  // interaction ending the step, if any
+  G4int process = -1;
+  const G4VProcess* limiter
+    = step->GetPostStepPoint()->GetProcessDefinedStep();
+  if (limiter) {
+    const G4String& name = limiter->GetProcessName();
+    for (G4int p = 0; p < B1AttenuationTable::kNofProcesses; p++) {
+      if (name == B1AttenuationTable::GetProcessName(
+                    (B1AttenuationTable::Process)p)) {
+        process = p;
+        break;
+      }
+    }
+  }
+
+  G4int nofPerturbations = (G4int)fPerturbations.size();
+  for (G4int j = 0; j < nofPerturbations; j++) {
+    const Perturbation& perturbation = fPerturbations[j];
+    if (perturbation.fRegion != region) continue;
+    G4double muPerturbed, ratio = perturbation.fFactor;
+    if (perturbation.fTable) {
+      muPerturbed = perturbation.fTable->GetMu(energy);
+      if (process >= 0) {
+        B1AttenuationTable::Process p = (B1AttenuationTable::Process)process;
+        G4double muProcess = nominal->GetMu(p, energy);
+        ratio = (muProcess > 0.)
+          ? perturbation.fTable->GetMu(p, energy)/muProcess : 1.;
+      }
+    }
+    else muPerturbed = perturbation.fFactor*mu;
+    scores[j] -= (muPerturbed - mu)*length;
+    // an interaction impossible in the perturbed material gives a
+    // vanishing weight
+    if (process >= 0) scores[j] += (ratio > 0.) ? std::log(ratio) : -100.;
+  }
+
+  // derivative of the log of the weight at the nominal density
+  scores[nofPerturbations + region] += ((process >= 0) ? 1. : 0.) - mu*length;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Perturbation::EndOfEvent(B1Run* run,
+                                const std::vector<G4double>& scores,
+                                const std::vector<G4int>& hitDetectors,
+                                const std::vector<G4double>& detectorEdep) const
+{
+  G4int nofPerturbations = (G4int)fPerturbations.size();
+  for (G4int s = 0; s < GetNumberOfScores(); s++) {
+    // weight of the history, or its derivative
+    G4double weight = (s < nofPerturbations) ? std::exp(scores[s]) : scores[s];
+    run->AddPerturbationWeight(s, weight);
+    for (size_t i = 0; i < hitDetectors.size(); i++) {
+      G4int detector = hitDetectors[i];
+      run->AddPerturbedEdep(s, detector, weight*detectorEdep[detector]);
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Perturbation::BeginOfRun()
+{
+  if (!IsActive()) return;
+
+  // tables of the nominal materials of the regions, and of the
+  // perturbed materials
+  fTables.clear();
+  for (G4int r = 0; r < kNofRegions; r++) {
+    const std::vector<G4LogicalVolume*>& volumes = GetVolumes(r);
+    for (size_t i = 0; i < volumes.size(); i++) {
+      const G4Material* material = volumes[i]->GetMaterial();
+      if (!fTables.count(material)) {
+        fTables[material] = B1AttenuationTable::GetShared(material);
+      }
+    }
+  }
+  for (size_t j = 0; j < fPerturbations.size(); j++) {
+    Perturbation& perturbation = fPerturbations[j];
+    perturbation.fTable = 0;
+    if (perturbation.fMaterialName == "same") continue;
+    std::ostringstream specification;
+    specification << perturbation.fMaterialName << " " << perturbation.fFactor;
+    perturbation.fTable = B1AttenuationTable::GetShared(
+      B1DetectorConstruction::FindMaterial(specification.str()));
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B1Perturbation::GetMassFactor(const Perturbation& perturbation,
+                                       const G4Material* nominal) const
+{
+  if (perturbation.fRegion != kDetectors) return 1.;
+  if (!perturbation.fTable) return perturbation.fFactor;
+  return perturbation.fTable->GetMaterial()->GetDensity()
+         / nominal->GetDensity();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Perturbation::EndOfRun(const B1Run* run)
+{
+  G4double n = run->GetNumberOfEvent();
+  const std::vector<G4LogicalVolume*>& volumes = GetVolumes(kDetectors);
+  G4int nofDetectors = run->GetNumberOfDetectors();
+
+  // direct run of a perturbed geometry during a validation
+  if (fValidating && fSuspended) {
+    std::vector<G4double> doses(nofDetectors), errors(nofDetectors);
+    for (G4int d = 0; d < nofDetectors; d++) {
+      G4double mass = volumes[d]->GetMass();
+      G4double sum = run->GetDetectorEdep(d);
+      doses[d] = sum/n/mass;
+      errors[d]
+        = std::sqrt(VarianceOfMean(sum, run->GetDetectorEdep2(d), n))/mass;
+    }
+    fDirect.push_back(doses);
+    fDirectErrors.push_back(errors);
+    return;
+  }
+  if (!run->HasPerturbations() || n < 1.) return;
+
+  std::ofstream output(fFileName.c_str());
+  if (!output) {
+    G4ExceptionDescription msg;
+    msg << "Cannot write the perturbed doses to " << fFileName << ".";
+    G4Exception("B1Perturbation::EndOfRun()", "MyCode0025", JustWarning, msg);
+  }
+  output << "# perturbation: per perturbation and detector the nominal and"
+            " reweighted dose per primary (Gy) with their standard errors\n"
+         << "# label  region  material  factor  detector  nominal  error"
+            "  perturbed  error\n";
+
+  G4int nofPerturbations = (G4int)fPerturbations.size();
+  if (fValidating) {
+    fEstimates.assign(nofPerturbations, std::vector<G4double>(nofDetectors));
+    fEstimateErrors = fEstimates;
+  }
+  for (G4int j = 0; j < nofPerturbations; j++) {
+    const Perturbation& perturbation = fPerturbations[j];
+    G4double weight = run->GetPerturbationWeight(j);
+    G4double weightError
+      = std::sqrt(VarianceOfMean(weight, run->GetPerturbationWeight2(j), n));
+    G4cout << "\n Perturbation " << perturbation.fLabel << ": "
+           << regionNames[perturbation.fRegion] << " "
+           << perturbation.fMaterialName << " x " << perturbation.fFactor
+           << ", mean weight " << weight/n << " +- " << weightError << "\n"
+           << " detector           nominal                 perturbed"
+              "        ratio" << G4endl;
+    for (G4int d = 0; d < nofDetectors; d++) {
+      G4double mass = volumes[d]->GetMass();
+      G4double massPerturbed
+        = mass*GetMassFactor(perturbation, volumes[d]->GetMaterial());
+      G4double sum = run->GetDetectorEdep(d);
+      G4double dose = sum/n/mass;
+      G4double error
+        = std::sqrt(VarianceOfMean(sum, run->GetDetectorEdep2(d), n))/mass;
+      G4double sumPerturbed = run->GetPerturbedEdep(j, d);
+      G4double dosePerturbed = sumPerturbed/n/massPerturbed;
+      G4double errorPerturbed
+        = std::sqrt(VarianceOfMean(sumPerturbed,
+                                   run->GetPerturbedEdep2(j, d), n))
+          /massPerturbed;
+      output << perturbation.fLabel << "\t"
+             << regionNames[perturbation.fRegion] << "\t"
+             << perturbation.fMaterialName << "\t" << perturbation.fFactor
+             << "\t" << d << "\t" << dose/gray << "\t" << error/gray
+             << "\t" << dosePerturbed/gray << "\t" << errorPerturbed/gray
+             << "\n";
+      G4cout << std::setw(9) << d << "  "
+             << std::setw(10) << G4BestUnit(dose, "Dose") << " +- "
+             << std::setw(10) << G4BestUnit(error, "Dose") << "  "
+             << std::setw(10) << G4BestUnit(dosePerturbed, "Dose") << " +- "
+             << std::setw(10) << G4BestUnit(errorPerturbed, "Dose") << "  "
+             << std::setw(8) << (dose > 0. ? dosePerturbed/dose : 0.)
+             << G4endl;
+      if (fValidating) {
+        fEstimates[j][d] = dosePerturbed;
+        fEstimateErrors[j][d] = errorPerturbed;
+      }
+    }
+  }
+
+  // first-order change of the dose for a 1% denser region; a denser
+  // detector also has a larger mass
+  output << "# density sensitivity: region  detector  dose change (Gy) for"
+            " +1% density  error\n";
+  G4cout << "\n Dose change for +1% density of the region\n"
+         << " detector        shapes                    detectors" << G4endl;
+  for (G4int d = 0; d < nofDetectors; d++) {
+    G4double mass = volumes[d]->GetMass();
+    G4double dose = run->GetDetectorEdep(d)/n/mass;
+    G4cout << std::setw(9) << d;
+    for (G4int r = 0; r < kNofRegions; r++) {
+      G4int s = nofPerturbations + r;
+      G4double sum = run->GetPerturbedEdep(s, d);
+      G4double derivative = sum/n/mass - ((r == kDetectors) ? dose : 0.);
+      G4double error
+        = std::sqrt(VarianceOfMean(sum, run->GetPerturbedEdep2(s, d), n))
+          /mass;
+      output << "# " << regionNames[r] << "\t" << d << "\t"
+             << 0.01*derivative/gray << "\t" << 0.01*error/gray << "\n";
+      G4cout << "  " << std::setw(10) << G4BestUnit(0.01*derivative, "Dose")
+             << " +- " << std::setw(10) << G4BestUnit(0.01*error, "Dose");
+    }
+    G4cout << G4endl;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String B1Perturbation::GetSpecification(const Perturbation& perturbation) const
+{
+  G4String name = perturbation.fMaterialName;
+  G4double factor = perturbation.fFactor;
+  if (name == "same") {
+    // the material currently set for the region, or the one of its volumes
+    const B1DetectorConstruction* detectorConstruction
+      = GetDetectorConstruction();
+    std::istringstream current((perturbation.fRegion == kShapes)
+                               ? detectorConstruction->GetShapeMaterial()
+                               : detectorConstruction->GetDetectorMaterial());
+    G4double currentFactor = 1.;
+    if (current >> name) {
+      current >> currentFactor;
+      factor *= currentFactor;
+    }
+    else {
+      const std::vector<G4LogicalVolume*>& volumes
+        = GetVolumes(perturbation.fRegion);
+      name = volumes.empty() ? G4String("G4_Pb")
+                             : volumes[0]->GetMaterial()->GetName();
+    }
+  }
+  std::ostringstream specification;
+  specification << name << " " << factor;
+  return specification.str();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Perturbation::AddPerturbation(G4String definition)
+{
+  std::istringstream input(definition);
+  Perturbation perturbation;
+  G4String region;
+  perturbation.fFactor = 1.;
+  perturbation.fTable = 0;
+  G4bool valid = (G4bool)(input >> perturbation.fLabel >> region
+                                >> perturbation.fMaterialName);
+  input >> perturbation.fFactor;
+  if (region == regionNames[kShapes]) perturbation.fRegion = kShapes;
+  else if (region == regionNames[kDetectors]) perturbation.fRegion = kDetectors;
+  else valid = false;
+  if (!(perturbation.fFactor > 0.)) valid = false;
+  if (valid && perturbation.fMaterialName != "same"
+      && !B1DetectorConstruction::FindMaterial(perturbation.fMaterialName)) {
+    valid = false;
+  }
+  if (!valid) {
+    G4ExceptionDescription msg;
+    msg << "Perturbation \"" << definition << "\" not added, expected: "
+        << "label shapes|detectors material|same [densityFactor].";
+    G4Exception("B1Perturbation::AddPerturbation()", "MyCode0025",
+                JustWarning, msg);
+    return;
+  }
+  fPerturbations.push_back(perturbation);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Perturbation::Clear()
+{
+  fPerturbations.clear();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Perturbation::Validate(G4int nofEvents)
+{
+  if (fPerturbations.empty()) {
+    G4Exception("B1Perturbation::Validate()", "MyCode0025", JustWarning,
+                "No perturbation added, no run.");
+    return;
+  }
+
+  G4RunManager* runManager = G4RunManager::GetRunManager();
+  G4UImanager* uiManager = G4UImanager::GetUIpointer();
+  const B1DetectorConstruction* detectorConstruction
+    = GetDetectorConstruction();
+
+  fValidating = true;
+  fEstimates.clear();
+  fEstimateErrors.clear();
+  fDirect.clear();
+  fDirectErrors.clear();
+  G4cout << "Perturbation validation: nominal run, " << nofEvents
+         << " primaries" << G4endl;
+  runManager->BeamOn(nofEvents);
+
+  // the perturbed geometries, one direct run each
+  fSuspended = true;
+  for (size_t j = 0; j < fPerturbations.size() && !fEstimates.empty(); j++) {
+    const Perturbation& perturbation = fPerturbations[j];
+    G4String command = (perturbation.fRegion == kShapes)
+      ? "/B1/det/shapeMaterial " : "/B1/det/detectorMaterial ";
+    G4String nominal = (perturbation.fRegion == kShapes)
+      ? detectorConstruction->GetShapeMaterial()
+      : detectorConstruction->GetDetectorMaterial();
+    G4String specification = GetSpecification(perturbation);
+    G4cout << "Perturbation validation: " << perturbation.fLabel << ", "
+           << regionNames[perturbation.fRegion] << " " << specification
+           << G4endl;
+    uiManager->ApplyCommand(command + specification);
+    runManager->BeamOn(nofEvents);
+    uiManager->ApplyCommand(command + (nominal.empty() ? "none" : nominal));
+  }
+  fSuspended = false;
+  fValidating = false;
+
+  if (fEstimates.size() != fPerturbations.size()
+      || fDirect.size() != fPerturbations.size()) {
+    G4Exception("B1Perturbation::Validate()", "MyCode0025", JustWarning,
+                "Incomplete validation runs, no comparison.");
+    return;
+  }
+
+  G4cout << "\n Perturbation validation, reweighted vs direct dose\n"
+         << "        label  detector       reweighted"
+            "                  direct         z" << G4endl;
+  for (size_t j = 0; j < fPerturbations.size(); j++) {
+    for (size_t d = 0; d < fEstimates[j].size() && d < fDirect[j].size();
+         d++) {
+      G4double error = std::sqrt(fEstimateErrors[j][d]*fEstimateErrors[j][d]
+                                 + fDirectErrors[j][d]*fDirectErrors[j][d]);
+      G4cout << std::setw(13) << fPerturbations[j].fLabel << "  "
+             << std::setw(8) << d << "  "
+             << std::setw(10) << G4BestUnit(fEstimates[j][d], "Dose") << " +- "
+             << std::setw(10) << G4BestUnit(fEstimateErrors[j][d], "Dose")
+             << "  "
+             << std::setw(10) << G4BestUnit(fDirect[j][d], "Dose") << " +- "
+             << std::setw(10) << G4BestUnit(fDirectErrors[j][d], "Dose")
+             << "  " << std::setw(8)
+             << (error > 0. ? (fEstimates[j][d] - fDirect[j][d])/error : 0.)
+             << G4endl;
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Perturbation::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/perturb/",
+                                      "Reweighting for perturbed materials");
+
+  G4GenericMessenger::Command& addCmd
+    = fMessenger->DeclareMethod("add", &B1Perturbation::AddPerturbation,
+        "Add a perturbation: label, region (shapes or detectors), NIST "
+        "material or same, density factor.");
+  addCmd.SetParameterName("perturbation", false);
+  addCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareProperty("file", fFileName,
+        "Output file of the perturbed doses.");
+  fileCmd.SetParameterName("fileName", false);
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& validateCmd
+    = fMessenger->DeclareMethod("validate", &B1Perturbation::Validate,
+        "Run the nominal geometry and every perturbed one with the given "
+        "number of primaries, and compare the reweighted doses.");
+  validateCmd.SetParameterName("nofEvents", false);
+  validateCmd.SetRange("nofEvents>0");
+  validateCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& clearCmd
+    = fMessenger->DeclareMethod("clear", &B1Perturbation::Clear,
+        "Remove all perturbations.");
+  clearCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
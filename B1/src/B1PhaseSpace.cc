@@ -0,0 +1,341 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1PhaseSpace.cc
+/// \brief Implementation of the B1PhaseSpaceWriter and B1PhaseSpaceReader classes
+
+#include "B1PhaseSpace.hh"
+
+#include "G4Step.hh"
+#include "G4Event.hh"
+#include "G4EventManager.hh"
+#include "G4Track.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4GenericMessenger.hh"
+#include "G4AutoLock.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <map>
+#include <algorithm>
+#include <cstring>
+#include <sys/stat.h>
+
+namespace
+{
+  G4Mutex phaseSpaceMutex = G4MUTEX_INITIALIZER;
+
+  const char phaseSpaceMagic[8] = { 'B','1','P','H','S','P','0','2' };
+  const size_t phaseSpaceBufferSize = 4096;
+
+  G4ThreadLocal std::vector<B1PhaseSpaceRecord>* threadBuffer = 0;
+
+  // a file is loaded again when its size or modification time changed,
+  // e.g. recorded again in the session; the readers of the earlier
+  // contents are kept until exit, the generators may still use them
+  struct PhaseSpaceFile
+  {
+    B1PhaseSpaceReader* fReader;
+    off_t               fSize;
+    time_t              fModified;
+  };
+
+  struct PhaseSpaceRegistry
+  {
+    std::map<G4String, PhaseSpaceFile> fFiles;
+    std::vector<B1PhaseSpaceReader*>   fRetired;
+    ~PhaseSpaceRegistry()
+    {
+      std::map<G4String, PhaseSpaceFile>::iterator it;
+      for (it = fFiles.begin(); it != fFiles.end(); ++it)
+        delete it->second.fReader;
+      for (size_t i = 0; i < fRetired.size(); i++) delete fRetired[i];
+    }
+  };
+  PhaseSpaceRegistry phaseSpaceRegistry;
+
+  G4bool EarlierHistory(const B1PhaseSpaceRecord& a,
+                        const B1PhaseSpaceRecord& b)
+  {
+    return a.fHistory < b.fHistory;
+  }
+}
+
+B1PhaseSpaceWriter* B1PhaseSpaceWriter::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1PhaseSpaceWriter* B1PhaseSpaceWriter::Instance()
+{
+  if (!fgInstance) fgInstance = new B1PhaseSpaceWriter;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1PhaseSpaceWriter::B1PhaseSpaceWriter()
+: fMessenger(0),
+  fPlaneZ(5.*cm),
+  fKillAtPlane(false),
+  fActive(false),
+  fFile(0),
+  fRecords(0)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1PhaseSpaceWriter::~B1PhaseSpaceWriter()
+{
+  if (fFile) fclose(fFile);
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PhaseSpaceWriter::SetFileName(G4String fileName)
+{
+  fActive = !(fileName == "none" || fileName.empty());
+  fFileName = fActive ? fileName : G4String();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PhaseSpaceWriter::ProcessStep(const G4Step* step)
+{
+  const G4StepPoint* prePoint = step->GetPreStepPoint();
+  const G4StepPoint* postPoint = step->GetPostStepPoint();
+  G4double z1 = prePoint->GetPosition().z();
+  G4double z2 = postPoint->GetPosition().z();
+  if (!(z1 < fPlaneZ && z2 >= fPlaneZ)) return;
+
+  // straight-line interpolation to the plane
+  G4double f = (fPlaneZ - z1) / (z2 - z1);
+  G4ThreeVector position
+    = prePoint->GetPosition() + f*(postPoint->GetPosition() - prePoint->GetPosition());
+  const G4ThreeVector& direction = prePoint->GetMomentumDirection();
+
+  B1PhaseSpaceRecord record;
+  record.fPDG    = step->GetTrack()->GetDefinition()->GetPDGEncoding();
+  record.fEnergy = (float)(prePoint->GetKineticEnergy()/MeV);
+  record.fX      = (float)(position.x()/mm);
+  record.fY      = (float)(position.y()/mm);
+  record.fU      = (float)direction.x();
+  record.fV      = (float)direction.y();
+  record.fW      = (float)direction.z();
+  record.fWeight = (float)prePoint->GetWeight();
+  record.fHistory
+    = G4EventManager::GetEventManager()->GetConstCurrentEvent()->GetEventID();
+
+  if (!threadBuffer) {
+    threadBuffer = new std::vector<B1PhaseSpaceRecord>;
+    threadBuffer->reserve(phaseSpaceBufferSize);
+  }
+  threadBuffer->push_back(record);
+  if (threadBuffer->size() >= phaseSpaceBufferSize) Flush();
+
+  if (fKillAtPlane) step->GetTrack()->SetTrackStatus(fStopAndKill);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PhaseSpaceWriter::Flush()
+{
+  if (!threadBuffer || threadBuffer->empty()) return;
+
+  G4AutoLock lock(&phaseSpaceMutex);
+  if (fFile) {
+    fwrite(&(*threadBuffer)[0], sizeof(B1PhaseSpaceRecord),
+           threadBuffer->size(), fFile);
+    fRecords += threadBuffer->size();
+  }
+  threadBuffer->clear();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PhaseSpaceWriter::BeginOfRun()
+{
+  if (!fActive) return;
+
+  G4AutoLock lock(&phaseSpaceMutex);
+  if (fFile) fclose(fFile);
+  fFile = fopen(fFileName.c_str(), "wb");
+  fRecords = 0;
+  if (!fFile) {
+    G4ExceptionDescription msg;
+    msg << "Cannot open phase-space file " << fFileName << " for writing.";
+    G4Exception("B1PhaseSpaceWriter::BeginOfRun()",
+                "MyCode0006", JustWarning, msg);
+    return;
+  }
+
+  // placeholder, completed in EndOfRun()
+  B1PhaseSpaceHeader header;
+  std::memset(&header, 0, sizeof(header));
+  fwrite(&header, sizeof(header), 1, fFile);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PhaseSpaceWriter::EndOfRun(G4bool isMaster, G4int nofHistories)
+{
+  Flush();
+  if (!isMaster) {
+    delete threadBuffer;
+    threadBuffer = 0;
+    return;
+  }
+
+  G4AutoLock lock(&phaseSpaceMutex);
+  if (!fFile) return;
+
+  B1PhaseSpaceHeader header;
+  std::memcpy(header.fMagic, phaseSpaceMagic, sizeof(header.fMagic));
+  header.fRecords   = fRecords;
+  header.fHistories = (uint64_t)nofHistories;
+  header.fPlaneZ    = fPlaneZ/mm;
+  fseek(fFile, 0, SEEK_SET);
+  fwrite(&header, sizeof(header), 1, fFile);
+  fclose(fFile);
+  fFile = 0;
+
+  G4cout << "Phase space: " << fRecords << " particles crossing z = "
+         << fPlaneZ/cm << " cm from " << nofHistories
+         << " histories written to " << fFileName << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PhaseSpaceWriter::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/phaseSpace/",
+                                      "Phase-space recording");
+
+  // the writer is shared by all threads, the commands act on the master
+  G4GenericMessenger::Command& recordCmd
+    = fMessenger->DeclareMethod("record", &B1PhaseSpaceWriter::SetFileName,
+        "Record particles crossing the plane into the given file "
+        "(none to stop recording).");
+  recordCmd.SetParameterName("fileName", false);
+  recordCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& planeCmd
+    = fMessenger->DeclarePropertyWithUnit("plane", "cm", fPlaneZ,
+        "Position z of the phase-space plane.");
+  planeCmd.SetParameterName("z", false);
+  planeCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& killCmd
+    = fMessenger->DeclareProperty("killAtPlane", fKillAtPlane,
+        "Stop the particles once they are recorded.");
+  killCmd.SetParameterName("flag", true);
+  killCmd.SetDefaultValue("true");
+  killCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+const B1PhaseSpaceReader* B1PhaseSpaceReader::GetShared(const G4String& fileName)
+{
+  G4AutoLock lock(&phaseSpaceMutex);
+
+  struct stat status;
+  if (stat(fileName.c_str(), &status) != 0) return 0;
+
+  std::map<G4String, PhaseSpaceFile>::iterator it
+    = phaseSpaceRegistry.fFiles.find(fileName);
+  if (it != phaseSpaceRegistry.fFiles.end()) {
+    if (it->second.fSize == status.st_size &&
+        it->second.fModified == status.st_mtime) return it->second.fReader;
+  }
+
+  B1PhaseSpaceReader* reader = new B1PhaseSpaceReader(fileName);
+  if (!reader->IsValid()) {
+    delete reader;
+    return 0;
+  }
+  if (it != phaseSpaceRegistry.fFiles.end()) {
+    phaseSpaceRegistry.fRetired.push_back(it->second.fReader);
+  }
+  PhaseSpaceFile file = { reader, status.st_size, status.st_mtime };
+  phaseSpaceRegistry.fFiles[fileName] = file;
+  return reader;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1PhaseSpaceReader::B1PhaseSpaceReader(const G4String& fileName)
+: fFileName(fileName),
+  fHistories(0),
+  fPlaneZ(0.)
+{
+  FILE* input = fopen(fileName.c_str(), "rb");
+  B1PhaseSpaceHeader header;
+  if (!input || fread(&header, sizeof(header), 1, input) != 1
+      || std::memcmp(header.fMagic, phaseSpaceMagic, sizeof(header.fMagic))) {
+    G4ExceptionDescription msg;
+    msg << "Cannot read phase-space file " << fileName;
+    G4Exception("B1PhaseSpaceReader::B1PhaseSpaceReader()",
+                "MyCode0006", JustWarning, msg);
+    if (input) fclose(input);
+    return;
+  }
+
+  fRecords.resize(header.fRecords);
+  size_t nofRead = header.fRecords
+    ? fread(&fRecords[0], sizeof(B1PhaseSpaceRecord), fRecords.size(), input) : 0;
+  fclose(input);
+  if (nofRead != fRecords.size()) {
+    G4ExceptionDescription msg;
+    msg << "Phase-space file " << fileName << " is truncated, "
+        << nofRead << " of " << fRecords.size() << " records read.";
+    G4Exception("B1PhaseSpaceReader::B1PhaseSpaceReader()",
+                "MyCode0006", JustWarning, msg);
+    fRecords.resize(nofRead);
+  }
+  fHistories = header.fHistories;
+  fPlaneZ = header.fPlaneZ*mm;
+
+  // the threads append their buffers in any order, the particles of one
+  // history are brought together, keeping their order
+  std::stable_sort(fRecords.begin(), fRecords.end(), EarlierHistory);
+  for (size_t i = 0; i < fRecords.size(); i++) {
+    if (i == 0 || fRecords[i].fHistory != fRecords[i-1].fHistory) {
+      fHistoryStarts.push_back((G4int)i);
+    }
+  }
+  fHistoryStarts.push_back((G4int)fRecords.size());
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1PhaseSpaceReader::~B1PhaseSpaceReader()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
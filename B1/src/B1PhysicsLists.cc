@@ -0,0 +1,86 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1PhysicsLists.cc
+/// \brief Implementation of the B1PhysicsLists class
+
+#include "B1PhysicsLists.hh"
+#include "B1AdjointScan.hh"
+
+#include "G4VModularPhysicsList.hh"
+#include "G4PhysListFactory.hh"
+#include "G4EmStandardPhysics.hh"
+#include "G4EmStandardPhysics_option1.hh"
+#include "G4EmStandardPhysics_option2.hh"
+#include "G4EmStandardPhysics_option3.hh"
+#include "G4EmStandardPhysics_option4.hh"
+#include "G4EmLivermorePhysics.hh"
+#include "G4EmPenelopePhysics.hh"
+#include "QBBC.hh"
+
+#include <cstdlib>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String B1PhysicsLists::GetSelectedName()
+{
+  const char* name = std::getenv("PHYSLIST");
+  return (name && *name) ? G4String(name) : G4String("QBBC");
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4VModularPhysicsList* B1PhysicsLists::Create(const G4String& name)
+{
+  G4VPhysicsConstructor* em = 0;
+  if (name == "emstandard") em = new G4EmStandardPhysics;
+  else if (name == "emstandard_opt1") em = new G4EmStandardPhysics_option1;
+  else if (name == "emstandard_opt2") em = new G4EmStandardPhysics_option2;
+  else if (name == "emstandard_opt3") em = new G4EmStandardPhysics_option3;
+  else if (name == "emstandard_opt4") em = new G4EmStandardPhysics_option4;
+  else if (name == "livermore") em = new G4EmLivermorePhysics;
+  else if (name == "penelope") em = new G4EmPenelopePhysics;
+  else if (name == "adjoint") em = new B1AdjointPhysics;
+  if (em) {
+    G4VModularPhysicsList* physicsList = new G4VModularPhysicsList;
+    physicsList->RegisterPhysics(em);
+    return physicsList;
+  }
+
+  if (name != "QBBC") {
+    G4PhysListFactory factory;
+    if (factory.IsReferencePhysList(name)) {
+      return factory.GetReferencePhysList(name);
+    }
+    G4ExceptionDescription msg;
+    msg << "Unknown physics list " << name << ", QBBC is used.";
+    G4Exception("B1PhysicsLists::Create()", "MyCode0019", JustWarning, msg);
+  }
+  return new QBBC;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -29,25 +29,55 @@
 /// \brief Implementation of the B1PrimaryGeneratorAction class
 
 #include "B1PrimaryGeneratorAction.hh"
+#include "B1EnergySpectrum.hh"
+#include "B1PhaseSpace.hh"
+#include "B1ResponseKernel.hh"
+#include "B1EnergyResponse.hh"
+#include "B1QuasiRandom.hh"
+#include "B1CorrelatedSampling.hh"
+#include "B1EventInformation.hh"
+#include "B1UncollidedDose.hh"
+#include "B1Run.hh"
 
 #include "G4LogicalVolumeStore.hh"
 #include "G4LogicalVolume.hh"
 #include "G4Box.hh"
 #include "G4RunManager.hh"
 #include "G4ParticleGun.hh"
+#include "G4PrimaryVertex.hh"
+#include "G4PrimaryParticle.hh"
+#include "G4Event.hh"
 #include "G4ParticleTable.hh"
 #include "G4ParticleDefinition.hh"
+#include "G4Gamma.hh"
+#include "G4GenericMessenger.hh"
+#include "G4UnitsTable.hh"
 #include "G4SystemOfUnits.hh"
+#include "G4PhysicalConstants.hh"
 #include "Randomize.hh"
 
 #include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <sstream>
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 B1PrimaryGeneratorAction::B1PrimaryGeneratorAction()
 : G4VUserPrimaryGeneratorAction(),
   fParticleGun(0), 
-  fEnvelopeBox(0)
+  fEnvelopeBox(0),
+  fMessenger(0),
+  fSpectrumType("histogram"),
+  fSpectrum(0),
+  fMonoEnergy(0.),
+  fDivergence(0.),
+  fDiverged(false),
+  fPhaseSpace(0),
+  fRecycle(1),
+  fSourceMessenger(0),
+  fGunParticle(0),
+  fGunEnergy(0.)
 {
   G4int n_particle = 1;
   fParticleGun  = new G4ParticleGun(n_particle);
@@ -61,6 +91,8 @@ B1PrimaryGeneratorAction::B1PrimaryGeneratorAction()
   fParticleGun->SetParticleMomentumDirection(G4ThreeVector(0.,0.,1.));
   //Change particle default energy here
   fParticleGun->SetParticleEnergy(6.0*MeV);
+
+  DefineCommands();
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -68,6 +100,8 @@ B1PrimaryGeneratorAction::B1PrimaryGeneratorAction()
 B1PrimaryGeneratorAction::~B1PrimaryGeneratorAction()
 {
   delete fParticleGun;
+  delete fMessenger;
+  delete fSourceMessenger;
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -77,6 +111,15 @@ void B1PrimaryGeneratorAction::GeneratePrimaries(G4Event* anEvent)
   //this function is called at the begining of ecah event
   //
 
+  // same random numbers for the same primary in every configuration
+  B1CorrelatedSampling* correlated = B1CorrelatedSampling::Instance();
+  if (correlated->IsActive()) correlated->SeedEvent(anEvent->GetEventID());
+
+  if (fPhaseSpace) {
+    GeneratePhaseSpacePrimaries(anEvent);
+    return;
+  }
+
   // In order to avoid dependence of PrimaryGeneratorAction
   // on DetectorConstruction class we get Envelope volume
   // from G4LogicalVolumeStore.
@@ -104,23 +147,421 @@ void B1PrimaryGeneratorAction::GeneratePrimaries(G4Event* anEvent)
      "MyCode0002",JustWarning,msg);
   }
 
-  float X0_Pos, X0_Area;
-  float Y0_Pos, Y0_Area;
+  G4double x0, y0;
+  G4double z0 = -0.5 * envSizeZ;
 
-  FILE* parameters_file = fopen("GunPositionParameters.txt", "r");
+  // uniform numbers of the primary, from the quasi-random point of the
+  // event if so selected
+  B1QuasiRandom* quasiRandom = B1QuasiRandom::Instance();
+  G4bool quasi = quasiRandom->IsActive();
+  G4double u[B1QuasiRandom::kDimensions];
+  if (quasi) quasiRandom->GetPoint(anEvent->GetEventID(), u);
 
-  fscanf(parameters_file, "%f%f%f%f", &X0_Pos, &X0_Area, &Y0_Pos, &Y0_Area);
-  fflush(parameters_file);
+  // component of a mixed field
+  B1EventInformation* info = 0;
+  const SourceComponent* component = 0;
+  if (!fComponents.empty()) {
+    G4int index = fComponentTable.Sample(G4UniformRand());
+    component = &fComponents[index];
+    info = new B1EventInformation;
+    info->SetSourceComponent(index);
+    anEvent->SetUserInformation(info);
+    fParticleGun->SetParticleDefinition(component->fParticle);
+  }
 
-  G4double x0 = X0_Pos*cm + X0_Area*cm * (G4UniformRand()-0.5);
-  G4double y0 = Y0_Pos*cm + Y0_Area*cm * (G4UniformRand()-0.5);
-  G4double z0 = -0.5 * envSizeZ;
-  
-  fclose(parameters_file);
+  B1ResponseKernel* kernel = B1ResponseKernel::Instance();
+  if (kernel->GetMode() != B1ResponseKernel::kOff) {
+    // pencil beams of the response kernel
+    if (!info) {
+      info = new B1EventInformation;
+      anEvent->SetUserInformation(info);
+    }
+    info->SetBeamIndex(kernel->SamplePixel(anEvent->GetEventID(), x0, y0));
+  }
+  else if (component && component->fHasSpot) {
+    G4double ux = quasi ? u[B1QuasiRandom::kX] : G4UniformRand();
+    G4double uy = quasi ? u[B1QuasiRandom::kY] : G4UniformRand();
+    x0 = component->fX + component->fWidthX * (ux-0.5);
+    y0 = component->fY + component->fWidthY * (uy-0.5);
+  }
+  else {
+    float X0_Pos, X0_Area;
+    float Y0_Pos, Y0_Area;
+
+    FILE* parameters_file = fopen("GunPositionParameters.txt", "r");
+
+    fscanf(parameters_file, "%f%f%f%f", &X0_Pos, &X0_Area, &Y0_Pos, &Y0_Area);
+    fflush(parameters_file);
+
+    G4double ux = quasi ? u[B1QuasiRandom::kX] : G4UniformRand();
+    G4double uy = quasi ? u[B1QuasiRandom::kY] : G4UniformRand();
+    x0 = X0_Pos*cm + X0_Area*cm * (ux-0.5);
+    y0 = Y0_Pos*cm + Y0_Area*cm * (uy-0.5);
+
+    fclose(parameters_file);
+  }
 
   fParticleGun->SetParticlePosition(G4ThreeVector(x0,y0,z0));
 
+  const B1EnergySpectrum* spectrum
+    = component ? component->fSpectrum : fSpectrum;
+  if (spectrum) {
+    fParticleGun->SetParticleEnergy(quasi
+      ? spectrum->Sample(u[B1QuasiRandom::kEnergyBin],
+                         u[B1QuasiRandom::kEnergy])
+      : spectrum->Sample());
+  }
+  else if (component) fParticleGun->SetParticleEnergy(component->fEnergy);
+
+  // uniform in solid angle within the divergence cone around +z
+  if (fDivergence > 0.) {
+    G4double uTheta = quasi ? u[B1QuasiRandom::kCosTheta] : G4UniformRand();
+    G4double uPhi = quasi ? u[B1QuasiRandom::kPhi] : G4UniformRand();
+    G4double cosTheta = 1. - uTheta*(1. - std::cos(fDivergence));
+    G4double sinTheta = std::sqrt(1. - cosTheta*cosTheta);
+    G4double phi = twopi*uPhi;
+    fParticleGun->SetParticleMomentumDirection(
+      G4ThreeVector(sinTheta*std::cos(phi), sinTheta*std::sin(phi), cosTheta));
+    fDiverged = true;
+  }
+  else if (fDiverged) {
+    fParticleGun->SetParticleMomentumDirection(G4ThreeVector(0.,0.,1.));
+    fDiverged = false;
+  }
+
+  B1EnergyResponse* response = B1EnergyResponse::Instance();
+  if (kernel->GetMode() == B1ResponseKernel::kOff && !component
+      && !response->IsActive()
+      && B1UncollidedDose::Instance()->UseControlVariate()) {
+    AttachControlVariate(anEvent);
+  }
+
   fParticleGun->GeneratePrimaryVertex(anEvent);
+
+  // incident energy bins of the response run, the gun energy is kept
+  if (response->IsActive()) {
+    if (!info) {
+      info = new B1EventInformation;
+      anEvent->SetUserInformation(info);
+    }
+    G4int bin;
+    G4double energy = response->SampleEnergy(anEvent->GetEventID(), bin);
+    anEvent->GetPrimaryVertex()->GetPrimary()->SetKineticEnergy(energy);
+    info->SetEnergyBin(bin);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PrimaryGeneratorAction::AttachControlVariate(G4Event* anEvent)
+{
+  if (fParticleGun->GetParticleDefinition() != G4Gamma::Gamma()) return;
+
+  B1UncollidedDose* uncollided = B1UncollidedDose::Instance();
+  B1Run* run
+    = static_cast<B1Run*>(G4RunManager::GetRunManager()->GetNonConstCurrentRun());
+
+  // expectation of the control variate, once per run
+  if (!run->HasControlVariate()) {
+    B1BeamSpot spot;
+    if (!B1UncollidedDose::ReadBeamSpot(spot)) return;
+    std::vector<G4double> energies, probabilities, expected;
+    if (fSpectrum) fSpectrum->GetQuadrature(energies, probabilities);
+    else {
+      energies.push_back(fParticleGun->GetParticleEnergy());
+      probabilities.push_back(1.);
+    }
+    uncollided->ComputeExpectedDeposits(spot, energies, probabilities, expected);
+    run->EnableControlVariate(expected);
+  }
+
+  B1EventInformation* info = new B1EventInformation;
+  uncollided->ComputeDeposits(fParticleGun->GetParticlePosition(),
+                              fParticleGun->GetParticleEnergy(),
+                              info->GetUncollidedDeposits());
+  anEvent->SetUserInformation(info);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PrimaryGeneratorAction::SetSpectrum(G4String fileName)
+{
+  if (fileName == "none" || fileName.empty()) {
+    if (fSpectrum) fParticleGun->SetParticleEnergy(fMonoEnergy);
+    fSpectrum = 0;
+    return;
+  }
+  if (!fSpectrum) fMonoEnergy = fParticleGun->GetParticleEnergy();
+  B1EnergySpectrum::Type type = (fSpectrumType == "discrete")
+    ? B1EnergySpectrum::kDiscrete : B1EnergySpectrum::kHistogram;
+  fSpectrum = B1EnergySpectrum::GetShared(fileName, type);
+  if (!fSpectrum) {
+    G4ExceptionDescription msg;
+    msg << "Spectrum " << fileName << " not loaded, keeping the gun energy.";
+    G4Exception("B1PrimaryGeneratorAction::SetSpectrum()",
+                "MyCode0005", JustWarning, msg);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PrimaryGeneratorAction::GeneratePhaseSpacePrimaries(G4Event* anEvent)
+{
+  // the event number selects the history, independently of the thread;
+  // the histories past the recorded ones had no particle at the plane
+  G4int nofRecorded = fPhaseSpace->GetNumberOfRecordedHistories();
+  G4double nofHistories
+    = std::max(fPhaseSpace->GetNumberOfHistories(), (G4double)nofRecorded);
+  G4int history
+    = (G4int)std::fmod((G4double)anEvent->GetEventID(), nofHistories);
+  if (history >= nofRecorded) return;
+
+  for (G4int r = fPhaseSpace->GetHistoryBegin(history);
+       r < fPhaseSpace->GetHistoryEnd(history); r++) {
+    const B1PhaseSpaceRecord& record = fPhaseSpace->GetRecord(r);
+    G4ParticleDefinition* particle
+      = G4ParticleTable::GetParticleTable()->FindParticle(record.fPDG);
+    if (!particle) {
+      G4ExceptionDescription msg;
+      msg << "Unknown particle " << record.fPDG << " in phase space, "
+          << "skipped in event " << anEvent->GetEventID() << ".";
+      G4Exception("B1PrimaryGeneratorAction::GeneratePhaseSpacePrimaries()",
+                  "MyCode0007", JustWarning, msg);
+      continue;
+    }
+
+    G4PrimaryVertex* vertex
+      = new G4PrimaryVertex(record.fX*mm, record.fY*mm,
+                            fPhaseSpace->GetPlaneZ(), 0.);
+    G4ThreeVector direction(record.fU, record.fV, record.fW);
+    for (G4int i = 0; i < fRecycle; i++) {
+      G4PrimaryParticle* primary = new G4PrimaryParticle(particle);
+      primary->SetKineticEnergy(record.fEnergy*MeV);
+      primary->SetMomentumDirection(direction.unit());
+      primary->SetWeight(record.fWeight / fRecycle);
+      vertex->SetPrimary(primary);
+    }
+    anEvent->AddPrimaryVertex(vertex);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PrimaryGeneratorAction::SetPhaseSpace(G4String fileName)
+{
+  if (fileName == "none" || fileName.empty()) {
+    fPhaseSpace = 0;
+    return;
+  }
+  fPhaseSpace = B1PhaseSpaceReader::GetShared(fileName);
+  if (!fPhaseSpace) {
+    G4ExceptionDescription msg;
+    msg << "Phase space " << fileName << " not loaded, keeping the gun.";
+    G4Exception("B1PrimaryGeneratorAction::SetPhaseSpace()",
+                "MyCode0007", JustWarning, msg);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+std::vector<G4String> B1PrimaryGeneratorAction::GetComponentNames() const
+{
+  std::vector<G4String> names;
+  for (size_t i = 0; i < fComponents.size(); i++) {
+    const SourceComponent& component = fComponents[i];
+    std::ostringstream name;
+    name << component.fParticle->GetParticleName() << " ";
+    if (component.fSpectrum) name << component.fSpectrum->GetFileName();
+    else name << G4BestUnit(component.fEnergy, "Energy");
+    names.push_back(name.str());
+  }
+  return names;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PrimaryGeneratorAction::AddComponent(G4String definition)
+{
+  std::istringstream input(definition);
+  G4String particleName;
+  G4double intensity = 1.;
+  input >> particleName >> intensity;
+  G4ParticleDefinition* particle
+    = G4ParticleTable::GetParticleTable()->FindParticle(particleName);
+  if (!particle || intensity <= 0.) {
+    G4ExceptionDescription msg;
+    msg << "Source component \"" << definition << "\" not added: "
+        << (particle ? "intensity must be positive." : "unknown particle.");
+    G4Exception("B1PrimaryGeneratorAction::AddComponent()",
+                "MyCode0014", JustWarning, msg);
+    return;
+  }
+
+  // the gun is driven by the components until they are cleared
+  if (fComponents.empty()) {
+    fGunParticle = fParticleGun->GetParticleDefinition();
+    fGunEnergy = fParticleGun->GetParticleEnergy();
+  }
+
+  // starts from the current gun settings
+  SourceComponent component;
+  component.fParticle  = particle;
+  component.fIntensity = intensity;
+  component.fEnergy    = fSpectrum ? fMonoEnergy : fGunEnergy;
+  component.fSpectrum  = 0;
+  component.fHasSpot   = false;
+  component.fX = component.fWidthX = component.fY = component.fWidthY = 0.;
+  fComponents.push_back(component);
+
+  std::vector<G4double> intensities;
+  for (size_t i = 0; i < fComponents.size(); i++) {
+    intensities.push_back(fComponents[i].fIntensity);
+  }
+  fComponentTable.Build(intensities);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PrimaryGeneratorAction::SetComponentEnergy(G4double energy)
+{
+  if (fComponents.empty()) {
+    G4Exception("B1PrimaryGeneratorAction::SetComponentEnergy()",
+                "MyCode0014", JustWarning, "No source component added yet.");
+    return;
+  }
+  fComponents.back().fEnergy = energy;
+  fComponents.back().fSpectrum = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PrimaryGeneratorAction::SetComponentSpectrum(G4String fileName)
+{
+  if (fComponents.empty()) {
+    G4Exception("B1PrimaryGeneratorAction::SetComponentSpectrum()",
+                "MyCode0014", JustWarning, "No source component added yet.");
+    return;
+  }
+  B1EnergySpectrum::Type type = (fSpectrumType == "discrete")
+    ? B1EnergySpectrum::kDiscrete : B1EnergySpectrum::kHistogram;
+  const B1EnergySpectrum* spectrum
+    = B1EnergySpectrum::GetShared(fileName, type);
+  if (!spectrum) {
+    G4ExceptionDescription msg;
+    msg << "Spectrum " << fileName << " not loaded, keeping the energy of "
+        << "the source component.";
+    G4Exception("B1PrimaryGeneratorAction::SetComponentSpectrum()",
+                "MyCode0014", JustWarning, msg);
+    return;
+  }
+  fComponents.back().fSpectrum = spectrum;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PrimaryGeneratorAction::SetComponentSpot(G4String spot)
+{
+  std::istringstream input(spot);
+  G4double x, widthX, y, widthY;
+  if (fComponents.empty() || !(input >> x >> widthX >> y >> widthY)) {
+    G4ExceptionDescription msg;
+    msg << "Beam spot \"" << spot << "\" not set, expected a source "
+        << "component and: x widthX y widthY (cm).";
+    G4Exception("B1PrimaryGeneratorAction::SetComponentSpot()",
+                "MyCode0014", JustWarning, msg);
+    return;
+  }
+  SourceComponent& component = fComponents.back();
+  component.fHasSpot = true;
+  component.fX      = x*cm;
+  component.fWidthX = widthX*cm;
+  component.fY      = y*cm;
+  component.fWidthY = widthY*cm;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PrimaryGeneratorAction::ClearComponents()
+{
+  if (fComponents.empty()) return;
+  fComponents.clear();
+  fParticleGun->SetParticleDefinition(fGunParticle);
+  fParticleGun->SetParticleEnergy(fGunEnergy);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PrimaryGeneratorAction::DefineCommands()
+{
+  fMessenger
+    = new G4GenericMessenger(this, "/B1/gun/", "Primary source control");
+
+  G4GenericMessenger::Command& typeCmd
+    = fMessenger->DeclareProperty("spectrumType", fSpectrumType,
+        "Interpretation of the next spectrum file.");
+  typeCmd.SetParameterName("type", false);
+  typeCmd.SetCandidates("histogram discrete");
+
+  G4GenericMessenger::Command& spectrumCmd
+    = fMessenger->DeclareMethod("spectrum",
+        &B1PrimaryGeneratorAction::SetSpectrum,
+        "Sample the primary energy from a tabulated spectrum file "
+        "(columns: energy in MeV, weight); none restores the gun energy.");
+  spectrumCmd.SetParameterName("fileName", false);
+
+  G4GenericMessenger::Command& divergenceCmd
+    = fMessenger->DeclarePropertyWithUnit("divergence", "deg", fDivergence,
+        "Half-angle of the cone the primary direction is spread into.");
+  divergenceCmd.SetParameterName("angle", false);
+  divergenceCmd.SetRange("angle>=0.");
+
+  G4GenericMessenger::Command& phaseSpaceCmd
+    = fMessenger->DeclareMethod("phaseSpace",
+        &B1PrimaryGeneratorAction::SetPhaseSpace,
+        "Replay primaries from a recorded phase-space file "
+        "(none restores the gun).");
+  phaseSpaceCmd.SetParameterName("fileName", false);
+
+  G4GenericMessenger::Command& recycleCmd
+    = fMessenger->DeclareProperty("recycle", fRecycle,
+        "Number of copies of each phase-space particle, "
+        "with weight divided accordingly.");
+  recycleCmd.SetParameterName("copies", false);
+  recycleCmd.SetRange("copies>=1");
+
+  fSourceMessenger
+    = new G4GenericMessenger(this, "/B1/source/", "Mixed-field source");
+
+  G4GenericMessenger::Command& addCmd
+    = fSourceMessenger->DeclareMethod("add",
+        &B1PrimaryGeneratorAction::AddComponent,
+        "Add a source component: particle and relative intensity. It "
+        "starts with the gun energy and the spot of GunPositionParameters.txt.");
+  addCmd.SetParameterName("component", false);
+
+  G4GenericMessenger::Command& energyCmd
+    = fSourceMessenger->DeclareMethodWithUnit("energy", "MeV",
+        &B1PrimaryGeneratorAction::SetComponentEnergy,
+        "Energy of the last source component.");
+  energyCmd.SetParameterName("energy", false);
+  energyCmd.SetRange("energy>0.");
+
+  G4GenericMessenger::Command& componentSpectrumCmd
+    = fSourceMessenger->DeclareMethod("spectrum",
+        &B1PrimaryGeneratorAction::SetComponentSpectrum,
+        "Spectrum file of the last source component "
+        "(interpreted as set by /B1/gun/spectrumType).");
+  componentSpectrumCmd.SetParameterName("fileName", false);
+
+  G4GenericMessenger::Command& spotCmd
+    = fSourceMessenger->DeclareMethod("spot",
+        &B1PrimaryGeneratorAction::SetComponentSpot,
+        "Beam spot of the last source component: x widthX y widthY in cm.");
+  spotCmd.SetParameterName("spot", false);
+
+  fSourceMessenger->DeclareMethod("clear",
+    &B1PrimaryGeneratorAction::ClearComponents,
+    "Remove all source components, back to the single gun.");
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,114 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1PulseHeightSpectra.cc
+/// \brief Implementation of the B1PulseHeightSpectra class
+
+#include "B1PulseHeightSpectra.hh"
+
+#include "G4SystemOfUnits.hh"
+
+#include <cstdio>
+
+#include <stdint.h>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1PulseHeightSpectra::B1PulseHeightSpectra(G4int nofDetectors, G4int nofBins,
+                                           G4double eMin, G4double eMax,
+                                           G4bool logBinning)
+: fNofDetectors(nofDetectors),
+  fNofBins(nofBins > 0 ? nofBins : 1),
+  fEMin(eMin),
+  fEMax(eMax),
+  fLogBinning(logBinning && eMin > 0.),
+  fOffset(0.),
+  fScale(0.),
+  fCounts(nofDetectors*(fNofBins+2), 0.)
+{
+  if (fLogBinning) {
+    fOffset = std::log(fEMin);
+    fScale  = fNofBins / (std::log(fEMax) - std::log(fEMin));
+  }
+  else {
+    fOffset = fEMin;
+    fScale  = fNofBins / (fEMax - fEMin);
+  }
+  if (logBinning && !fLogBinning) {
+    G4Exception("B1PulseHeightSpectra::B1PulseHeightSpectra()",
+                "MyCode0008", JustWarning,
+                "Logarithmic binning needs a positive lower edge, "
+                "using linear bins.");
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1PulseHeightSpectra::~B1PulseHeightSpectra()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PulseHeightSpectra::Merge(const B1PulseHeightSpectra& other)
+{
+  if (other.fCounts.size() != fCounts.size()) return;
+  for (size_t i = 0; i < fCounts.size(); i++) fCounts[i] += other.fCounts[i];
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1PulseHeightSpectra::Reset()
+{
+  fCounts.assign(fCounts.size(), 0.);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B1PulseHeightSpectra::Write(const G4String& fileName,
+                                   G4double nofEvents) const
+{
+  FILE* output = fopen(fileName.c_str(), "wb");
+  if (!output) {
+    G4ExceptionDescription msg;
+    msg << "Cannot open pulse-height file " << fileName << " for writing.";
+    G4Exception("B1PulseHeightSpectra::Write()",
+                "MyCode0008", JustWarning, msg);
+    return false;
+  }
+
+  const char magic[8] = { 'B','1','P','H','S','0','0','1' };
+  int32_t sizes[3] = { fNofDetectors, fNofBins, fLogBinning ? 1 : 0 };
+  double range[3] = { fEMin/MeV, fEMax/MeV, nofEvents };
+  fwrite(magic, sizeof(magic), 1, output);
+  fwrite(sizes, sizeof(sizes), 1, output);
+  fwrite(range, sizeof(range), 1, output);
+  fwrite(&fCounts[0], sizeof(G4double), fCounts.size(), output);
+  fclose(output);
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,324 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1QuasiRandom.cc
+/// \brief Implementation of the B1QuasiRandom class
+
+#include "B1QuasiRandom.hh"
+#include "B1Run.hh"
+
+#include "G4RunManager.hh"
+#include "G4GenericMessenger.hh"
+#include "Randomize.hh"
+
+#include <cmath>
+#include <iomanip>
+
+namespace
+{
+  const uint32_t haltonBases[B1QuasiRandom::kDimensions]
+    = { 2, 3, 5, 7, 11, 13 };
+
+  // primitive polynomials (degree, coefficients) and initial direction
+  // numbers of the Sobol dimensions after the first (Joe and Kuo)
+  struct SobolPolynomial
+  {
+    G4int    fDegree;
+    uint32_t fCoefficients;
+    uint32_t fM[4];
+  };
+  const SobolPolynomial sobolPolynomials[B1QuasiRandom::kDimensions - 1] = {
+    { 1, 0, { 1, 0, 0, 0 } },
+    { 2, 1, { 1, 3, 0, 0 } },
+    { 3, 1, { 1, 3, 1, 0 } },
+    { 3, 2, { 1, 1, 1, 0 } },
+    { 4, 1, { 1, 1, 3, 3 } } };
+
+  // mean and variance of the mean over the replicates, for one detector
+  void ReplicateStatistics(const std::vector<std::vector<G4double> >& replicates,
+                           G4int detector, G4double& mean, G4double& variance)
+  {
+    G4double n = replicates.size(), sum = 0., sum2 = 0.;
+    for (size_t r = 0; r < replicates.size(); r++) {
+      sum  += replicates[r][detector];
+      sum2 += replicates[r][detector]*replicates[r][detector];
+    }
+    mean = (n > 0.) ? sum/n : 0.;
+    variance = (n > 1.) ? (sum2 - sum*sum/n) / (n - 1.) / n : 0.;
+    if (variance < 0.) variance = 0.;
+  }
+}
+
+B1QuasiRandom* B1QuasiRandom::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1QuasiRandom* B1QuasiRandom::Instance()
+{
+  if (!fgInstance) fgInstance = new B1QuasiRandom;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1QuasiRandom::B1QuasiRandom()
+: fMessenger(0),
+  fSampling("pseudo"),
+  fNofStrata(16),
+  fEnergy(true),
+  fDirection(true),
+  fNofReplicates(10),
+  fComparing(false),
+  fComparedSampling(0)
+{
+  // direction numbers: van der Corput in base 2 for the first dimension,
+  // then the recurrence of the primitive polynomial
+  for (G4int k = 0; k < 32; k++) fDirections[0][k] = 1u << (31 - k);
+  for (G4int d = 1; d < kDimensions; d++) {
+    const SobolPolynomial& polynomial = sobolPolynomials[d - 1];
+    G4int s = polynomial.fDegree;
+    uint32_t* v = fDirections[d];
+    for (G4int k = 0; k < 32; k++) {
+      if (k < s) {
+        v[k] = polynomial.fM[k] << (31 - k);
+        continue;
+      }
+      v[k] = v[k - s] ^ (v[k - s] >> s);
+      for (G4int i = 1; i < s; i++) {
+        if ((polynomial.fCoefficients >> (s - 1 - i)) & 1u) v[k] ^= v[k - i];
+      }
+    }
+  }
+  for (G4int d = 0; d < kDimensions; d++) {
+    fShift[d] = 0.;
+    fDigitalShift[d] = 0;
+  }
+
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1QuasiRandom::~B1QuasiRandom()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B1QuasiRandom::RadicalInverse(uint32_t n, uint32_t base)
+{
+  G4double inverse = 1./base, factor = inverse, result = 0.;
+  while (n > 0) {
+    result += (n % base)*factor;
+    n /= base;
+    factor *= inverse;
+  }
+  return result;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+uint32_t B1QuasiRandom::Sobol(G4int dimension, uint32_t n) const
+{
+  uint32_t x = 0;
+  for (G4int k = 0; n; n >>= 1, k++) {
+    if (n & 1u) x ^= fDirections[dimension][k];
+  }
+  return x;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1QuasiRandom::GetPoint(G4int eventID, G4double* u) const
+{
+  if (fSampling == "stratified") {
+    G4int cell = eventID % (fNofStrata*fNofStrata);
+    u[kX] = (cell % fNofStrata + G4UniformRand()) / fNofStrata;
+    u[kY] = (cell / fNofStrata + G4UniformRand()) / fNofStrata;
+    for (G4int d = kEnergyBin; d < kDimensions; d++) u[d] = G4UniformRand();
+    return;
+  }
+
+  uint32_t n = (uint32_t)eventID;
+  for (G4int d = 0; d < kDimensions; d++) {
+    G4bool quasi = (d < kEnergyBin) || (d < kCosTheta ? fEnergy : fDirection);
+    if (!quasi) u[d] = G4UniformRand();
+    else if (fSampling == "halton") {
+      u[d] = RadicalInverse(n, haltonBases[d]) + fShift[d];
+      if (u[d] >= 1.) u[d] -= 1.;
+    }
+    else {
+      // midpoint of the 2^-32 cell, never 0 or 1
+      u[d] = ((Sobol(d, n) ^ fDigitalShift[d]) + 0.5) / 4294967296.;
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1QuasiRandom::BeginOfRun()
+{
+  // pseudo-random runs keep the random sequence they had without it
+  if (!IsActive()) return;
+
+  for (G4int d = 0; d < kDimensions; d++) {
+    fShift[d] = G4UniformRand();
+    fDigitalShift[d] = (uint32_t)(G4UniformRand()*4294967296.);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1QuasiRandom::Compare(G4int nofEvents)
+{
+  if (!IsActive()) {
+    G4Exception("B1QuasiRandom::Compare()", "MyCode0022", JustWarning,
+                "Select a stratified or quasi-random sampling to compare "
+                "with first, no run.");
+    return;
+  }
+
+  G4cout << "Sampling comparison: " << fNofReplicates << " replicates of "
+         << nofEvents << " events, pseudo-random and " << fSampling << G4endl;
+
+  G4String sampling = fSampling;
+  fComparing = true;
+  for (G4int s = 0; s < 2; s++) {
+    fComparedSampling = s;
+    fReplicates[s].clear();
+    fSampling = (s == 0) ? G4String("pseudo") : sampling;
+    for (G4int r = 0; r < fNofReplicates; r++) {
+      G4RunManager::GetRunManager()->BeamOn(nofEvents);
+    }
+  }
+  fSampling = sampling;
+  fComparing = false;
+
+  PrintComparison();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1QuasiRandom::EndOfRun(const B1Run* run)
+{
+  if (!fComparing || run->GetNumberOfEvent() == 0) return;
+
+  G4double nofEvents = run->GetNumberOfEvent();
+  std::vector<G4double> means(run->GetNumberOfDetectors());
+  for (size_t d = 0; d < means.size(); d++) {
+    means[d] = run->GetDetectorEdep(d) / nofEvents;
+  }
+  fReplicates[fComparedSampling].push_back(means);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1QuasiRandom::PrintComparison() const
+{
+  if (fReplicates[0].size() < 2 || fReplicates[1].size() < 2) return;
+
+  G4cout << "\n Sampling comparison, relative standard error of the mean"
+            " deposit over the replicates\n"
+         << " detector  pseudo-random  " << std::setw(13) << fSampling
+         << "  variance reduction" << G4endl;
+  G4double sumRatio = 0.;
+  G4int nofRatios = 0;
+  for (size_t d = 0; d < fReplicates[0][0].size(); d++) {
+    G4double mean[2], variance[2];
+    for (G4int s = 0; s < 2; s++) {
+      ReplicateStatistics(fReplicates[s], d, mean[s], variance[s]);
+    }
+    G4double ratio = (variance[1] > 0.) ? variance[0]/variance[1] : 0.;
+    if (ratio > 0.) {
+      sumRatio += ratio;
+      nofRatios++;
+    }
+    G4cout << std::setw(9) << d << "  "
+           << std::setw(13)
+           << (mean[0] > 0. ? std::sqrt(variance[0])/mean[0] : 0.) << "  "
+           << std::setw(13)
+           << (mean[1] > 0. ? std::sqrt(variance[1])/mean[1] : 0.) << "  "
+           << std::setw(18) << ratio << G4endl;
+  }
+  if (nofRatios > 0) {
+    G4cout << " mean variance reduction " << sumRatio/nofRatios << G4endl;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1QuasiRandom::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/qmc/",
+                                      "Quasi-random sampling of the primaries");
+
+  G4GenericMessenger::Command& samplingCmd
+    = fMessenger->DeclareProperty("sampling", fSampling,
+        "Sampling of the primary position (and energy, direction): "
+        "pseudo, stratified, halton or sobol.");
+  samplingCmd.SetParameterName("sampling", false);
+  samplingCmd.SetCandidates("pseudo stratified halton sobol");
+  samplingCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& strataCmd
+    = fMessenger->DeclareProperty("strata", fNofStrata,
+        "Number of strata along x and y of the beam spot.");
+  strataCmd.SetParameterName("strata", false);
+  strataCmd.SetRange("strata>0");
+  strataCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& energyCmd
+    = fMessenger->DeclareProperty("energy", fEnergy,
+        "Quasi-random sampling of the spectrum energy too.");
+  energyCmd.SetParameterName("energy", false);
+  energyCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& directionCmd
+    = fMessenger->DeclareProperty("direction", fDirection,
+        "Quasi-random sampling of the direction in the divergence cone too.");
+  directionCmd.SetParameterName("direction", false);
+  directionCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& replicatesCmd
+    = fMessenger->DeclareProperty("replicates", fNofReplicates,
+        "Number of replicate runs per sampling of a comparison.");
+  replicatesCmd.SetParameterName("replicates", false);
+  replicatesCmd.SetRange("replicates>1");
+  replicatesCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& compareCmd
+    = fMessenger->DeclareMethod("compare", &B1QuasiRandom::Compare,
+        "Run the replicates of the given number of events with pseudo-random "
+        "and with the selected sampling, and print the variance reduction.");
+  compareCmd.SetParameterName("nofEvents", false);
+  compareCmd.SetRange("nofEvents>0");
+  compareCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
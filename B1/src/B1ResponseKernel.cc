@@ -0,0 +1,466 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1ResponseKernel.cc
+/// \brief Implementation of the B1ResponseKernel class
+
+#include "B1ResponseKernel.hh"
+#include "B1DetectorConstruction.hh"
+#include "B1AliasTable.hh"
+#include "B1Run.hh"
+
+#include "G4RunManager.hh"
+#include "G4LogicalVolume.hh"
+#include "G4GenericMessenger.hh"
+#include "G4UnitsTable.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4Timer.hh"
+#include "Randomize.hh"
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <iomanip>
+
+#include <stdint.h>
+
+namespace
+{
+  const char kernelMagic[8] = { 'B','1','K','R','N','0','0','1' };
+
+  // variance of the mean from the sums over n events
+  G4double VarianceOfMean(G4double sum, G4double sum2, G4double n)
+  {
+    if (n < 2.) return 0.;
+    G4double variance = (sum2 - sum*sum/n) / (n - 1.);
+    return (variance > 0.) ? variance / n : 0.;
+  }
+}
+
+B1ResponseKernel* B1ResponseKernel::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1ResponseKernel* B1ResponseKernel::Instance()
+{
+  if (!fgInstance) fgInstance = new B1ResponseKernel;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1ResponseKernel::B1ResponseKernel()
+: fMessenger(0),
+  fMode(kOff),
+  fNX(80), fNY(80),
+  fPitch(1.*cm),
+  fCenterX(0.), fCenterY(0.),
+  fNofDetectors(0),
+  fKernelNX(0), fKernelNY(0),
+  fKernelPitch(0.), fKernelX0(0.), fKernelY0(0.),
+  fFluenceTable(0)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1ResponseKernel::~B1ResponseKernel()
+{
+  delete fFluenceTable;
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4int B1ResponseKernel::SamplePixel(G4int eventID,
+                                    G4double& x, G4double& y) const
+{
+  G4int beam = (fMode == kValidate)
+    ? fFluenceTable->Sample(G4UniformRand())
+    : eventID % (fKernelNX*fKernelNY);
+
+  G4int ix = beam % fKernelNX;
+  G4int iy = beam / fKernelNX;
+  x = fKernelX0 + (ix + G4UniformRand())*fKernelPitch;
+  y = fKernelY0 + (iy + G4UniformRand())*fKernelPitch;
+  return beam;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1ResponseKernel::Build(G4int primariesPerPixel)
+{
+  fKernelNX = fNX;
+  fKernelNY = fNY;
+  fKernelPitch = fPitch;
+  fKernelX0 = fCenterX - 0.5*fNX*fPitch;
+  fKernelY0 = fCenterY - 0.5*fNY*fPitch;
+  fNofDetectors = 0;
+
+  G4int nofBeams = fKernelNX*fKernelNY;
+  G4cout << "Building response kernel: " << nofBeams << " pixels of "
+         << G4BestUnit(fKernelPitch, "Length") << ", "
+         << primariesPerPixel << " primaries each" << G4endl;
+
+  fMode = kBuild;
+  G4RunManager::GetRunManager()->BeamOn(primariesPerPixel*nofBeams);
+  fMode = kOff;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1ResponseKernel::EndOfRun(const B1Run* run)
+{
+  if (fMode == kBuild && run->HasKernel()) {
+    const B1DetectorConstruction* detectorConstruction
+      = static_cast<const B1DetectorConstruction*>
+        (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+    const std::vector<G4LogicalVolume*>& volumes
+      = detectorConstruction->GetScoringVolumes();
+
+    G4int nofBeams = fKernelNX*fKernelNY;
+    fNofDetectors = run->GetNumberOfDetectors();
+    fKernel.assign(fNofDetectors*nofBeams, 0.);
+    fKernelVar.assign(fNofDetectors*nofBeams, 0.);
+    fMasses.resize(fNofDetectors);
+    for (G4int d = 0; d < fNofDetectors; d++) fMasses[d] = volumes[d]->GetMass();
+
+    const std::vector<G4double>& edep   = run->GetKernelEdep();
+    const std::vector<G4double>& edep2  = run->GetKernelEdep2();
+    const std::vector<G4double>& events = run->GetKernelEvents();
+    for (G4int b = 0; b < nofBeams; b++) {
+      if (events[b] <= 0.) continue;
+      for (G4int d = 0; d < fNofDetectors; d++) {
+        G4int i = b*fNofDetectors + d;
+        fKernel[d*nofBeams + b] = edep[i] / events[b];
+        fKernelVar[d*nofBeams + b] = VarianceOfMean(edep[i], edep2[i], events[b]);
+      }
+    }
+    G4cout << "Response kernel built: " << fNofDetectors << " detectors x "
+           << nofBeams << " pixels" << G4endl;
+  }
+  else if (fMode == kValidate) {
+    std::vector<G4double> doses, errors;
+    ComputeDoses(doses, errors);
+
+    G4double nofEvents = run->GetNumberOfEvent();
+    G4double totalFluence = fFluenceTable->GetTotalWeight();
+    G4cout << "\n Kernel vs Monte Carlo for the same fluence ("
+           << nofEvents << " events)\n"
+           << " detector      kernel dose              MC dose          ratio   pull"
+           << G4endl;
+    for (G4int d = 0; d < fNofDetectors; d++) {
+      G4double edep = run->GetDetectorEdep(d);
+      G4double mean = edep / nofEvents;
+      G4double error = std::sqrt(VarianceOfMean(edep, run->GetDetectorEdep2(d),
+                                                nofEvents));
+      G4double dose = totalFluence*mean/fMasses[d];
+      G4double doseError = totalFluence*error/fMasses[d];
+      G4double sigma = std::sqrt(errors[d]*errors[d] + doseError*doseError);
+      G4cout << std::setw(9) << d << "  "
+             << std::setw(12) << G4BestUnit(doses[d], "Dose") << " +- "
+             << std::setw(12) << G4BestUnit(errors[d], "Dose") << "  "
+             << std::setw(12) << G4BestUnit(dose, "Dose") << " +- "
+             << std::setw(12) << G4BestUnit(doseError, "Dose") << "  "
+             << std::setw(6) << (doses[d] > 0. ? dose/doses[d] : 0.) << "  "
+             << std::setw(6) << (sigma > 0. ? (dose - doses[d])/sigma : 0.)
+             << G4endl;
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1ResponseKernel::ComputeDoses(std::vector<G4double>& doses,
+                                    std::vector<G4double>& errors) const
+{
+  const G4int nofBeams = fKernelNX*fKernelNY;
+  doses.assign(fNofDetectors, 0.);
+  errors.assign(fNofDetectors, 0.);
+  const G4double* phi = &fFluence[0];
+  for (G4int d = 0; d < fNofDetectors; d++) {
+    const G4double* k = &fKernel[d*nofBeams];
+    const G4double* v = &fKernelVar[d*nofBeams];
+    G4double sum = 0., var = 0.;
+    for (G4int b = 0; b < nofBeams; b++) {
+      sum += k[b]*phi[b];
+      var += v[b]*phi[b]*phi[b];
+    }
+    doses[d]  = sum / fMasses[d];
+    errors[d] = std::sqrt(var) / fMasses[d];
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1ResponseKernel::SetFluence(G4String fileName)
+{
+  std::ifstream input(fileName.c_str());
+  std::vector<G4double> fluence;
+  std::string line;
+  while (input && std::getline(input, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream values(line);
+    G4double value;
+    while (values >> value) fluence.push_back(value);
+  }
+
+  G4int nofBeams = HasKernel() ? fKernelNX*fKernelNY : fNX*fNY;
+  if ((G4int)fluence.size() != nofBeams) {
+    G4ExceptionDescription msg;
+    msg << "Fluence map " << fileName << " has " << fluence.size()
+        << " values, the kernel grid has " << nofBeams << " pixels.";
+    G4Exception("B1ResponseKernel::SetFluence()",
+                "MyCode0009", JustWarning, msg);
+    return;
+  }
+  fFluence = fluence;
+  delete fFluenceTable;
+  fFluenceTable = new B1AliasTable(fFluence);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1ResponseKernel::Apply(G4String fileName)
+{
+  if (!HasKernel() || !fFluenceTable) {
+    G4Exception("B1ResponseKernel::Apply()", "MyCode0009", JustWarning,
+                "Build or load a kernel and set a fluence map first.");
+    return;
+  }
+
+  G4Timer timer;
+  timer.Start();
+  std::vector<G4double> doses, errors;
+  ComputeDoses(doses, errors);
+  timer.Stop();
+
+  std::ofstream output(fileName.c_str());
+  output << "# detector  dose (Gy)  error (Gy)\n";
+  G4cout << "\n Doses from the response kernel (" << timer.GetRealElapsed()*1.e3
+         << " ms)" << G4endl;
+  for (G4int d = 0; d < fNofDetectors; d++) {
+    output << d << "\t" << doses[d]/gray << "\t" << errors[d]/gray << "\n";
+    G4cout << std::setw(9) << d << "  " << G4BestUnit(doses[d], "Dose")
+           << " +- " << G4BestUnit(errors[d], "Dose") << G4endl;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1ResponseKernel::Validate(G4int nofEvents)
+{
+  if (!HasKernel() || !fFluenceTable) {
+    G4Exception("B1ResponseKernel::Validate()", "MyCode0009", JustWarning,
+                "Build or load a kernel and set a fluence map first.");
+    return;
+  }
+  fMode = kValidate;
+  G4RunManager::GetRunManager()->BeamOn(nofEvents);
+  fMode = kOff;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1ResponseKernel::Save(G4String fileName)
+{
+  FILE* output = HasKernel() ? fopen(fileName.c_str(), "wb") : 0;
+  if (!output) {
+    G4ExceptionDescription msg;
+    msg << "No kernel to save or cannot open " << fileName;
+    G4Exception("B1ResponseKernel::Save()", "MyCode0009", JustWarning, msg);
+    return;
+  }
+
+  int32_t sizes[3] = { fKernelNX, fKernelNY, fNofDetectors };
+  double grid[3] = { fKernelPitch/mm, fKernelX0/mm, fKernelY0/mm };
+  std::vector<double> masses(fNofDetectors);
+  for (G4int d = 0; d < fNofDetectors; d++) masses[d] = fMasses[d]/kg;
+  std::vector<double> kernel(fKernel.size()), variance(fKernel.size());
+  for (size_t i = 0; i < fKernel.size(); i++) {
+    kernel[i] = fKernel[i]/MeV;
+    variance[i] = fKernelVar[i]/(MeV*MeV);
+  }
+
+  fwrite(kernelMagic, sizeof(kernelMagic), 1, output);
+  fwrite(sizes, sizeof(sizes), 1, output);
+  fwrite(grid, sizeof(grid), 1, output);
+  fwrite(&masses[0], sizeof(double), masses.size(), output);
+  fwrite(&kernel[0], sizeof(double), kernel.size(), output);
+  fwrite(&variance[0], sizeof(double), variance.size(), output);
+  fclose(output);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1ResponseKernel::Load(G4String fileName)
+{
+  FILE* input = fopen(fileName.c_str(), "rb");
+  char magic[8];
+  int32_t sizes[3];
+  double grid[3];
+  if (!input || fread(magic, sizeof(magic), 1, input) != 1
+      || std::memcmp(magic, kernelMagic, sizeof(magic))
+      || fread(sizes, sizeof(sizes), 1, input) != 1
+      || fread(grid, sizeof(grid), 1, input) != 1) {
+    G4ExceptionDescription msg;
+    msg << "Cannot read kernel file " << fileName;
+    G4Exception("B1ResponseKernel::Load()", "MyCode0009", JustWarning, msg);
+    if (input) fclose(input);
+    return;
+  }
+
+  // the convolution indexes the detectors of the current geometry
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  G4int nofVolumes = detectorConstruction->GetNumberOfScoringVolumes();
+  if (sizes[0] <= 0 || sizes[1] <= 0 || sizes[2] != nofVolumes) {
+    G4ExceptionDescription msg;
+    msg << "Kernel file " << fileName << " is for " << sizes[2]
+        << " detectors, the geometry has " << nofVolumes
+        << ", kernel not loaded.";
+    G4Exception("B1ResponseKernel::Load()", "MyCode0009", JustWarning, msg);
+    fclose(input);
+    return;
+  }
+
+  size_t nofDetectors = sizes[2];
+  size_t size = nofDetectors*sizes[0]*sizes[1];
+  std::vector<double> masses(nofDetectors), kernel(size), variance(size);
+  G4bool complete
+    =  fread(&masses[0], sizeof(double), nofDetectors, input) == nofDetectors
+    && fread(&kernel[0], sizeof(double), size, input) == size
+    && fread(&variance[0], sizeof(double), size, input) == size;
+  fclose(input);
+  if (!complete) {
+    G4ExceptionDescription msg;
+    msg << "Kernel file " << fileName << " is truncated.";
+    G4Exception("B1ResponseKernel::Load()", "MyCode0009", JustWarning, msg);
+    return;
+  }
+
+  fKernelNX = sizes[0];
+  fKernelNY = sizes[1];
+  fNofDetectors = sizes[2];
+  fKernelPitch = grid[0]*mm;
+  fKernelX0 = grid[1]*mm;
+  fKernelY0 = grid[2]*mm;
+  fMasses.resize(nofDetectors);
+  for (size_t d = 0; d < nofDetectors; d++) fMasses[d] = masses[d]*kg;
+  fKernel.resize(size);
+  fKernelVar.resize(size);
+  for (size_t i = 0; i < size; i++) {
+    fKernel[i] = kernel[i]*MeV;
+    fKernelVar[i] = variance[i]*MeV*MeV;
+  }
+  if ((G4int)fFluence.size() != fKernelNX*fKernelNY) {
+    fFluence.clear();
+    delete fFluenceTable;
+    fFluenceTable = 0;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1ResponseKernel::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/kernel/",
+                                      "Pencil-beam response kernels");
+
+  G4GenericMessenger::Command& nXCmd
+    = fMessenger->DeclareProperty("nX", fNX, "Number of pixels along x.");
+  nXCmd.SetParameterName("nX", false);
+  nXCmd.SetRange("nX>0");
+  nXCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& nYCmd
+    = fMessenger->DeclareProperty("nY", fNY, "Number of pixels along y.");
+  nYCmd.SetParameterName("nY", false);
+  nYCmd.SetRange("nY>0");
+  nYCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& pitchCmd
+    = fMessenger->DeclarePropertyWithUnit("pitch", "cm", fPitch,
+        "Pixel size.");
+  pitchCmd.SetParameterName("pitch", false);
+  pitchCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& centerXCmd
+    = fMessenger->DeclarePropertyWithUnit("centerX", "cm", fCenterX,
+        "Grid centre along x.");
+  centerXCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& centerYCmd
+    = fMessenger->DeclarePropertyWithUnit("centerY", "cm", fCenterY,
+        "Grid centre along y.");
+  centerYCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& buildCmd
+    = fMessenger->DeclareMethod("build", &B1ResponseKernel::Build,
+        "Simulate the pencil-beam grid with the given primaries per pixel.");
+  buildCmd.SetParameterName("primaries", false);
+  buildCmd.SetRange("primaries>0");
+  buildCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& saveCmd
+    = fMessenger->DeclareMethod("save", &B1ResponseKernel::Save,
+        "Write the kernel to a binary file.");
+  saveCmd.SetParameterName("fileName", false);
+  saveCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& loadCmd
+    = fMessenger->DeclareMethod("load", &B1ResponseKernel::Load,
+        "Read a kernel written by /B1/kernel/save.");
+  loadCmd.SetParameterName("fileName", false);
+  loadCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& fluenceCmd
+    = fMessenger->DeclareMethod("fluence", &B1ResponseKernel::SetFluence,
+        "Read a fluence map: nY lines of nX primaries per pixel.");
+  fluenceCmd.SetParameterName("fileName", false);
+  fluenceCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& applyCmd
+    = fMessenger->DeclareMethod("apply", &B1ResponseKernel::Apply,
+        "Compute the detector doses of the fluence map from the kernel.");
+  applyCmd.SetParameterName("fileName", false);
+  applyCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& validateCmd
+    = fMessenger->DeclareMethod("validate", &B1ResponseKernel::Validate,
+        "Simulate the fluence map directly and compare with the kernel.");
+  validateCmd.SetParameterName("events", false);
+  validateCmd.SetRange("events>0");
+  validateCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
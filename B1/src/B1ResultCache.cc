@@ -0,0 +1,516 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1ResultCache.cc
+/// \brief Implementation of the B1ResultCache class
+
+#include "B1ResultCache.hh"
+#include "B1RunAction.hh"
+#include "B1Run.hh"
+#include "B1DetectorConstruction.hh"
+#include "B1PhaseSpace.hh"
+#include "B1ResponseKernel.hh"
+#include "B1UncollidedDose.hh"
+#include "B1EventStream.hh"
+#include "B1FastShapes.hh"
+#include "B1StepTrace.hh"
+#include "B1Perturbation.hh"
+
+#include "G4RunManager.hh"
+#include "G4UImanager.hh"
+#include "G4GenericMessenger.hh"
+#include "G4VUserPhysicsList.hh"
+#include "G4VModularPhysicsList.hh"
+#include "G4VPhysicsConstructor.hh"
+#include "G4PhysicalVolumeStore.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VSolid.hh"
+#include "G4Material.hh"
+#include "G4RegionStore.hh"
+#include "G4Region.hh"
+#include "G4ProductionCuts.hh"
+#include "Randomize.hh"
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <typeinfo>
+#include <map>
+#include <vector>
+#include <utility>
+#include <cstdio>
+
+#include <stdint.h>
+
+namespace
+{
+  const uint64_t fnvOffset = 14695981039346656037ULL;
+  const uint64_t fnvPrime  = 1099511628211ULL;
+
+  // commands which do not change the result of a run
+  const char* const ignoredCommands[] = {
+    "/control/", "/vis/", "/gui/", "/tracking/", "/event/verbose",
+    "/random/", "/run/beamOn", "/run/verbose", "/run/printProgress",
+    "/run/initialize", "/run/reinitializeGeometry", "/run/geometryModified",
+    "/run/physicsModified", "/B1/cache/", "/B1/metrics/", "/B1/kernel/",
+    "/B1/uncollided/", "/B1/eventStream/", "/B1/pulseHeight/", "/B1/sweep/",
+    "/B1/cutTuner/", "/B1/stepTrace/", "/B1/snapshot/",
+    "/B1/response/", "/B1/adjoint/", "/B1/qmc/replicates", "/B1/qmc/compare",
+    "/B1/correlated/", "/B1/perturb/", "/B1/surrogate/", 0 };
+
+  // commands which add up rather than replace the previous value: their
+  // whole sequence since the last <group>clear is part of the key
+  const char* const sequenceCommands[] = {
+    "/B1/source/", "/process/", 0 };
+
+  uint64_t Fnv1a(const char* data, size_t size, uint64_t hash = fnvOffset)
+  {
+    for (size_t i = 0; i < size; i++) {
+      hash ^= (unsigned char)data[i];
+      hash *= fnvPrime;
+    }
+    return hash;
+  }
+
+  G4String ToHex(uint64_t hash)
+  {
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", (unsigned long long)hash);
+    return text;
+  }
+
+  G4bool HashFile(const G4String& fileName, uint64_t& hash)
+  {
+    struct stat status;
+    if (fileName.empty() || stat(fileName.c_str(), &status) != 0
+        || (status.st_mode & S_IFMT) != S_IFREG) return false;
+    std::ifstream file(fileName.c_str(), std::ios::binary);
+    if (!file) return false;
+    hash = fnvOffset;
+    char buffer[65536];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+      hash = Fnv1a(buffer, (size_t)file.gcount(), hash);
+    }
+    return true;
+  }
+
+  G4bool IsIgnored(const G4String& command)
+  {
+    for (const char* const* prefix = ignoredCommands; *prefix; prefix++) {
+      if (command.compare(0, std::char_traits<char>::length(*prefix),
+                          *prefix) == 0) return true;
+    }
+    return false;
+  }
+
+  const char* GetSequence(const G4String& command)
+  {
+    for (const char* const* prefix = sequenceCommands; *prefix; prefix++) {
+      if (command.compare(0, std::char_traits<char>::length(*prefix),
+                          *prefix) == 0) return *prefix;
+    }
+    return 0;
+  }
+
+  // a command with the hashes of the files its parameters name
+  void DescribeCommand(std::ostream& config, const G4String& path,
+                       const G4String& parameters)
+  {
+    config << "command " << path << " " << parameters;
+    std::istringstream words(parameters);
+    G4String word;
+    uint64_t hash;
+    while (words >> word) {
+      if (HashFile(word, hash)) config << " [" << ToHex(hash) << "]";
+    }
+    config << "\n";
+  }
+
+  // reads "<label> <size>\n" followed by size bytes
+  G4bool ReadBlock(std::istream& in, const char* label, std::string& block)
+  {
+    std::string name;
+    size_t size = 0;
+    if (!(in >> name >> size) || name != label) return false;
+    in.get();
+    block.resize(size);
+    return size == 0 || (bool)in.read(&block[0], size);
+  }
+}
+
+B1ResultCache* B1ResultCache::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1ResultCache* B1ResultCache::Instance()
+{
+  if (!fgInstance) fgInstance = new B1ResultCache;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1ResultCache::B1ResultCache()
+: fMessenger(0),
+  fPendingEvents(0),
+  fHits(0),
+  fMisses(0)
+{
+  // the configuration is rebuilt from the command history
+  G4UImanager::GetUIpointer()->SetMaxHistSize(1000000);
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1ResultCache::~B1ResultCache()
+{
+  if (fHits + fMisses > 0) {
+    G4cout << "Result cache: " << fHits << " runs read from " << fDirectory
+           << ", " << fMisses << " simulated" << G4endl;
+  }
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1ResultCache::SetDirectory(G4String directory)
+{
+  if (directory == "none" || directory.empty()) {
+    fDirectory = "";
+    return;
+  }
+#ifdef _WIN32
+  _mkdir(directory.c_str());
+#else
+  mkdir(directory.c_str(), 0755);
+#endif
+  fDirectory = directory;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1ResultCache::BeamOn(G4int nofEvents)
+{
+  G4RunManager* runManager = G4RunManager::GetRunManager();
+  G4String reason;
+  if (fDirectory.empty() || nofEvents <= 0 || !IsCacheable(reason)) {
+    if (!reason.empty()) {
+      G4cout << "Result cache: run simulated, " << reason << G4endl;
+    }
+    runManager->BeamOn(nofEvents);
+    return;
+  }
+
+  // geometry and cuts must be up to date before they are described
+  if (!runManager->ConfirmBeamOnCondition()) return;
+
+  G4String configuration = DescribeConfiguration(nofEvents);
+  G4String key = ToHex(Fnv1a(configuration.data(), configuration.size()));
+  if (Replay(key, configuration)) {
+    fHits++;
+    return;
+  }
+
+  fMisses++;
+  fPendingKey = key;
+  fPendingConfiguration = configuration;
+  fPendingEvents = nofEvents;
+  runManager->BeamOn(nofEvents);
+  fPendingKey = "";
+  fPendingConfiguration = "";
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1ResultCache::EndOfRun(const B1Run* run)
+{
+  // aborted runs are not stored
+  if (fPendingKey.empty() || run->GetNumberOfEvent() != fPendingEvents) {
+    return;
+  }
+
+  std::ostringstream engineState;
+  G4Random::saveFullState(engineState);
+
+  // written aside and renamed, an interrupted sweep leaves no partial entry
+  G4String fileName = GetEntryName(fPendingKey);
+  G4String tmpName = fileName + ".tmp";
+  std::ofstream out(tmpName.c_str(), std::ios::binary);
+  out << "B1RESULT 2\n" << std::setprecision(17);
+  run->WriteTallies(out);
+  out << "random " << engineState.str().size() << "\n" << engineState.str()
+      << "\nconfiguration " << fPendingConfiguration.size() << "\n"
+      << fPendingConfiguration;
+  out.close();
+  if (!out || std::rename(tmpName.c_str(), fileName.c_str()) != 0) {
+    G4ExceptionDescription msg;
+    msg << "Cannot write the result cache entry " << fileName << ".";
+    G4Exception("B1ResultCache::EndOfRun()", "MyCode0012", JustWarning, msg);
+    std::remove(tmpName.c_str());
+    return;
+  }
+  G4cout << "Result cache: run stored as " << fPendingKey << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B1ResultCache::IsCacheable(G4String& reason) const
+{
+  const B1RunAction* runAction = dynamic_cast<const B1RunAction*>
+    (G4RunManager::GetRunManager()->GetUserRunAction());
+
+  if (B1ResponseKernel::Instance()->GetMode() != B1ResponseKernel::kOff) {
+    reason = "kernel runs are not cached";
+  }
+  else if (B1PhaseSpaceWriter::Instance()->IsActive()) {
+    reason = "a phase space is recorded";
+  }
+  else if (B1EventStream::Instance()->IsActive()) {
+    reason = "an event stream is written";
+  }
+  else if (B1StepTrace::Instance()->IsActive()) {
+    reason = "a step trace is recorded";
+  }
+  else if (B1UncollidedDose::Instance()->UseControlVariate()) {
+    reason = "control variate sums are not cached";
+  }
+  else if (runAction && runAction->HasPulseHeightOutput()) {
+    reason = "pulse-height spectra are written";
+  }
+  else if (B1FastShapes::Instance()->GetMode() != B1FastShapes::kOff) {
+    reason = "fast shape tables are not part of the key";
+  }
+  else if (B1Perturbation::Instance()->IsActive()) {
+    reason = "perturbation sums are not cached";
+  }
+  return reason.empty();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String B1ResultCache::DescribeConfiguration(G4int nofEvents)
+{
+  std::ostringstream config;
+  config << std::setprecision(17);
+  config << "executable " << HashExecutable() << "\n"
+         << "events " << nofEvents << "\n";
+
+  // geometry, in construction order
+  G4PhysicalVolumeStore* volumeStore = G4PhysicalVolumeStore::GetInstance();
+  for (size_t i = 0; i < volumeStore->size(); i++) {
+    const G4VPhysicalVolume* volume = (*volumeStore)[i];
+    const G4LogicalVolume* logical = volume->GetLogicalVolume();
+    const G4LogicalVolume* mother = volume->GetMotherLogical();
+    G4ThreeVector translation = volume->GetTranslation();
+    config << "volume " << volume->GetName() << " " << volume->GetCopyNo()
+           << " in " << (mother ? mother->GetName() : G4String("-"))
+           << " at " << translation.x() << " " << translation.y() << " "
+           << translation.z();
+    const G4RotationMatrix* rotation = volume->GetRotation();
+    if (rotation) {
+      config << " rotation " << rotation->xx() << " " << rotation->xy()
+             << " " << rotation->xz() << " " << rotation->yx() << " "
+             << rotation->yy() << " " << rotation->yz() << " "
+             << rotation->zx() << " " << rotation->zy() << " "
+             << rotation->zz();
+    }
+    const G4Material* material = logical->GetMaterial();
+    config << " material " << material->GetName() << " "
+           << material->GetDensity() << "\n";
+    logical->GetSolid()->StreamInfo(config);
+  }
+
+  // physics
+  const G4VUserPhysicsList* physicsList
+    = G4RunManager::GetRunManager()->GetUserPhysicsList();
+  if (physicsList) {
+    config << "physics " << typeid(*physicsList).name()
+           << " cut " << physicsList->GetDefaultCutValue();
+    // the EM-only lists differ by their constructors only
+    const G4VModularPhysicsList* modularList
+      = dynamic_cast<const G4VModularPhysicsList*>(physicsList);
+    for (G4int i = 0; modularList && modularList->GetPhysics(i); i++) {
+      config << " " << modularList->GetPhysics(i)->GetPhysicsName();
+    }
+    config << "\n";
+  }
+  G4RegionStore* regionStore = G4RegionStore::GetInstance();
+  for (size_t i = 0; i < regionStore->size(); i++) {
+    G4Region* region = (*regionStore)[i];
+    G4ProductionCuts* cuts = region->GetProductionCuts();
+    config << "region " << region->GetName();
+    if (cuts) {
+      for (G4int p = 0; p < 4; p++) config << " " << cuts->GetProductionCut(p);
+    }
+    config << "\n";
+  }
+
+  // last value of every setting, and the sequences of the commands which
+  // add up (source components), with the contents of the files they name
+  G4UImanager* uiManager = G4UImanager::GetUIpointer();
+  std::map<G4String, G4String> settings;
+  std::map<G4String, std::vector<std::pair<G4String, G4String> > > sequences;
+  for (G4int i = 0; i < uiManager->GetNumberOfHistory(); i++) {
+    G4String command = uiManager->GetPreviousCommand(i);
+    size_t blank = command.find(' ');
+    G4String path = command.substr(0, blank);
+    if (IsIgnored(path)) continue;
+    G4String parameters
+      = (blank == std::string::npos) ? G4String() : command.substr(blank + 1);
+    const char* sequence = GetSequence(path);
+    if (!sequence) {
+      settings[path] = parameters;
+    }
+    else if (path == G4String(sequence) + "clear") {
+      sequences[sequence].clear();
+    }
+    else {
+      sequences[sequence].push_back(std::make_pair(path, parameters));
+    }
+  }
+  for (std::map<G4String, G4String>::const_iterator it = settings.begin();
+       it != settings.end(); ++it) {
+    DescribeCommand(config, it->first, it->second);
+  }
+  for (std::map<G4String, std::vector<std::pair<G4String, G4String> > >
+         ::const_iterator it = sequences.begin(); it != sequences.end(); ++it) {
+    for (size_t i = 0; i < it->second.size(); i++) {
+      DescribeCommand(config, it->second[i].first, it->second[i].second);
+    }
+  }
+
+  uint64_t hash;
+  if (HashFile("GunPositionParameters.txt", hash)) {
+    config << "gunPosition " << ToHex(hash) << "\n";
+  }
+
+  std::ostringstream engineState;
+  G4Random::saveFullState(engineState);
+  config << "random\n" << engineState.str() << "\n";
+
+  return config.str();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String B1ResultCache::HashExecutable()
+{
+  if (fExecutableHash.empty()) {
+    uint64_t hash;
+    if (HashFile("/proc/self/exe", hash) || HashFile(fExecutable, hash)) {
+      fExecutableHash = ToHex(hash);
+    }
+    else {
+      fExecutableHash = "unknown";
+    }
+  }
+  return fExecutableHash;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B1ResultCache::Replay(const G4String& key,
+                             const G4String& configuration)
+{
+  std::ifstream in(GetEntryName(key).c_str(), std::ios::binary);
+  if (!in) return false;
+
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  B1Run run(detectorConstruction->GetNumberOfScoringVolumes());
+
+  std::string magic, version, engineState, storedConfiguration;
+  G4bool valid = (in >> magic >> version)
+                 && magic == "B1RESULT" && version == "2"
+                 && run.ReadTallies(in)
+                 && ReadBlock(in, "random", engineState)
+                 && ReadBlock(in, "configuration", storedConfiguration);
+  if (!valid || storedConfiguration != configuration) {
+    G4ExceptionDescription msg;
+    msg << "Result cache entry " << GetEntryName(key) << " is "
+        << (valid ? "for another configuration" : "unreadable")
+        << ", the run is simulated again.";
+    G4Exception("B1ResultCache::Replay()", "MyCode0012", JustWarning, msg);
+    return false;
+  }
+
+  G4cout << "Result cache: run " << key << " read, "
+         << run.GetNumberOfEvent() << " events not simulated" << G4endl;
+
+  // the run action reports the stored doses, without the other outputs
+  B1RunAction* runAction = dynamic_cast<B1RunAction*>(
+    const_cast<G4UserRunAction*>(
+      G4RunManager::GetRunManager()->GetUserRunAction()));
+  if (runAction) runAction->ReplayRun(&run);
+
+  // continue the random sequence where the simulated run had left it
+  std::istringstream state(engineState);
+  G4Random::restoreFullState(state);
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String B1ResultCache::GetEntryName(const G4String& key) const
+{
+  return fDirectory + "/" + key + ".b1r";
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1ResultCache::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/cache/",
+                                      "Cache of run results");
+
+  // the cache is kept by the master
+  G4GenericMessenger::Command& dirCmd
+    = fMessenger->DeclareMethod("dir", &B1ResultCache::SetDirectory,
+        "Directory of the cached results, created if needed "
+        "(none to disable).");
+  dirCmd.SetParameterName("directory", false);
+  dirCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& beamOnCmd
+    = fMessenger->DeclareMethod("beamOn", &B1ResultCache::BeamOn,
+        "Start a run, or read its result if this configuration "
+        "was already run.");
+  beamOnCmd.SetParameterName("nofEvents", false);
+  beamOnCmd.SetRange("nofEvents>=0");
+  beamOnCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
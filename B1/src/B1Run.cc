@@ -29,19 +29,47 @@
 /// \brief Implementation of the B1Run class
 
 #include "B1Run.hh"
+#include "B1PulseHeightSpectra.hh"
+
+#include <iostream>
+#include <string>
+
+namespace
+{
+  // the tallies of all threads are enabled with the same sizes, anything
+  // else is a bug and would give short merged results
+  G4bool CheckMergeSize(const char* tally, size_t master, size_t worker)
+  {
+    if (master == worker) return true;
+    G4ExceptionDescription msg;
+    msg << "Cannot merge the " << tally << " tally of a worker, " << worker
+        << " entries for " << master << " in the master run.";
+    G4Exception("B1Run::Merge()", "MyCode0029", FatalException, msg);
+    return false;
+  }
+}
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
-B1Run::B1Run()
+B1Run::B1Run(G4int nofDetectors)
 : G4Run(),
   fEdep(0.), 
-  fEdep2(0.)
+  fEdep2(0.),
+  fNofDetectors(nofDetectors),
+  fDetectorEdep(nofDetectors, 0.),
+  fDetectorEdep2(nofDetectors, 0.),
+  fDetectorKerma(nofDetectors, 0.),
+  fDetectorKerma2(nofDetectors, 0.),
+  fControlEvents(0.),
+  fPulseHeight(0)
 {} 
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 B1Run::~B1Run()
-{} 
+{
+  delete fPulseHeight;
+} 
  
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
@@ -50,6 +78,76 @@ void B1Run::Merge(const G4Run* run)
   const B1Run* localRun = static_cast<const B1Run*>(run);
   fEdep  += localRun->fEdep;
   fEdep2 += localRun->fEdep2;
+  for (G4int i = 0; i < fNofDetectors; i++) {
+    fDetectorEdep[i]  += localRun->fDetectorEdep[i];
+    fDetectorEdep2[i] += localRun->fDetectorEdep2[i];
+    fDetectorKerma[i]  += localRun->fDetectorKerma[i];
+    fDetectorKerma2[i] += localRun->fDetectorKerma2[i];
+  }
+  if (fKernelEvents.empty() && !localRun->fKernelEvents.empty()) {
+    EnableKernel(localRun->fKernelEvents.size());
+  }
+  if (CheckMergeSize("kernel", fKernelEvents.size(),
+                     localRun->fKernelEvents.size())) {
+    for (size_t i = 0; i < fKernelEdep.size(); i++) {
+      fKernelEdep[i]  += localRun->fKernelEdep[i];
+      fKernelEdep2[i] += localRun->fKernelEdep2[i];
+    }
+    for (size_t i = 0; i < fKernelEvents.size(); i++) {
+      fKernelEvents[i] += localRun->fKernelEvents[i];
+    }
+  }
+  if (localRun->HasControlVariate()) {
+    if (!HasControlVariate()) EnableControlVariate(localRun->fControlExpected);
+    for (G4int i = 0; i < fNofDetectors; i++) {
+      fControlSum[i]   += localRun->fControlSum[i];
+      fControlSum2[i]  += localRun->fControlSum2[i];
+      fControlCross[i] += localRun->fControlCross[i];
+    }
+    fControlEvents += localRun->fControlEvents;
+  }
+  if (localRun->HasSourceComponents()) {
+    if (fComponentNames.size() != localRun->fComponentNames.size()) {
+      EnableSourceComponents(localRun->fComponentNames);
+    }
+    for (size_t i = 0; i < fComponentEdep.size(); i++) {
+      fComponentEdep[i]  += localRun->fComponentEdep[i];
+      fComponentEdep2[i] += localRun->fComponentEdep2[i];
+    }
+    for (size_t i = 0; i < fComponentEvents.size(); i++) {
+      fComponentEvents[i] += localRun->fComponentEvents[i];
+    }
+  }
+  if (fEnergyBinEvents.empty() && !localRun->fEnergyBinEvents.empty()) {
+    EnableEnergyBins(localRun->fEnergyBinEvents.size());
+  }
+  if (CheckMergeSize("energy bin", fEnergyBinEvents.size(),
+                     localRun->fEnergyBinEvents.size())) {
+    for (size_t i = 0; i < fEnergyBinEdep.size(); i++) {
+      fEnergyBinEdep[i]  += localRun->fEnergyBinEdep[i];
+      fEnergyBinEdep2[i] += localRun->fEnergyBinEdep2[i];
+    }
+    for (size_t i = 0; i < fEnergyBinEvents.size(); i++) {
+      fEnergyBinEvents[i] += localRun->fEnergyBinEvents[i];
+    }
+  }
+  if (fPerturbationWeight.empty() && !localRun->fPerturbationWeight.empty()) {
+    EnablePerturbations(localRun->fPerturbationWeight.size());
+  }
+  if (CheckMergeSize("perturbation", fPerturbationWeight.size(),
+                     localRun->fPerturbationWeight.size())) {
+    for (size_t i = 0; i < fPerturbedEdep.size(); i++) {
+      fPerturbedEdep[i]  += localRun->fPerturbedEdep[i];
+      fPerturbedEdep2[i] += localRun->fPerturbedEdep2[i];
+    }
+    for (size_t i = 0; i < fPerturbationWeight.size(); i++) {
+      fPerturbationWeight[i]  += localRun->fPerturbationWeight[i];
+      fPerturbationWeight2[i] += localRun->fPerturbationWeight2[i];
+    }
+  }
+  if (fPulseHeight && localRun->fPulseHeight) {
+    fPulseHeight->Merge(*localRun->fPulseHeight);
+  }
 
   G4Run::Merge(run); 
 } 
@@ -64,4 +162,218 @@ void B1Run::AddEdep (G4double edep)
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
+void B1Run::AddDetectorEdep (G4int detector, G4double edep)
+{
+  fDetectorEdep[detector]  += edep;
+  fDetectorEdep2[detector] += edep*edep;
+  if (fPulseHeight) fPulseHeight->Fill(detector, edep);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Run::AddDetectorKerma (G4int detector, G4double kerma)
+{
+  fDetectorKerma[detector]  += kerma;
+  fDetectorKerma2[detector] += kerma*kerma;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Run::EnablePulseHeight(G4int nofBins, G4double eMin, G4double eMax,
+                              G4bool logBinning)
+{
+  delete fPulseHeight;
+  fPulseHeight
+    = new B1PulseHeightSpectra(fNofDetectors, nofBins, eMin, eMax, logBinning);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Run::EnableKernel(G4int nofBeams)
+{
+  fKernelEdep.assign(nofBeams*fNofDetectors, 0.);
+  fKernelEdep2.assign(nofBeams*fNofDetectors, 0.);
+  fKernelEvents.assign(nofBeams, 0.);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Run::AddKernelEvent(G4int beam)
+{
+  fKernelEvents[beam] += 1.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Run::AddKernelEdep(G4int beam, G4int detector, G4double edep)
+{
+  G4int i = beam*fNofDetectors + detector;
+  fKernelEdep[i]  += edep;
+  fKernelEdep2[i] += edep*edep;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Run::EnableSourceComponents(const std::vector<G4String>& names)
+{
+  fComponentNames = names;
+  fComponentEdep.assign(names.size()*fNofDetectors, 0.);
+  fComponentEdep2.assign(names.size()*fNofDetectors, 0.);
+  fComponentEvents.assign(names.size(), 0.);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Run::AddComponentEvent(G4int component)
+{
+  fComponentEvents[component] += 1.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Run::AddComponentEdep(G4int component, G4int detector, G4double edep)
+{
+  G4int i = component*fNofDetectors + detector;
+  fComponentEdep[i]  += edep;
+  fComponentEdep2[i] += edep*edep;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
+void B1Run::EnableEnergyBins(G4int nofBins)
+{
+  fEnergyBinEdep.assign(nofBins*fNofDetectors, 0.);
+  fEnergyBinEdep2.assign(nofBins*fNofDetectors, 0.);
+  fEnergyBinEvents.assign(nofBins, 0.);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Run::AddEnergyBinEvent(G4int bin)
+{
+  fEnergyBinEvents[bin] += 1.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Run::AddEnergyBinEdep(G4int bin, G4int detector, G4double edep)
+{
+  G4int i = bin*fNofDetectors + detector;
+  fEnergyBinEdep[i]  += edep;
+  fEnergyBinEdep2[i] += edep*edep;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Run::EnablePerturbations(G4int nofScores)
+{
+  fPerturbedEdep.assign(nofScores*fNofDetectors, 0.);
+  fPerturbedEdep2.assign(nofScores*fNofDetectors, 0.);
+  fPerturbationWeight.assign(nofScores, 0.);
+  fPerturbationWeight2.assign(nofScores, 0.);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Run::AddPerturbationWeight(G4int score, G4double weight)
+{
+  fPerturbationWeight[score]  += weight;
+  fPerturbationWeight2[score] += weight*weight;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Run::AddPerturbedEdep(G4int score, G4int detector, G4double edep)
+{
+  G4int i = score*fNofDetectors + detector;
+  fPerturbedEdep[i]  += edep;
+  fPerturbedEdep2[i] += edep*edep;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Run::WriteTallies(std::ostream& out) const
+{
+  out << "events " << numberOfEvent << "\n"
+      << "total " << fEdep << " " << fEdep2 << "\n"
+      << "detectors " << fNofDetectors << "\n";
+  for (G4int i = 0; i < fNofDetectors; i++) {
+    out << fDetectorEdep[i] << " " << fDetectorEdep2[i] << " "
+        << fDetectorKerma[i] << " " << fDetectorKerma2[i] << "\n";
+  }
+  out << "components " << fComponentNames.size() << "\n";
+  for (size_t c = 0; c < fComponentNames.size(); c++) {
+    out << fComponentNames[c] << "\n" << fComponentEvents[c] << "\n";
+    for (G4int i = 0; i < fNofDetectors; i++) {
+      out << fComponentEdep[c*fNofDetectors + i] << " "
+          << fComponentEdep2[c*fNofDetectors + i] << "\n";
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B1Run::ReadTallies(std::istream& in)
+{
+  std::string label1, label2, label3;
+  G4int nofEvents = 0, nofDetectors = 0;
+  if (!(in >> label1 >> nofEvents >> label2 >> fEdep >> fEdep2
+           >> label3 >> nofDetectors)
+      || label1 != "events" || label2 != "total" || label3 != "detectors"
+      || nofDetectors != fNofDetectors) return false;
+  for (G4int i = 0; i < fNofDetectors; i++) {
+    in >> fDetectorEdep[i] >> fDetectorEdep2[i]
+       >> fDetectorKerma[i] >> fDetectorKerma2[i];
+  }
+
+  std::string label4;
+  size_t nofComponents = 0;
+  if (!(in >> label4 >> nofComponents) || label4 != "components") return false;
+  std::vector<G4String> names(nofComponents);
+  std::vector<G4double> events(nofComponents), edep, edep2;
+  for (size_t c = 0; c < nofComponents; c++) {
+    in >> std::ws;
+    std::getline(in, names[c]);
+    in >> events[c];
+    for (G4int i = 0; i < fNofDetectors; i++) {
+      G4double sum = 0., sum2 = 0.;
+      in >> sum >> sum2;
+      edep.push_back(sum);
+      edep2.push_back(sum2);
+    }
+  }
+  if (nofComponents > 0) {
+    EnableSourceComponents(names);
+    fComponentEvents = events;
+    fComponentEdep = edep;
+    fComponentEdep2 = edep2;
+  }
+  numberOfEvent = nofEvents;
+  return (bool)in;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Run::EnableControlVariate(const std::vector<G4double>& expected)
+{
+  fControlExpected = expected;
+  fControlSum.assign(fNofDetectors, 0.);
+  fControlSum2.assign(fNofDetectors, 0.);
+  fControlCross.assign(fNofDetectors, 0.);
+  fControlEvents = 0.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1Run::AddControlVariate(const std::vector<G4double>& edep,
+                              const std::vector<G4double>& control)
+{
+  for (G4int i = 0; i < fNofDetectors; i++) {
+    fControlSum[i]   += control[i];
+    fControlSum2[i]  += control[i]*control[i];
+    fControlCross[i] += control[i]*edep[i];
+  }
+  fControlEvents += 1.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -31,22 +31,52 @@
 #include "B1RunAction.hh"
 #include "B1PrimaryGeneratorAction.hh"
 #include "B1DetectorConstruction.hh"
+#include "B1EnergySpectrum.hh"
+#include "B1PhaseSpace.hh"
+#include "B1PulseHeightSpectra.hh"
+#include "B1ResponseKernel.hh"
+#include "B1EnergyResponse.hh"
+#include "B1QuasiRandom.hh"
+#include "B1CorrelatedSampling.hh"
+#include "B1Perturbation.hh"
+#include "B1AdjointScan.hh"
+#include "B1UncollidedDose.hh"
+#include "B1EventStream.hh"
+#include "B1RunMetrics.hh"
+#include "B1RunSnapshots.hh"
+#include "B1ResultCache.hh"
+#include "B1AdaptiveSweep.hh"
+#include "B1SurrogateModel.hh"
+#include "B1CutTuner.hh"
+#include "B1FastShapes.hh"
+#include "B1StepTrace.hh"
 #include "B1Run.hh"
 
 #include "G4RunManager.hh"
+#include "G4GenericMessenger.hh"
 #include "G4LogicalVolumeStore.hh"
 #include "G4LogicalVolume.hh"
 #include "G4UnitsTable.hh"
 #include "G4SystemOfUnits.hh"
+#include "G4Timer.hh"
 
 #include <cstdio>
 #include <cstdlib>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 B1RunAction::B1RunAction()
 : G4UserRunAction(),
-  counter(0)
+  counter(0),
+  fMessenger(0),
+  fPulseHeightBins(200),
+  fPulseHeightEMin(1.*keV),
+  fPulseHeightEMax(10.*MeV),
+  fPulseHeightLog(true),
+  fReplaying(false)
 { 
   // add new units for dose
   // 
@@ -61,36 +91,123 @@ B1RunAction::B1RunAction()
   new G4UnitDefinition("picogray" , "picoGy"  , "Dose", picogray);
 
   counter = 0;
+
+  DefineCommands();
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 B1RunAction::~B1RunAction()
-{}
+{
+  delete fMessenger;
+}
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 G4Run* B1RunAction::GenerateRun()
 {
-  return new B1Run; 
+  const B1DetectorConstruction* detectorConstruction
+   = static_cast<const B1DetectorConstruction*>
+     (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  B1Run* run = new B1Run(detectorConstruction->GetNumberOfScoringVolumes());
+
+  if (!fPulseHeightFile.empty()) {
+    run->EnablePulseHeight(fPulseHeightBins, fPulseHeightEMin,
+                           fPulseHeightEMax, fPulseHeightLog);
+  }
+  B1ResponseKernel* kernel = B1ResponseKernel::Instance();
+  if (kernel->GetMode() == B1ResponseKernel::kBuild) {
+    run->EnableKernel(kernel->GetNumberOfBeams());
+  }
+  B1EnergyResponse* response = B1EnergyResponse::Instance();
+  if (response->IsActive()) {
+    run->EnableEnergyBins(response->GetNumberOfBins());
+  }
+  B1Perturbation* perturbation = B1Perturbation::Instance();
+  if (perturbation->IsActive()) {
+    run->EnablePerturbations(perturbation->GetNumberOfScores());
+  }
+  // the master learns the source components when merging
+  const B1PrimaryGeneratorAction* generatorAction
+   = static_cast<const B1PrimaryGeneratorAction*>
+     (G4RunManager::GetRunManager()->GetUserPrimaryGeneratorAction());
+  if (generatorAction && generatorAction->GetNumberOfComponents() > 0) {
+    run->EnableSourceComponents(generatorAction->GetComponentNames());
+  }
+  return run; 
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
-void B1RunAction::BeginOfRunAction(const G4Run*)
+void B1RunAction::BeginOfRunAction(const G4Run* run)
 { 
   //inform the runManager to save random number seed
   G4RunManager::GetRunManager()->SetRandomNumberStore(false);
+
+  if (IsMaster()) {
+    fEventLoopTimer.Start();
+    B1PhaseSpaceWriter::Instance()->BeginOfRun();
+    B1StepTrace::Instance()->BeginOfRun(run->GetRunID());
+    B1EventStream::Instance()->BeginOfRun(
+      run->GetRunID(),
+      static_cast<const B1Run*>(run)->GetNumberOfDetectors());
+    B1RunMetrics::Instance()->BeginOfRun(
+      run->GetRunID(), run->GetNumberOfEventToBeProcessed(),
+      static_cast<const B1Run*>(run)->GetNumberOfDetectors());
+    B1RunSnapshots::Instance()->BeginOfRun(
+      run->GetRunID(), run->GetNumberOfEventToBeProcessed());
+    B1CutTuner::Instance()->BeginOfRun();
+    B1FastShapes::Instance()->BeginOfRun();
+    B1QuasiRandom::Instance()->BeginOfRun();
+    B1Perturbation::Instance()->BeginOfRun();
+    B1CorrelatedSampling::Instance()->BeginOfRun(
+      run->GetNumberOfEventToBeProcessed(),
+      static_cast<const B1Run*>(run)->GetNumberOfDetectors());
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunAction::ReplayRun(const G4Run* run)
+{
+  fReplaying = true;
+  EndOfRunAction(run);
+  fReplaying = false;
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 void B1RunAction::EndOfRunAction(const G4Run* run)
 {
+  // a replayed run only reports its doses, the hooks below opt in
+  G4bool simulated = !fReplaying;
+
   G4int nofEvents = run->GetNumberOfEvent();
+  if (IsMaster() && simulated) {
+    fEventLoopTimer.Stop();
+    if (nofEvents > 0) {
+      G4cout << " Event loop: " << nofEvents << " events in "
+             << fEventLoopTimer.GetRealElapsed() << " s" << G4endl;
+    }
+  }
+  if (simulated) {
+    B1PhaseSpaceWriter::Instance()->EndOfRun(IsMaster(), nofEvents);
+  }
+  if (IsMaster() && simulated) {
+    B1EventStream::Instance()->EndOfRun();
+    B1StepTrace::Instance()->EndOfRun();
+    B1RunMetrics::Instance()->EndOfRun(static_cast<const B1Run*>(run));
+    B1RunSnapshots::Instance()->EndOfRun(static_cast<const B1Run*>(run));
+  }
   if (nofEvents == 0) return;
+  // the adjoint runs are scored by B1AdjointScan only
+  if (B1AdjointScan::Instance()->IsActive()) return;
   
   const B1Run* b1Run = static_cast<const B1Run*>(run);
+  if (simulated) B1FastShapes::Instance()->EndOfRun(IsMaster(), b1Run);
+
+  G4Timer outputTimer;
+  outputTimer.Start();
 
   // Compute dose
   //
@@ -107,32 +224,35 @@ void B1RunAction::EndOfRunAction(const G4Run* run)
   //G4double dose = edep/mass;
   //G4double rmsDose = rms/mass;
 
-  G4LogicalVolume** volumes = detectorConstruction->GetScoringVolumes();
-  G4int volumesCount = 16;//(G4int)(sizeof(*volumes) / sizeof(G4LogicalVolume*));
+  const std::vector<G4LogicalVolume*>& volumes
+    = detectorConstruction->GetScoringVolumes();
+  G4int volumesCount = (G4int)volumes.size();
 
-  G4double masses[volumesCount];
+  std::vector<G4double> masses(volumesCount);
   for(int i = 0; i < volumesCount; i++)
   {
 	 masses[i] = volumes[i]->GetMass();
   }
 
-  G4double doses[volumesCount];
+  std::vector<G4double> doses(volumesCount);
   for(int i = 0; i < volumesCount; i++)
   {
 	  doses[i] = edep / masses[i];
   }
 
-  G4double rmsDoses[volumesCount];
+  std::vector<G4double> rmsDoses(volumesCount);
   for(int i = 0; i < volumesCount; i++)
   {
 	  rmsDoses[i] = rms / masses[i];
   }
 
   // Getting masses of the solids
-  G4LogicalVolume** solids_volumes = detectorConstruction->GetSolidVolumes();
+  const std::vector<G4LogicalVolume*>& solids_volumes
+    = detectorConstruction->GetSolidVolumes();
 
-  G4double solids_masses[volumesCount];
-  for(int i = 0; i < volumesCount; i++)
+  // an imported geometry may have fewer shapes than detectors
+  std::vector<G4double> solids_masses(volumesCount, 0.);
+  for(int i = 0; i < volumesCount && i < (int)solids_volumes.size(); i++)
   {
 	  solids_masses[i] = solids_volumes[i]->GetMass();
   }
@@ -147,11 +267,36 @@ void B1RunAction::EndOfRunAction(const G4Run* run)
   if (generatorAction)
   {
     const G4ParticleGun* particleGun = generatorAction->GetParticleGun();
-    runCondition += particleGun->GetParticleDefinition()->GetParticleName();
-    runCondition += " of ";
-    G4double particleEnergy = particleGun->GetParticleEnergy();
-    runCondition += G4BestUnit(particleEnergy,"Energy");
+    const B1EnergySpectrum* spectrum = generatorAction->GetSpectrum();
+    const B1PhaseSpaceReader* phaseSpace = generatorAction->GetPhaseSpace();
+    if (generatorAction->GetNumberOfComponents() > 0) {
+      std::ostringstream description;
+      description << "mixed field of "
+                  << generatorAction->GetNumberOfComponents() << " components";
+      runCondition += description.str();
+    }
+    else if (phaseSpace) {
+      std::ostringstream description;
+      description << "phase-space histories from " << phaseSpace->GetFileName()
+                  << " (" << phaseSpace->GetNumberOfRecords() << " records of "
+                  << phaseSpace->GetNumberOfHistories() << " histories)";
+      runCondition += description.str();
+    }
+    else {
+      runCondition += particleGun->GetParticleDefinition()->GetParticleName();
+      runCondition += " of ";
+      if (spectrum) {
+        runCondition += "spectrum " + spectrum->GetFileName() + " (mean ";
+        runCondition += G4BestUnit(spectrum->GetMeanEnergy(),"Energy");
+        runCondition += ")";
+      }
+      else {
+        G4double particleEnergy = particleGun->GetParticleEnergy();
+        runCondition += G4BestUnit(particleEnergy,"Energy");
+      }
+    }
   }
+  if (fReplaying) runCondition += " (read from the result cache)";
         
   // Print
   //  
@@ -187,13 +332,131 @@ void B1RunAction::EndOfRunAction(const G4Run* run)
   			  static_cast<int>(volumesCount));
 
   int j = counter++;
-  fprintf(outputToPlot, "%d\t%s\t%s +- %s\r\n", j, G4String(G4BestUnit(solids_masses[j],"Mass")).c_str(), G4String(G4BestUnit(doses[0],"Dose")).c_str(), G4String(G4BestUnit(rmsDoses[0],"Dose")).c_str());
+  G4double solidMass = (j < volumesCount) ? solids_masses[j] : 0.;
+  fprintf(outputToPlot, "%d\t%s\t%s +- %s\r\n", j, G4String(G4BestUnit(solidMass,"Mass")).c_str(), G4String(G4BestUnit(doses[0],"Dose")).c_str(), G4String(G4BestUnit(rmsDoses[0],"Dose")).c_str());
 
   fflush(output);
   fflush(outputToPlot);
 
   fclose(output);
   fclose(outputToPlot);
+
+  // deposit and track-length kerma per detector, with the standard errors
+  // of the run totals and the ratio of their variances
+  if (IsMaster()) {
+    G4cout << "\n Dose per detector: deposit vs track-length collision kerma\n"
+           << " detector        deposit                    kerma"
+              "              var ratio" << G4endl;
+    for (G4int d = 0; d < b1Run->GetNumberOfDetectors(); d++) {
+      G4double mass = volumes[d]->GetMass();
+      G4double sum  = b1Run->GetDetectorEdep(d);
+      G4double var  = b1Run->GetDetectorEdep2(d) - sum*sum/nofEvents;
+      G4double sumK = b1Run->GetDetectorKerma(d);
+      G4double varK = b1Run->GetDetectorKerma2(d) - sumK*sumK/nofEvents;
+      if (var < 0.) var = 0.;
+      if (varK < 0.) varK = 0.;
+      G4cout << std::setw(9) << d << "  "
+             << std::setw(12) << G4BestUnit(sum/mass, "Dose") << " +- "
+             << std::setw(12) << G4BestUnit(std::sqrt(var)/mass, "Dose") << "  "
+             << std::setw(12) << G4BestUnit(sumK/mass, "Dose") << " +- "
+             << std::setw(12) << G4BestUnit(std::sqrt(varK)/mass, "Dose") << "  "
+             << std::setw(8) << (varK > 0. ? var/varK : 0.)
+             << G4endl;
+    }
+  }
+
+  // dose per primary of the mixed field, split by source component
+  if (IsMaster() && b1Run->HasSourceComponents()) {
+    const std::vector<G4String>& names = b1Run->GetComponentNames();
+    G4int nofComponents = (G4int)names.size();
+    G4cout << "\n Dose per detector and source component "
+              "(per primary of the mixed field)\n";
+    for (G4int c = 0; c < nofComponents; c++) {
+      G4cout << "   component " << c << ": " << names[c] << ", "
+             << b1Run->GetComponentEvents(c) << " events ("
+             << 100.*b1Run->GetComponentEvents(c)/nofEvents << " %)\n";
+    }
+    G4cout << " detector";
+    for (G4int c = 0; c < nofComponents; c++) {
+      G4cout << std::setw(22) << c;
+    }
+    G4cout << G4endl;
+    for (G4int d = 0; d < b1Run->GetNumberOfDetectors(); d++) {
+      G4double mass = volumes[d]->GetMass();
+      G4cout << std::setw(9) << d;
+      for (G4int c = 0; c < nofComponents; c++) {
+        G4double sum = b1Run->GetComponentEdep(c, d);
+        G4double var = b1Run->GetComponentEdep2(c, d) - sum*sum/nofEvents;
+        G4double relative = (sum > 0. && var > 0.) ? std::sqrt(var)/sum : 0.;
+        G4cout << "  " << std::setw(12) << G4BestUnit(sum/nofEvents/mass, "Dose")
+               << " " << std::setw(3) << (G4int)(100.*relative + 0.5) << "%";
+      }
+      G4cout << G4endl;
+    }
+  }
+
+  if (IsMaster() && simulated) {
+    B1ResponseKernel::Instance()->EndOfRun(b1Run);
+    B1EnergyResponse::Instance()->EndOfRun(b1Run);
+    B1QuasiRandom::Instance()->EndOfRun(b1Run);
+    B1Perturbation::Instance()->EndOfRun(b1Run);
+    B1UncollidedDose::Instance()->EndOfRun(b1Run);
+    B1ResultCache::Instance()->EndOfRun(b1Run);
+    B1CutTuner::Instance()->EndOfRun(b1Run);
+  }
+  // the sweeps take the doses of replayed runs as well
+  if (IsMaster()) B1AdaptiveSweep::Instance()->EndOfRun(b1Run);
+  if (IsMaster()) B1SurrogateModel::Instance()->EndOfRun(b1Run);
+
+  if (IsMaster() && simulated && b1Run->GetPulseHeight()) {
+    if (b1Run->GetPulseHeight()->Write(fPulseHeightFile, nofEvents)) {
+      G4cout << " Pulse-height spectra written to " << fPulseHeightFile
+             << G4endl;
+    }
+  }
+
+  outputTimer.Stop();
+  if (IsMaster() && simulated) {
+    B1RunMetrics::Instance()->AddPhaseTime("output",
+                                           outputTimer.GetRealElapsed());
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunAction::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/pulseHeight/",
+                                      "Per-detector pulse-height spectra");
+
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareProperty("file", fPulseHeightFile,
+        "Output file of the spectra, written at the end of each run "
+        "(empty string to disable).");
+  fileCmd.SetParameterName("fileName", true);
+  fileCmd.SetDefaultValue("");
+
+  G4GenericMessenger::Command& binsCmd
+    = fMessenger->DeclareProperty("nBins", fPulseHeightBins,
+        "Number of energy bins.");
+  binsCmd.SetParameterName("nBins", false);
+  binsCmd.SetRange("nBins>0");
+
+  G4GenericMessenger::Command& eMinCmd
+    = fMessenger->DeclarePropertyWithUnit("eMin", "keV", fPulseHeightEMin,
+        "Lower edge of the first bin.");
+  eMinCmd.SetParameterName("eMin", false);
+
+  G4GenericMessenger::Command& eMaxCmd
+    = fMessenger->DeclarePropertyWithUnit("eMax", "MeV", fPulseHeightEMax,
+        "Upper edge of the last bin.");
+  eMaxCmd.SetParameterName("eMax", false);
+
+  G4GenericMessenger::Command& logCmd
+    = fMessenger->DeclareProperty("logBinning", fPulseHeightLog,
+        "Use bins of equal width in log(E).");
+  logCmd.SetParameterName("flag", true);
+  logCmd.SetDefaultValue("true");
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,349 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1RunMetrics.cc
+/// \brief Implementation of the B1RunMetrics class
+
+#include "B1RunMetrics.hh"
+#include "B1MemoryUsage.hh"
+#include "B1Run.hh"
+
+#include "G4RunManager.hh"
+#include "G4GenericMessenger.hh"
+#include "G4Threading.hh"
+#include "G4SystemOfUnits.hh"
+
+#ifdef G4MULTITHREADED
+#include "G4MTRunManager.hh"
+#endif
+
+#include <sstream>
+#include <cstdio>
+#include <cmath>
+
+namespace
+{
+  const uint64_t publishEvery = 1000;
+}
+
+B1RunMetrics* B1RunMetrics::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1RunMetrics* B1RunMetrics::Instance()
+{
+  if (!fgInstance) fgInstance = new B1RunMetrics;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1RunMetrics::B1RunMetrics()
+: fMessenger(0),
+  fInterval(10.*s),
+  fActive(false),
+  fRunID(-1),
+  fEventsRequested(0),
+  fRunning(false),
+  fThread(0),
+  fStop(false)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1RunMetrics::~B1RunMetrics()
+{
+  SetFileName("none");
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunMetrics::SetFileName(G4String fileName)
+{
+  G4bool active = !(fileName == "none" || fileName.empty());
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fFileName = active ? fileName : G4String();
+    fActive = active;
+    fStop = !active;
+  }
+
+  if (active && !fThread) {
+    fThread = new std::thread(&B1RunMetrics::Loop, this);
+  }
+  else if (!active && fThread) {
+    fWakeUp.notify_all();
+    fThread->join();
+    delete fThread;
+    fThread = 0;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunMetrics::SetInterval(G4double interval)
+{
+  std::lock_guard<std::mutex> lock(fMutex);
+  fInterval = interval;
+  fWakeUp.notify_all();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunMetrics::BeginOfRun(G4int runID, G4int nofEventsRequested,
+                              G4int nofDetectors)
+{
+  if (!fActive) return;
+
+  G4int nofThreads = 1;
+#ifdef G4MULTITHREADED
+  G4MTRunManager* mtRunManager
+    = dynamic_cast<G4MTRunManager*>(G4RunManager::GetRunManager());
+  if (mtRunManager) nofThreads = mtRunManager->GetNumberOfThreads();
+#endif
+
+  // the workers start their events after this, so the slots stay put
+  std::lock_guard<std::mutex> lock(fMutex);
+  ThreadSlot empty;
+  empty.fEvents = 0;
+  empty.fPublishedEvents = 0.;
+  empty.fSum.assign(nofDetectors, 0.);
+  empty.fSum2.assign(nofDetectors, 0.);
+  empty.fLastEvents = 0;
+  fSlots.assign(nofThreads, empty);
+
+  fRunID = runID;
+  fEventsRequested = nofEventsRequested;
+  fRunning = true;
+  fRunStart = std::chrono::steady_clock::now();
+  fLastWrite = fRunStart;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunMetrics::EndOfEvent(const B1Run* run)
+{
+  // nothing to count or publish once the exporter is turned off
+  if (!fActive) return;
+
+  G4int slot = G4Threading::G4GetThreadId();
+  if (slot < 0) slot = 0;
+  if (slot >= (G4int)fSlots.size()) return;
+
+  ThreadSlot& threadSlot = fSlots[slot];
+  uint64_t events = threadSlot.fEvents + 1;
+  __atomic_store_n(&threadSlot.fEvents, events, __ATOMIC_RELAXED);
+  if (events % publishEvery) return;
+
+  std::lock_guard<std::mutex> lock(fMutex);
+  threadSlot.fPublishedEvents = (G4double)events;
+  for (size_t d = 0; d < threadSlot.fSum.size(); d++) {
+    threadSlot.fSum[d]  = run->GetDetectorEdep(d);
+    threadSlot.fSum2[d] = run->GetDetectorEdep2(d);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunMetrics::EndOfRun(const B1Run* run)
+{
+  if (!fActive) return;
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    if (fRunning) {
+      fPhaseSeconds["run"] += std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - fRunStart).count();
+    }
+    fRunning = false;
+
+    // the merged run replaces the sums published every 1000 events, the
+    // relative errors then cover all the events of the run
+    if (run->GetNumberOfEvent() > 0) {
+      for (size_t t = 0; t < fSlots.size(); t++) {
+        ThreadSlot& threadSlot = fSlots[t];
+        threadSlot.fPublishedEvents = 0.;
+        threadSlot.fSum.assign(threadSlot.fSum.size(), 0.);
+        threadSlot.fSum2.assign(threadSlot.fSum2.size(), 0.);
+      }
+      if (!fSlots.empty()) {
+        ThreadSlot& total = fSlots[0];
+        total.fPublishedEvents = run->GetNumberOfEvent();
+        for (size_t d = 0; d < total.fSum.size()
+                           && (G4int)d < run->GetNumberOfDetectors(); d++) {
+          total.fSum[d]  = run->GetDetectorEdep(d);
+          total.fSum2[d] = run->GetDetectorEdep2(d);
+        }
+      }
+    }
+  }
+  Write();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunMetrics::AddPhaseTime(const G4String& phase, G4double seconds)
+{
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fPhaseSeconds[phase] += seconds;
+  }
+  if (fActive && phase == "output") Write();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunMetrics::Loop()
+{
+  std::unique_lock<std::mutex> lock(fMutex);
+  while (!fStop) {
+    std::chrono::duration<double> interval(fInterval/s);
+    if (fWakeUp.wait_for(lock, interval) == std::cv_status::no_timeout) {
+      continue;  // new settings or stop
+    }
+    lock.unlock();
+    Write();
+    lock.lock();
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunMetrics::Write()
+{
+  // under the lock also for the file, the master and the thread may both
+  // write; the file is small and the workers take the lock rarely
+  std::lock_guard<std::mutex> lock(fMutex);
+  if (fFileName.empty()) return;
+
+  std::ostringstream text;
+
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  G4double elapsed
+    = std::chrono::duration<double>(now - fLastWrite).count();
+  fLastWrite = now;
+
+  uint64_t events = 0;
+  std::vector<G4double> rates(fSlots.size(), 0.);
+  for (size_t t = 0; t < fSlots.size(); t++) {
+    uint64_t threadEvents
+      = __atomic_load_n(&fSlots[t].fEvents, __ATOMIC_RELAXED);
+    if (elapsed > 0.) rates[t] = (threadEvents - fSlots[t].fLastEvents)/elapsed;
+    fSlots[t].fLastEvents = threadEvents;
+    events += threadEvents;
+  }
+
+  text << "# HELP b1_run_id Identifier of the current or last run.\n"
+       << "# TYPE b1_run_id gauge\n"
+       << "b1_run_id " << fRunID << "\n"
+       << "# HELP b1_events_processed_total Events processed in the run.\n"
+       << "# TYPE b1_events_processed_total counter\n"
+       << "b1_events_processed_total " << events << "\n"
+       << "# HELP b1_events_requested Events requested for the run.\n"
+       << "# TYPE b1_events_requested gauge\n"
+       << "b1_events_requested " << fEventsRequested << "\n"
+       << "# HELP b1_events_per_second Event rate of each worker thread.\n"
+       << "# TYPE b1_events_per_second gauge\n";
+  for (size_t t = 0; t < rates.size(); t++) {
+    text << "b1_events_per_second{thread=\"" << t << "\"} "
+         << (fRunning ? rates[t] : 0.) << "\n";
+  }
+
+  // relative error of the mean deposit, from the published sums
+  text << "# HELP b1_detector_relative_error Relative standard error "
+          "of the dose per detector.\n"
+       << "# TYPE b1_detector_relative_error gauge\n";
+  size_t nofDetectors = fSlots.empty() ? 0 : fSlots[0].fSum.size();
+  for (size_t d = 0; d < nofDetectors; d++) {
+    G4double n = 0., sum = 0., sum2 = 0.;
+    for (size_t t = 0; t < fSlots.size(); t++) {
+      n    += fSlots[t].fPublishedEvents;
+      sum  += fSlots[t].fSum[d];
+      sum2 += fSlots[t].fSum2[d];
+    }
+    G4double error = 1.;
+    if (n > 1. && sum > 0.) {
+      G4double variance = (sum2 - sum*sum/n)/(n - 1.);
+      error = (variance > 0.) ? std::sqrt(variance*n)/sum : 0.;
+    }
+    text << "b1_detector_relative_error{detector=\"" << d << "\"} "
+         << error << "\n";
+  }
+
+  text << "# HELP b1_resident_memory_bytes Resident memory of the process.\n"
+       << "# TYPE b1_resident_memory_bytes gauge\n"
+       << "b1_resident_memory_bytes " << B1MemoryUsage::GetResidentSize() << "\n"
+       << "# HELP b1_phase_seconds Wall-clock time spent per phase.\n"
+       << "# TYPE b1_phase_seconds counter\n";
+  std::map<G4String, G4double> phases = fPhaseSeconds;
+  if (fRunning) {
+    phases["run"] += std::chrono::duration<double>(now - fRunStart).count();
+  }
+  std::map<G4String, G4double>::const_iterator it;
+  for (it = phases.begin(); it != phases.end(); ++it) {
+    text << "b1_phase_seconds{phase=\"" << it->first << "\"} "
+         << it->second << "\n";
+  }
+
+  // atomic replacement, a scraper sees the old or the new file
+  G4String temporary = fFileName + ".tmp";
+  FILE* output = fopen(temporary.c_str(), "w");
+  if (!output) return;
+  std::string content = text.str();
+  fwrite(content.data(), 1, content.size(), output);
+  fclose(output);
+  std::rename(temporary.c_str(), fFileName.c_str());
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunMetrics::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/metrics/",
+                                      "Live run metrics file");
+
+  // the metrics are collected by the master, the commands act on it
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareMethod("file", &B1RunMetrics::SetFileName,
+        "Rewrite the given file with the run metrics in the Prometheus "
+        "text format (none to stop).");
+  fileCmd.SetParameterName("fileName", false);
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& intervalCmd
+    = fMessenger->DeclareMethodWithUnit("interval", "s",
+        &B1RunMetrics::SetInterval,
+        "Time between two updates of the metrics file.");
+  intervalCmd.SetParameterName("interval", false);
+  intervalCmd.SetRange("interval>0.");
+  intervalCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
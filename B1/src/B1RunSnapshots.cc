@@ -0,0 +1,456 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1RunSnapshots.cc
+/// \brief Implementation of the B1RunSnapshots class
+
+#include "B1RunSnapshots.hh"
+#include "B1DetectorConstruction.hh"
+#include "B1Run.hh"
+
+#include "G4RunManager.hh"
+#include "G4GenericMessenger.hh"
+#include "G4LogicalVolume.hh"
+#include "G4Threading.hh"
+#include "G4SystemOfUnits.hh"
+
+#ifdef G4MULTITHREADED
+#include "G4MTRunManager.hh"
+#endif
+
+#include <algorithm>
+#include <sstream>
+#include <cstdio>
+#include <cmath>
+
+namespace
+{
+  const uint64_t publishEvery = 100;
+  const G4double eventsPollTime = 0.25;  // s, for the event trigger
+  const size_t stressDetectors = 64;
+
+  // the buffer values are read while a worker may rewrite them, relaxed
+  // atomic accesses ordered by the fences around the sequence counter
+  inline void StoreRelaxed(G4double& value, G4double x)
+  {
+    __atomic_store(&value, &x, __ATOMIC_RELAXED);
+  }
+
+  inline G4double LoadRelaxed(const G4double& value)
+  {
+    G4double x;
+    __atomic_load(&value, &x, __ATOMIC_RELAXED);
+    return x;
+  }
+}
+
+B1RunSnapshots* B1RunSnapshots::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1RunSnapshots* B1RunSnapshots::Instance()
+{
+  if (!fgInstance) fgInstance = new B1RunSnapshots;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1RunSnapshots::B1RunSnapshots()
+: fMessenger(0),
+  fEvents(0),
+  fInterval(30.*s),
+  fActive(false),
+  fRunID(-1),
+  fEventsRequested(0),
+  fRunning(false),
+  fNextEvents(0.),
+  fThread(0),
+  fStop(false)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1RunSnapshots::~B1RunSnapshots()
+{
+  SetFileName("none");
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunSnapshots::SetFileName(G4String fileName)
+{
+  G4bool active = !(fileName == "none" || fileName.empty());
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fFileName = active ? fileName : G4String();
+    fActive = active;
+    fStop = !active;
+  }
+
+  if (active && !fThread) {
+    fThread = new std::thread(&B1RunSnapshots::Loop, this);
+  }
+  else if (!active && fThread) {
+    fWakeUp.notify_all();
+    fThread->join();
+    delete fThread;
+    fThread = 0;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunSnapshots::SetEvents(G4int events)
+{
+  std::lock_guard<std::mutex> lock(fMutex);
+  fEvents = events;
+  fNextEvents = events;
+  fWakeUp.notify_all();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunSnapshots::SetInterval(G4double interval)
+{
+  std::lock_guard<std::mutex> lock(fMutex);
+  fInterval = interval;
+  fWakeUp.notify_all();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunSnapshots::BeginOfRun(G4int runID, G4int nofEventsRequested)
+{
+  if (!fActive) return;
+
+  G4int nofThreads = 1;
+#ifdef G4MULTITHREADED
+  G4MTRunManager* mtRunManager
+    = dynamic_cast<G4MTRunManager*>(G4RunManager::GetRunManager());
+  if (mtRunManager) nofThreads = mtRunManager->GetNumberOfThreads();
+#endif
+
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  const std::vector<G4LogicalVolume*>& volumes
+    = detectorConstruction->GetScoringVolumes();
+
+  // the workers start their events after this, so the slots stay put
+  std::lock_guard<std::mutex> lock(fMutex);
+  fMasses.resize(volumes.size());
+  for (size_t d = 0; d < volumes.size(); d++) {
+    fMasses[d] = volumes[d]->GetMass();
+  }
+
+  ThreadSlot empty;
+  empty.fEvents = 0;
+  empty.fSequence = 0;
+  empty.fBuffer.fEvents = 0.;
+  empty.fBuffer.fSum.assign(volumes.size(), 0.);
+  empty.fBuffer.fSum2.assign(volumes.size(), 0.);
+  fSlots.assign(nofThreads, empty);
+
+  fRunID = runID;
+  fEventsRequested = nofEventsRequested;
+  fRunning = true;
+  fNextEvents = fEvents;
+  fRunStart = std::chrono::steady_clock::now();
+  fLastWrite = fRunStart;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunSnapshots::EndOfEvent(const B1Run* run)
+{
+  G4int slot = G4Threading::G4GetThreadId();
+  if (slot < 0) slot = 0;
+  if (slot >= (G4int)fSlots.size()) return;
+
+  ThreadSlot& threadSlot = fSlots[slot];
+  if (++threadSlot.fEvents % publishEvery) return;
+  Publish(threadSlot, run);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunSnapshots::Publish(ThreadSlot& slot, const B1Run* run)
+{
+  // odd sequence while writing: a reader which saw the even value before
+  // and sees any of these stores sees the odd value or a later one after
+  uint64_t sequence = __atomic_load_n(&slot.fSequence, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot.fSequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  Buffer& buffer = slot.fBuffer;
+  StoreRelaxed(buffer.fEvents, (G4double)slot.fEvents);
+  for (size_t d = 0; d < buffer.fSum.size(); d++) {
+    StoreRelaxed(buffer.fSum[d], run ? run->GetDetectorEdep(d)
+                                     : (G4double)slot.fEvents);
+    StoreRelaxed(buffer.fSum2[d], run ? run->GetDetectorEdep2(d)
+                                      : (G4double)slot.fEvents*slot.fEvents);
+  }
+
+  __atomic_store_n(&slot.fSequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunSnapshots::Read(const ThreadSlot& slot, Buffer& copy)
+{
+  const Buffer& buffer = slot.fBuffer;
+  copy.fSum.resize(buffer.fSum.size());
+  copy.fSum2.resize(buffer.fSum2.size());
+  for (;;) {
+    uint64_t before = __atomic_load_n(&slot.fSequence, __ATOMIC_ACQUIRE);
+    if (before & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    copy.fEvents = LoadRelaxed(buffer.fEvents);
+    for (size_t d = 0; d < buffer.fSum.size(); d++) {
+      copy.fSum[d]  = LoadRelaxed(buffer.fSum[d]);
+      copy.fSum2[d] = LoadRelaxed(buffer.fSum2[d]);
+    }
+    // the copy is good if no write started meanwhile
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot.fSequence, __ATOMIC_RELAXED) == before) return;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunSnapshots::EndOfRun(const B1Run* run)
+{
+  if (!fActive) return;
+
+  std::lock_guard<std::mutex> lock(fMutex);
+  fRunning = false;
+  if (run->GetNumberOfEvent() == 0) return;
+
+  // the merged run of the master replaces the last snapshot
+  Buffer total;
+  total.fEvents = run->GetNumberOfEvent();
+  total.fSum.resize(run->GetNumberOfDetectors());
+  total.fSum2.resize(run->GetNumberOfDetectors());
+  for (G4int d = 0; d < run->GetNumberOfDetectors(); d++) {
+    total.fSum[d]  = run->GetDetectorEdep(d);
+    total.fSum2[d] = run->GetDetectorEdep2(d);
+  }
+  Write(total, true);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunSnapshots::Loop()
+{
+  std::unique_lock<std::mutex> lock(fMutex);
+  while (!fStop) {
+    G4double wait = fInterval/s;
+    if (fEvents > 0) wait = std::min(wait, eventsPollTime);
+    std::chrono::duration<double> interval(wait);
+    if (fWakeUp.wait_for(lock, interval) == std::cv_status::no_timeout) {
+      continue;  // new settings or stop
+    }
+    if (!fRunning) continue;
+
+    Buffer total;
+    Collect(total);
+    G4double elapsed = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - fLastWrite).count();
+    G4bool eventsDue = fEvents > 0 && total.fEvents >= fNextEvents;
+    if (eventsDue || elapsed >= fInterval/s) {
+      if (fEvents > 0) {
+        fNextEvents = (std::floor(total.fEvents/fEvents) + 1.)*fEvents;
+      }
+      Write(total, false);
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunSnapshots::Collect(Buffer& total)
+{
+  size_t nofDetectors = fMasses.size();
+  total.fEvents = 0.;
+  total.fSum.assign(nofDetectors, 0.);
+  total.fSum2.assign(nofDetectors, 0.);
+
+  Buffer copy;
+  for (size_t t = 0; t < fSlots.size(); t++) {
+    Read(fSlots[t], copy);
+    total.fEvents += copy.fEvents;
+    for (size_t d = 0; d < nofDetectors && d < copy.fSum.size(); d++) {
+      total.fSum[d]  += copy.fSum[d];
+      total.fSum2[d] += copy.fSum2[d];
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunSnapshots::StressWriter(ThreadSlot* slot, G4int publications)
+{
+  for (G4int i = 0; i < publications; i++) {
+    slot->fEvents++;
+    Publish(*slot, 0);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunSnapshots::StressTest(G4int publications)
+{
+  // a writer thread publishes as fast as it can buffers whose values all
+  // follow from the publication number, the master reads them meanwhile:
+  // a torn copy mixes two publications
+  ThreadSlot slot;
+  slot.fEvents = 0;
+  slot.fSequence = 0;
+  slot.fBuffer.fEvents = 0.;
+  slot.fBuffer.fSum.assign(stressDetectors, 0.);
+  slot.fBuffer.fSum2.assign(stressDetectors, 0.);
+
+  std::thread writer(&B1RunSnapshots::StressWriter, &slot, publications);
+  uint64_t last = 2*(uint64_t)publications;
+  G4int reads = 0, torn = 0;
+  Buffer copy;
+  do {
+    Read(slot, copy);
+    reads++;
+    G4double n = copy.fEvents;
+    for (size_t d = 0; d < stressDetectors; d++) {
+      if (copy.fSum[d] != n || copy.fSum2[d] != n*n) {
+        torn++;
+        break;
+      }
+    }
+  } while (__atomic_load_n(&slot.fSequence, __ATOMIC_ACQUIRE) != last);
+  writer.join();
+
+  G4cout << "Snapshot stress test: " << reads << " reads of "
+         << publications << " publications, " << torn << " torn copies"
+         << G4endl;
+  if (torn > 0) {
+    G4ExceptionDescription msg;
+    msg << torn << " of " << reads << " snapshot reads mixed two "
+        << "publications of the worker.";
+    G4Exception("B1RunSnapshots::StressTest()", "MyCode0028",
+                FatalException, msg);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunSnapshots::Write(const Buffer& total, G4bool final)
+{
+  // called with the lock held
+  if (fFileName.empty()) return;
+
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  G4double elapsed = std::chrono::duration<double>(now - fRunStart).count();
+  fLastWrite = now;
+
+  G4double n = total.fEvents;
+  std::ostringstream text;
+  text << "# dose snapshot of example B1\n"
+       << "run " << fRunID << "\n"
+       << "state " << (final ? "final" : "running") << "\n"
+       << "events " << n << " of " << fEventsRequested << "\n"
+       << "elapsed " << elapsed << " s\n"
+       << "rate " << (elapsed > 0. ? n/elapsed : 0.) << " events/s\n"
+       << "# detector  dose per primary [Gy]  standard error [Gy]"
+          "  relative error\n";
+  for (size_t d = 0; d < total.fSum.size() && d < fMasses.size(); d++) {
+    G4double sum = total.fSum[d];
+    G4double mean = 0., error = 0.;
+    if (n > 0.) mean = sum/n;
+    if (n > 1.) {
+      G4double variance = (total.fSum2[d] - sum*sum/n)/(n - 1.);
+      if (variance > 0.) error = std::sqrt(variance/n);
+    }
+    text << d << " " << mean/fMasses[d]/gray << " " << error/fMasses[d]/gray
+         << " " << (mean > 0. ? error/mean : 1.) << "\n";
+  }
+
+  // atomic replacement, a reader sees the old or the new snapshot
+  G4String temporary = fFileName + ".tmp";
+  FILE* output = fopen(temporary.c_str(), "w");
+  if (!output) return;
+  std::string content = text.str();
+  fwrite(content.data(), 1, content.size(), output);
+  fclose(output);
+  std::rename(temporary.c_str(), fFileName.c_str());
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RunSnapshots::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/snapshot/",
+                                      "Dose snapshots during a run");
+
+  // the snapshots are written by the master, the commands act on it
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareMethod("file", &B1RunSnapshots::SetFileName,
+        "Rewrite the given file with the dose per detector during the "
+        "runs (none to stop).");
+  fileCmd.SetParameterName("fileName", false);
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& eventsCmd
+    = fMessenger->DeclareMethod("events", &B1RunSnapshots::SetEvents,
+        "Events of the run between two snapshots (0 for the interval "
+        "only).");
+  eventsCmd.SetParameterName("events", false);
+  eventsCmd.SetRange("events>=0");
+  eventsCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& intervalCmd
+    = fMessenger->DeclareMethodWithUnit("interval", "s",
+        &B1RunSnapshots::SetInterval,
+        "Longest time between two snapshots.");
+  intervalCmd.SetParameterName("interval", false);
+  intervalCmd.SetRange("interval>0.");
+  intervalCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& stressCmd
+    = fMessenger->DeclareMethod("stressTest", &B1RunSnapshots::StressTest,
+        "Publish snapshots from a thread against the reader of the master, "
+        "abort on a torn copy.");
+  stressCmd.SetParameterName("publications", false);
+  stressCmd.SetRange("publications>0");
+  stressCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,347 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1StepTrace.cc
+/// \brief Implementation of the B1StepTrace class
+
+#include "B1StepTrace.hh"
+
+#include "G4Step.hh"
+#include "G4Event.hh"
+#include "G4EventManager.hh"
+#include "G4Track.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4VProcess.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4GenericMessenger.hh"
+#include "G4Threading.hh"
+#include "G4AutoLock.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+namespace
+{
+  G4Mutex stepTraceMutex = G4MUTEX_INITIALIZER;
+
+  const char stepTraceMagic[8] = { 'B','1','S','T','R','0','0','1' };
+}
+
+/// Ring buffer of one thread, with its sampling state and the indices
+/// of the volumes, particles and processes it has met.
+
+struct B1StepTrace::Buffer
+{
+  Buffer() : fSampled(0), fSteps(0), fSkip(1), fRandom(0) {}
+
+  std::vector<B1StepTraceRecord> fRecords;
+  uint64_t fSampled;   // records written, the ring position is fSampled % size
+  uint64_t fSteps;
+  G4int    fSkip;      // steps to the next sample
+  uint64_t fRandom;    // xorshift state, apart from the physics engine
+  std::map<const void*, G4int> fVolumes, fParticles, fProcesses;
+};
+
+B1StepTrace* B1StepTrace::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1StepTrace* B1StepTrace::Instance()
+{
+  if (!fgInstance) fgInstance = new B1StepTrace;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1StepTrace::B1StepTrace()
+: fMessenger(0),
+  fRate(0.001),
+  fCapacity(1000000),
+  fActive(false),
+  fRunID(0)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1StepTrace::~B1StepTrace()
+{
+  for (size_t i = 0; i < fBuffers.size(); i++) delete fBuffers[i];
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1StepTrace::SetFileName(G4String fileName)
+{
+  fActive = !(fileName == "none" || fileName.empty());
+  fFileName = fActive ? fileName : G4String();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1StepTrace::SetRate(G4double rate)
+{
+  fRate = std::min(rate, 1.);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1StepTrace::Buffer* B1StepTrace::GetBuffer()
+{
+  static G4ThreadLocal Buffer* buffer = 0;
+  if (!buffer) {
+    buffer = new Buffer;
+    buffer->fRecords.resize(fCapacity);
+    G4int thread = G4Threading::G4GetThreadId();
+    buffer->fRandom = 0x9e3779b97f4a7c15ULL*(uint64_t)(thread + 2);
+    G4AutoLock lock(&stepTraceMutex);
+    fBuffers.push_back(buffer);
+  }
+  return buffer;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4int B1StepTrace::Register(std::vector<G4String>& names,
+                            const G4String& name, G4int maxNames)
+{
+  G4AutoLock lock(&stepTraceMutex);
+  for (size_t i = 0; i < names.size(); i++) {
+    if (names[i] == name) return (G4int)i;
+  }
+  if ((G4int)names.size() >= maxNames) return maxNames;
+  names.push_back(name);
+  return (G4int)names.size() - 1;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1StepTrace::ProcessStep(const G4Step* step)
+{
+  Buffer* buffer = GetBuffer();
+  buffer->fSteps++;
+  if (--buffer->fSkip > 0) return;
+
+  // geometric gap to the next sample
+  uint64_t& x = buffer->fRandom;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  G4double u = ((x*0x2545f4914f6cdd1dULL) >> 11)*(1./9007199254740992.);
+  buffer->fSkip = (fRate >= 1.) ? 1
+    : 1 + (G4int)std::min(std::log(1. - u)/std::log(1. - fRate), 1.e9);
+
+  const G4Track* track = step->GetTrack();
+  const G4StepPoint* prePoint = step->GetPreStepPoint();
+  const G4StepPoint* postPoint = step->GetPostStepPoint();
+  const G4VPhysicalVolume* volume = prePoint->GetTouchableHandle()->GetVolume();
+  const G4ParticleDefinition* particle = track->GetDefinition();
+  const G4VProcess* process = postPoint->GetProcessDefinedStep();
+
+  // indices, looked up in the shared tables once per thread
+  std::map<const void*, G4int>::const_iterator it;
+  it = buffer->fVolumes.find(volume);
+  G4int volumeIndex = (it != buffer->fVolumes.end()) ? it->second
+    : (buffer->fVolumes[volume]
+         = Register(fVolumes, volume->GetName(), kB1StepTraceOtherVolume));
+  it = buffer->fParticles.find(particle);
+  G4int particleIndex = (it != buffer->fParticles.end()) ? it->second
+    : (buffer->fParticles[particle]
+         = Register(fParticles, particle->GetParticleName(),
+                    kB1StepTraceOther));
+  it = buffer->fProcesses.find(process);
+  G4int processIndex = (it != buffer->fProcesses.end()) ? it->second
+    : (buffer->fProcesses[process]
+         = Register(fProcesses,
+                    process ? process->GetProcessName() : G4String("none"),
+                    kB1StepTraceOther));
+
+  B1StepTraceRecord& record
+    = buffer->fRecords[buffer->fSampled % buffer->fRecords.size()];
+  G4ThreeVector position = postPoint->GetPosition();
+  record.fX = (float)(position.x()/mm);
+  record.fY = (float)(position.y()/mm);
+  record.fZ = (float)(position.z()/mm);
+  record.fStepLength = (float)(step->GetStepLength()/mm);
+  record.fEdep = (float)(step->GetTotalEnergyDeposit()/MeV);
+  record.fKineticEnergy = (float)(postPoint->GetKineticEnergy()/MeV);
+  record.fGlobalTime = postPoint->GetGlobalTime()/ns;
+  record.fWallTime = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - fStart).count();
+  record.fEventID
+    = G4EventManager::GetEventManager()->GetConstCurrentEvent()->GetEventID();
+  record.fTrackID = track->GetTrackID();
+  record.fStepNumber = track->GetCurrentStepNumber();
+  record.fVolume = (uint16_t)volumeIndex;
+  record.fParticle = (uint8_t)particleIndex;
+  record.fProcess = (uint8_t)processIndex;
+  buffer->fSampled++;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1StepTrace::BeginOfRun(G4int runID)
+{
+  // the workers do not step yet
+  fRunID = runID;
+  fStart = std::chrono::steady_clock::now();
+  fVolumes.clear();
+  fParticles.clear();
+  fProcesses.clear();
+  for (size_t i = 0; i < fBuffers.size(); i++) {
+    Buffer* buffer = fBuffers[i];
+    buffer->fRecords.resize(fCapacity);
+    buffer->fSampled = 0;
+    buffer->fSteps = 0;
+    buffer->fVolumes.clear();
+    buffer->fParticles.clear();
+    buffer->fProcesses.clear();
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1StepTrace::EndOfRun()
+{
+  if (!fActive) return;
+
+  std::vector<Buffer*> buffers;
+  for (size_t i = 0; i < fBuffers.size(); i++) {
+    if (fBuffers[i]->fSteps > 0) buffers.push_back(fBuffers[i]);
+  }
+
+  std::string names;
+  for (size_t i = 0; i < fVolumes.size(); i++) {
+    names += fVolumes[i];
+    names += '\0';
+  }
+  for (size_t i = 0; i < fParticles.size(); i++) {
+    names += fParticles[i];
+    names += '\0';
+  }
+  for (size_t i = 0; i < fProcesses.size(); i++) {
+    names += fProcesses[i];
+    names += '\0';
+  }
+
+  FILE* output = fopen(fFileName.c_str(), "wb");
+  if (!output) {
+    G4ExceptionDescription msg;
+    msg << "Cannot write step trace " << fFileName;
+    G4Exception("B1StepTrace::EndOfRun()", "MyCode0018", JustWarning, msg);
+    return;
+  }
+  B1StepTraceHeader header;
+  std::memcpy(header.fMagic, stepTraceMagic, sizeof(header.fMagic));
+  header.fRunID = fRunID;
+  header.fNofSections = (uint32_t)buffers.size();
+  header.fSamplingRate = fRate;
+  header.fNofVolumes = (uint32_t)fVolumes.size();
+  header.fNofParticles = (uint32_t)fParticles.size();
+  header.fNofProcesses = (uint32_t)fProcesses.size();
+  header.fNamesSize = (uint32_t)names.size();
+  fwrite(&header, sizeof(header), 1, output);
+  fwrite(names.data(), 1, names.size(), output);
+
+  uint64_t steps = 0, sampled = 0, written = 0;
+  for (size_t b = 0; b < buffers.size(); b++) {
+    const Buffer* buffer = buffers[b];
+    uint64_t capacity = buffer->fRecords.size();
+    B1StepTraceSection section;
+    section.fSteps = buffer->fSteps;
+    section.fSampled = buffer->fSampled;
+    section.fNofRecords = std::min(buffer->fSampled, capacity);
+    fwrite(&section, sizeof(section), 1, output);
+
+    // oldest record first
+    uint64_t first = (buffer->fSampled > capacity) ? buffer->fSampled % capacity
+                                                   : 0;
+    const B1StepTraceRecord* records = &buffer->fRecords[0];
+    fwrite(records + first, sizeof(B1StepTraceRecord),
+           section.fNofRecords - first, output);
+    fwrite(records, sizeof(B1StepTraceRecord), first, output);
+
+    steps += section.fSteps;
+    sampled += section.fSampled;
+    written += section.fNofRecords;
+  }
+  G4bool complete = (ferror(output) == 0);
+  fclose(output);
+
+  G4cout << "Step trace: " << sampled << " of " << steps
+         << " steps sampled, " << written << " records of "
+         << buffers.size() << " threads written to " << fFileName << G4endl;
+  if (!complete) {
+    G4ExceptionDescription msg;
+    msg << "Step trace " << fFileName << " is incomplete.";
+    G4Exception("B1StepTrace::EndOfRun()", "MyCode0018", JustWarning, msg);
+  }
+  else if (written < sampled) {
+    G4cout << "Step trace: the oldest " << sampled - written
+           << " records were overwritten, raise /B1/stepTrace/capacity "
+              "to keep them" << G4endl;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1StepTrace::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/stepTrace/",
+                                      "Sampled step trace");
+
+  // the buffers are written by the master
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareMethod("file", &B1StepTrace::SetFileName,
+        "Record sampled steps, written to the given file at the end of "
+        "the run (none to disable).");
+  fileCmd.SetParameterName("fileName", false);
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& rateCmd
+    = fMessenger->DeclareMethod("rate", &B1StepTrace::SetRate,
+        "Fraction of the steps sampled.");
+  rateCmd.SetParameterName("rate", false);
+  rateCmd.SetRange("rate>0.");
+  rateCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& capacityCmd
+    = fMessenger->DeclareProperty("capacity", fCapacity,
+        "Records kept per thread, the latest ones.");
+  capacityCmd.SetParameterName("records", false);
+  capacityCmd.SetRange("records>0");
+  capacityCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
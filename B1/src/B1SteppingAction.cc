@@ -31,18 +31,31 @@
 #include "B1SteppingAction.hh"
 #include "B1EventAction.hh"
 #include "B1DetectorConstruction.hh"
+#include "B1PhaseSpace.hh"
+#include "B1AttenuationTable.hh"
+#include "B1FastShapes.hh"
+#include "B1StepTrace.hh"
+#include "B1Perturbation.hh"
 
 #include "G4Step.hh"
 #include "G4Event.hh"
 #include "G4RunManager.hh"
 #include "G4LogicalVolume.hh"
+#include "G4Gamma.hh"
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 B1SteppingAction::B1SteppingAction(B1EventAction* eventAction)
 : G4UserSteppingAction(),
   fEventAction(eventAction),
-  fScoringVolumeArray(0)
+  fDetectorConstruction(0),
+  fGeometryId(-1),
+  fNofScoringVolumes(0),
+  fPhaseSpaceWriter(B1PhaseSpaceWriter::Instance()),
+  fFastShapes(B1FastShapes::Instance()),
+  fStepTrace(B1StepTrace::Instance()),
+  fPerturbation(B1Perturbation::Instance()),
+  fGamma(G4Gamma::Gamma())
 {}
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -54,11 +67,26 @@ B1SteppingAction::~B1SteppingAction()
 
 void B1SteppingAction::UserSteppingAction(const G4Step* step)
 {
-  if (!fScoringVolumeArray) {
-    const B1DetectorConstruction* detectorConstruction
+  if (fStepTrace->IsActive()) fStepTrace->ProcessStep(step);
+  if (fPhaseSpaceWriter->IsActive()) fPhaseSpaceWriter->ProcessStep(step);
+  if (fFastShapes->IsCalibrating()) fFastShapes->ProcessStep(step);
+
+  if (!fDetectorConstruction) {
+    fDetectorConstruction
       = static_cast<const B1DetectorConstruction*>
         (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
-    fScoringVolumeArray = detectorConstruction->GetScoringVolumes();
+  }
+  // volumes are cached per construction, they change on a geometry rebuild
+  if (fGeometryId != fDetectorConstruction->GetGeometryId()) {
+    fGeometryId = fDetectorConstruction->GetGeometryId();
+    fScoringVolumes = fDetectorConstruction->GetScoringVolumes();
+    fSolidVolumes = fDetectorConstruction->GetSolidVolumes();
+    fNofScoringVolumes = (G4int)fScoringVolumes.size();
+    fKermaTables.resize(fNofScoringVolumes);
+    for (G4int i = 0; i < fNofScoringVolumes; i++) {
+      fKermaTables[i]
+        = B1AttenuationTable::GetShared(fScoringVolumes[i]->GetMaterial());
+    }
   }
 
   // get volume of the current step
@@ -67,27 +95,47 @@ void B1SteppingAction::UserSteppingAction(const G4Step* step)
       ->GetVolume()->GetLogicalVolume();
       
   // check if we are in scoring volume
-  if ((volume != fScoringVolumeArray[0]) &&
-		  (volume != fScoringVolumeArray[1]) &&
-		  (volume != fScoringVolumeArray[2]) &&
-		  (volume != fScoringVolumeArray[3]) &&
-		  (volume != fScoringVolumeArray[4]) &&
-		  (volume != fScoringVolumeArray[5]) &&
-		  (volume != fScoringVolumeArray[6]) &&
-		  (volume != fScoringVolumeArray[7]) &&
-		  (volume != fScoringVolumeArray[8]) &&
-		  (volume != fScoringVolumeArray[9]) &&
-		  (volume != fScoringVolumeArray[10]) &&
-		  (volume != fScoringVolumeArray[11]) &&
-		  (volume != fScoringVolumeArray[12]) &&
-		  (volume != fScoringVolumeArray[13]) &&
-		  (volume != fScoringVolumeArray[14]) &&
-		  (volume != fScoringVolumeArray[15]))
-	  return;
-
-  // collect energy deposited in this step
-  G4double edepStep = step->GetTotalEnergyDeposit();
-  fEventAction->AddEdep(edepStep);  
+  G4int detector = -1;
+  for (G4int i = 0; i < fNofScoringVolumes; i++) {
+    if (volume == fScoringVolumes[i]) {
+      detector = i;
+      break;
+    }
+  }
+
+  // likelihood ratios of the perturbed materials
+  if (fPerturbation->IsActive()) {
+    G4bool inShape = false;
+    for (size_t i = 0; detector < 0 && i < fSolidVolumes.size(); i++) {
+      if (volume == fSolidVolumes[i]) {
+        inShape = true;
+        break;
+      }
+    }
+    if (detector >= 0 || inShape) {
+      fPerturbation->ProcessStep(step, (detector >= 0)
+                                 ? B1Perturbation::kDetectors
+                                 : B1Perturbation::kShapes,
+                                 fEventAction->GetPerturbationScores());
+    }
+  }
+
+  if (detector < 0) return;
+
+  // collect energy deposited in this step,
+  // weighted for primaries replayed from a phase space
+  const G4StepPoint* prePoint = step->GetPreStepPoint();
+  G4double weight = prePoint->GetWeight();
+  G4double edepStep = step->GetTotalEnergyDeposit() * weight;
+  fEventAction->AddEdep(detector, edepStep);  
+
+  // track-length kerma of the photons
+  if (step->GetTrack()->GetDefinition() == fGamma) {
+    G4double energy = prePoint->GetKineticEnergy();
+    G4double kerma = weight * step->GetStepLength() * energy
+                     * fKermaTables[detector]->GetMuEn(energy);
+    fEventAction->AddKerma(detector, kerma);
+  }
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
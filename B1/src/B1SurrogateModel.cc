@@ -0,0 +1,699 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1SurrogateModel.cc
+/// \brief Implementation of the B1SurrogateModel class
+
+#include "B1SurrogateModel.hh"
+#include "B1ResultCache.hh"
+#include "B1DetectorConstruction.hh"
+#include "B1Run.hh"
+
+#include "G4RunManager.hh"
+#include "G4UImanager.hh"
+#include "G4UIcommand.hh"
+#include "G4GenericMessenger.hh"
+#include "G4LogicalVolume.hh"
+#include "G4UnitsTable.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+  // events added to a targeted point at once, in events per point
+  const G4double maximumBatches = 8.;
+
+  // reads "value... unit"
+  G4bool ReadValues(const G4String& text, std::vector<G4double>& values)
+  {
+    std::istringstream input(text);
+    std::vector<G4String> words;
+    G4String word;
+    while (input >> word) words.push_back(word);
+    if (words.size() < 2 || G4UIcommand::ValueOf(words.back()) <= 0.) {
+      return false;
+    }
+    G4double unit = G4UIcommand::ValueOf(words.back());
+    std::vector<G4double> result;
+    for (size_t i = 0; i + 1 < words.size(); i++) {
+      std::istringstream number(words[i]);
+      G4double value = 0.;
+      if (!(number >> value) || !(value > 0.)) return false;
+      result.push_back(value*unit);
+    }
+    values = result;
+    return true;
+  }
+
+  // nodes of an axis around x, both x when it is a node
+  G4bool Bracket(const std::set<G4double>& axis, G4double x,
+                 G4double& lower, G4double& upper)
+  {
+    std::set<G4double>::const_iterator it = axis.lower_bound(x);
+    if (it == axis.end()) return false;
+    upper = *it;
+    if (upper == x) {
+      lower = upper;
+      return true;
+    }
+    if (it == axis.begin()) return false;
+    lower = *--it;
+    return true;
+  }
+}
+
+B1SurrogateModel* B1SurrogateModel::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B1SurrogateModel::Sample::GetDose() const
+{
+  return (fEvents > 0. && fMass > 0.) ? fSum/fEvents/fMass : 0.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B1SurrogateModel::Sample::GetError() const
+{
+  if (fEvents <= 1. || fMass <= 0.) return 0.;
+  G4double mean = fSum/fEvents;
+  G4double variance = (fSum2/fEvents - mean*mean)/fEvents;
+  return variance > 0. ? std::sqrt(variance)/fMass : 0.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B1SurrogateModel::Answer::GetError() const
+{
+  return std::sqrt(fStatisticalError*fStatisticalError
+                   + fInterpolationError*fInterpolationError);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B1SurrogateModel::Answer::GetRelativeError() const
+{
+  // a dose of zero gives no relative error to improve
+  return fDose > 0. ? GetError()/fDose : 0.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1SurrogateModel* B1SurrogateModel::Instance()
+{
+  if (!fgInstance) fgInstance = new B1SurrogateModel;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1SurrogateModel::B1SurrogateModel()
+: fMessenger(0),
+  fFileName("surrogate.txt"),
+  fEventsPerPoint(10000),
+  fMaxError(0.05),
+  fAutoRun(true),
+  fCurrent(0)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1SurrogateModel::~B1SurrogateModel()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1SurrogateModel::SetMaterials(G4String materials)
+{
+  std::istringstream input(materials);
+  G4String material;
+  fMaterials.clear();
+  while (input >> material) fMaterials.push_back(material);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1SurrogateModel::SetEnergies(G4String energies)
+{
+  if (!ReadValues(energies, fEnergyGrid)) {
+    G4ExceptionDescription msg;
+    msg << "Cannot read the energies \"" << energies
+        << "\", expected: value... unit.";
+    G4Exception("B1SurrogateModel::SetEnergies()", "MyCode0026",
+                JustWarning, msg);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1SurrogateModel::SetRadii(G4String radii)
+{
+  if (!ReadValues(radii, fRadiusGrid)) {
+    G4ExceptionDescription msg;
+    msg << "Cannot read the radii \"" << radii
+        << "\", expected: value... unit.";
+    G4Exception("B1SurrogateModel::SetRadii()", "MyCode0026",
+                JustWarning, msg);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+const B1SurrogateModel::Sample* B1SurrogateModel::FindSample(
+  const NodeMap& nodes, G4double energy, G4double radius,
+  G4int detector) const
+{
+  NodeMap::const_iterator node = nodes.find(NodeKey(energy, radius));
+  if (node == nodes.end() || detector < 0
+      || detector >= (G4int)node->second.size()
+      || node->second[detector].fEvents <= 0.) return 0;
+  return &node->second[detector];
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B1SurrogateModel::GetCurvature(const Slice& slice,
+                                        G4bool alongEnergy, G4double node,
+                                        G4double other, G4int detector) const
+{
+  // significant second derivative at an interior node of the axis
+  const std::set<G4double>& axis
+    = alongEnergy ? slice.fEnergies : slice.fRadii;
+  std::set<G4double>::const_iterator it = axis.find(node);
+  if (it == axis.end() || it == axis.begin()) return 0.;
+  std::set<G4double>::const_iterator previous = it, next = it;
+  --previous;
+  ++next;
+  if (next == axis.end()) return 0.;
+
+  const Sample* sampleM = alongEnergy
+    ? FindSample(slice.fNodes, *previous, other, detector)
+    : FindSample(slice.fNodes, other, *previous, detector);
+  const Sample* sample = alongEnergy
+    ? FindSample(slice.fNodes, node, other, detector)
+    : FindSample(slice.fNodes, other, node, detector);
+  const Sample* sampleP = alongEnergy
+    ? FindSample(slice.fNodes, *next, other, detector)
+    : FindSample(slice.fNodes, other, *next, detector);
+  if (!sampleM || !sample || !sampleP) return -1.;
+
+  G4double um = alongEnergy ? std::log(*previous) : *previous;
+  G4double u  = alongEnergy ? std::log(node) : node;
+  G4double up = alongEnergy ? std::log(*next) : *next;
+  G4double a = 2./((up - um)*(u - um));
+  G4double c = 2./((up - um)*(up - u));
+  G4double b = -(a + c);
+  G4double second = a*sampleM->GetDose() + b*sample->GetDose()
+                  + c*sampleP->GetDose();
+  G4double errorM = a*sampleM->GetError();
+  G4double error  = b*sample->GetError();
+  G4double errorP = c*sampleP->GetError();
+  G4double sigma = std::sqrt(errorM*errorM + error*error + errorP*errorP);
+  return std::max(0., std::fabs(second) - 2.*sigma);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1SurrogateModel::Answer B1SurrogateModel::Interpolate(
+  const G4String& material, G4double energy, G4double radius,
+  G4int detector) const
+{
+  Answer answer = { 0., 0., 0., false };
+  std::map<G4String, Slice>::const_iterator it = fSlices.find(material);
+  if (it == fSlices.end()) return answer;
+  const Slice& slice = it->second;
+
+  // a targeted run at the query point answers it
+  const Sample* point = FindSample(slice.fPoints, energy, radius, detector);
+  if (point) {
+    answer.fDose = point->GetDose();
+    answer.fStatisticalError = point->GetError();
+    answer.fInDomain = true;
+    return answer;
+  }
+
+  G4double energies[2], radii[2];
+  if (!Bracket(slice.fEnergies, energy, energies[0], energies[1])
+      || !Bracket(slice.fRadii, radius, radii[0], radii[1])) return answer;
+
+  // bilinear in (log energy, radius)
+  G4double t = (energies[1] > energies[0])
+    ? std::log(energy/energies[0])/std::log(energies[1]/energies[0]) : 0.;
+  G4double s = (radii[1] > radii[0])
+    ? (radius - radii[0])/(radii[1] - radii[0]) : 0.;
+  const G4double energyWeights[2] = { 1. - t, t };
+  const G4double radiusWeights[2] = { 1. - s, s };
+
+  G4double variance = 0.;
+  for (G4int i = 0; i < 2; i++) {
+    for (G4int j = 0; j < 2; j++) {
+      G4double weight = energyWeights[i]*radiusWeights[j];
+      if (weight == 0.) continue;
+      const Sample* sample
+        = FindSample(slice.fNodes, energies[i], radii[j], detector);
+      if (!sample) {
+        answer.fDose = 0.;
+        return answer;
+      }
+      answer.fDose += weight*sample->GetDose();
+      G4double error = weight*sample->GetError();
+      variance += error*error;
+    }
+  }
+  answer.fStatisticalError = std::sqrt(variance);
+
+  // interpolation error along each axis, from the sides of the cell; an
+  // incomplete grid gives no estimate, the query is then simulated
+  if (energies[1] > energies[0]) {
+    G4double curvature = 0.;
+    for (G4int i = 0; i < 2; i++) {
+      for (G4int j = 0; j < 2; j++) {
+        if (radiusWeights[j] == 0.) continue;
+        G4double value
+          = GetCurvature(slice, true, energies[i], radii[j], detector);
+        if (value < 0.) return answer;
+        curvature = std::max(curvature, value);
+      }
+    }
+    G4double u = std::log(energy);
+    answer.fInterpolationError += 0.5*(u - std::log(energies[0]))
+                                 *(std::log(energies[1]) - u)*curvature;
+  }
+  if (radii[1] > radii[0]) {
+    G4double curvature = 0.;
+    for (G4int i = 0; i < 2; i++) {
+      if (energyWeights[i] == 0.) continue;
+      for (G4int j = 0; j < 2; j++) {
+        G4double value
+          = GetCurvature(slice, false, radii[j], energies[i], detector);
+        if (value < 0.) return answer;
+        curvature = std::max(curvature, value);
+      }
+    }
+    answer.fInterpolationError
+      += 0.5*(radius - radii[0])*(radii[1] - radius)*curvature;
+  }
+  answer.fInDomain = true;
+  return answer;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1SurrogateModel::Query(G4String query)
+{
+  std::istringstream input(query);
+  G4String material, energyUnit, radiusUnit;
+  G4double energy = 0., radius = 0.;
+  G4int detector = 0;
+  if (!(input >> material >> energy >> energyUnit >> radius >> radiusUnit)
+      || G4UIcommand::ValueOf(energyUnit) <= 0.
+      || G4UIcommand::ValueOf(radiusUnit) <= 0.
+      || !(energy > 0.) || !(radius > 0.)) {
+    G4ExceptionDescription msg;
+    msg << "Cannot read the query \"" << query
+        << "\", expected: material energy unit radius unit [detector].";
+    G4Exception("B1SurrogateModel::Query()", "MyCode0026", JustWarning, msg);
+    return;
+  }
+  // optional detector, one of the geometry, nothing after it
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  G4int nofDetectors = detectorConstruction->GetNumberOfScoringVolumes();
+  G4bool readable = true;
+  G4String rest;
+  if (!(input >> detector)) {
+    readable = input.eof();  // none given, detector 0
+    detector = 0;
+  }
+  else if (input >> rest) {
+    readable = false;
+  }
+  if (!readable || detector < 0 || detector >= nofDetectors) {
+    G4ExceptionDescription msg;
+    msg << "Invalid detector in the query \"" << query << "\", the "
+        << "geometry has " << nofDetectors << " detectors (0 to "
+        << nofDetectors - 1 << ").";
+    G4Exception("B1SurrogateModel::Query()", "MyCode0026", JustWarning, msg);
+    return;
+  }
+  energy *= G4UIcommand::ValueOf(energyUnit);
+  radius *= G4UIcommand::ValueOf(radiusUnit);
+
+  if (fSlices.empty()) Load();
+
+  std::chrono::steady_clock::time_point start
+    = std::chrono::steady_clock::now();
+  Answer answer = Interpolate(material, energy, radius, detector);
+  G4double microseconds = std::chrono::duration<double, std::micro>(
+                            std::chrono::steady_clock::now() - start).count();
+
+  G4cout << "\n Surrogate " << material << ", "
+         << G4BestUnit(energy, "Energy") << ", radius "
+         << G4BestUnit(radius, "Length") << ", detector " << detector;
+  if (answer.fInDomain) {
+    G4cout << ": dose " << G4BestUnit(answer.fDose, "Dose") << " +- "
+           << 100.*answer.GetRelativeError() << " % (statistical "
+           << G4BestUnit(answer.fStatisticalError, "Dose")
+           << ", interpolation "
+           << G4BestUnit(answer.fInterpolationError, "Dose") << "), "
+           << microseconds << " us" << G4endl;
+  }
+  else {
+    G4cout << ": outside the grid, or on an incomplete cell" << G4endl;
+  }
+
+  if ((answer.fInDomain && answer.GetRelativeError() <= fMaxError)
+      || !fAutoRun) return;
+
+  // targeted run at the query point
+  if (!Simulate(material, energy, radius, fEventsPerPoint, false)) return;
+  answer = Interpolate(material, energy, radius, detector);
+  const Sample* sample = FindSample(fSlices[material].fPoints, energy,
+                                    radius, detector);
+  G4double ratio = answer.GetRelativeError()/fMaxError;
+  if (sample && ratio > 1.) {
+    // events for the target error, as N ~ 1/error^2
+    G4double needed = sample->fEvents*(ratio*ratio - 1.);
+    needed = std::max(needed, (G4double)fEventsPerPoint);
+    needed = std::min(needed, maximumBatches*fEventsPerPoint);
+    Simulate(material, energy, radius, (G4int)std::ceil(needed), false);
+    answer = Interpolate(material, energy, radius, detector);
+  }
+  Save();
+
+  G4cout << " Surrogate targeted run: dose "
+         << G4BestUnit(answer.fDose, "Dose") << " +- "
+         << 100.*answer.GetRelativeError() << " %" << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1SurrogateModel::Build()
+{
+  if (fMaterials.empty() || fEnergyGrid.empty() || fRadiusGrid.empty()) {
+    G4Exception("B1SurrogateModel::Build()", "MyCode0026", JustWarning,
+                "No materials, energies or radii to build the table on.");
+    return;
+  }
+  if (fSlices.empty()) Load();
+
+  // the radius changes least often, as it rebuilds the geometry
+  G4int simulated = 0;
+  for (size_t m = 0; m < fMaterials.size(); m++) {
+    for (size_t r = 0; r < fRadiusGrid.size(); r++) {
+      for (size_t e = 0; e < fEnergyGrid.size(); e++) {
+        const Sample* sample = FindSample(fSlices[fMaterials[m]].fNodes,
+                                          fEnergyGrid[e], fRadiusGrid[r], 0);
+        if (sample && sample->fEvents >= fEventsPerPoint) continue;
+        if (!Simulate(fMaterials[m], fEnergyGrid[e], fRadiusGrid[r],
+                      fEventsPerPoint, true)) {
+          Save();
+          return;
+        }
+        simulated++;
+      }
+    }
+  }
+  Save();
+  G4cout << " Surrogate table: " << simulated << " nodes simulated" << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B1SurrogateModel::Simulate(const G4String& material, G4double energy,
+                                  G4double radius, G4int nofEvents,
+                                  G4bool onGrid)
+{
+  if (!B1DetectorConstruction::FindMaterial(material)) {
+    G4ExceptionDescription msg;
+    msg << "Unknown material " << material << ", no run made.";
+    G4Exception("B1SurrogateModel::Simulate()", "MyCode0026",
+                JustWarning, msg);
+    return false;
+  }
+
+  G4UImanager* uiManager = G4UImanager::GetUIpointer();
+  std::ostringstream command;
+  command << std::setprecision(17);
+  command << "/B1/det/shapeMaterial " << material;
+  uiManager->ApplyCommand(command.str());
+  command.str("");
+  command << "/B1/det/detectorRadius " << radius/mm << " mm";
+  uiManager->ApplyCommand(command.str());
+  command.str("");
+  command << "/gun/energy " << energy/MeV << " MeV";
+  uiManager->ApplyCommand(command.str());
+
+  Slice& slice = fSlices[material];
+  NodeMap& nodes = onGrid ? slice.fNodes : slice.fPoints;
+  NodeKey key(energy, radius);
+  std::vector<Sample>& node = nodes[key];
+  G4double events = node.empty() ? 0. : node[0].fEvents;
+
+  fCurrent = &node;
+  B1ResultCache::Instance()->BeamOn(nofEvents);
+  fCurrent = 0;
+
+  if (node.empty() || node[0].fEvents <= events) {
+    if (node.empty()) nodes.erase(key);
+    G4Exception("B1SurrogateModel::Simulate()", "MyCode0026", JustWarning,
+                "Run aborted, the node is not added.");
+    return false;
+  }
+  if (onGrid) {
+    slice.fEnergies.insert(energy);
+    slice.fRadii.insert(radius);
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1SurrogateModel::EndOfRun(const B1Run* run)
+{
+  if (!fCurrent || run->GetNumberOfEvent() <= 0) return;
+
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+
+  // runs of one node are independent, their sums add up
+  G4int nofDetectors = run->GetNumberOfDetectors();
+  if (fCurrent->empty()) {
+    Sample empty = { 0., 0., 0., 0. };
+    fCurrent->assign(nofDetectors, empty);
+  }
+  if ((G4int)fCurrent->size() != nofDetectors) return;
+  for (G4int i = 0; i < nofDetectors; i++) {
+    Sample& sample = (*fCurrent)[i];
+    sample.fSum    += run->GetDetectorEdep(i);
+    sample.fSum2   += run->GetDetectorEdep2(i);
+    sample.fEvents += run->GetNumberOfEvent();
+    sample.fMass = detectorConstruction->GetScoringVolumes()[i]->GetMass();
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1SurrogateModel::Load()
+{
+  std::ifstream file(fFileName.c_str());
+  if (fFileName.empty() || !file) return;
+
+  fSlices.clear();
+  G4int nofNodes = 0;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream input(line);
+    G4String kind, material;
+    G4double energy, radius;
+    G4int detector;
+    Sample sample;
+    if (!(input >> kind >> material >> energy >> radius >> detector
+                >> sample.fSum >> sample.fSum2 >> sample.fEvents
+                >> sample.fMass)
+        || (kind != "grid" && kind != "point") || detector < 0) {
+      G4ExceptionDescription msg;
+      msg << "Cannot read the line \"" << line << "\" of " << fFileName
+          << ", it is skipped.";
+      G4Exception("B1SurrogateModel::Load()", "MyCode0026", JustWarning, msg);
+      continue;
+    }
+    energy *= MeV;
+    radius *= mm;
+    sample.fSum  *= MeV;
+    sample.fSum2 *= MeV*MeV;
+    sample.fMass *= kg;
+
+    Slice& slice = fSlices[material];
+    G4bool onGrid = (kind == "grid");
+    NodeMap& nodes = onGrid ? slice.fNodes : slice.fPoints;
+    std::vector<Sample>& node = nodes[NodeKey(energy, radius)];
+    if (node.empty()) nofNodes++;
+    if ((G4int)node.size() <= detector) {
+      Sample empty = { 0., 0., 0., 0. };
+      node.resize(detector + 1, empty);
+    }
+    node[detector] = sample;
+    if (onGrid) {
+      slice.fEnergies.insert(energy);
+      slice.fRadii.insert(radius);
+    }
+  }
+  G4cout << " Surrogate table: " << nofNodes << " nodes read from "
+         << fFileName << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1SurrogateModel::Save() const
+{
+  if (fFileName.empty()) return;
+
+  // written aside and renamed, an interrupted run leaves the old table
+  G4String tmpName = fFileName + ".tmp";
+  std::ofstream file(tmpName.c_str());
+  file << "# grid|point  material  energy [MeV]  radius [mm]  detector"
+       << "  sum [MeV]  sum2 [MeV^2]  events  mass [kg]\n"
+       << std::setprecision(17);
+  for (std::map<G4String, Slice>::const_iterator slice = fSlices.begin();
+       slice != fSlices.end(); ++slice) {
+    WriteNodes(file, "grid", slice->first, slice->second.fNodes);
+    WriteNodes(file, "point", slice->first, slice->second.fPoints);
+  }
+  file.close();
+  if (!file || std::rename(tmpName.c_str(), fFileName.c_str()) != 0) {
+    G4ExceptionDescription msg;
+    msg << "Cannot write the surrogate table " << fFileName << ".";
+    G4Exception("B1SurrogateModel::Save()", "MyCode0026", JustWarning, msg);
+    std::remove(tmpName.c_str());
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1SurrogateModel::WriteNodes(std::ostream& out, const G4String& kind,
+                                  const G4String& material,
+                                  const NodeMap& nodes) const
+{
+  for (NodeMap::const_iterator node = nodes.begin(); node != nodes.end();
+       ++node) {
+    for (size_t i = 0; i < node->second.size(); i++) {
+      const Sample& sample = node->second[i];
+      out << kind << " " << material << " " << node->first.first/MeV << " "
+          << node->first.second/mm << " " << i << " "
+          << sample.fSum/MeV << " " << sample.fSum2/(MeV*MeV) << " "
+          << sample.fEvents << " " << sample.fMass/kg << "\n";
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1SurrogateModel::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/surrogate/",
+                                      "Interpolated dose table");
+
+  // the table drives the runs from the master
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareProperty("file", fFileName,
+        "File of the table, read at the first use and after every run.");
+  fileCmd.SetParameterName("fileName", true);
+  fileCmd.SetDefaultValue("");
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& loadCmd
+    = fMessenger->DeclareMethod("load", &B1SurrogateModel::Load,
+        "Replace the table by the contents of its file.");
+  loadCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& materialsCmd
+    = fMessenger->DeclareMethod("materials", &B1SurrogateModel::SetMaterials,
+        "Materials of the shapes the table is built for.");
+  materialsCmd.SetParameterName("materials", false);
+  materialsCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& energiesCmd
+    = fMessenger->DeclareMethod("energies", &B1SurrogateModel::SetEnergies,
+        "Beam energies the table is built for: value... unit.");
+  energiesCmd.SetParameterName("energies", false);
+  energiesCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& radiiCmd
+    = fMessenger->DeclareMethod("radii", &B1SurrogateModel::SetRadii,
+        "Detector radii the table is built for: value... unit.");
+  radiiCmd.SetParameterName("radii", false);
+  radiiCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& eventsCmd
+    = fMessenger->DeclareProperty("eventsPerPoint", fEventsPerPoint,
+        "Events of a node of the table, and of a targeted run.");
+  eventsCmd.SetParameterName("events", false);
+  eventsCmd.SetRange("events>0");
+  eventsCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& buildCmd
+    = fMessenger->DeclareMethod("build", &B1SurrogateModel::Build,
+        "Simulate the nodes of the grid missing from the table.");
+  buildCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& errorCmd
+    = fMessenger->DeclareProperty("maxError", fMaxError,
+        "Relative uncertainty above which a query is simulated.");
+  errorCmd.SetParameterName("error", false);
+  errorCmd.SetRange("error>0.");
+  errorCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& autoCmd
+    = fMessenger->DeclareProperty("autoRun", fAutoRun,
+        "Simulate the queries the table cannot answer.");
+  autoCmd.SetParameterName("flag", true);
+  autoCmd.SetDefaultValue("true");
+  autoCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& queryCmd
+    = fMessenger->DeclareMethod("query", &B1SurrogateModel::Query,
+        "Dose of a detector: material energy unit radius unit [detector].");
+  queryCmd.SetParameterName("query", false);
+  queryCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
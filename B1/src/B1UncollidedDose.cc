@@ -0,0 +1,535 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file B1UncollidedDose.cc
+/// \brief Implementation of the B1RayTracer and B1UncollidedDose classes
+
+#include "B1UncollidedDose.hh"
+#include "B1AttenuationTable.hh"
+#include "B1DetectorConstruction.hh"
+#include "B1EnergySpectrum.hh"
+#include "B1Run.hh"
+
+#include "G4RunManager.hh"
+#include "G4TransportationManager.hh"
+#include "G4Navigator.hh"
+#include "G4PhysicalVolumeStore.hh"
+#include "G4LogicalVolumeStore.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VSolid.hh"
+#include "G4VisExtent.hh"
+#include "G4Box.hh"
+#include "G4Material.hh"
+#include "G4GenericMessenger.hh"
+#include "G4AutoLock.hh"
+#include "G4UnitsTable.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4Timer.hh"
+#include "geomdefs.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cmath>
+#include <iomanip>
+
+namespace
+{
+  G4Mutex tracerMutex = G4MUTEX_INITIALIZER;
+
+  G4ThreadLocal B1RayTracer* threadTracer = 0;
+
+  // tracers of all threads, deleted with the B1UncollidedDose instance
+  std::vector<B1RayTracer*> tracers;
+
+  const G4int maxSegments = 10000;
+
+  // translation of a volume in the world, assuming unrotated placements
+  G4ThreeVector GlobalTranslation(const G4VPhysicalVolume* volume)
+  {
+    G4ThreeVector translation = volume->GetTranslation();
+    G4PhysicalVolumeStore* store = G4PhysicalVolumeStore::GetInstance();
+    G4bool found = true;
+    while (found) {
+      found = false;
+      for (size_t i = 0; i < store->size(); i++) {
+        G4VPhysicalVolume* mother = (*store)[i];
+        if (mother->GetLogicalVolume()->IsDaughter(volume)) {
+          translation += mother->GetTranslation();
+          volume = mother;
+          found = true;
+          break;
+        }
+      }
+    }
+    return translation;
+  }
+
+  // samples of one axis of the spot falling on [lo, hi]: centres and
+  // probabilities of the cells
+  void SpotCells(G4double centre, G4double width, G4double lo, G4double hi,
+                 G4int n, std::vector<G4double>& positions,
+                 std::vector<G4double>& probabilities)
+  {
+    positions.clear();
+    probabilities.clear();
+    if (width <= 0.) {
+      if (centre >= lo && centre <= hi) {
+        positions.push_back(centre);
+        probabilities.push_back(1.);
+      }
+      return;
+    }
+    G4double a = std::max(lo, centre - 0.5*width);
+    G4double b = std::min(hi, centre + 0.5*width);
+    if (b <= a) return;
+    G4double step = (b - a)/n;
+    for (G4int i = 0; i < n; i++) {
+      positions.push_back(a + (i + 0.5)*step);
+      probabilities.push_back(step/width);
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1RayTracer* B1RayTracer::GetThreadInstance()
+{
+  if (!threadTracer) {
+    threadTracer = new B1RayTracer;
+    G4AutoLock lock(&tracerMutex);
+    tracers.push_back(threadTracer);
+  }
+  return threadTracer;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1RayTracer::B1RayTracer()
+: fNavigator(new G4Navigator),
+  fWorld(0),
+  fGeometryId(-1)
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1RayTracer::~B1RayTracer()
+{
+  delete fNavigator;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RayTracer::Setup()
+{
+  fWorld = G4TransportationManager::GetTransportationManager()
+             ->GetNavigatorForTracking()->GetWorldVolume();
+  fNavigator->SetWorldVolume(fWorld);
+
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  fDetectors = detectorConstruction->GetScoringVolumes();
+  fGeometryId = detectorConstruction->GetGeometryId();
+  G4int nofDetectors = (G4int)fDetectors.size();
+
+  fFootprints.assign(4*nofDetectors, 0.);
+  G4PhysicalVolumeStore* store = G4PhysicalVolumeStore::GetInstance();
+  for (G4int d = 0; d < nofDetectors; d++) {
+    for (size_t i = 0; i < store->size(); i++) {
+      if ((*store)[i]->GetLogicalVolume() != fDetectors[d]) continue;
+      G4ThreeVector centre = GlobalTranslation((*store)[i]);
+      G4VisExtent extent = fDetectors[d]->GetSolid()->GetExtent();
+      fFootprints[4*d]   = centre.x() + extent.GetXmin();
+      fFootprints[4*d+1] = centre.x() + extent.GetXmax();
+      fFootprints[4*d+2] = centre.y() + extent.GetYmin();
+      fFootprints[4*d+3] = centre.y() + extent.GetYmax();
+      break;
+    }
+  }
+
+  fTables.assign(G4Material::GetNumberOfMaterials(), 0);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RayTracer::GetFootprint(G4int detector, G4double& xMin, G4double& xMax,
+                               G4double& yMin, G4double& yMax) const
+{
+  xMin = fFootprints[4*detector];
+  xMax = fFootprints[4*detector+1];
+  yMin = fFootprints[4*detector+2];
+  yMax = fFootprints[4*detector+3];
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RayTracer::Trace(const G4ThreeVector& start)
+{
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  if (detectorConstruction->GetGeometryId() != fGeometryId) Setup();
+
+  fSegmentTable.clear();
+  fSegmentLength.clear();
+  fSegmentDetector.clear();
+
+  const G4ThreeVector direction(0., 0., 1.);
+  G4ThreeVector position = start;
+  fNavigator->ResetStackAndState();
+  G4VPhysicalVolume* volume
+    = fNavigator->LocateGlobalPointAndSetup(position, &direction, false, false);
+
+  while (volume && (G4int)fSegmentLength.size() < maxSegments) {
+    G4double safety;
+    G4double step = fNavigator->ComputeStep(position, direction, kInfinity, safety);
+    if (step == kInfinity) break;
+
+    G4LogicalVolume* logical = volume->GetLogicalVolume();
+    if (step > 0.) {
+      const G4Material* material = logical->GetMaterial();
+      size_t index = material->GetIndex();
+      if (index >= fTables.size()) fTables.resize(index + 1, 0);
+      if (!fTables[index]) fTables[index] = B1AttenuationTable::GetShared(material);
+
+      G4int detector = -1;
+      for (size_t d = 0; d < fDetectors.size(); d++) {
+        if (fDetectors[d] == logical) { detector = (G4int)d; break; }
+      }
+      fSegmentTable.push_back(fTables[index]);
+      fSegmentLength.push_back(step);
+      fSegmentDetector.push_back(detector);
+    }
+
+    position += step*direction;
+    fNavigator->SetGeometricallyLimitedStep();
+    volume = fNavigator->LocateGlobalPointAndSetup(position, &direction, true, false);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1RayTracer::AddDeposits(G4double energy, G4double weight,
+                              G4double* deposits)
+{
+  const G4int n = (G4int)fSegmentLength.size();
+  fMu.resize(n);
+  fMuTr.resize(n);
+  fAttenuation.resize(n);
+  if (n == 0) return;
+
+  G4double* mu = &fMu[0];
+  G4double* muTr = &fMuTr[0];
+  G4double* attenuation = &fAttenuation[0];
+  const G4double* length = &fSegmentLength[0];
+
+  for (G4int i = 0; i < n; i++) {
+    mu[i]   = fSegmentTable[i]->GetMu(energy);
+    muTr[i] = fSegmentTable[i]->GetMuTr(energy);
+  }
+  // optical depth of every segment, then exp(-tau) at its entrance
+  for (G4int i = 0; i < n; i++) attenuation[i] = mu[i]*length[i];
+  G4double tau = 0.;
+  for (G4int i = 0; i < n; i++) {
+    G4double depth = attenuation[i];
+    attenuation[i] = tau;
+    tau += depth;
+  }
+  for (G4int i = 0; i < n; i++) attenuation[i] = std::exp(-attenuation[i]);
+
+  const G4double scale = weight*energy;
+  for (G4int i = 0; i < n; i++) {
+    G4int detector = fSegmentDetector[i];
+    if (detector < 0 || mu[i] <= 0.) continue;
+    deposits[detector] += scale * attenuation[i] * muTr[i]/mu[i]
+                          * (1. - std::exp(-mu[i]*length[i]));
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1UncollidedDose* B1UncollidedDose::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1UncollidedDose* B1UncollidedDose::Instance()
+{
+  if (!fgInstance) fgInstance = new B1UncollidedDose;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1UncollidedDose::B1UncollidedDose()
+: fMessenger(0),
+  fNofRays(32),
+  fEnergy(6.*MeV),
+  fSpectrumType("histogram"),
+  fControlVariate(false)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B1UncollidedDose::~B1UncollidedDose()
+{
+  G4AutoLock lock(&tracerMutex);
+  for (size_t i = 0; i < tracers.size(); i++) delete tracers[i];
+  tracers.clear();
+  threadTracer = 0;
+
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B1UncollidedDose::ReadBeamSpot(B1BeamSpot& spot)
+{
+  G4LogicalVolume* envLV
+    = G4LogicalVolumeStore::GetInstance()->GetVolume("Envelope", false);
+  G4Box* envelopeBox = envLV ? dynamic_cast<G4Box*>(envLV->GetSolid()) : 0;
+  spot.fZ = envelopeBox ? -envelopeBox->GetZHalfLength() : 0.;
+
+  float X0_Pos, X0_Area;
+  float Y0_Pos, Y0_Area;
+  FILE* parameters_file = fopen("GunPositionParameters.txt", "r");
+  if (!parameters_file) return false;
+  G4int nofRead = fscanf(parameters_file, "%f%f%f%f",
+                         &X0_Pos, &X0_Area, &Y0_Pos, &Y0_Area);
+  fclose(parameters_file);
+  if (nofRead != 4) return false;
+
+  spot.fX = X0_Pos*cm;
+  spot.fY = Y0_Pos*cm;
+  spot.fWidthX = X0_Area*cm;
+  spot.fWidthY = Y0_Area*cm;
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1UncollidedDose::ComputeDeposits(const G4ThreeVector& position,
+                                       G4double energy,
+                                       std::vector<G4double>& deposits) const
+{
+  B1RayTracer* tracer = B1RayTracer::GetThreadInstance();
+  tracer->Trace(position);
+  deposits.assign(tracer->GetNumberOfDetectors(), 0.);
+  if (!deposits.empty()) tracer->AddDeposits(energy, 1., &deposits[0]);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1UncollidedDose::ComputeExpectedDeposits(
+  const B1BeamSpot& spot,
+  const std::vector<G4double>& energies,
+  const std::vector<G4double>& probabilities,
+  std::vector<G4double>& deposits) const
+{
+  B1RayTracer* tracer = B1RayTracer::GetThreadInstance();
+  tracer->Trace(G4ThreeVector(spot.fX, spot.fY, spot.fZ));  // set up geometry
+
+  const G4int nofDetectors = tracer->GetNumberOfDetectors();
+  deposits.assign(nofDetectors, 0.);
+  std::vector<G4double> rayDeposits(nofDetectors);
+  std::vector<G4double> xs, px, ys, py;
+
+  // only rays through the footprint of a detector can reach it
+  for (G4int d = 0; d < nofDetectors; d++) {
+    G4double xMin, xMax, yMin, yMax;
+    tracer->GetFootprint(d, xMin, xMax, yMin, yMax);
+    SpotCells(spot.fX, spot.fWidthX, xMin, xMax, fNofRays, xs, px);
+    SpotCells(spot.fY, spot.fWidthY, yMin, yMax, fNofRays, ys, py);
+
+    for (size_t i = 0; i < xs.size(); i++) {
+      for (size_t j = 0; j < ys.size(); j++) {
+        tracer->Trace(G4ThreeVector(xs[i], ys[j], spot.fZ));
+        std::fill(rayDeposits.begin(), rayDeposits.end(), 0.);
+        for (size_t e = 0; e < energies.size(); e++) {
+          tracer->AddDeposits(energies[e], px[i]*py[j]*probabilities[e],
+                              &rayDeposits[0]);
+        }
+        deposits[d] += rayDeposits[d];
+      }
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1UncollidedDose::Preview()
+{
+  B1BeamSpot spot;
+  if (!ReadBeamSpot(spot)) {
+    G4Exception("B1UncollidedDose::Preview()", "MyCode0010", JustWarning,
+                "Cannot read the beam spot from GunPositionParameters.txt.");
+    return;
+  }
+
+  std::vector<G4double> energies, probabilities;
+  if (!fSpectrumFile.empty()) {
+    B1EnergySpectrum::Type type = (fSpectrumType == "discrete")
+      ? B1EnergySpectrum::kDiscrete : B1EnergySpectrum::kHistogram;
+    const B1EnergySpectrum* spectrum
+      = B1EnergySpectrum::GetShared(fSpectrumFile, type);
+    if (spectrum) spectrum->GetQuadrature(energies, probabilities);
+  }
+  if (energies.empty()) {
+    energies.push_back(fEnergy);
+    probabilities.push_back(1.);
+  }
+
+  G4Timer timer;
+  timer.Start();
+  std::vector<G4double> deposits;
+  ComputeExpectedDeposits(spot, energies, probabilities, deposits);
+  timer.Stop();
+
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  const std::vector<G4LogicalVolume*>& volumes
+    = detectorConstruction->GetScoringVolumes();
+
+  G4cout << "\n Uncollided dose per primary photon ("
+         << timer.GetRealElapsed()*1.e3 << " ms)\n"
+         << " detector   dose/primary" << G4endl;
+  for (size_t d = 0; d < deposits.size(); d++) {
+    G4cout << std::setw(9) << d << "  "
+           << G4BestUnit(deposits[d]/volumes[d]->GetMass(), "Dose") << G4endl;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1UncollidedDose::EndOfRun(const B1Run* run) const
+{
+  if (!run->HasControlVariate()) return;
+
+  G4double n = run->GetControlVariateEvents();
+  if (n < 2. || n != run->GetNumberOfEvent()) {
+    G4ExceptionDescription msg;
+    msg << "Control variate attached to " << n << " of "
+        << run->GetNumberOfEvent() << " events, not applied.";
+    G4Exception("B1UncollidedDose::EndOfRun()", "MyCode0010", JustWarning, msg);
+    return;
+  }
+
+  const B1DetectorConstruction* detectorConstruction
+    = static_cast<const B1DetectorConstruction*>
+      (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  const std::vector<G4LogicalVolume*>& volumes
+    = detectorConstruction->GetScoringVolumes();
+
+  G4cout << "\n Uncollided control variate (" << n << " events)\n"
+         << " detector  uncollided dose        MC dose               "
+            "CV dose           gain" << G4endl;
+  for (G4int d = 0; d < run->GetNumberOfDetectors(); d++) {
+    G4double sumY  = run->GetDetectorEdep(d);
+    G4double sumY2 = run->GetDetectorEdep2(d);
+    G4double sumC  = run->GetControlVariateSum(d);
+    G4double sumC2 = run->GetControlVariateSum2(d);
+    G4double sumYC = run->GetControlVariateCross(d);
+    G4double expected = run->GetControlVariateExpected(d);
+
+    G4double varY  = (sumY2 - sumY*sumY/n) / (n - 1.);
+    G4double varC  = (sumC2 - sumC*sumC/n) / (n - 1.);
+    G4double covYC = (sumYC - sumY*sumC/n) / (n - 1.);
+    G4double beta  = (varC > 0.) ? covYC/varC : 0.;
+    if (varY < 0.) varY = 0.;
+    G4double varCV = varY - beta*covYC;
+    if (varCV < 0.) varCV = 0.;
+
+    // totals for the run, as the plain dose tally
+    G4double mass = volumes[d]->GetMass();
+    G4double total = sumY - beta*(sumC - n*expected);
+    G4cout << std::setw(9) << d << "  "
+           << std::setw(12) << G4BestUnit(n*expected/mass, "Dose") << "  "
+           << std::setw(12) << G4BestUnit(sumY/mass, "Dose") << " +- "
+           << std::setw(12) << G4BestUnit(std::sqrt(n*varY)/mass, "Dose") << "  "
+           << std::setw(12) << G4BestUnit(total/mass, "Dose") << " +- "
+           << std::setw(12) << G4BestUnit(std::sqrt(n*varCV)/mass, "Dose") << "  "
+           << std::setw(6) << (varCV > 0. ? varY/varCV : 1.)
+           << G4endl;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B1UncollidedDose::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B1/uncollided/",
+                                      "Analytic uncollided-photon dose");
+
+  // the settings are shared by all threads, the commands act on the master
+  G4GenericMessenger::Command& previewCmd
+    = fMessenger->DeclareMethod("preview", &B1UncollidedDose::Preview,
+        "Print the uncollided dose per primary in every detector "
+        "for the current beam spot.");
+  previewCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& raysCmd
+    = fMessenger->DeclareProperty("nRays", fNofRays,
+        "Rays per side of every detector footprint.");
+  raysCmd.SetParameterName("n", false);
+  raysCmd.SetRange("n>0");
+  raysCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& energyCmd
+    = fMessenger->DeclarePropertyWithUnit("energy", "MeV", fEnergy,
+        "Photon energy of the preview.");
+  energyCmd.SetParameterName("energy", false);
+  energyCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& typeCmd
+    = fMessenger->DeclareProperty("spectrumType", fSpectrumType,
+        "Interpretation of the preview spectrum file.");
+  typeCmd.SetParameterName("type", false);
+  typeCmd.SetCandidates("histogram discrete");
+  typeCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& spectrumCmd
+    = fMessenger->DeclareProperty("spectrum", fSpectrumFile,
+        "Spectrum file of the preview instead of a single energy "
+        "(empty string to disable).");
+  spectrumCmd.SetParameterName("fileName", true);
+  spectrumCmd.SetDefaultValue("");
+  spectrumCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& controlCmd
+    = fMessenger->DeclareProperty("controlVariate", fControlVariate,
+        "Use the uncollided deposit of every event as a control variate "
+        "of the dose tally.");
+  controlCmd.SetParameterName("flag", true);
+  controlCmd.SetDefaultValue("true");
+  controlCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
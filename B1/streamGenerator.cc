@@ -0,0 +1,150 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file streamGenerator.cc
+/// \brief Synthetic per-event deposition stream for benchmarking the reader
+//
+// Usage: streamGenerator events.bin [records] [segments] [detectors]
+//
+// Writes a complete stream file in the layout of B1EventStream, without
+// running Geant4: the records are split evenly over the segments, events
+// hit 1 to 4 distinct detectors with an exponential energy. With the
+// defaults, 8M records in 8 segments over the 16 detectors, it gives the
+// benchmark of the reader, which prints its processing rate:
+//   streamGenerator events.bin && streamReader events.bin
+
+#include "B1EventStreamFormat.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+
+#include <stdint.h>
+
+namespace
+{
+  const uint64_t pageSize = 4096;
+
+  // xorshift64*, fast and good enough for synthetic data
+  uint64_t Next(uint64_t& state)
+  {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+  }
+
+  double Uniform(uint64_t& state)
+  {
+    return ((Next(state) >> 11) + 0.5) * (1./9007199254740992.);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s events.bin [records] [segments] [detectors]\n",
+            argv[0]);
+    return 1;
+  }
+  uint64_t nofRecords = (argc > 2) ? strtoull(argv[2], 0, 10) : 8000000;
+  uint32_t nofSegments = (argc > 3) ? (uint32_t)atoi(argv[3]) : 8;
+  uint32_t nofDetectors = (argc > 4) ? (uint32_t)atoi(argv[4]) : 16;
+  if (nofSegments == 0 || nofSegments > kB1EventStreamMaxSegments
+      || nofDetectors == 0) {
+    fprintf(stderr, "Between 1 and %u segments and at least one detector\n",
+            kB1EventStreamMaxSegments);
+    return 1;
+  }
+
+  FILE* output = fopen(argv[1], "wb");
+  if (!output) {
+    fprintf(stderr, "Cannot create %s\n", argv[1]);
+    return 1;
+  }
+
+  B1EventStreamHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.fMagic, "B1EVS001", 8);
+  header.fNofSegments = nofSegments;
+  header.fNofDetectors = nofDetectors;
+  header.fSegmentCapacity = (nofRecords + nofSegments - 1)/nofSegments;
+  header.fDataOffset
+    = ((sizeof(B1EventStreamHeader) + pageSize - 1)/pageSize)*pageSize;
+  header.fComplete = 1;
+
+  // each segment gets whole events, as a worker thread writes them
+  std::vector<B1EventStreamRecord> segment(header.fSegmentCapacity);
+  std::vector<char> padding(header.fDataOffset - sizeof(header), 0);
+  fwrite(&header, sizeof(header), 1, output);
+  fwrite(&padding[0], 1, padding.size(), output);
+
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  uint64_t left = nofRecords;
+  int32_t eventID = 0;
+  for (uint32_t s = 0; s < nofSegments; s++) {
+    uint64_t capacity = header.fSegmentCapacity;
+    uint64_t count = 0;
+    while (count < capacity && left > 0) {
+      uint64_t hits = 1 + Next(state) % 4;
+      if (hits > nofDetectors) hits = nofDetectors;
+      if (hits > capacity - count) hits = capacity - count;
+      if (hits > left) hits = left;
+      uint32_t first = (uint32_t)(Next(state) % nofDetectors);
+      for (uint64_t h = 0; h < hits; h++) {
+        B1EventStreamRecord& record = segment[count++];
+        record.fEventID = eventID;
+        record.fDetector = (int32_t)((first + h) % nofDetectors);
+        record.fEdep = -std::log(Uniform(state));
+      }
+      left -= hits;
+      eventID++;
+    }
+    header.fCounts[s] = count;
+    std::memset(&segment[count], 0,
+                (capacity - count)*sizeof(B1EventStreamRecord));
+    fwrite(&segment[0], sizeof(B1EventStreamRecord), capacity, output);
+  }
+
+  // the counts are known once the segments are written
+  fseek(output, 0, SEEK_SET);
+  fwrite(&header, sizeof(header), 1, output);
+  if (fclose(output) != 0) {
+    fprintf(stderr, "Cannot write %s\n", argv[1]);
+    return 1;
+  }
+  printf("%s: %llu records, %d events, %u segments, %u detectors\n",
+         argv[1], (unsigned long long)nofRecords, eventID, nofSegments,
+         nofDetectors);
+  return 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,180 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+// $Id$
+//
+/// \file streamReader.cc
+/// \brief Reader of the per-event deposition stream of the B1 example
+//
+// Usage: streamReader events.bin [-f]
+//
+// Maps the stream file written by B1EventStream read-only and processes
+// the records in place: energy and hit count per detector, detector
+// multiplicity per event and the matrix of two-detector coincidences.
+// With -f it follows a file still being written, processing new records
+// as the workers publish them, until the run is complete. The processing
+// rate is printed at the end.
+
+#include "B1EventStreamFormat.hh"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s events.bin [-f]\n", argv[0]);
+    return 1;
+  }
+  bool follow = (argc > 2 && std::strcmp(argv[2], "-f") == 0);
+
+  int file = open(argv[1], O_RDONLY);
+  struct stat status;
+  if (file < 0 || fstat(file, &status) != 0
+      || (size_t)status.st_size < sizeof(B1EventStreamHeader)) {
+    fprintf(stderr, "Cannot open %s\n", argv[1]);
+    return 1;
+  }
+  size_t size = (size_t)status.st_size;
+  void* base = mmap(0, size, PROT_READ, MAP_SHARED, file, 0);
+  if (base == MAP_FAILED) {
+    fprintf(stderr, "Cannot map %s\n", argv[1]);
+    return 1;
+  }
+
+  const B1EventStreamHeader* header
+    = static_cast<const B1EventStreamHeader*>(base);
+  if (std::memcmp(header->fMagic, "B1EVS001", 8) != 0
+      || header->fNofSegments > kB1EventStreamMaxSegments
+      || header->fDataOffset + header->fNofSegments*header->fSegmentCapacity
+         *sizeof(B1EventStreamRecord) > size) {
+    fprintf(stderr, "%s is not a B1 event stream\n", argv[1]);
+    return 1;
+  }
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+  const uint32_t nofSegments = header->fNofSegments;
+  const uint32_t nofDetectors = header->fNofDetectors;
+  const B1EventStreamRecord* records
+    = reinterpret_cast<const B1EventStreamRecord*>(
+        static_cast<const char*>(base) + header->fDataOffset);
+
+  std::vector<uint64_t> done(nofSegments, 0);
+  std::vector<double>   energy(nofDetectors, 0.);
+  std::vector<uint64_t> hits(nofDetectors, 0);
+  std::vector<uint64_t> multiplicity(nofDetectors + 1, 0);
+  std::vector<uint64_t> coincidences(nofDetectors*nofDetectors, 0);
+  std::vector<uint32_t> eventDetectors;
+  eventDetectors.reserve(nofDetectors);
+  uint64_t nofRecords = 0, nofEvents = 0;
+  double seconds = 0.;
+
+  for (;;) {
+    bool complete = __atomic_load_n(&header->fComplete, __ATOMIC_ACQUIRE) != 0;
+
+    std::chrono::steady_clock::time_point start
+      = std::chrono::steady_clock::now();
+    for (uint32_t s = 0; s < nofSegments; s++) {
+      // records up to the count are complete events
+      uint64_t count = __atomic_load_n(&header->fCounts[s], __ATOMIC_ACQUIRE);
+      const B1EventStreamRecord* segment = records + s*header->fSegmentCapacity;
+      uint64_t i = done[s];
+      while (i < count) {
+        int32_t eventID = segment[i].fEventID;
+        eventDetectors.clear();
+        for (; i < count && segment[i].fEventID == eventID; i++) {
+          uint32_t d = (uint32_t)segment[i].fDetector;
+          if (d >= nofDetectors) continue;
+          energy[d] += segment[i].fEdep;
+          hits[d]++;
+          eventDetectors.push_back(d);
+        }
+        for (size_t a = 0; a < eventDetectors.size(); a++) {
+          for (size_t b = a + 1; b < eventDetectors.size(); b++) {
+            uint32_t d1 = eventDetectors[a], d2 = eventDetectors[b];
+            if (d1 > d2) { uint32_t t = d1; d1 = d2; d2 = t; }
+            coincidences[d1*nofDetectors + d2]++;
+          }
+        }
+        multiplicity[eventDetectors.size()]++;
+        nofEvents++;
+      }
+      nofRecords += count - done[s];
+      done[s] = count;
+    }
+    seconds += std::chrono::duration<double>(
+                 std::chrono::steady_clock::now() - start).count();
+
+    if (!follow || complete) break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+
+  printf("Run %u: %llu records, %llu events with deposits, %u segments%s\n",
+         header->fRunID, (unsigned long long)nofRecords,
+         (unsigned long long)nofEvents, nofSegments,
+         header->fComplete ? "" : " (run not complete)");
+
+  printf("\n detector        hits    energy [MeV]\n");
+  for (uint32_t d = 0; d < nofDetectors; d++) {
+    printf(" %8u  %10llu  %14.6g\n", d, (unsigned long long)hits[d], energy[d]);
+  }
+
+  printf("\n multiplicity      events\n");
+  for (uint32_t m = 1; m <= nofDetectors; m++) {
+    if (multiplicity[m]) {
+      printf(" %12u  %10llu\n", m, (unsigned long long)multiplicity[m]);
+    }
+  }
+
+  printf("\n coincidences (detector pairs)\n");
+  for (uint32_t d1 = 0; d1 < nofDetectors; d1++) {
+    for (uint32_t d2 = d1 + 1; d2 < nofDetectors; d2++) {
+      uint64_t n = coincidences[d1*nofDetectors + d2];
+      if (n) printf(" %4u %4u  %10llu\n", d1, d2, (unsigned long long)n);
+    }
+  }
+
+  if (seconds > 0.) {
+    printf("\nProcessed in %.3f s: %.3g records/s, %.3g events/s, %.1f MB/s\n",
+           seconds, nofRecords/seconds, nofEvents/seconds,
+           nofRecords*sizeof(B1EventStreamRecord)/seconds/(1024.*1024.));
+  }
+
+  munmap(base, size);
+  close(file);
+  return 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
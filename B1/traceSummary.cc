@@ -0,0 +1,259 @@
+//
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+//
+//
+// $Id$
+//
+/// \file traceSummary.cc
+/// \brief Summary of the sampled step trace of the B1 example
+//
+// Usage: traceSummary trace.bin [minSteps]
+//
+// Reads the step trace written by B1StepTrace and prints:
+//  - the hot volumes: sampled steps, the estimated number of steps
+//    (sampled / rate) and the wall-clock time, each sample being charged
+//    the time elapsed on its thread since the previous sample;
+//  - the steps per particle and per process limiting the step;
+//  - the tracks with the most steps, a track being flagged as looping when
+//    its step number reaches minSteps (default 10000); with its particle,
+//    volume, energy and the mean length of its sampled steps.
+
+#include "B1StepTraceFormat.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+namespace
+{
+  struct Tally
+  {
+    Tally() : fSamples(0), fSeconds(0.), fEdep(0.) {}
+    uint64_t fSamples;
+    double   fSeconds;
+    double   fEdep;
+  };
+
+  struct TrackKey
+  {
+    uint32_t fSection;
+    int32_t  fEventID;
+    int32_t  fTrackID;
+    bool operator<(const TrackKey& other) const
+    {
+      if (fSection != other.fSection) return fSection < other.fSection;
+      if (fEventID != other.fEventID) return fEventID < other.fEventID;
+      return fTrackID < other.fTrackID;
+    }
+  };
+
+  struct TrackInfo
+  {
+    TrackKey fKey;
+    int32_t  fMaxStep;
+    uint64_t fSamples;
+    double   fLength;
+    float    fEnergy;     // at the last sample
+    uint16_t fVolume;
+    uint8_t  fParticle;
+    bool operator<(const TrackInfo& other) const
+      { return fMaxStep > other.fMaxStep; }
+  };
+
+  const char* Name(const std::vector<std::string>& names, size_t index)
+  {
+    return index < names.size() ? names[index].c_str() : "(other)";
+  }
+
+  // rows sorted by time, then samples
+  void PrintTallies(const char* title, const std::vector<std::string>& names,
+                    const std::map<uint32_t, Tally>& tallies,
+                    double rate, uint64_t samples, double seconds)
+  {
+    std::vector<std::pair<double, uint32_t> > order;
+    for (std::map<uint32_t, Tally>::const_iterator it = tallies.begin();
+         it != tallies.end(); ++it) {
+      order.push_back(std::make_pair(
+        -(it->second.fSeconds + 1.e-12*it->second.fSamples), it->first));
+    }
+    std::sort(order.begin(), order.end());
+    printf("\n %-24s %10s %12s %7s %10s %7s %12s\n", title, "sampled",
+           "est. steps", "steps%", "time [s]", "time%", "edep [MeV]");
+    for (size_t i = 0; i < order.size(); i++) {
+      const Tally& tally = tallies.find(order[i].second)->second;
+      printf(" %-24s %10llu %12.4g %6.2f%% %10.4g %6.2f%% %12.4g\n",
+             Name(names, order[i].second),
+             (unsigned long long)tally.fSamples, tally.fSamples/rate,
+             samples ? 100.*tally.fSamples/samples : 0.,
+             tally.fSeconds, seconds > 0. ? 100.*tally.fSeconds/seconds : 0.,
+             tally.fEdep/rate);
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s trace.bin [minSteps]\n", argv[0]);
+    return 1;
+  }
+  int32_t minSteps = (argc > 2) ? std::atoi(argv[2]) : 10000;
+
+  FILE* input = fopen(argv[1], "rb");
+  B1StepTraceHeader header;
+  if (!input || fread(&header, sizeof(header), 1, input) != 1
+      || std::memcmp(header.fMagic, "B1STR001", 8) != 0) {
+    fprintf(stderr, "%s is not a B1 step trace\n", argv[1]);
+    return 1;
+  }
+
+  std::vector<char> nameData(header.fNamesSize);
+  if (header.fNamesSize
+      && fread(&nameData[0], 1, header.fNamesSize, input) != header.fNamesSize) {
+    fprintf(stderr, "%s is truncated\n", argv[1]);
+    return 1;
+  }
+  std::vector<std::string> names;
+  for (size_t i = 0; i < nameData.size(); i += names.back().size() + 1) {
+    names.push_back(std::string(&nameData[i]));
+  }
+  if (names.size() != (size_t)header.fNofVolumes + header.fNofParticles
+                      + header.fNofProcesses) {
+    fprintf(stderr, "%s has an inconsistent name table\n", argv[1]);
+    return 1;
+  }
+  std::vector<std::string> volumes(names.begin(),
+                                   names.begin() + header.fNofVolumes);
+  std::vector<std::string> particles(names.begin() + header.fNofVolumes,
+    names.begin() + header.fNofVolumes + header.fNofParticles);
+  std::vector<std::string> processes(
+    names.begin() + header.fNofVolumes + header.fNofParticles, names.end());
+
+  double rate = header.fSamplingRate > 0. ? header.fSamplingRate : 1.;
+  std::map<uint32_t, Tally> byVolume, byParticle, byProcess;
+  std::map<TrackKey, TrackInfo> tracks;
+  uint64_t steps = 0, sampled = 0, nofRecords = 0;
+  double seconds = 0.;
+
+  std::vector<B1StepTraceRecord> records;
+  for (uint32_t s = 0; s < header.fNofSections; s++) {
+    B1StepTraceSection section;
+    if (fread(&section, sizeof(section), 1, input) != 1) {
+      fprintf(stderr, "%s is truncated\n", argv[1]);
+      return 1;
+    }
+    records.resize(section.fNofRecords);
+    if (section.fNofRecords
+        && fread(&records[0], sizeof(B1StepTraceRecord), records.size(), input)
+           != records.size()) {
+      fprintf(stderr, "%s is truncated\n", argv[1]);
+      return 1;
+    }
+    steps += section.fSteps;
+    sampled += section.fSampled;
+    nofRecords += records.size();
+
+    // without the records overwritten, the first interval is unknown
+    bool complete = (section.fNofRecords == section.fSampled);
+    for (size_t i = 0; i < records.size(); i++) {
+      const B1StepTraceRecord& record = records[i];
+      double interval = 0.;
+      if (i > 0) interval = record.fWallTime - records[i-1].fWallTime;
+      else if (complete) interval = record.fWallTime;
+      if (interval < 0.) interval = 0.;
+      seconds += interval;
+
+      Tally* tallies[3] = { &byVolume[record.fVolume],
+                            &byParticle[record.fParticle],
+                            &byProcess[record.fProcess] };
+      for (int t = 0; t < 3; t++) {
+        tallies[t]->fSamples++;
+        tallies[t]->fSeconds += interval;
+        tallies[t]->fEdep += record.fEdep;
+      }
+
+      TrackKey key = { s, record.fEventID, record.fTrackID };
+      std::map<TrackKey, TrackInfo>::iterator it = tracks.find(key);
+      if (it == tracks.end()) {
+        TrackInfo info = { key, 0, 0, 0., 0.f, 0, 0 };
+        it = tracks.insert(std::make_pair(key, info)).first;
+      }
+      TrackInfo& info = it->second;
+      info.fSamples++;
+      info.fLength += record.fStepLength;
+      if (record.fStepNumber >= info.fMaxStep) {
+        info.fMaxStep = record.fStepNumber;
+        info.fEnergy = record.fKineticEnergy;
+        info.fVolume = record.fVolume;
+        info.fParticle = record.fParticle;
+      }
+    }
+  }
+  fclose(input);
+
+  printf("Run %u: %llu steps on %u threads, %llu sampled (rate %g), "
+         "%llu records read\n", header.fRunID, (unsigned long long)steps,
+         header.fNofSections, (unsigned long long)sampled, header.fSamplingRate,
+         (unsigned long long)nofRecords);
+
+  PrintTallies("volume", volumes, byVolume, rate, nofRecords, seconds);
+  PrintTallies("particle", particles, byParticle, rate, nofRecords, seconds);
+  PrintTallies("process", processes, byProcess, rate, nofRecords, seconds);
+
+  std::vector<TrackInfo> sorted;
+  for (std::map<TrackKey, TrackInfo>::const_iterator it = tracks.begin();
+       it != tracks.end(); ++it) {
+    sorted.push_back(it->second);
+  }
+  std::sort(sorted.begin(), sorted.end());
+  size_t looping = 0;
+  for (size_t i = 0; i < sorted.size() && sorted[i].fMaxStep >= minSteps; i++) {
+    looping++;
+  }
+  printf("\n %llu sampled tracks, %llu with %d steps or more\n",
+         (unsigned long long)sorted.size(), (unsigned long long)looping,
+         minSteps);
+  printf(" %6s %10s %8s %10s %-12s %-20s %12s %14s\n", "thread", "event",
+         "track", "steps", "particle", "volume", "energy [MeV]",
+         "mean step [mm]");
+  for (size_t i = 0; i < sorted.size() && i < 20; i++) {
+    const TrackInfo& info = sorted[i];
+    printf(" %6u %10d %8d %10d %-12s %-20s %12.4g %14.4g%s\n",
+           info.fKey.fSection, info.fKey.fEventID, info.fKey.fTrackID,
+           info.fMaxStep, Name(particles, info.fParticle),
+           Name(volumes, info.fVolume), info.fEnergy,
+           info.fLength/info.fSamples,
+           info.fMaxStep >= minSteps ? "  looping" : "");
+  }
+  return 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......